@@ -20,9 +20,9 @@ fn main() -> Result<(), Box<dyn std::error::Error>> {
             Ok(received) => {
                 println!(
                     "Received frame {} from {} with {} vertices",
-                    received.frame.frame_number,
+                    received.frame().frame_number,
                     received.source_addr,
-                    received.frame.vertex_count()
+                    received.frame().vertex_count()
                 );
             }
             Err(e) => {
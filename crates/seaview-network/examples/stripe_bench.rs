@@ -0,0 +1,80 @@
+//! Loopback benchmark for multi-connection striping
+//!
+//! Encodes one large frame, then moves it over 1, 2, 4 and 8 striped
+//! loopback connections and reports transport throughput. Serialization is
+//! left out so the numbers show what striping changes. Scaling needs as
+//! many free cores as stripes.
+//!
+//! Run with `cargo run --release --example stripe_bench [MB]`.
+
+use seaview_network::stripe::{self, StripedFrameHeader};
+use seaview_network::{MeshFrame, MessageType, Protocol};
+use std::net::{TcpListener, TcpStream};
+use std::thread;
+use std::time::Instant;
+
+const FRAMES: u32 = 4;
+
+fn main() -> Result<(), Box<dyn std::error::Error>> {
+    let frame_mb: usize = std::env::args()
+        .nth(1)
+        .and_then(|arg| arg.parse().ok())
+        .unwrap_or(512);
+
+    let protocol = Protocol::default().with_max_message_size(usize::MAX);
+    let mut mesh = MeshFrame::new("stripe-bench".to_string(), 0);
+    mesh.vertices = vec![0.5; frame_mb * 1024 * 1024 / 4 / 9 * 9];
+    let payload = protocol.serialize_mesh(&mesh)?.payload;
+
+    println!(
+        "Frame payload: {} MB, {} frames per run, {} cores",
+        payload.len() >> 20,
+        FRAMES,
+        thread::available_parallelism().map_or(1, |n| n.get())
+    );
+    println!("{:>8} {:>12} {:>10}", "stripes", "MB/s", "speedup");
+
+    let mut baseline = None;
+    for stripes in [1, 2, 4, 8] {
+        let listener = TcpListener::bind("127.0.0.1:0")?;
+        let addr = listener.local_addr()?;
+
+        let mut senders = Vec::new();
+        let mut receivers = Vec::new();
+        for _ in 0..stripes {
+            senders.push(TcpStream::connect(addr)?);
+            receivers.push(listener.accept()?.0);
+        }
+
+        let receiving = thread::spawn(move || {
+            let protocol = Protocol::default().with_max_message_size(usize::MAX);
+            let (primary, rest) = receivers.split_first_mut().unwrap();
+            for _ in 0..FRAMES {
+                let message = protocol.read_message(primary).expect("Failed to read");
+                let header: StripedFrameHeader =
+                    stripe::parse_message(&message.payload).expect("Bad header");
+                stripe::read_striped(primary, rest, header.payload_len as usize)
+                    .expect("Failed to read stripes");
+            }
+        });
+
+        let start = Instant::now();
+        let (primary, rest) = senders.split_first_mut().unwrap();
+        for _ in 0..FRAMES {
+            stripe::write_striped(&protocol, primary, rest, MessageType::MeshFrame, &payload)?;
+        }
+        receiving.join().expect("Receiver thread panicked");
+        let elapsed = start.elapsed().as_secs_f64();
+
+        let throughput = (payload.len() as f64 * FRAMES as f64) / elapsed / (1024.0 * 1024.0);
+        let baseline = *baseline.get_or_insert(throughput);
+        println!(
+            "{:>8} {:>12.0} {:>9.2}x",
+            stripes,
+            throughput,
+            throughput / baseline
+        );
+    }
+
+    Ok(())
+}
@@ -0,0 +1,105 @@
+//! Loopback benchmark of the socket I/O backends
+//!
+//! Streams frames of several sizes from a `MeshSender` to a `MeshReceiver`
+//! with each backend and reports the CPU time each side spends per GB. The
+//! receiver only takes frames off the wire without decoding them, so its
+//! column is the ingest cost of the transport.
+//!
+//! Run with `cargo run --release --features io-uring --example uring_bench [GB]`.
+
+use seaview_network::{
+    IoBackend, MeshFrame, MeshReceiver, MeshSender, ReceiverConfig, SenderConfig,
+};
+use std::thread;
+use std::time::{Duration, Instant};
+
+/// CPU time (user + system) consumed by the calling thread
+fn thread_cpu_time() -> Duration {
+    // SAFETY: getrusage only writes into the struct we pass
+    let usage = unsafe {
+        let mut usage = std::mem::zeroed::<libc::rusage>();
+        libc::getrusage(libc::RUSAGE_THREAD, &mut usage);
+        usage
+    };
+    let micros = |tv: libc::timeval| tv.tv_sec as u64 * 1_000_000 + tv.tv_usec as u64;
+    Duration::from_micros(micros(usage.ru_utime) + micros(usage.ru_stime))
+}
+
+fn main() -> Result<(), Box<dyn std::error::Error>> {
+    let total_gb: f64 = std::env::args()
+        .nth(1)
+        .and_then(|arg| arg.parse().ok())
+        .unwrap_or(1.0);
+    let total_bytes = (total_gb * (1u64 << 30) as f64) as usize;
+
+    println!(
+        "{} GB per run, io_uring available: {}",
+        total_gb,
+        IoBackend::uring_available()
+    );
+    println!(
+        "{:>10} {:>10} {:>10} {:>14} {:>14}",
+        "backend", "frame", "MB/s", "recv CPU s/GB", "send CPU s/GB"
+    );
+
+    for frame_kb in [64, 1024, 16 * 1024] {
+        let mut mesh = MeshFrame::new("uring-bench".to_string(), 0);
+        mesh.vertices = vec![0.5; frame_kb * 1024 / 4 / 9 * 9];
+        let frames = (total_bytes / (frame_kb * 1024)).max(1);
+
+        for backend in [IoBackend::Blocking, IoBackend::Uring] {
+            let receiver = MeshReceiver::bind_with_config(
+                "127.0.0.1:0",
+                ReceiverConfig {
+                    io_backend: backend,
+                    ..Default::default()
+                },
+            )?;
+            let addr = receiver.local_addr()?;
+
+            let receiving = thread::spawn(move || {
+                let mut receiver = receiver;
+                let start = thread_cpu_time();
+                for _ in 0..frames {
+                    receiver.receive_frame().expect("Failed to receive");
+                }
+                thread_cpu_time() - start
+            });
+
+            let config = SenderConfig {
+                io_backend: backend,
+                ..Default::default()
+            };
+            let mut sender = MeshSender::connect_with_config(addr, config)?;
+            // Settle on the negotiated encoding before measuring
+            for _ in 0..200 {
+                if sender.negotiated().is_some() {
+                    break;
+                }
+                thread::sleep(Duration::from_millis(5));
+            }
+
+            let start = Instant::now();
+            let cpu_start = thread_cpu_time();
+            for frame_number in 0..frames {
+                mesh.frame_number = frame_number as u32;
+                sender.send_mesh(&mesh)?;
+            }
+            let send_cpu = thread_cpu_time() - cpu_start;
+            let recv_cpu = receiving.join().expect("Receiver thread panicked");
+            let elapsed = start.elapsed().as_secs_f64();
+
+            let gb = (frames * mesh.vertices.len() * 4) as f64 / (1u64 << 30) as f64;
+            println!(
+                "{:>10} {:>8}KB {:>10.0} {:>14.3} {:>14.3}",
+                format!("{:?}", backend),
+                frame_kb,
+                gb * 1024.0 / elapsed,
+                recv_cpu.as_secs_f64() / gb,
+                send_cpu.as_secs_f64() / gb
+            );
+        }
+    }
+
+    Ok(())
+}
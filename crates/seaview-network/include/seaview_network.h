@@ -26,6 +26,15 @@ extern "C" {
  */
 #define PROTOCOL_VERSION 2
 
+/**
+ * Oldest protocol version still accepted from a peer
+ *
+ * Version 2 is the first this crate speaks, so the window holds only it.
+ * Messages always go out with [`PROTOCOL_VERSION`] in their header; the
+ * window only matters once a later version has to accept this one.
+ */
+#define MIN_PROTOCOL_VERSION 2
+
 /**
  * Maximum message size (100MB by default)
  */
@@ -45,6 +54,24 @@ typedef enum CWireFormat {
   Json = 1,
 } CWireFormat;
 
+/**
+ * Index encodings for columnar frames
+ */
+typedef enum CIndexCompression {
+  /**
+   * Always 32-bit indices
+   */
+  Uncompressed = 0,
+  /**
+   * 16-bit indices when every index fits (default)
+   */
+  Narrow = 1,
+  /**
+   * Variable-length codes
+   */
+  Coded = 2,
+} CIndexCompression;
+
 /**
  * Opaque handle to a network sender
  */
@@ -78,6 +105,68 @@ typedef struct CSenderConfig {
    * Write timeout in milliseconds (0 = no timeout)
    */
   unsigned int write_timeout_ms;
+  /**
+   * Reconnect automatically after a lost connection (1 = true, 0 = false)
+   */
+  int reconnect;
+  /**
+   * Most recent frames kept while disconnected and sent once
+   * reconnected (0 = drop them)
+   */
+  unsigned int replay_frames;
+  /**
+   * Most bytes of frames kept while disconnected
+   */
+  uintptr_t replay_bytes;
+  /**
+   * Upper bound for the reconnect backoff in milliseconds
+   */
+  unsigned int max_backoff_ms;
+  /**
+   * Parallel connections to stripe large frames across (0 or 1 = single)
+   */
+  unsigned int stripes;
+  /**
+   * Negotiate the fastest encoding with the receiver (1 = true, 0 = false)
+   */
+  int negotiate;
+  /**
+   * Write through io_uring where available (1 = true, 0 = false)
+   */
+  int io_uring;
+  /**
+   * Send messages at least this large zero-copy where available (0 = off)
+   */
+  uintptr_t zerocopy_threshold;
+  /**
+   * Fraction of triangles kept in reduced frames (0 or 1 = always full
+   * resolution)
+   */
+  float lod_ratio;
+  /**
+   * Send every Nth frame at full resolution when reducing (0 = only
+   * on request)
+   */
+  unsigned int lod_full_every;
+  /**
+   * Send coarse levels ahead of frames with at least this many
+   * triangles (0 = off)
+   */
+  uintptr_t progressive_min_triangles;
+  /**
+   * Send at most this many frames per second, skipping the rest
+   * (0 = no limit)
+   */
+  float max_frame_rate;
+  /**
+   * Send only the changed vertices of frames that changed in places
+   * (1 = true, 0 = false)
+   */
+  int partial_updates;
+  /**
+   * Index encoding, used with receivers that decode it
+   */
+  enum CIndexCompression index_compression;
 } CSenderConfig;
 
 /**
@@ -126,6 +215,154 @@ typedef struct CMeshFrame {
   const unsigned int *indices;
 } CMeshFrame;
 
+/**
+ * A run of consecutive vertices
+ */
+typedef struct CVertexRange {
+  /**
+   * First vertex
+   */
+  uintptr_t start;
+  /**
+   * Number of vertices
+   */
+  uintptr_t count;
+} CVertexRange;
+
+/**
+ * C-compatible scalar-field volume frame
+ */
+typedef struct CVolumeFrame {
+  /**
+   * Null-terminated simulation ID string
+   */
+  const char *simulation_id;
+  /**
+   * Frame number
+   */
+  unsigned int frame_number;
+  /**
+   * Timestamp in nanoseconds
+   */
+  uint64_t timestamp;
+  /**
+   * Position of the first sample (x, y, z)
+   */
+  float origin[3];
+  /**
+   * Distance between neighbouring samples (x, y, z)
+   */
+  float spacing[3];
+  /**
+   * Samples along each axis, at least 2 and at most 2^30 in all
+   */
+  unsigned int dims[3];
+  /**
+   * Pointer to `dims[0] * dims[1] * dims[2]` samples, x fastest
+   */
+  const float *samples;
+  /**
+   * Value to extract the surface at; samples below it are inside
+   */
+  float iso_value;
+  /**
+   * Samples per side of the blocks of a sparse frame, at most 64, or 0
+   * to send every sample
+   */
+  unsigned int block_size;
+} CVolumeFrame;
+
+/**
+ * A named per-particle value of a point frame
+ */
+typedef struct CPointScalars {
+  /**
+   * Null-terminated name, such as "density"
+   */
+  const char *name;
+  /**
+   * Pointer to one value per particle
+   */
+  const float *values;
+} CPointScalars;
+
+/**
+ * C-compatible particle frame
+ */
+typedef struct CPointFrame {
+  /**
+   * Null-terminated simulation ID string
+   */
+  const char *simulation_id;
+  /**
+   * Frame number
+   */
+  unsigned int frame_number;
+  /**
+   * Timestamp in nanoseconds
+   */
+  uint64_t timestamp;
+  /**
+   * Domain minimum bounds (x, y, z); positions are quantized relative
+   * to the domain
+   */
+  float domain_min[3];
+  /**
+   * Domain maximum bounds (x, y, z)
+   */
+  float domain_max[3];
+  /**
+   * Number of particles
+   */
+  uintptr_t point_count;
+  /**
+   * Pointer to particle positions (x,y,z triplets)
+   */
+  const float *positions;
+  /**
+   * Number of entries in `scalars`
+   */
+  uintptr_t scalar_count;
+  /**
+   * Pointer to per-particle values, NULL if none
+   */
+  const struct CPointScalars *scalars;
+} CPointFrame;
+
+/**
+ * Sender statistics
+ */
+typedef struct CSenderStats {
+  /**
+   * Number of frames sent
+   */
+  uint64_t frames_sent;
+  /**
+   * Total bytes sent
+   */
+  uint64_t bytes_sent;
+  /**
+   * Successful reconnects after a lost connection
+   */
+  uint64_t reconnects;
+  /**
+   * Frames discarded because the replay buffer was full
+   */
+  uint64_t frames_dropped;
+  /**
+   * Frames not sent because of a rate limit
+   */
+  uint64_t frames_skipped;
+  /**
+   * Frames waiting to be written, including those kept for replay
+   */
+  uint64_t frames_buffered;
+  /**
+   * Whether the connection is currently up (1 = true, 0 = false)
+   */
+  int connected;
+} CSenderStats;
+
 #ifdef __cplusplus
 extern "C" {
 #endif // __cplusplus
@@ -172,12 +409,63 @@ struct NetworkSender *seaview_network_create_sender_with_config(const char *host
  * - `mesh`: Mesh frame data
  *
  * # Returns
- * - 0 on success
+ * - 0 on success, including frames buffered while reconnecting
  * - -1 on invalid parameters
- * - -2 on send failure
+ * - -2 on send failure (only when reconnect is disabled)
  */
 int seaview_network_send_mesh(struct NetworkSender *sender, const struct CMeshFrame *mesh);
 
+/**
+ * Send a mesh frame that only changed in the given vertex ranges
+ *
+ * With partial updates enabled only the changed vertices are sent when
+ * the receiver supports it; the topology must be that of the previous
+ * frame. Otherwise this is the same as `seaview_network_send_mesh`.
+ *
+ * # Parameters
+ * - `sender`: Sender handle
+ * - `mesh`: Mesh frame data
+ * - `ranges`: Changed vertex ranges
+ * - `range_count`: Number of entries in `ranges`
+ *
+ * # Returns
+ * Same as `seaview_network_send_mesh`
+ */
+int seaview_network_send_mesh_dirty(struct NetworkSender *sender,
+                                    const struct CMeshFrame *mesh,
+                                    const struct CVertexRange *ranges,
+                                    uintptr_t range_count);
+
+/**
+ * Send a scalar-field volume frame
+ *
+ * Samples are quantized to 16 bits. Receivers that support volume frames
+ * extract the surface themselves; for others it is extracted here.
+ *
+ * # Parameters
+ * - `sender`: Sender handle
+ * - `volume`: Volume frame data
+ *
+ * # Returns
+ * Same as `seaview_network_send_mesh`
+ */
+int seaview_network_send_volume(struct NetworkSender *sender, const struct CVolumeFrame *volume);
+
+/**
+ * Send a particle frame
+ *
+ * Positions and values are quantized to 16 bits and sorted in Morton
+ * order. Frames for receivers that do not support point frames are skipped.
+ *
+ * # Parameters
+ * - `sender`: Sender handle
+ * - `points`: Particle frame data
+ *
+ * # Returns
+ * Same as `seaview_network_send_mesh`
+ */
+int seaview_network_send_points(struct NetworkSender *sender, const struct CPointFrame *points);
+
 /**
  * Send a heartbeat message
  *
@@ -220,6 +508,19 @@ int seaview_network_get_stats(struct NetworkSender *sender,
                               uint64_t *frames_sent,
                               uint64_t *bytes_sent);
 
+/**
+ * Get detailed sender statistics, including reconnect counters
+ *
+ * # Parameters
+ * - `sender`: Sender handle
+ * - `stats`: Pointer to store the statistics
+ *
+ * # Returns
+ * - 0 on success
+ * - -1 on invalid parameters
+ */
+int seaview_network_get_sender_stats(struct NetworkSender *sender, struct CSenderStats *stats);
+
 /**
  * Destroy a network sender
  *
@@ -0,0 +1,46 @@
+//! Relay one simulation stream to several viewers
+//!
+//! Usage: seaview-relay <listen-addr> <viewer-addr>...
+//!
+//! The simulation connects to `<listen-addr>` as it would to a viewer; every
+//! frame it sends is forwarded to each `<viewer-addr>`.
+
+use seaview_network::MeshRelay;
+use std::process::ExitCode;
+
+fn main() -> ExitCode {
+    let args: Vec<String> = std::env::args().skip(1).collect();
+    let Some((listen_addr, viewers)) = args.split_first() else {
+        eprintln!("Usage: seaview-relay <listen-addr> <viewer-addr>...");
+        return ExitCode::FAILURE;
+    };
+
+    let mut relay = match MeshRelay::bind(listen_addr.as_str()) {
+        Ok(relay) => relay,
+        Err(e) => {
+            eprintln!("Failed to start relay on {listen_addr}: {e}");
+            return ExitCode::FAILURE;
+        }
+    };
+
+    let handle = relay.handle();
+    for viewer in viewers {
+        match handle.add_subscriber(viewer.as_str()) {
+            Ok(addr) => println!("Forwarding to {addr}"),
+            Err(e) => eprintln!("Failed to connect to viewer {viewer}: {e}"),
+        }
+    }
+
+    println!("Relay listening on {listen_addr}");
+    loop {
+        if let Err(e) = relay.relay_one() {
+            eprintln!("Upstream error: {e}");
+        }
+
+        let stats = handle.stats();
+        println!(
+            "Upstream finished: {} frames relayed, {} dropped, {} viewers attached",
+            stats.frames_relayed, stats.messages_dropped, stats.subscribers
+        );
+    }
+}
@@ -0,0 +1,167 @@
+//! Pooled payload buffers for received frames
+//!
+//! Receivers read frame payloads into buffers taken from a [`BufferPool`].
+//! A filled [`FrameBuffer`] is immutable and is usually shared behind an
+//! `Arc`; when the last reference drops, its allocation goes back to the
+//! pool, so a steady stream of similarly sized frames stops allocating.
+
+use std::fmt;
+use std::ops::Deref;
+use std::sync::{Arc, Mutex, Weak};
+
+/// Free list shared by a pool and the buffers it handed out
+struct PoolInner {
+    free: Mutex<Vec<Vec<u8>>>,
+    max_free: usize,
+}
+
+/// Recycles payload allocations between received frames
+#[derive(Clone)]
+pub struct BufferPool {
+    inner: Arc<PoolInner>,
+}
+
+impl BufferPool {
+    /// Create a pool keeping up to `max_free` idle buffers
+    ///
+    /// With `max_free` of zero every buffer is freed on drop.
+    pub fn new(max_free: usize) -> Self {
+        Self {
+            inner: Arc::new(PoolInner {
+                free: Mutex::new(Vec::with_capacity(max_free)),
+                max_free,
+            }),
+        }
+    }
+
+    /// Take a zeroed buffer of `len` bytes, reusing an idle one if possible
+    pub fn take(&self, len: usize) -> Vec<u8> {
+        let reused = {
+            let mut free = self.inner.free.lock().unwrap();
+            // Prefer a buffer that is already large enough
+            match free.iter().position(|buffer| buffer.capacity() >= len) {
+                Some(index) => Some(free.swap_remove(index)),
+                None => free.pop(),
+            }
+        };
+
+        let mut buffer = reused.unwrap_or_default();
+        buffer.resize(len, 0);
+        buffer
+    }
+
+    /// Wrap filled data so its allocation returns here when dropped
+    pub fn wrap(&self, data: Vec<u8>) -> FrameBuffer {
+        FrameBuffer {
+            data,
+            pool: Some(Arc::downgrade(&self.inner)),
+        }
+    }
+
+    /// Number of idle buffers waiting to be reused
+    pub fn available(&self) -> usize {
+        self.inner.free.lock().unwrap().len()
+    }
+}
+
+impl Default for BufferPool {
+    fn default() -> Self {
+        Self::new(8)
+    }
+}
+
+/// An immutable received payload
+///
+/// Dereferences to the payload bytes. Dropping it hands the allocation back
+/// to the pool it came from, if that pool still exists and has room.
+pub struct FrameBuffer {
+    data: Vec<u8>,
+    pool: Option<Weak<PoolInner>>,
+}
+
+impl FrameBuffer {
+    /// Wrap data that does not belong to any pool
+    pub fn from_vec(data: Vec<u8>) -> Self {
+        Self { data, pool: None }
+    }
+}
+
+impl Deref for FrameBuffer {
+    type Target = [u8];
+
+    fn deref(&self) -> &[u8] {
+        &self.data
+    }
+}
+
+impl AsRef<[u8]> for FrameBuffer {
+    fn as_ref(&self) -> &[u8] {
+        &self.data
+    }
+}
+
+impl fmt::Debug for FrameBuffer {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("FrameBuffer")
+            .field("len", &self.data.len())
+            .finish()
+    }
+}
+
+impl Drop for FrameBuffer {
+    fn drop(&mut self) {
+        let Some(pool) = self.pool.as_ref().and_then(Weak::upgrade) else {
+            return;
+        };
+
+        let mut free = pool.free.lock().unwrap();
+        if free.len() < pool.max_free {
+            let mut data = std::mem::take(&mut self.data);
+            data.clear();
+            free.push(data);
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_buffers_return_to_pool() {
+        let pool = BufferPool::new(2);
+
+        let mut data = pool.take(1024);
+        data[0] = 7;
+        let shared = Arc::new(pool.wrap(data));
+        let second = Arc::clone(&shared);
+        assert_eq!(second[0], 7);
+
+        // Only the last reference hands the allocation back
+        drop(shared);
+        assert_eq!(pool.available(), 0);
+        drop(second);
+        assert_eq!(pool.available(), 1);
+
+        // The recycled allocation is reused, zeroed
+        let reused = pool.take(512);
+        assert!(reused.capacity() >= 1024);
+        assert!(reused.iter().all(|&byte| byte == 0));
+        assert_eq!(pool.available(), 0);
+    }
+
+    #[test]
+    fn test_pool_keeps_at_most_max_free() {
+        let pool = BufferPool::new(1);
+        let first = pool.wrap(pool.take(16));
+        let second = pool.wrap(pool.take(16));
+        drop(first);
+        drop(second);
+        assert_eq!(pool.available(), 1);
+
+        // Buffers outliving their pool are simply freed
+        let orphan = pool.wrap(pool.take(16));
+        drop(pool);
+        drop(orphan);
+    }
+}
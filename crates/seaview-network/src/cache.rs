@@ -0,0 +1,246 @@
+//! Bounded cache of recently streamed frames
+//!
+//! Keeps the last N mesh frames in their wire encoding, together with the
+//! latest metadata and checkpoint messages. A viewer that joins mid-run can
+//! be brought up to date from memory, and can ask for specific frame ranges
+//! without the simulation resending anything.
+
+use crate::protocol::{EncodedMessage, MessageType, Protocol};
+use crate::types::FrameRangeRequest;
+
+use std::collections::VecDeque;
+use tracing::{debug, warn};
+
+/// A cached mesh frame
+#[derive(Debug, Clone)]
+struct CachedFrame {
+    frame_number: u32,
+    message: EncodedMessage,
+}
+
+/// Ring of the most recent encoded frames for one stream
+pub struct FrameCache {
+    capacity: usize,
+    frames: VecDeque<CachedFrame>,
+    simulation_id: Option<String>,
+    metadata: Option<EncodedMessage>,
+    checkpoint: Option<EncodedMessage>,
+    protocol: Protocol,
+}
+
+impl FrameCache {
+    /// Create a cache holding up to `capacity` frames
+    ///
+    /// A capacity of zero disables frame caching; metadata and checkpoints
+    /// are still kept.
+    pub fn new(capacity: usize) -> Self {
+        Self::with_protocol(capacity, Protocol::default())
+    }
+
+    /// Create a cache that decodes frame headers with the given protocol
+    pub fn with_protocol(capacity: usize, protocol: Protocol) -> Self {
+        Self {
+            capacity,
+            frames: VecDeque::with_capacity(capacity),
+            simulation_id: None,
+            metadata: None,
+            checkpoint: None,
+            protocol,
+        }
+    }
+
+    /// Record a message passing through the stream
+    pub fn record(&mut self, message: &EncodedMessage) {
+        match message.msg_type {
+            MessageType::MeshFrame => self.record_frame(message),
+            MessageType::Metadata => self.metadata = Some(message.clone()),
+            MessageType::Checkpoint => self.checkpoint = Some(message.clone()),
+            _ => {}
+        }
+    }
+
+    fn record_frame(&mut self, message: &EncodedMessage) {
+        if self.capacity == 0 {
+            return;
+        }
+
+        let header = match self.protocol.deserialize_frame_header(message.payload()) {
+            Ok(header) => header,
+            Err(e) => {
+                warn!("Not caching undecodable frame: {}", e);
+                return;
+            }
+        };
+
+        // A new simulation invalidates the frames and checkpoint of the old
+        // one; metadata is kept since it usually precedes the first frame
+        if self.simulation_id.as_deref() != Some(header.simulation_id.as_str()) {
+            if self.simulation_id.is_some() {
+                debug!(
+                    "Simulation changed to {}, clearing frame cache",
+                    header.simulation_id
+                );
+                self.frames.clear();
+                self.checkpoint = None;
+            }
+            self.simulation_id = Some(header.simulation_id);
+        }
+
+        // A resent frame replaces the cached copy
+        self.frames
+            .retain(|cached| cached.frame_number != header.frame_number);
+        if self.frames.len() == self.capacity {
+            self.frames.pop_front();
+        }
+        self.frames.push_back(CachedFrame {
+            frame_number: header.frame_number,
+            message: message.clone(),
+        });
+    }
+
+    /// Messages that bring a newly joined viewer up to date
+    ///
+    /// Metadata first, then the latest checkpoint, then cached frames in
+    /// arrival order.
+    pub fn replay(&self) -> Vec<EncodedMessage> {
+        self.metadata
+            .iter()
+            .chain(self.checkpoint.iter())
+            .cloned()
+            .chain(self.frames.iter().map(|cached| cached.message.clone()))
+            .collect()
+    }
+
+    /// Cached frames within a requested range, in frame order
+    pub fn frames_in(&self, request: &FrameRangeRequest) -> Vec<EncodedMessage> {
+        let mut frames: Vec<&CachedFrame> = self
+            .frames
+            .iter()
+            .filter(|cached| request.contains(cached.frame_number))
+            .collect();
+        frames.sort_by_key(|cached| cached.frame_number);
+        frames
+            .into_iter()
+            .map(|cached| cached.message.clone())
+            .collect()
+    }
+
+    /// Lowest and highest cached frame numbers
+    pub fn frame_range(&self) -> Option<(u32, u32)> {
+        let first = self.frames.iter().map(|cached| cached.frame_number).min()?;
+        let last = self.frames.iter().map(|cached| cached.frame_number).max()?;
+        Some((first, last))
+    }
+
+    /// Drop all cached messages
+    pub fn clear(&mut self) {
+        self.frames.clear();
+        self.simulation_id = None;
+        self.metadata = None;
+        self.checkpoint = None;
+    }
+
+    /// Number of cached frames
+    pub fn len(&self) -> usize {
+        self.frames.len()
+    }
+
+    /// Check if no frames are cached
+    pub fn is_empty(&self) -> bool {
+        self.frames.is_empty()
+    }
+
+    /// Maximum number of cached frames
+    pub fn capacity(&self) -> usize {
+        self.capacity
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::protocol::NetworkMessage;
+    use crate::types::MeshFrame;
+
+    fn frame(simulation_id: &str, frame_number: u32) -> EncodedMessage {
+        let mut mesh = MeshFrame::new(simulation_id.to_string(), frame_number);
+        mesh.vertices = vec![frame_number as f32; 9];
+        let message = Protocol::default().serialize_mesh(&mesh).unwrap();
+        EncodedMessage::from_message(&message)
+    }
+
+    fn frame_numbers(messages: &[EncodedMessage]) -> Vec<u32> {
+        let protocol = Protocol::default();
+        messages
+            .iter()
+            .filter(|m| m.msg_type == MessageType::MeshFrame)
+            .map(|m| {
+                protocol
+                    .deserialize_frame_header(m.payload())
+                    .unwrap()
+                    .frame_number
+            })
+            .collect()
+    }
+
+    #[test]
+    fn test_ring_keeps_latest_frames() {
+        let mut cache = FrameCache::new(3);
+        for i in 0..5 {
+            cache.record(&frame("sim", i));
+        }
+
+        assert_eq!(cache.len(), 3);
+        assert_eq!(cache.frame_range(), Some((2, 4)));
+        assert_eq!(frame_numbers(&cache.replay()), vec![2, 3, 4]);
+    }
+
+    #[test]
+    fn test_replay_starts_with_metadata_and_checkpoint() {
+        let mut cache = FrameCache::new(4);
+        cache.record(&EncodedMessage::from_message(&NetworkMessage::new(
+            MessageType::Metadata,
+            vec![2],
+        )));
+        cache.record(&frame("sim", 0));
+        cache.record(&EncodedMessage::from_message(&NetworkMessage::new(
+            MessageType::Checkpoint,
+            vec![1],
+        )));
+        cache.record(&frame("sim", 1));
+
+        let replay = cache.replay();
+        let types: Vec<MessageType> = replay.iter().map(|m| m.msg_type).collect();
+        assert_eq!(
+            types,
+            vec![
+                MessageType::Metadata,
+                MessageType::Checkpoint,
+                MessageType::MeshFrame,
+                MessageType::MeshFrame
+            ]
+        );
+    }
+
+    #[test]
+    fn test_frame_range_lookup() {
+        let mut cache = FrameCache::new(8);
+        for i in [5, 3, 4, 6, 7] {
+            cache.record(&frame("sim", i));
+        }
+
+        let frames = cache.frames_in(&FrameRangeRequest::new(4, 6));
+        assert_eq!(frame_numbers(&frames), vec![4, 5, 6]);
+        assert!(cache.frames_in(&FrameRangeRequest::new(10, 20)).is_empty());
+    }
+
+    #[test]
+    fn test_new_simulation_clears_cache() {
+        let mut cache = FrameCache::new(8);
+        cache.record(&frame("first", 0));
+        cache.record(&frame("first", 1));
+        cache.record(&frame("second", 0));
+
+        assert_eq!(cache.len(), 1);
+    }
+}
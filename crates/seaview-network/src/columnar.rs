@@ -0,0 +1,510 @@
+//! Raw columnar encoding for mesh frames
+//!
+//! A fixed little-endian header followed by the simulation id and the
+//! vertex, normal and index arrays stored back to back. Every array starts on
+//! a 4-byte boundary relative to the start of the payload, so encoding and
+//! decoding are plain memory copies rather than per-element serialization.
+//!
+//! Layout (all little-endian):
+//!
+//! | offset | type      | field                                  |
+//! |--------|-----------|----------------------------------------|
+//! | 0      | u32       | flags (see below)                      |
+//! | 4      | u32       | frame number                           |
+//! | 8      | u64       | timestamp                              |
+//! | 16     | [f32; 3]  | domain min                             |
+//! | 28     | [f32; 3]  | domain max                             |
+//! | 40     | u32       | simulation id length in bytes          |
+//! | 44     | u32       | vertex component count                 |
+//! | 48     | u32       | normal component count                 |
+//! | 52     | u32       | index count                            |
+//! | 56     | bytes     | simulation id, zero-padded to 4 bytes  |
+//! | ...    | f32 / u32 | vertices, normals, indices             |
+//!
+//! Flags: 1 = normals, 2 = indices, 4 = 16-bit indices, 8 = coded indices.
+//! 16-bit indices are zero-padded to 4 bytes; coded indices (see
+//! [`crate::indices`]) are preceded by their length in bytes as a u32 and
+//! zero-padded to 4 bytes.
+//!
+//! Because of the alignment, a received payload can also be read in place
+//! through a [`MeshFrameView`] without copying the geometry, unless its
+//! indices are coded.
+
+use crate::indices::{self, IndexCompression, IndexSlice, NARROW_VERTICES};
+use crate::protocol::ProtocolError;
+use crate::types::{DomainBounds, FrameHeader, MeshFrame};
+
+use std::ops::Range;
+
+/// Size of the fixed columnar header
+pub const HEADER_LEN: usize = 56;
+
+const FLAG_NORMALS: u32 = 1;
+const FLAG_INDICES: u32 = 2;
+const FLAG_INDICES_U16: u32 = 4;
+const FLAG_INDICES_CODED: u32 = 8;
+
+/// Decoded fixed header with the byte ranges of each section
+#[derive(Debug, Clone)]
+pub(crate) struct Layout {
+    pub flags: u32,
+    pub frame_number: u32,
+    pub timestamp: u64,
+    pub domain_bounds: DomainBounds,
+    pub simulation_id: Range<usize>,
+    pub vertices: Range<usize>,
+    pub normals: Range<usize>,
+    /// Index data as stored, without length prefix or padding
+    pub indices: Range<usize>,
+    pub index_count: usize,
+}
+
+impl Layout {
+    /// Parse and bounds-check the header of a columnar payload
+    pub fn parse(payload: &[u8]) -> Result<Self, ProtocolError> {
+        if payload.len() < HEADER_LEN {
+            return Err(ProtocolError::InvalidFormat);
+        }
+
+        let u32_at =
+            |offset: usize| u32::from_le_bytes(payload[offset..offset + 4].try_into().unwrap());
+        let f32_at = |offset: usize| f32::from_bits(u32_at(offset));
+
+        let flags = u32_at(0);
+        let id_len = u32_at(40) as usize;
+        let vertex_len = u32_at(44) as usize;
+        let normal_len = u32_at(48) as usize;
+        let index_len = u32_at(52) as usize;
+
+        let simulation_id = HEADER_LEN..HEADER_LEN + id_len;
+        let vertices_start = HEADER_LEN + padded(id_len);
+        let vertices = vertices_start..vertices_start + vertex_len * 4;
+        let normals = vertices.end..vertices.end + normal_len * 4;
+
+        let compact = flags & (FLAG_INDICES_U16 | FLAG_INDICES_CODED);
+        if (flags & FLAG_NORMALS == 0 && normal_len != 0)
+            || (flags & FLAG_INDICES == 0 && (index_len != 0 || compact != 0))
+            || compact == FLAG_INDICES_U16 | FLAG_INDICES_CODED
+        {
+            return Err(ProtocolError::InvalidFormat);
+        }
+
+        let (indices, end) = match compact {
+            FLAG_INDICES_U16 => {
+                let indices = normals.end..normals.end + index_len * 2;
+                (indices, normals.end + padded(index_len * 2))
+            }
+            FLAG_INDICES_CODED => {
+                if normals.end + 4 > payload.len() {
+                    return Err(ProtocolError::InvalidFormat);
+                }
+                let start = normals.end + 4;
+                let len = u32_at(normals.end) as usize;
+                (start..start + len, start + padded(len))
+            }
+            _ => {
+                let indices = normals.end..normals.end + index_len * 4;
+                (indices.clone(), indices.end)
+            }
+        };
+        if end != payload.len() {
+            return Err(ProtocolError::InvalidFormat);
+        }
+
+        Ok(Self {
+            flags,
+            frame_number: u32_at(4),
+            timestamp: u64::from_le_bytes(payload[8..16].try_into().unwrap()),
+            domain_bounds: DomainBounds::new(
+                [f32_at(16), f32_at(20), f32_at(24)],
+                [f32_at(28), f32_at(32), f32_at(36)],
+            ),
+            simulation_id,
+            vertices,
+            normals,
+            indices,
+            index_count: index_len,
+        })
+    }
+
+    pub fn has_normals(&self) -> bool {
+        self.flags & FLAG_NORMALS != 0
+    }
+
+    pub fn has_indices(&self) -> bool {
+        self.flags & FLAG_INDICES != 0
+    }
+
+    pub fn has_narrow_indices(&self) -> bool {
+        self.flags & FLAG_INDICES_U16 != 0
+    }
+
+    pub fn has_coded_indices(&self) -> bool {
+        self.flags & FLAG_INDICES_CODED != 0
+    }
+
+    /// Whether the indices are anything but plain 32-bit values
+    pub fn has_compact_indices(&self) -> bool {
+        self.has_narrow_indices() || self.has_coded_indices()
+    }
+}
+
+/// Whether a columnar payload carries 16-bit or coded indices
+pub fn has_compact_indices(payload: &[u8]) -> Result<bool, ProtocolError> {
+    Ok(Layout::parse(payload)?.has_compact_indices())
+}
+
+/// Round a byte length up to the next multiple of 4
+fn padded(len: usize) -> usize {
+    len.div_ceil(4) * 4
+}
+
+/// Encode a mesh frame in the columnar layout
+pub fn encode(mesh: &MeshFrame) -> Vec<u8> {
+    encode_with(mesh, IndexCompression::None)
+}
+
+/// Encode a mesh frame in the columnar layout with compact indices
+pub fn encode_with(mesh: &MeshFrame, compression: IndexCompression) -> Vec<u8> {
+    let mut out = Vec::new();
+    encode_into(mesh, compression, &mut out);
+    out
+}
+
+/// Append a mesh frame in the columnar layout to `out`
+///
+/// Padding is relative to where the frame starts, so it can follow a
+/// message header in the same buffer.
+pub fn encode_into(mesh: &MeshFrame, compression: IndexCompression, out: &mut Vec<u8>) {
+    let id = mesh.simulation_id.as_bytes();
+    let normals = mesh.normals.as_deref().unwrap_or(&[]);
+    let indices = mesh.indices.as_deref().unwrap_or(&[]);
+
+    let mut flags = 0;
+    if mesh.normals.is_some() {
+        flags |= FLAG_NORMALS;
+    }
+    if mesh.indices.is_some() {
+        flags |= FLAG_INDICES;
+        match compression {
+            IndexCompression::None => {}
+            IndexCompression::Narrow => {
+                if indices
+                    .iter()
+                    .all(|&index| (index as usize) < NARROW_VERTICES)
+                {
+                    flags |= FLAG_INDICES_U16;
+                }
+            }
+            IndexCompression::Coded => flags |= FLAG_INDICES_CODED,
+        }
+    }
+
+    // Coded indices are usually well under half the size of 32-bit ones
+    let index_bytes = match flags & (FLAG_INDICES_U16 | FLAG_INDICES_CODED) {
+        FLAG_INDICES_U16 => padded(indices.len() * 2),
+        FLAG_INDICES_CODED => 4 + indices.len() * 2,
+        _ => indices.len() * 4,
+    };
+    let len =
+        HEADER_LEN + padded(id.len()) + (mesh.vertices.len() + normals.len()) * 4 + index_bytes;
+    let start = out.len();
+    out.reserve(len);
+
+    out.extend_from_slice(&flags.to_le_bytes());
+    out.extend_from_slice(&mesh.frame_number.to_le_bytes());
+    out.extend_from_slice(&mesh.timestamp.to_le_bytes());
+    for value in mesh.domain_bounds.min.iter().chain(&mesh.domain_bounds.max) {
+        out.extend_from_slice(&value.to_le_bytes());
+    }
+    for count in [id.len(), mesh.vertices.len(), normals.len(), indices.len()] {
+        out.extend_from_slice(&(count as u32).to_le_bytes());
+    }
+
+    out.extend_from_slice(id);
+    out.resize(start + HEADER_LEN + padded(id.len()), 0);
+
+    extend_f32s(out, &mesh.vertices);
+    extend_f32s(out, normals);
+    if flags & FLAG_INDICES_U16 != 0 {
+        for &index in indices {
+            out.extend_from_slice(&(index as u16).to_le_bytes());
+        }
+    } else if flags & FLAG_INDICES_CODED != 0 {
+        let prefix = out.len();
+        out.extend_from_slice(&[0; 4]);
+        indices::encode(indices, out);
+        let coded = (out.len() - prefix - 4) as u32;
+        out[prefix..prefix + 4].copy_from_slice(&coded.to_le_bytes());
+    } else {
+        for index in indices {
+            out.extend_from_slice(&index.to_le_bytes());
+        }
+    }
+    out.resize(start + padded(out.len() - start), 0);
+
+    debug_assert!(flags & FLAG_INDICES_CODED != 0 || out.len() - start == len);
+}
+
+/// Decode a columnar payload into an owned mesh frame
+pub fn decode(payload: &[u8]) -> Result<MeshFrame, ProtocolError> {
+    // An aligned buffer is copied array by array; otherwise fall back to
+    // reading element by element
+    match MeshFrameView::parse(payload) {
+        Ok(view) => return Ok(view.to_mesh_frame()),
+        Err(ProtocolError::Misaligned | ProtocolError::Compressed) => {}
+        Err(e) => return Err(e),
+    }
+
+    let layout = Layout::parse(payload)?;
+
+    let mut mesh = MeshFrame::new(
+        decode_id(payload, &layout)?.to_string(),
+        layout.frame_number,
+    );
+    mesh.timestamp = layout.timestamp;
+    mesh.domain_bounds = layout.domain_bounds;
+    mesh.vertices = read_f32s(&payload[layout.vertices.clone()]);
+    if layout.has_normals() {
+        mesh.normals = Some(read_f32s(&payload[layout.normals.clone()]));
+    }
+    if layout.has_indices() {
+        let bytes = &payload[layout.indices.clone()];
+        mesh.indices = Some(if layout.has_coded_indices() {
+            let mut indices = Vec::new();
+            indices::decode_into(bytes, layout.index_count, &mut indices)?;
+            indices
+        } else if layout.has_narrow_indices() {
+            bytes
+                .chunks_exact(2)
+                .map(|b| u16::from_le_bytes(b.try_into().unwrap()) as u32)
+                .collect()
+        } else {
+            bytes
+                .chunks_exact(4)
+                .map(|b| u32::from_le_bytes(b.try_into().unwrap()))
+                .collect()
+        });
+    }
+
+    Ok(mesh)
+}
+
+/// Decode only the header fields of a columnar payload
+pub fn decode_header(payload: &[u8]) -> Result<FrameHeader, ProtocolError> {
+    let layout = Layout::parse(payload)?;
+    Ok(FrameHeader {
+        simulation_id: decode_id(payload, &layout)?.to_string(),
+        frame_number: layout.frame_number,
+        timestamp: layout.timestamp,
+    })
+}
+
+pub(crate) fn decode_id<'a>(payload: &'a [u8], layout: &Layout) -> Result<&'a str, ProtocolError> {
+    std::str::from_utf8(&payload[layout.simulation_id.clone()])
+        .map_err(|_| ProtocolError::InvalidFormat)
+}
+
+/// A columnar mesh frame borrowed from its payload buffer
+///
+/// Geometry is exposed as slices straight into the received bytes, so
+/// forwarding, recording or hashing a frame costs no copy. Use
+/// [`to_mesh_frame`](Self::to_mesh_frame) when an owned frame is needed.
+#[derive(Debug, Clone, Copy)]
+pub struct MeshFrameView<'a> {
+    /// Simulation identifier
+    pub simulation_id: &'a str,
+    /// Frame number in the simulation sequence
+    pub frame_number: u32,
+    /// Timestamp in nanoseconds since simulation start
+    pub timestamp: u64,
+    /// Spatial bounds of the mesh
+    pub domain_bounds: DomainBounds,
+    /// Flattened vertex positions (x,y,z triplets)
+    pub vertices: &'a [f32],
+    /// Optional vertex normals (x,y,z triplets)
+    pub normals: Option<&'a [f32]>,
+    /// Optional indices for indexed mesh representation
+    pub indices: Option<IndexSlice<'a>>,
+}
+
+impl<'a> MeshFrameView<'a> {
+    /// Borrow a frame from a columnar payload
+    ///
+    /// Checks every section length against the payload size, and fails with
+    /// [`ProtocolError::Misaligned`] if the buffer does not start on a
+    /// 4-byte boundary or the target is big-endian, and with
+    /// [`ProtocolError::Compressed`] if the indices are coded.
+    pub fn parse(payload: &'a [u8]) -> Result<Self, ProtocolError> {
+        let layout = Layout::parse(payload)?;
+        if layout.has_coded_indices() {
+            return Err(ProtocolError::Compressed);
+        }
+        let indices = &payload[layout.indices.clone()];
+
+        Ok(Self {
+            simulation_id: decode_id(payload, &layout)?,
+            frame_number: layout.frame_number,
+            timestamp: layout.timestamp,
+            domain_bounds: layout.domain_bounds,
+            vertices: cast_slice(&payload[layout.vertices.clone()])?,
+            normals: layout
+                .has_normals()
+                .then(|| cast_slice(&payload[layout.normals.clone()]))
+                .transpose()?,
+            indices: layout
+                .has_indices()
+                .then(|| {
+                    if layout.has_narrow_indices() {
+                        cast_slice(indices).map(IndexSlice::U16)
+                    } else {
+                        cast_slice(indices).map(IndexSlice::U32)
+                    }
+                })
+                .transpose()?,
+        })
+    }
+
+    /// Get the number of vertices in the mesh
+    pub fn vertex_count(&self) -> usize {
+        self.vertices.len() / 3
+    }
+
+    /// Get the number of triangles in the mesh
+    pub fn triangle_count(&self) -> usize {
+        match self.indices {
+            Some(indices) => indices.len() / 3,
+            None => self.vertex_count() / 3,
+        }
+    }
+
+    /// Copy into an owned mesh frame
+    pub fn to_mesh_frame(&self) -> MeshFrame {
+        MeshFrame {
+            simulation_id: self.simulation_id.to_string(),
+            frame_number: self.frame_number,
+            timestamp: self.timestamp,
+            domain_bounds: self.domain_bounds,
+            vertices: self.vertices.to_vec(),
+            normals: self.normals.map(<[f32]>::to_vec),
+            indices: self.indices.map(|indices| indices.to_vec()),
+        }
+    }
+}
+
+/// Plain values that every bit pattern is valid for
+trait Pod: Copy {}
+impl Pod for f32 {}
+impl Pod for u32 {}
+impl Pod for u16 {}
+
+/// Reinterpret little-endian bytes as a slice of plain values
+fn cast_slice<T: Pod>(bytes: &[u8]) -> Result<&[T], ProtocolError> {
+    if cfg!(target_endian = "big") || bytes.as_ptr().align_offset(std::mem::align_of::<T>()) != 0 {
+        return Err(ProtocolError::Misaligned);
+    }
+    debug_assert_eq!(bytes.len() % std::mem::size_of::<T>(), 0);
+
+    // SAFETY: the pointer is aligned for T, the length is a whole number of
+    // T (section lengths are counts of T), T accepts any bit
+    // pattern, and the slice borrows `bytes` so it cannot outlive it
+    Ok(unsafe {
+        std::slice::from_raw_parts(
+            bytes.as_ptr().cast::<T>(),
+            bytes.len() / std::mem::size_of::<T>(),
+        )
+    })
+}
+
+fn extend_f32s(out: &mut Vec<u8>, values: &[f32]) {
+    for value in values {
+        out.extend_from_slice(&value.to_le_bytes());
+    }
+}
+
+fn read_f32s(bytes: &[u8]) -> Vec<f32> {
+    bytes
+        .chunks_exact(4)
+        .map(|b| f32::from_le_bytes(b.try_into().unwrap()))
+        .collect()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_round_trip() {
+        let mut mesh = MeshFrame::new("columnar-sim".to_string(), 17);
+        mesh.timestamp = 42;
+        mesh.domain_bounds = DomainBounds::new([-1.0, -2.0, -3.0], [1.0, 2.0, 3.0]);
+        mesh.vertices = (0..18).map(|i| i as f32 * 0.5).collect();
+        mesh.normals = Some(vec![0.0; 18]);
+        mesh.indices = Some(vec![0, 1, 2, 3, 4, 5]);
+
+        let payload = encode(&mesh);
+        assert_eq!(payload.len() % 4, 0);
+
+        let decoded = decode(&payload).unwrap();
+        assert_eq!(decoded.simulation_id, mesh.simulation_id);
+        assert_eq!(decoded.frame_number, 17);
+        assert_eq!(decoded.timestamp, 42);
+        assert_eq!(decoded.domain_bounds.max, [1.0, 2.0, 3.0]);
+        assert_eq!(decoded.vertices, mesh.vertices);
+        assert_eq!(decoded.normals, mesh.normals);
+        assert_eq!(decoded.indices, mesh.indices);
+
+        let header = decode_header(&payload).unwrap();
+        assert_eq!(header.frame_number, 17);
+    }
+
+    #[test]
+    fn test_optional_sections_stay_absent() {
+        let mut mesh = MeshFrame::new("x".to_string(), 0);
+        mesh.vertices = vec![1.0; 9];
+
+        let decoded = decode(&encode(&mesh)).unwrap();
+        assert!(decoded.normals.is_none());
+        assert!(decoded.indices.is_none());
+    }
+
+    #[test]
+    fn test_view_borrows_payload() {
+        let mut mesh = MeshFrame::new("view".to_string(), 5);
+        mesh.vertices = (0..9).map(|i| i as f32).collect();
+        mesh.indices = Some(vec![0, 1, 2]);
+        let payload = encode(&mesh);
+
+        let view = MeshFrameView::parse(&payload).unwrap();
+        assert_eq!(view.simulation_id, "view");
+        assert_eq!(view.vertices, mesh.vertices.as_slice());
+        assert!(view.normals.is_none());
+        assert_eq!(view.indices, Some(IndexSlice::U32(&[0, 1, 2])));
+        assert_eq!(view.triangle_count(), 1);
+
+        // The geometry points into the payload itself
+        let start = payload.as_ptr() as usize;
+        let vertices = view.vertices.as_ptr() as usize;
+        assert!(vertices > start && vertices < start + payload.len());
+
+        // A payload that starts off a 4-byte boundary cannot be viewed, but
+        // still decodes
+        let mut shifted = vec![0u8; payload.len() + 1];
+        shifted[1..].copy_from_slice(&payload);
+        assert!(matches!(
+            MeshFrameView::parse(&shifted[1..]),
+            Err(ProtocolError::Misaligned)
+        ));
+        assert_eq!(decode(&shifted[1..]).unwrap().vertices, mesh.vertices);
+    }
+
+    #[test]
+    fn test_truncated_payload_rejected() {
+        let mut mesh = MeshFrame::new("truncated".to_string(), 0);
+        mesh.vertices = vec![1.0; 9];
+        let payload = encode(&mesh);
+
+        assert!(decode(&payload[..payload.len() - 4]).is_err());
+        assert!(decode(&payload[..10]).is_err());
+    }
+}
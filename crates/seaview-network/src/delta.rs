@@ -0,0 +1,363 @@
+//! Partial updates of frames whose surface only moves in places
+//!
+//! In coupled runs most of a surface is often static between frames. A
+//! sender configured with a [`DeltaConfig`] remembers a hash of every block
+//! of vertices it sent. When the next frame has the same topology and only
+//! a few blocks changed, it sends a [`PartialUpdate`] with just those
+//! vertex ranges instead of the whole frame. Callers that already know what
+//! moved can pass the dirty ranges themselves with
+//! [`MeshSender::send_mesh_dirty`](crate::MeshSender::send_mesh_dirty) and
+//! skip the hashing.
+//!
+//! A [`MeshReceiver`](crate::MeshReceiver) with partial updates enabled
+//! keeps the last frame it decoded, patches it in place and reports the
+//! changed ranges in [`ReceivedMesh::dirty`](crate::ReceivedMesh::dirty)
+//! so a viewer only uploads those. An update whose base frame the receiver
+//! does not have is dropped, and the receiver asks for a full frame.
+
+use crate::lod;
+use crate::protocol::{EncodedMessage, MessageType, NetworkMessage, ProtocolError};
+use crate::types::{FrameHeader, MeshFrame};
+
+use serde::{Deserialize, Serialize};
+use std::ops::Range;
+
+/// Partial update settings for a sender
+#[derive(Debug, Clone)]
+pub struct DeltaConfig {
+    /// Vertices per hashed block
+    pub block_vertices: usize,
+    /// Send the whole frame when more than this fraction of it changed
+    pub max_dirty_fraction: f32,
+    /// Worker threads used for hashing
+    pub workers: usize,
+}
+
+impl Default for DeltaConfig {
+    fn default() -> Self {
+        Self {
+            block_vertices: 4096,
+            max_dirty_fraction: 0.5,
+            workers: lod::default_workers(),
+        }
+    }
+}
+
+/// New values for a run of consecutive vertices
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct DirtyRange {
+    /// First vertex of the run
+    pub start: u32,
+    /// Positions of the run, 3 floats per vertex
+    pub vertices: Vec<f32>,
+    /// Normals of the run, if the frame has normals
+    pub normals: Option<Vec<f32>>,
+}
+
+/// The changed vertices of a frame relative to an earlier one
+///
+/// Starts with the same fields as a frame, so its header decodes like
+/// one. Topology, normals layout and domain bounds are those of the base.
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct PartialUpdate {
+    /// Simulation identifier
+    pub simulation_id: String,
+    /// Frame number of the updated frame
+    pub frame_number: u32,
+    /// Timestamp of the updated frame
+    pub timestamp: u64,
+    /// Frame the update applies to
+    pub base_frame: u32,
+    /// Number of vertices of both frames
+    pub vertex_count: u32,
+    /// Changed runs of vertices, in order
+    pub ranges: Vec<DirtyRange>,
+}
+
+impl PartialUpdate {
+    /// Create the message carrying this update
+    pub fn to_message(&self) -> Result<NetworkMessage, ProtocolError> {
+        Ok(NetworkMessage::new(
+            MessageType::PartialUpdate,
+            bincode::serialize(self)?,
+        ))
+    }
+
+    /// Create the message carrying this update, already in its wire encoding
+    pub fn to_encoded(&self) -> Result<EncodedMessage, ProtocolError> {
+        EncodedMessage::bincode(MessageType::PartialUpdate, self)
+    }
+
+    /// Parse an update payload
+    pub fn from_payload(payload: &[u8]) -> Result<Self, ProtocolError> {
+        Ok(bincode::deserialize(payload)?)
+    }
+
+    /// Changed vertex ranges
+    pub fn dirty_ranges(&self) -> Vec<Range<usize>> {
+        self.ranges
+            .iter()
+            .map(|range| {
+                let start = range.start as usize;
+                start..start + range.vertices.len() / 3
+            })
+            .collect()
+    }
+
+    /// Patch `base` into the updated frame
+    ///
+    /// Fails without touching `base` if it is not the frame this update
+    /// was made against.
+    pub fn apply(&self, base: &mut MeshFrame) -> Result<(), ProtocolError> {
+        let fits = base.frame_number == self.base_frame
+            && base.simulation_id == self.simulation_id
+            && base.vertex_count() == self.vertex_count as usize
+            && self.ranges.iter().all(|range| {
+                let end = range.start as usize * 3 + range.vertices.len();
+                end <= base.vertices.len()
+                    && range.normals.as_ref().map(Vec::len)
+                        == base.normals.as_ref().map(|_| range.vertices.len())
+            });
+        if !fits {
+            return Err(ProtocolError::InvalidFormat);
+        }
+
+        for range in &self.ranges {
+            let start = range.start as usize * 3;
+            let end = start + range.vertices.len();
+            base.vertices[start..end].copy_from_slice(&range.vertices);
+            if let (Some(normals), Some(patch)) = (base.normals.as_mut(), &range.normals) {
+                normals[start..end].copy_from_slice(patch);
+            }
+        }
+        base.frame_number = self.frame_number;
+        base.timestamp = self.timestamp;
+        Ok(())
+    }
+}
+
+/// Decode only the header of an update payload
+pub fn decode_header(payload: &[u8]) -> Result<FrameHeader, ProtocolError> {
+    Ok(bincode::deserialize(payload)?)
+}
+
+/// What the sender last sent, by block
+struct Base {
+    frame_number: u32,
+    vertex_count: usize,
+    index_count: usize,
+    has_normals: bool,
+    topology: u64,
+    blocks: Vec<u64>,
+}
+
+/// Turns frames into partial updates against the previous one
+pub(crate) struct DeltaEncoder {
+    config: DeltaConfig,
+    base: Option<Base>,
+}
+
+impl DeltaEncoder {
+    pub(crate) fn new(config: DeltaConfig) -> Self {
+        Self { config, base: None }
+    }
+
+    /// Record `mesh` as sent, returning an update against the previous
+    /// frame if only a small part of it changed
+    ///
+    /// `dirty` lists the vertex ranges the caller changed; without it the
+    /// blocks are hashed to find them. With `full` the frame is only
+    /// recorded.
+    pub(crate) fn encode(
+        &mut self,
+        mesh: &MeshFrame,
+        dirty: Option<&[Range<usize>]>,
+        full: bool,
+    ) -> Option<PartialUpdate> {
+        let block = self.config.block_vertices.max(1);
+        let workers = self.config.workers.max(1);
+        let vertex_count = mesh.vertex_count();
+        let index_count = mesh.indices.as_ref().map_or(0, Vec::len);
+        let block_count = vertex_count.div_ceil(block);
+        let previous = self.base.take();
+
+        // Callers passing dirty ranges vouch for the topology
+        let topology = match (dirty, &previous) {
+            (Some(_), Some(previous)) => previous.topology,
+            _ => hash_words(mesh.indices.as_deref().unwrap_or(&[]).iter().copied(), 0),
+        };
+        let comparable = previous.filter(|previous| {
+            previous.vertex_count == vertex_count
+                && previous.index_count == index_count
+                && previous.has_normals == mesh.has_normals()
+                && previous.topology == topology
+        });
+
+        // Rehash only the blocks the caller changed, or all of them
+        let (blocks, changed) = match (&comparable, dirty) {
+            (Some(previous), Some(dirty)) => {
+                let mut blocks = previous.blocks.clone();
+                let mut changed = vec![false; block_count];
+                for range in dirty {
+                    let range = range.start.min(vertex_count)..range.end.min(vertex_count);
+                    if range.is_empty() {
+                        continue;
+                    }
+                    for index in range.start / block..=(range.end - 1) / block {
+                        if !changed[index] {
+                            changed[index] = true;
+                            blocks[index] = hash_block(mesh, index, block);
+                        }
+                    }
+                }
+                (blocks, changed)
+            }
+            _ => {
+                let blocks = lod::parallel_ranges(block_count, workers, |range| {
+                    range
+                        .map(|index| hash_block(mesh, index, block))
+                        .collect::<Vec<_>>()
+                })
+                .concat();
+                let changed = match &comparable {
+                    Some(previous) => blocks
+                        .iter()
+                        .zip(&previous.blocks)
+                        .map(|(hash, previous)| hash != previous)
+                        .collect(),
+                    None => vec![true; block_count],
+                };
+                (blocks, changed)
+            }
+        };
+
+        self.base = Some(Base {
+            frame_number: mesh.frame_number,
+            vertex_count,
+            index_count,
+            has_normals: mesh.has_normals(),
+            topology,
+            blocks,
+        });
+
+        let previous = comparable?;
+        let dirty_blocks = changed.iter().filter(|&&changed| changed).count();
+        if full || dirty_blocks as f32 > block_count as f32 * self.config.max_dirty_fraction {
+            return None;
+        }
+
+        // Merge runs of changed blocks into vertex ranges
+        let mut ranges = Vec::new();
+        let mut index = 0;
+        while index < block_count {
+            if !changed[index] {
+                index += 1;
+                continue;
+            }
+            let first = index;
+            while index < block_count && changed[index] {
+                index += 1;
+            }
+            let vertices = first * block..(index * block).min(vertex_count);
+            let floats = vertices.start * 3..vertices.end * 3;
+            ranges.push(DirtyRange {
+                start: vertices.start as u32,
+                vertices: mesh.vertices[floats.clone()].to_vec(),
+                normals: mesh
+                    .normals
+                    .as_ref()
+                    .map(|normals| normals[floats].to_vec()),
+            });
+        }
+
+        Some(PartialUpdate {
+            simulation_id: mesh.simulation_id.clone(),
+            frame_number: mesh.frame_number,
+            timestamp: mesh.timestamp,
+            base_frame: previous.frame_number,
+            vertex_count: vertex_count as u32,
+            ranges,
+        })
+    }
+}
+
+/// Hash the positions and normals of one block of vertices
+fn hash_block(mesh: &MeshFrame, index: usize, block: usize) -> u64 {
+    let start = index * block * 3;
+    let end = ((index + 1) * block * 3).min(mesh.vertices.len());
+    let hash = hash_words(mesh.vertices[start..end].iter().map(|v| v.to_bits()), 0);
+    match &mesh.normals {
+        Some(normals) => hash_words(normals[start..end].iter().map(|n| n.to_bits()), hash),
+        None => hash,
+    }
+}
+
+/// FNV-1a over 32-bit words
+///
+/// Every single-word change changes the hash, since both steps are
+/// bijective.
+fn hash_words(words: impl Iterator<Item = u32>, seed: u64) -> u64 {
+    words.fold(seed ^ 0xcbf2_9ce4_8422_2325, |hash, word| {
+        (hash ^ word as u64).wrapping_mul(0x0000_0100_0000_01b3)
+    })
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn mesh(vertices: usize, frame_number: u32) -> MeshFrame {
+        let mut mesh = MeshFrame::new("delta".to_string(), frame_number);
+        mesh.vertices = (0..vertices * 3).map(|i| i as f32).collect();
+        mesh.normals = Some(vec![0.0; vertices * 3]);
+        mesh.indices = Some((0..vertices as u32).collect());
+        mesh
+    }
+
+    #[test]
+    fn test_partial_update_round_trip() {
+        let config = DeltaConfig {
+            block_vertices: 100,
+            ..DeltaConfig::default()
+        };
+        let mut encoder = DeltaEncoder::new(config);
+        let first = mesh(999, 0);
+        assert!(encoder.encode(&first, None, false).is_none());
+
+        // Two separate vertices move
+        let mut second = first.clone();
+        second.frame_number = 1;
+        second.vertices[150 * 3] = -1.0;
+        second.normals.as_mut().unwrap()[990 * 3 + 2] = 1.0;
+        let update = encoder
+            .encode(&second, None, false)
+            .expect("Expected an update");
+        assert_eq!(update.base_frame, 0);
+        assert_eq!(update.dirty_ranges(), vec![100..200, 900..999]);
+
+        let message = update.to_message().unwrap();
+        let update = PartialUpdate::from_payload(&message.payload).unwrap();
+        assert_eq!(decode_header(&message.payload).unwrap().frame_number, 1);
+        let mut patched = first.clone();
+        update.apply(&mut patched).unwrap();
+        assert_eq!(patched.frame_number, 1);
+        assert_eq!(patched.vertices, second.vertices);
+        assert_eq!(patched.normals, second.normals);
+        // Not applicable twice
+        assert!(update.apply(&mut patched).is_err());
+
+        // Explicit ranges skip the hashing
+        let mut third = second.clone();
+        third.frame_number = 2;
+        third.vertices[5 * 3] = 7.0;
+        let update = encoder.encode(&third, Some(&[5..6]), false).unwrap();
+        assert_eq!(update.dirty_ranges(), vec![0..100]);
+
+        // Changed topology or a forced full frame send everything
+        let mut fourth = third.clone();
+        fourth.frame_number = 3;
+        fourth.indices.as_mut().unwrap().swap(0, 1);
+        assert!(encoder.encode(&fourth, None, false).is_none());
+        assert!(encoder.encode(&fourth, None, true).is_none());
+    }
+}
@@ -3,10 +3,19 @@
 //! This module provides a C-compatible API for using the seaview-network library
 //! from C and C++ applications.
 
+use crate::delta::DeltaConfig;
+use crate::indices::IndexCompression;
+use crate::lod::{LodConfig, LodTarget};
+use crate::points::{PointFrame, PointScalars};
+use crate::progressive::ProgressiveConfig;
 use crate::protocol::WireFormat;
-use crate::sender::{MeshSender, SenderConfig};
+use crate::rate::RateLimit;
+use crate::sender::{MeshSender, ReconnectConfig, SenderConfig};
 use crate::types::{DomainBounds, MeshFrame};
+use crate::uring::IoBackend;
+use crate::volume::{VolumeFrame, VolumeGrid, VolumeLayout};
 use std::ffi::{c_char, CStr};
+use std::ops::Range;
 use std::os::raw::{c_float, c_int, c_uint};
 use std::ptr;
 use std::slice;
@@ -52,6 +61,17 @@ pub enum CWireFormat {
     Json = 1,
 }
 
+/// Index encodings for columnar frames
+#[repr(C)]
+pub enum CIndexCompression {
+    /// Always 32-bit indices
+    Uncompressed = 0,
+    /// 16-bit indices when every index fits (default)
+    Narrow = 1,
+    /// Variable-length codes
+    Coded = 2,
+}
+
 /// Sender configuration
 #[repr(C)]
 pub struct CSenderConfig {
@@ -67,6 +87,125 @@ pub struct CSenderConfig {
     pub connect_timeout_ms: c_uint,
     /// Write timeout in milliseconds (0 = no timeout)
     pub write_timeout_ms: c_uint,
+    /// Reconnect automatically after a lost connection (1 = true, 0 = false)
+    pub reconnect: c_int,
+    /// Most recent frames kept while disconnected and sent once
+    /// reconnected (0 = drop them)
+    pub replay_frames: c_uint,
+    /// Most bytes of frames kept while disconnected
+    pub replay_bytes: usize,
+    /// Upper bound for the reconnect backoff in milliseconds
+    pub max_backoff_ms: c_uint,
+    /// Parallel connections to stripe large frames across (0 or 1 = single)
+    pub stripes: c_uint,
+    /// Negotiate the fastest encoding with the receiver (1 = true, 0 = false)
+    pub negotiate: c_int,
+    /// Write through io_uring where available (1 = true, 0 = false)
+    pub io_uring: c_int,
+    /// Send messages at least this large zero-copy where available (0 = off)
+    pub zerocopy_threshold: usize,
+    /// Fraction of triangles kept in reduced frames (0 or 1 = always full
+    /// resolution)
+    pub lod_ratio: c_float,
+    /// Send every Nth frame at full resolution when reducing (0 = only
+    /// on request)
+    pub lod_full_every: c_uint,
+    /// Send coarse levels ahead of frames with at least this many
+    /// triangles (0 = off)
+    pub progressive_min_triangles: usize,
+    /// Send at most this many frames per second, skipping the rest
+    /// (0 = no limit)
+    pub max_frame_rate: c_float,
+    /// Send only the changed vertices of frames that changed in places
+    /// (1 = true, 0 = false)
+    pub partial_updates: c_int,
+    /// Index encoding, used with receivers that decode it
+    pub index_compression: CIndexCompression,
+}
+
+/// A run of consecutive vertices
+#[repr(C)]
+pub struct CVertexRange {
+    /// First vertex
+    pub start: usize,
+    /// Number of vertices
+    pub count: usize,
+}
+
+/// C-compatible scalar-field volume frame
+#[repr(C)]
+pub struct CVolumeFrame {
+    /// Null-terminated simulation ID string
+    pub simulation_id: *const c_char,
+    /// Frame number
+    pub frame_number: c_uint,
+    /// Timestamp in nanoseconds
+    pub timestamp: u64,
+    /// Position of the first sample (x, y, z)
+    pub origin: [c_float; 3],
+    /// Distance between neighbouring samples (x, y, z)
+    pub spacing: [c_float; 3],
+    /// Samples along each axis, at least 2 and at most 2^30 in all
+    pub dims: [c_uint; 3],
+    /// Pointer to `dims[0] * dims[1] * dims[2]` samples, x fastest
+    pub samples: *const c_float,
+    /// Value to extract the surface at; samples below it are inside
+    pub iso_value: c_float,
+    /// Samples per side of the blocks of a sparse frame, at most 64, or 0
+    /// to send every sample
+    pub block_size: c_uint,
+}
+
+/// A named per-particle value of a point frame
+#[repr(C)]
+pub struct CPointScalars {
+    /// Null-terminated name, such as "density"
+    pub name: *const c_char,
+    /// Pointer to one value per particle
+    pub values: *const c_float,
+}
+
+/// C-compatible particle frame
+#[repr(C)]
+pub struct CPointFrame {
+    /// Null-terminated simulation ID string
+    pub simulation_id: *const c_char,
+    /// Frame number
+    pub frame_number: c_uint,
+    /// Timestamp in nanoseconds
+    pub timestamp: u64,
+    /// Domain minimum bounds (x, y, z); positions are quantized relative
+    /// to the domain
+    pub domain_min: [c_float; 3],
+    /// Domain maximum bounds (x, y, z)
+    pub domain_max: [c_float; 3],
+    /// Number of particles
+    pub point_count: usize,
+    /// Pointer to particle positions (x,y,z triplets)
+    pub positions: *const c_float,
+    /// Number of entries in `scalars`
+    pub scalar_count: usize,
+    /// Pointer to per-particle values, NULL if none
+    pub scalars: *const CPointScalars,
+}
+
+/// Sender statistics
+#[repr(C)]
+pub struct CSenderStats {
+    /// Number of frames sent
+    pub frames_sent: u64,
+    /// Total bytes sent
+    pub bytes_sent: u64,
+    /// Successful reconnects after a lost connection
+    pub reconnects: u64,
+    /// Frames discarded because the replay buffer was full
+    pub frames_dropped: u64,
+    /// Frames not sent because of a rate limit
+    pub frames_skipped: u64,
+    /// Frames waiting to be written, including those kept for replay
+    pub frames_buffered: u64,
+    /// Whether the connection is currently up (1 = true, 0 = false)
+    pub connected: c_int,
 }
 
 /// Create a default sender configuration
@@ -79,6 +218,20 @@ pub extern "C" fn seaview_network_default_config() -> CSenderConfig {
         send_buffer_size: 1024 * 1024, // 1MB
         connect_timeout_ms: 10000,     // 10 seconds
         write_timeout_ms: 30000,       // 30 seconds
+        reconnect: 1,
+        replay_frames: 0,
+        replay_bytes: 64 * 1024 * 1024, // 64MB
+        max_backoff_ms: 5000,           // 5 seconds
+        stripes: 1,
+        negotiate: 1,
+        io_uring: 0,
+        zerocopy_threshold: 0,
+        lod_ratio: 0.0,
+        lod_full_every: 30,
+        progressive_min_triangles: 0,
+        max_frame_rate: 0.0,
+        partial_updates: 0,
+        index_compression: CIndexCompression::Narrow,
     }
 }
 
@@ -160,6 +313,38 @@ pub unsafe extern "C" fn seaview_network_create_sender_with_config(
         } else {
             None
         },
+        reconnect: (config.reconnect != 0).then(|| ReconnectConfig {
+            replay_frames: config.replay_frames as usize,
+            replay_bytes: config.replay_bytes,
+            max_backoff: Duration::from_millis(config.max_backoff_ms.max(1) as u64),
+            ..ReconnectConfig::default()
+        }),
+        stripes: (config.stripes as usize).max(1),
+        negotiate: config.negotiate != 0,
+        io_backend: if config.io_uring != 0 {
+            IoBackend::Uring
+        } else {
+            IoBackend::Blocking
+        },
+        zerocopy_threshold: (config.zerocopy_threshold > 0).then_some(config.zerocopy_threshold),
+        lod: (config.lod_ratio > 0.0 && config.lod_ratio < 1.0).then(|| LodConfig {
+            target: LodTarget::Ratio(config.lod_ratio),
+            full_every: config.lod_full_every,
+            ..LodConfig::default()
+        }),
+        progressive: (config.progressive_min_triangles > 0).then(|| ProgressiveConfig {
+            min_triangles: config.progressive_min_triangles,
+            ..ProgressiveConfig::default()
+        }),
+        rate_limit: (config.max_frame_rate > 0.0)
+            .then(|| RateLimit::max_fps(config.max_frame_rate)),
+        partial_updates: (config.partial_updates != 0).then(DeltaConfig::default),
+        index_compression: match config.index_compression {
+            CIndexCompression::Uncompressed => IndexCompression::None,
+            CIndexCompression::Narrow => IndexCompression::Narrow,
+            CIndexCompression::Coded => IndexCompression::Coded,
+        },
+        ..SenderConfig::default()
     };
 
     let addr = format!("{host_str}:{port}");
@@ -184,9 +369,9 @@ pub unsafe extern "C" fn seaview_network_create_sender_with_config(
 /// - `mesh`: Mesh frame data
 ///
 /// # Returns
-/// - 0 on success
+/// - 0 on success, including frames buffered while reconnecting
 /// - -1 on invalid parameters
-/// - -2 on send failure
+/// - -2 on send failure (only when reconnect is disabled)
 #[no_mangle]
 pub unsafe extern "C" fn seaview_network_send_mesh(
     sender: *mut NetworkSender,
@@ -199,16 +384,264 @@ pub unsafe extern "C" fn seaview_network_send_mesh(
 
     let sender = &mut (*sender);
     let mesh = &*mesh;
+    let Some(rust_mesh) = convert_mesh(mesh) else {
+        return -1;
+    };
+
+    // Send the mesh
+    match sender.sender.send_mesh(&rust_mesh) {
+        Ok(()) => {
+            debug!(
+                "Successfully sent mesh frame {} with {} vertices",
+                mesh.frame_number, mesh.vertex_count
+            );
+            0
+        }
+        Err(e) => {
+            error!("Failed to send mesh: {}", e);
+            -2
+        }
+    }
+}
+
+/// Send a mesh frame that only changed in the given vertex ranges
+///
+/// With partial updates enabled only the changed vertices are sent when
+/// the receiver supports it; the topology must be that of the previous
+/// frame. Otherwise this is the same as `seaview_network_send_mesh`.
+///
+/// # Parameters
+/// - `sender`: Sender handle
+/// - `mesh`: Mesh frame data
+/// - `ranges`: Changed vertex ranges
+/// - `range_count`: Number of entries in `ranges`
+///
+/// # Returns
+/// Same as `seaview_network_send_mesh`
+#[no_mangle]
+pub unsafe extern "C" fn seaview_network_send_mesh_dirty(
+    sender: *mut NetworkSender,
+    mesh: *const CMeshFrame,
+    ranges: *const CVertexRange,
+    range_count: usize,
+) -> c_int {
+    if sender.is_null() || mesh.is_null() || (ranges.is_null() && range_count > 0) {
+        error!("Null pointer passed to send_mesh_dirty");
+        return -1;
+    }
+
+    let sender = &mut (*sender);
+    let mesh = &*mesh;
+    let Some(rust_mesh) = convert_mesh(mesh) else {
+        return -1;
+    };
+    let dirty: Vec<Range<usize>> = if range_count == 0 {
+        Vec::new()
+    } else {
+        slice::from_raw_parts(ranges, range_count)
+            .iter()
+            .map(|range| range.start..range.start.saturating_add(range.count))
+            .collect()
+    };
 
+    match sender.sender.send_mesh_dirty(&rust_mesh, &dirty) {
+        Ok(()) => {
+            debug!(
+                "Successfully sent mesh frame {} with {} changed ranges",
+                mesh.frame_number, range_count
+            );
+            0
+        }
+        Err(e) => {
+            error!("Failed to send mesh: {}", e);
+            -2
+        }
+    }
+}
+
+/// Send a scalar-field volume frame
+///
+/// Samples are quantized to 16 bits. Receivers that support volume frames
+/// extract the surface themselves; for others it is extracted here.
+///
+/// # Parameters
+/// - `sender`: Sender handle
+/// - `volume`: Volume frame data
+///
+/// # Returns
+/// Same as `seaview_network_send_mesh`
+#[no_mangle]
+pub unsafe extern "C" fn seaview_network_send_volume(
+    sender: *mut NetworkSender,
+    volume: *const CVolumeFrame,
+) -> c_int {
+    if sender.is_null() || volume.is_null() {
+        error!("Null pointer passed to send_volume");
+        return -1;
+    }
+
+    let sender = &mut (*sender);
+    let volume = &*volume;
+    if volume.simulation_id.is_null() || volume.samples.is_null() {
+        error!("Null simulation_id or samples pointer");
+        return -1;
+    }
+    let sim_id = match CStr::from_ptr(volume.simulation_id).to_str() {
+        Ok(s) => s.to_string(),
+        Err(e) => {
+            error!("Invalid UTF-8 in simulation_id: {}", e);
+            return -1;
+        }
+    };
+
+    let grid = VolumeGrid {
+        origin: volume.origin,
+        spacing: volume.spacing,
+        dims: volume.dims,
+    };
+    if !grid.is_valid() {
+        error!("Invalid volume dimensions {:?}", grid.dims);
+        return -1;
+    }
+    let samples = slice::from_raw_parts(volume.samples, grid.sample_count());
+    let layout = match volume.block_size {
+        0 => VolumeLayout::Dense,
+        block_size => VolumeLayout::Sparse { block_size },
+    };
+    let mut rust_volume = match VolumeFrame::from_values(
+        sim_id,
+        volume.frame_number,
+        grid,
+        samples,
+        volume.iso_value,
+        layout,
+    ) {
+        Ok(rust_volume) => rust_volume,
+        Err(e) => {
+            error!("Invalid volume data: {}", e);
+            return -1;
+        }
+    };
+    rust_volume.timestamp = volume.timestamp;
+
+    match sender.sender.send_volume(&rust_volume) {
+        Ok(()) => {
+            debug!(
+                "Successfully sent volume frame {} of {:?} samples",
+                volume.frame_number, volume.dims
+            );
+            0
+        }
+        Err(e) => {
+            error!("Failed to send volume: {}", e);
+            -2
+        }
+    }
+}
+
+/// Send a particle frame
+///
+/// Positions and values are quantized to 16 bits and sorted in Morton
+/// order. Frames for receivers that do not support point frames are skipped.
+///
+/// # Parameters
+/// - `sender`: Sender handle
+/// - `points`: Particle frame data
+///
+/// # Returns
+/// Same as `seaview_network_send_mesh`
+#[no_mangle]
+pub unsafe extern "C" fn seaview_network_send_points(
+    sender: *mut NetworkSender,
+    points: *const CPointFrame,
+) -> c_int {
+    if sender.is_null() || points.is_null() {
+        error!("Null pointer passed to send_points");
+        return -1;
+    }
+
+    let sender = &mut (*sender);
+    let points = &*points;
+    if points.simulation_id.is_null()
+        || (points.positions.is_null() && points.point_count > 0)
+        || (points.scalars.is_null() && points.scalar_count > 0)
+    {
+        error!("Null simulation_id, positions or scalars pointer");
+        return -1;
+    }
+    let sim_id = match CStr::from_ptr(points.simulation_id).to_str() {
+        Ok(s) => s.to_string(),
+        Err(e) => {
+            error!("Invalid UTF-8 in simulation_id: {}", e);
+            return -1;
+        }
+    };
+
+    let positions = if points.point_count == 0 {
+        &[][..]
+    } else {
+        slice::from_raw_parts(points.positions, points.point_count * 3)
+    };
+    let c_scalars = if points.scalar_count == 0 {
+        &[][..]
+    } else {
+        slice::from_raw_parts(points.scalars, points.scalar_count)
+    };
+    let mut scalars = Vec::with_capacity(c_scalars.len());
+    for scalar in c_scalars {
+        if scalar.name.is_null() || (scalar.values.is_null() && points.point_count > 0) {
+            error!("Null scalar name or values pointer");
+            return -1;
+        }
+        let Ok(name) = CStr::from_ptr(scalar.name).to_str() else {
+            error!("Invalid UTF-8 in scalar name");
+            return -1;
+        };
+        let values = if points.point_count == 0 {
+            &[][..]
+        } else {
+            slice::from_raw_parts(scalar.values, points.point_count)
+        };
+        scalars.push(PointScalars { name, values });
+    }
+
+    let bounds = DomainBounds::new(points.domain_min, points.domain_max);
+    let mut frame =
+        match PointFrame::encode(sim_id, points.frame_number, bounds, positions, &scalars) {
+            Ok(frame) => frame,
+            Err(e) => {
+                error!("Invalid point data: {}", e);
+                return -1;
+            }
+        };
+    frame.timestamp = points.timestamp;
+
+    match sender.sender.send_points(&frame) {
+        Ok(()) => {
+            debug!(
+                "Successfully sent point frame {} with {} particles",
+                points.frame_number, points.point_count
+            );
+            0
+        }
+        Err(e) => {
+            error!("Failed to send points: {}", e);
+            -2
+        }
+    }
+}
+
+/// Copy and validate a C mesh frame
+unsafe fn convert_mesh(mesh: &CMeshFrame) -> Option<MeshFrame> {
     // Validate mesh data
     if mesh.simulation_id.is_null() {
         error!("Null simulation_id");
-        return -1;
+        return None;
     }
 
     if mesh.vertices.is_null() {
         error!("Null vertices pointer");
-        return -1;
+        return None;
     }
 
     if mesh.vertex_count == 0 || mesh.vertex_count % 3 != 0 {
@@ -216,7 +649,7 @@ pub unsafe extern "C" fn seaview_network_send_mesh(
             "Invalid vertex count: {} (must be non-zero and divisible by 3)",
             mesh.vertex_count
         );
-        return -1;
+        return None;
     }
 
     // Convert simulation ID
@@ -224,7 +657,7 @@ pub unsafe extern "C" fn seaview_network_send_mesh(
         Ok(s) => s.to_string(),
         Err(e) => {
             error!("Invalid UTF-8 in simulation_id: {}", e);
-            return -1;
+            return None;
         }
     };
 
@@ -252,23 +685,10 @@ pub unsafe extern "C" fn seaview_network_send_mesh(
     // Validate the mesh
     if let Err(e) = rust_mesh.validate() {
         error!("Invalid mesh data: {}", e);
-        return -1;
+        return None;
     }
 
-    // Send the mesh
-    match sender.sender.send_mesh(&rust_mesh) {
-        Ok(()) => {
-            debug!(
-                "Successfully sent mesh frame {} with {} vertices",
-                mesh.frame_number, mesh.vertex_count
-            );
-            0
-        }
-        Err(e) => {
-            error!("Failed to send mesh: {}", e);
-            -2
-        }
-    }
+    Some(rust_mesh)
 }
 
 /// Send a heartbeat message
@@ -361,6 +781,41 @@ pub unsafe extern "C" fn seaview_network_get_stats(
     0
 }
 
+/// Get detailed sender statistics, including reconnect counters
+///
+/// # Parameters
+/// - `sender`: Sender handle
+/// - `stats`: Pointer to store the statistics
+///
+/// # Returns
+/// - 0 on success
+/// - -1 on invalid parameters
+#[no_mangle]
+pub unsafe extern "C" fn seaview_network_get_sender_stats(
+    sender: *mut NetworkSender,
+    stats: *mut CSenderStats,
+) -> c_int {
+    if sender.is_null() || stats.is_null() {
+        error!("Null pointer passed to get_sender_stats");
+        return -1;
+    }
+
+    let sender = &(*sender);
+    let sender_stats = sender.sender.stats();
+
+    *stats = CSenderStats {
+        frames_sent: sender_stats.frames_sent,
+        bytes_sent: sender_stats.bytes_sent,
+        reconnects: sender_stats.reconnects,
+        frames_dropped: sender_stats.frames_dropped,
+        frames_skipped: sender_stats.frames_skipped,
+        frames_buffered: sender_stats.frames_buffered as u64,
+        connected: sender_stats.connected as c_int,
+    };
+
+    0
+}
+
 /// Destroy a network sender
 ///
 /// # Parameters
@@ -416,6 +871,8 @@ mod tests {
         let config = seaview_network_default_config();
         assert_eq!(config.tcp_nodelay, 1);
         assert_eq!(config.max_message_size, 100 * 1024 * 1024);
+        assert_eq!(config.reconnect, 1);
+        assert_eq!(config.replay_frames, 0);
     }
 
     #[test]
@@ -431,6 +888,10 @@ mod tests {
         // Test null mesh
         let result = unsafe { seaview_network_send_heartbeat(ptr::null_mut()) };
         assert_eq!(result, -1);
+
+        // Test null stats
+        let result = unsafe { seaview_network_get_sender_stats(ptr::null_mut(), ptr::null_mut()) };
+        assert_eq!(result, -1);
     }
 
     #[test]
@@ -0,0 +1,303 @@
+//! Capability handshake between sender and receiver
+//!
+//! A sender opens each connection with a [`MessageType::Hello`] carrying its
+//! [`Capabilities`]: the protocol versions it speaks, the frame encodings and
+//! compression codecs it can produce, its maximum message size and a set of
+//! feature flags. The receiver answers with a [`MessageType::HelloAck`]
+//! holding the [`Negotiated`] settings, or a rejection when the two sides
+//! have nothing in common.
+//!
+//! The handshake never delays the stream. The sender keeps writing plain
+//! frames in its configured format until the acknowledgement arrives and
+//! only then switches to the negotiated encoding. Receivers that predate
+//! the handshake drop the connection on the unknown message; the sender
+//! then reconnects without a hello and stays on its configured format.
+
+use crate::protocol::{
+    EncodedMessage, MessageType, NetworkMessage, Protocol, ProtocolError, WireFormat,
+    MIN_PROTOCOL_VERSION, PROTOCOL_VERSION,
+};
+
+use serde::{Deserialize, Serialize};
+use std::io::Write;
+use tracing::{debug, warn};
+
+/// The peer reassembles frames striped across parallel connections
+pub const FEATURE_STRIPING: u64 = 1 << 0;
+
+/// The peer shows coarse levels of progressive frames
+pub const FEATURE_PROGRESSIVE: u64 = 1 << 1;
+
+/// The peer applies partial updates to the previous frame
+pub const FEATURE_PARTIAL_UPDATES: u64 = 1 << 2;
+
+/// The peer decodes 16-bit and coded indices in columnar frames
+pub const FEATURE_COMPACT_INDICES: u64 = 1 << 3;
+
+/// The peer extracts surfaces from volume frames
+pub const FEATURE_VOLUME_FRAMES: u64 = 1 << 4;
+
+/// The peer decodes point frames
+pub const FEATURE_POINT_FRAMES: u64 = 1 << 5;
+
+/// Encoding of mesh frame payloads
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+#[repr(u8)]
+pub enum FrameEncoding {
+    /// Bincode serialization of the whole frame
+    Bincode = 0,
+    /// JSON serialization, for debugging
+    Json = 1,
+    /// Aligned raw arrays, see [`crate::columnar`]; the fastest to encode
+    /// and decode
+    Columnar = 2,
+}
+
+impl FrameEncoding {
+    /// Convert from the id used in capability lists
+    pub fn from_id(id: u8) -> Option<Self> {
+        match id {
+            0 => Some(Self::Bincode),
+            1 => Some(Self::Json),
+            2 => Some(Self::Columnar),
+            _ => None,
+        }
+    }
+
+    /// The wire format used for `MeshFrame` messages, if this is one
+    pub fn wire_format(self) -> Option<WireFormat> {
+        match self {
+            Self::Bincode => Some(WireFormat::Bincode),
+            #[cfg(feature = "json")]
+            Self::Json => Some(WireFormat::Json),
+            _ => None,
+        }
+    }
+}
+
+impl From<WireFormat> for FrameEncoding {
+    fn from(format: WireFormat) -> Self {
+        match format {
+            WireFormat::Bincode => Self::Bincode,
+            #[cfg(feature = "json")]
+            WireFormat::Json => Self::Json,
+        }
+    }
+}
+
+/// Compression applied to frame payloads
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+#[repr(u8)]
+pub enum Codec {
+    /// Payloads are sent as encoded
+    None = 0,
+}
+
+impl Codec {
+    /// Convert from the id used in capability lists
+    pub fn from_id(id: u8) -> Option<Self> {
+        match id {
+            0 => Some(Self::None),
+            _ => None,
+        }
+    }
+}
+
+/// What one side of a connection supports
+///
+/// Encodings and codecs are listed by id, in order of preference, so a peer
+/// can advertise ids the other side does not know yet.
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct Capabilities {
+    /// Oldest protocol version spoken
+    pub min_version: u16,
+    /// Newest protocol version spoken
+    pub max_version: u16,
+    /// Supported frame encodings, see [`FrameEncoding`]
+    pub encodings: Vec<u8>,
+    /// Supported compression codecs, see [`Codec`]
+    pub codecs: Vec<u8>,
+    /// Largest message accepted, in bytes
+    pub max_message_size: u64,
+    /// Bitmask of `FEATURE_*` flags
+    pub features: u64,
+}
+
+impl Capabilities {
+    /// Capabilities of this build for the given `MeshFrame` format
+    ///
+    /// Columnar frames are always supported and preferred; the configured
+    /// format is the fallback.
+    pub fn new(format: WireFormat, max_message_size: usize, features: u64) -> Self {
+        let mut encodings = vec![FrameEncoding::Columnar as u8];
+        let fallback = FrameEncoding::from(format) as u8;
+        if !encodings.contains(&fallback) {
+            encodings.push(fallback);
+        }
+
+        Self {
+            min_version: MIN_PROTOCOL_VERSION,
+            max_version: PROTOCOL_VERSION,
+            encodings,
+            codecs: vec![Codec::None as u8],
+            max_message_size: max_message_size as u64,
+            features,
+        }
+    }
+
+    /// Pick the settings for a connection, as the side answering `offer`
+    ///
+    /// The offer's order of preference wins. Returns `None` when there is no
+    /// common protocol version or frame encoding.
+    pub fn negotiate(&self, offer: &Capabilities) -> Option<Negotiated> {
+        let version = self.max_version.min(offer.max_version);
+        if version < self.min_version.max(offer.min_version) {
+            return None;
+        }
+
+        let encoding = offer
+            .encodings
+            .iter()
+            .filter(|id| self.encodings.contains(id))
+            .find_map(|&id| FrameEncoding::from_id(id))?;
+
+        let codec = offer
+            .codecs
+            .iter()
+            .filter(|id| self.codecs.contains(id))
+            .find_map(|&id| Codec::from_id(id))
+            .unwrap_or(Codec::None);
+
+        Some(Negotiated {
+            version,
+            encoding,
+            codec,
+            max_message_size: self.max_message_size.min(offer.max_message_size),
+            features: self.features & offer.features,
+        })
+    }
+
+    /// Encode as a hello message
+    pub fn to_hello(&self) -> Result<NetworkMessage, ProtocolError> {
+        Ok(NetworkMessage::new(
+            MessageType::Hello,
+            bincode::serialize(self)?,
+        ))
+    }
+
+    /// Decode the payload of a hello message
+    pub fn from_hello(payload: &[u8]) -> Result<Self, ProtocolError> {
+        Ok(bincode::deserialize(payload)?)
+    }
+}
+
+/// Settings agreed for one connection
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+pub struct Negotiated {
+    /// Protocol version both sides speak
+    pub version: u16,
+    /// Encoding for mesh frames
+    pub encoding: FrameEncoding,
+    /// Compression for frame payloads
+    pub codec: Codec,
+    /// Largest message both sides accept
+    pub max_message_size: u64,
+    /// Features both sides support
+    pub features: u64,
+}
+
+impl Negotiated {
+    /// Check whether a `FEATURE_*` flag was agreed
+    pub fn has_feature(&self, feature: u64) -> bool {
+        self.features & feature == feature
+    }
+}
+
+/// Answer to a hello: the agreed settings, or `None` if rejected
+pub fn ack_message(negotiated: Option<&Negotiated>) -> Result<NetworkMessage, ProtocolError> {
+    Ok(NetworkMessage::new(
+        MessageType::HelloAck,
+        bincode::serialize(&negotiated)?,
+    ))
+}
+
+/// Decode the payload of a hello acknowledgement
+pub fn parse_ack(payload: &[u8]) -> Result<Option<Negotiated>, ProtocolError> {
+    Ok(bincode::deserialize(payload)?)
+}
+
+/// Answer a received hello with the settings for this connection
+pub fn answer_hello<W: Write>(
+    protocol: &Protocol,
+    local: &Capabilities,
+    writer: &mut W,
+    payload: &[u8],
+) -> Result<Option<Negotiated>, ProtocolError> {
+    let offer = Capabilities::from_hello(payload)?;
+    let negotiated = local.negotiate(&offer);
+
+    match &negotiated {
+        Some(negotiated) => debug!(
+            "Agreed on {:?} frames, protocol v{}",
+            negotiated.encoding, negotiated.version
+        ),
+        None => warn!(
+            "No common settings with peer (versions {}..={}, encodings {:?})",
+            offer.min_version, offer.max_version, offer.encodings
+        ),
+    }
+
+    // A sender that already went away cannot take the answer, but the frames
+    // it sent before closing are still waiting to be read
+    let ack = EncodedMessage::from_message(&ack_message(negotiated.as_ref())?);
+    if let Err(e) = protocol.write_encoded(writer, &ack) {
+        debug!("Could not answer hello: {}", e);
+    }
+    Ok(negotiated)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_negotiate_prefers_columnar() {
+        let sender = Capabilities::new(WireFormat::Bincode, 1000, FEATURE_STRIPING);
+        let receiver = Capabilities::new(WireFormat::Bincode, 500, 0);
+
+        let negotiated = receiver.negotiate(&sender).unwrap();
+        assert_eq!(negotiated.version, PROTOCOL_VERSION);
+        assert_eq!(negotiated.encoding, FrameEncoding::Columnar);
+        assert_eq!(negotiated.codec, Codec::None);
+        assert_eq!(negotiated.max_message_size, 500);
+        assert!(!negotiated.has_feature(FEATURE_STRIPING));
+    }
+
+    #[test]
+    fn test_negotiate_falls_back_and_rejects() {
+        let sender = Capabilities::new(WireFormat::Bincode, 1000, 0);
+
+        // A peer without columnar support gets the plain format
+        let mut receiver = sender.clone();
+        receiver.encodings = vec![FrameEncoding::Bincode as u8, 99];
+        let negotiated = receiver.negotiate(&sender).unwrap();
+        assert_eq!(negotiated.encoding, FrameEncoding::Bincode);
+
+        // No overlapping version range
+        receiver.min_version = PROTOCOL_VERSION + 1;
+        receiver.max_version = PROTOCOL_VERSION + 2;
+        assert!(receiver.negotiate(&sender).is_none());
+    }
+
+    #[test]
+    fn test_hello_round_trip() {
+        let caps = Capabilities::new(WireFormat::Bincode, 1234, FEATURE_STRIPING);
+        let hello = caps.to_hello().unwrap();
+        assert_eq!(hello.msg_type, MessageType::Hello);
+        assert_eq!(Capabilities::from_hello(&hello.payload).unwrap(), caps);
+
+        let negotiated = caps.negotiate(&caps);
+        let ack = ack_message(negotiated.as_ref()).unwrap();
+        assert_eq!(parse_ack(&ack.payload).unwrap(), negotiated);
+    }
+}
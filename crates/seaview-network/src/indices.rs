@@ -0,0 +1,210 @@
+//! Compact index encodings for columnar frames
+//!
+//! Indices are handed to the sender as 32-bit values, but most frames need
+//! far fewer bits. With [`IndexCompression::Narrow`] frames of at most
+//! 65,536 vertices carry 16-bit indices, which a viewer can also keep on the
+//! GPU. [`IndexCompression::Coded`] goes further and codes every index
+//! relative to the ones before it:
+//!
+//! - a vertex used for the first time in order costs one byte (code 0),
+//! - one of the last 16 indices costs one byte (code 1–16),
+//! - anything else is the zigzag delta to the previous index plus 17, as a
+//!   LEB128 varint.
+//!
+//! Surfaces from marching cubes and other sweeps mostly reference vertices
+//! they just emitted, so a triangle typically costs 3–4 bytes instead of 12.
+//! Decoding writes straight into the final index buffer in one pass.
+//!
+//! Both encodings only apply to columnar frames and are only used with
+//! receivers that advertise
+//! [`FEATURE_COMPACT_INDICES`](crate::handshake::FEATURE_COMPACT_INDICES).
+
+use crate::protocol::ProtocolError;
+
+/// How a sender encodes the indices of columnar frames
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub enum IndexCompression {
+    /// Always 32-bit indices
+    None,
+    /// 16-bit indices when every index fits, 32-bit otherwise
+    #[default]
+    Narrow,
+    /// Variable-length codes, see the module documentation
+    Coded,
+}
+
+/// Most vertices a frame with 16-bit indices can address
+pub const NARROW_VERTICES: usize = u16::MAX as usize + 1;
+
+/// Recently used indices a code can refer back to
+const RECENT: usize = 16;
+
+/// First code of an explicit delta
+const DELTA_BASE: u64 = RECENT as u64 + 1;
+
+/// Indices of a borrowed columnar frame
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum IndexSlice<'a> {
+    /// 32-bit indices
+    U32(&'a [u32]),
+    /// 16-bit indices
+    U16(&'a [u16]),
+}
+
+impl IndexSlice<'_> {
+    /// Number of indices
+    pub fn len(&self) -> usize {
+        match self {
+            Self::U32(indices) => indices.len(),
+            Self::U16(indices) => indices.len(),
+        }
+    }
+
+    /// Whether there are no indices
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Index at `position`
+    pub fn get(&self, position: usize) -> Option<u32> {
+        match self {
+            Self::U32(indices) => indices.get(position).copied(),
+            Self::U16(indices) => indices.get(position).map(|&index| index as u32),
+        }
+    }
+
+    /// Copy out as 32-bit indices
+    pub fn to_vec(&self) -> Vec<u32> {
+        match self {
+            Self::U32(indices) => indices.to_vec(),
+            Self::U16(indices) => indices.iter().map(|&index| index as u32).collect(),
+        }
+    }
+}
+
+/// Append the variable-length coding of `indices` to `out`
+pub fn encode(indices: &[u32], out: &mut Vec<u8>) {
+    let mut recent = [0; RECENT];
+    let mut head = 0;
+    let mut next = 0u32;
+    let mut last = 0u32;
+
+    for (position, &index) in indices.iter().enumerate() {
+        let known = position.min(RECENT);
+        let code = if index == next {
+            0
+        } else if let Some(age) =
+            (1..=known).find(|&age| recent[(head + RECENT - age) % RECENT] == index)
+        {
+            age as u64
+        } else {
+            DELTA_BASE + zigzag(index as i64 - last as i64)
+        };
+        write_varint(out, code);
+
+        recent[head] = index;
+        head = (head + 1) % RECENT;
+        next = next.max(index.saturating_add(1));
+        last = index;
+    }
+}
+
+/// Decode `count` indices from `data`, appending them to `out`
+///
+/// Fails if `data` is truncated, has bytes left over or codes an index
+/// outside the 32-bit range.
+pub fn decode_into(data: &[u8], count: usize, out: &mut Vec<u32>) -> Result<(), ProtocolError> {
+    out.reserve(count);
+    let mut recent = [0; RECENT];
+    let mut head = 0;
+    let mut next = 0u32;
+    let mut last = 0u32;
+    let mut position = 0;
+
+    for decoded in 0..count {
+        let code = read_varint(data, &mut position)?;
+        let index = match code {
+            0 => next,
+            // Must not refer back past the start of the stream
+            code if code < DELTA_BASE && code as usize <= decoded => {
+                recent[(head + RECENT - code as usize) % RECENT]
+            }
+            code if code >= DELTA_BASE => u32::try_from(last as i64 + unzigzag(code - DELTA_BASE))
+                .map_err(|_| ProtocolError::InvalidFormat)?,
+            _ => return Err(ProtocolError::InvalidFormat),
+        };
+        out.push(index);
+
+        recent[head] = index;
+        head = (head + 1) % RECENT;
+        next = next.max(index.saturating_add(1));
+        last = index;
+    }
+
+    if position != data.len() {
+        return Err(ProtocolError::InvalidFormat);
+    }
+    Ok(())
+}
+
+fn zigzag(value: i64) -> u64 {
+    ((value << 1) ^ (value >> 63)) as u64
+}
+
+fn unzigzag(value: u64) -> i64 {
+    (value >> 1) as i64 ^ -((value & 1) as i64)
+}
+
+fn write_varint(out: &mut Vec<u8>, mut value: u64) {
+    while value >= 0x80 {
+        out.push(value as u8 | 0x80);
+        value >>= 7;
+    }
+    out.push(value as u8);
+}
+
+fn read_varint(data: &[u8], position: &mut usize) -> Result<u64, ProtocolError> {
+    let mut value = 0u64;
+    for shift in (0..64).step_by(7) {
+        let byte = *data.get(*position).ok_or(ProtocolError::InvalidFormat)?;
+        *position += 1;
+        value |= ((byte & 0x7f) as u64) << shift;
+        if byte & 0x80 == 0 {
+            return Ok(value);
+        }
+    }
+    Err(ProtocolError::InvalidFormat)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_coded_round_trip() {
+        // A strip of quads, as a sweep over a grid emits them
+        let width = 100u32;
+        let indices: Vec<u32> = (0..50u32)
+            .flat_map(|y| (0..width - 1).map(move |x| y * width + x))
+            .flat_map(|c| [c, c + 1, c + width, c + 1, c + width + 1, c + width])
+            .collect();
+
+        let mut coded = Vec::new();
+        encode(&indices, &mut coded);
+        assert!(coded.len() * 3 < indices.len() * 4, "{} bytes", coded.len());
+
+        let mut decoded = Vec::new();
+        decode_into(&coded, indices.len(), &mut decoded).unwrap();
+        assert_eq!(decoded, indices);
+
+        // Far jumps in both directions, and corrupt input
+        let indices = vec![0, u32::MAX - 1, 5, 5, 70_000, 1];
+        let mut coded = Vec::new();
+        encode(&indices, &mut coded);
+        let mut decoded = Vec::new();
+        decode_into(&coded, indices.len(), &mut decoded).unwrap();
+        assert_eq!(decoded, indices);
+        assert!(decode_into(&coded[..coded.len() - 1], indices.len(), &mut Vec::new()).is_err());
+        assert!(decode_into(&[3], 1, &mut Vec::new()).is_err());
+    }
+}
@@ -4,21 +4,57 @@
 //! data from simulations to visualization tools. It supports both Rust and C/C++ clients
 //! through FFI bindings.
 
+pub mod buffer;
+pub mod cache;
+pub mod columnar;
+pub mod delta;
+pub mod handshake;
+pub mod indices;
+pub mod isosurface;
+pub mod lod;
+pub mod points;
+pub mod progressive;
 pub mod protocol;
+pub mod rate;
 pub mod receiver;
+pub mod relay;
+pub mod roi;
 pub mod sender;
+pub mod stripe;
 pub mod types;
+pub mod uring;
+pub mod volume;
+pub mod zerocopy;
 
 #[cfg(feature = "ffi")]
 pub mod ffi;
 
 // Re-export commonly used types
-pub use protocol::{MessageType, Protocol, ProtocolError, WireFormat, PROTOCOL_VERSION};
+pub use buffer::{BufferPool, FrameBuffer};
+pub use cache::FrameCache;
+pub use columnar::MeshFrameView;
+pub use delta::{DeltaConfig, PartialUpdate};
+pub use handshake::{Capabilities, Codec, FrameEncoding, Negotiated};
+pub use indices::{IndexCompression, IndexSlice};
+pub use isosurface::{IsoSurface, ScalarField};
+pub use lod::{LodConfig, LodTarget};
+pub use points::{PointCloud, PointFrame, PointScalars};
+pub use progressive::{CoarseLevel, ProgressiveConfig};
+pub use protocol::{
+    EncodedMessage, MessageType, Protocol, ProtocolError, WireFormat, MIN_PROTOCOL_VERSION,
+    PROTOCOL_VERSION,
+};
+pub use rate::RateLimit;
 pub use receiver::{
-    MeshReceiver, NonBlockingMeshReceiver, ReceiveError, ReceivedMesh, ReceiverConfig,
+    FrameSubscribers, MeshReceiver, NonBlockingMeshReceiver, ReceiveError, ReceivedFrame,
+    ReceivedMesh, ReceiverConfig, SharedFrame,
 };
-pub use sender::{MeshSender, NetworkError, SenderConfig};
-pub use types::{DomainBounds, MeshFrame, MeshMetadata};
+pub use relay::{MeshRelay, RelayConfig, RelayError, RelayHandle, RelayStats};
+pub use roi::{Region, RegionOfInterest};
+pub use sender::{MeshSender, NetworkError, ReconnectConfig, SenderConfig, SenderStats};
+pub use types::{DomainBounds, FrameHeader, FrameRangeRequest, MeshFrame, MeshMetadata};
+pub use uring::IoBackend;
+pub use volume::{VolumeFrame, VolumeGrid, VolumeLayout};
 
 /// Result type for network operations
 pub type Result<T> = std::result::Result<T, NetworkError>;
@@ -0,0 +1,448 @@
+//! Reduced level-of-detail frames for live monitoring
+//!
+//! A sender configured with a [`LodConfig`] ships simplified frames and
+//! full resolution only every so often, or when a viewer asks for it.
+//! Simplification is vertex clustering, the approach of meshoptimizer's
+//! `simplifySloppy`: vertices are snapped to a uniform grid, each occupied
+//! cell becomes one vertex at the mean of its members, and triangles that
+//! collapse or duplicate another are dropped. It ignores topology, which
+//! makes it fast enough for very large frames and spreads well over
+//! worker threads.
+
+use crate::types::MeshFrame;
+
+use std::collections::{HashMap, HashSet};
+use std::ops::Range;
+use std::thread;
+
+/// How far to simplify
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum LodTarget {
+    /// Keep about this fraction of the triangles (0.0..=1.0)
+    Ratio(f32),
+    /// Move no vertex further than this fraction of the bounding box
+    /// diagonal
+    Error(f32),
+}
+
+/// Reduced level-of-detail streaming for a sender
+#[derive(Debug, Clone)]
+pub struct LodConfig {
+    /// Simplification applied to reduced frames
+    pub target: LodTarget,
+    /// Send every Nth frame at full resolution (0 = only on request)
+    pub full_every: u32,
+    /// Worker threads used for simplification
+    pub workers: usize,
+}
+
+impl Default for LodConfig {
+    fn default() -> Self {
+        Self {
+            target: LodTarget::Ratio(0.1),
+            full_every: 30,
+            workers: default_workers(),
+        }
+    }
+}
+
+/// Grid probed to estimate the cell size for a triangle ratio
+const PROBE_RESOLUTION: usize = 64;
+/// Extra clustering passes allowed to get near a triangle ratio
+const RATIO_PASSES: usize = 3;
+/// Largest grid resolution along one axis, so cell keys pack into a u64
+const MAX_RESOLUTION: f32 = (1 << 21) as f32 - 1.0;
+
+/// Simplify a frame
+///
+/// Returns an indexed frame with the same id, number, timestamp and domain
+/// bounds. Normals, if present, are averaged per cluster.
+pub fn simplify(mesh: &MeshFrame, target: LodTarget, workers: usize) -> MeshFrame {
+    let workers = workers.max(1);
+    let Some(bounds) = bounds(&mesh.vertices, workers) else {
+        return mesh.clone();
+    };
+    let extent = (0..3)
+        .map(|axis| bounds.1[axis] - bounds.0[axis])
+        .fold(0.0f32, f32::max);
+    if extent <= 0.0 || mesh.triangle_count() == 0 {
+        return mesh.clone();
+    }
+
+    match target {
+        LodTarget::Error(error) => {
+            let diagonal = (0..3)
+                .map(|axis| (bounds.1[axis] - bounds.0[axis]).powi(2))
+                .sum::<f32>()
+                .sqrt();
+            // A cell's own diagonal bounds how far a vertex moves
+            let cell = (error * diagonal / 3f32.sqrt()).max(extent / MAX_RESOLUTION);
+            cluster(mesh, bounds.0, cell, workers)
+        }
+        LodTarget::Ratio(ratio) => {
+            if ratio >= 1.0 {
+                return mesh.clone();
+            }
+            let target = ((mesh.triangle_count() as f32 * ratio.max(0.0)).ceil() as usize).max(1);
+
+            // Surfaces occupy cells in proportion to the square of the grid
+            // resolution, and have about two triangles per vertex
+            let occupied = occupied_cells(&mesh.vertices, bounds, workers);
+            let mut resolution =
+                PROBE_RESOLUTION as f32 * (target as f32 / 2.0 / occupied as f32).sqrt();
+
+            let mut simplified = None;
+            for _ in 0..RATIO_PASSES {
+                resolution = resolution.clamp(1.0, MAX_RESOLUTION);
+                let candidate = cluster(mesh, bounds.0, extent / resolution, workers);
+                let triangles = candidate.triangle_count();
+                simplified = Some(candidate);
+                if triangles <= target + target / 4 {
+                    break;
+                }
+                resolution *= (target as f32 / triangles as f32).sqrt() * 0.95;
+            }
+            simplified.unwrap_or_else(|| mesh.clone())
+        }
+    }
+}
+
+/// Worker threads used for mesh processing unless configured otherwise
+pub(crate) fn default_workers() -> usize {
+    thread::available_parallelism().map_or(1, |n| n.get())
+}
+
+/// Run `work` on consecutive ranges of `0..len`, one per worker
+pub(crate) fn parallel_ranges<T, F>(len: usize, workers: usize, work: F) -> Vec<T>
+where
+    T: Send,
+    F: Fn(Range<usize>) -> T + Sync,
+{
+    let chunk = len.div_ceil(workers.max(1)).max(1);
+    let work = &work;
+    thread::scope(|scope| {
+        let handles: Vec<_> = (0..len)
+            .step_by(chunk)
+            .map(|start| scope.spawn(move || work(start..(start + chunk).min(len))))
+            .collect();
+        handles
+            .into_iter()
+            .map(|handle| handle.join().expect("LOD worker panicked"))
+            .collect()
+    })
+}
+
+/// Axis-aligned bounds of the vertex positions
+pub(crate) fn bounds(vertices: &[f32], workers: usize) -> Option<([f32; 3], [f32; 3])> {
+    if vertices.len() < 3 {
+        return None;
+    }
+
+    let partial = parallel_ranges(vertices.len() / 3, workers, |range| {
+        let mut min = [f32::INFINITY; 3];
+        let mut max = [f32::NEG_INFINITY; 3];
+        for vertex in vertices[range.start * 3..range.end * 3].chunks_exact(3) {
+            for axis in 0..3 {
+                min[axis] = min[axis].min(vertex[axis]);
+                max[axis] = max[axis].max(vertex[axis]);
+            }
+        }
+        (min, max)
+    });
+
+    partial.into_iter().reduce(|a, b| {
+        let mut merged = a;
+        for axis in 0..3 {
+            merged.0[axis] = merged.0[axis].min(b.0[axis]);
+            merged.1[axis] = merged.1[axis].max(b.1[axis]);
+        }
+        merged
+    })
+}
+
+/// Number of cells of the probe grid that hold at least one vertex
+fn occupied_cells(vertices: &[f32], bounds: ([f32; 3], [f32; 3]), workers: usize) -> usize {
+    const CELLS: usize = PROBE_RESOLUTION * PROBE_RESOLUTION * PROBE_RESOLUTION;
+    let extent = (0..3)
+        .map(|axis| bounds.1[axis] - bounds.0[axis])
+        .fold(0.0f32, f32::max);
+    let scale = (PROBE_RESOLUTION as f32 - 1.0) / extent;
+
+    let maps = parallel_ranges(vertices.len() / 3, workers, |range| {
+        let mut map = vec![0u64; CELLS / 64];
+        for vertex in vertices[range.start * 3..range.end * 3].chunks_exact(3) {
+            let cell = (0..3).fold(0, |cell, axis| {
+                cell * PROBE_RESOLUTION + ((vertex[axis] - bounds.0[axis]) * scale) as usize
+            });
+            map[cell / 64] |= 1 << (cell % 64);
+        }
+        map
+    });
+
+    let mut occupied = vec![0u64; CELLS / 64];
+    for map in maps {
+        for (word, bits) in occupied.iter_mut().zip(map) {
+            *word |= bits;
+        }
+    }
+    occupied
+        .iter()
+        .map(|word| word.count_ones() as usize)
+        .sum::<usize>()
+        .max(1)
+}
+
+/// Shard of the cluster maps a key belongs to
+fn shard(key: u64, shards: usize) -> usize {
+    ((key.wrapping_mul(0x9E37_79B9_7F4A_7C15) >> 32) as usize) % shards
+}
+
+/// Key of a triangle that ignores its winding
+fn triangle_key(mut corners: [u32; 3]) -> u128 {
+    corners.sort_unstable();
+    (corners[0] as u128) << 64 | (corners[1] as u128) << 32 | corners[2] as u128
+}
+
+/// Accumulated vertices of one shard of the grid
+#[derive(Default)]
+struct Shard {
+    ids: HashMap<u64, u32>,
+    positions: Vec<[f64; 3]>,
+    normals: Vec<[f64; 3]>,
+    counts: Vec<u32>,
+}
+
+/// Collapse the vertices of every grid cell into one
+fn cluster(mesh: &MeshFrame, origin: [f32; 3], cell: f32, workers: usize) -> MeshFrame {
+    let vertex_count = mesh.vertex_count();
+    let scale = 1.0 / cell;
+
+    // Grid cell of every vertex, and the vertices of each shard per chunk
+    let (keys, buckets): (Vec<Vec<u64>>, Vec<Vec<Vec<u32>>>) =
+        parallel_ranges(vertex_count, workers, |range| {
+            let mut buckets = vec![Vec::new(); workers];
+            let keys = range
+                .map(|vertex| {
+                    let key = (0..3).fold(0u64, |key, axis| {
+                        let coord = ((mesh.vertices[vertex * 3 + axis] - origin[axis]) * scale)
+                            .clamp(0.0, MAX_RESOLUTION);
+                        key << 21 | coord as u64
+                    });
+                    buckets[shard(key, workers)].push(vertex as u32);
+                    key
+                })
+                .collect::<Vec<_>>();
+            (keys, buckets)
+        })
+        .into_iter()
+        .unzip();
+    let keys = keys.concat();
+
+    // Each worker owns the cells of one shard and averages their vertices
+    let shards: Vec<Shard> = parallel_ranges(workers, workers, |range| {
+        let mut shards = Vec::new();
+        for index in range {
+            let mut shard_data = Shard::default();
+            for &vertex in buckets.iter().flat_map(|chunk| &chunk[index]) {
+                let vertex = vertex as usize;
+                let key = keys[vertex];
+                let next = shard_data.counts.len() as u32;
+                let id = *shard_data.ids.entry(key).or_insert(next);
+                if id == next {
+                    shard_data.positions.push([0.0; 3]);
+                    shard_data.normals.push([0.0; 3]);
+                    shard_data.counts.push(0);
+                }
+
+                let id = id as usize;
+                shard_data.counts[id] += 1;
+                for axis in 0..3 {
+                    shard_data.positions[id][axis] += mesh.vertices[vertex * 3 + axis] as f64;
+                    if let Some(normals) = &mesh.normals {
+                        shard_data.normals[id][axis] += normals[vertex * 3 + axis] as f64;
+                    }
+                }
+            }
+            shards.push(shard_data);
+        }
+        shards
+    })
+    .into_iter()
+    .flatten()
+    .collect();
+
+    let offsets: Vec<u32> = shards
+        .iter()
+        .scan(0u32, |offset, shard| {
+            let start = *offset;
+            *offset += shard.counts.len() as u32;
+            Some(start)
+        })
+        .collect();
+    let cluster_of: Vec<u32> = parallel_ranges(vertex_count, workers, |range| {
+        keys[range]
+            .iter()
+            .map(|&key| {
+                let index = shard(key, workers);
+                offsets[index] + shards[index].ids[&key]
+            })
+            .collect::<Vec<_>>()
+    })
+    .concat();
+
+    // Triangles between three distinct clusters
+    let corner_cluster = |triangle: usize, corner: usize| match &mesh.indices {
+        Some(indices) => cluster_of[indices[triangle * 3 + corner] as usize],
+        None => cluster_of[triangle * 3 + corner],
+    };
+    // Bucketed by shard of their corners, whichever way round they are wound
+    let buckets: Vec<Vec<Vec<[u32; 3]>>> =
+        parallel_ranges(mesh.triangle_count(), workers, |range| {
+            let mut buckets = vec![Vec::new(); workers];
+            for triangle in range {
+                let [a, b, c] = [0, 1, 2].map(|corner| corner_cluster(triangle, corner));
+                if a != b && b != c && a != c {
+                    let key = triangle_key([a, b, c]);
+                    buckets[shard(key as u64 ^ (key >> 64) as u64, workers)].push([a, b, c]);
+                }
+            }
+            buckets
+        });
+
+    // Drop duplicates, each worker within its own shard
+    let triangles: Vec<[u32; 3]> = parallel_ranges(workers, workers, |range| {
+        let mut kept = Vec::new();
+        for index in range {
+            let mut seen = HashSet::new();
+            for &triangle in buckets.iter().flat_map(|chunk| &chunk[index]) {
+                if seen.insert(triangle_key(triangle)) {
+                    kept.push(triangle);
+                }
+            }
+        }
+        kept
+    })
+    .concat();
+
+    // Keep only the clusters the remaining triangles use
+    let cluster_count = offsets.last().map_or(0, |&offset| offset) as usize
+        + shards.last().map_or(0, |shard| shard.counts.len());
+    let mut remap = vec![u32::MAX; cluster_count];
+    let mut vertices = Vec::new();
+    let mut normals = mesh.normals.as_ref().map(|_| Vec::new());
+    let mut shard_index = vec![0usize; cluster_count];
+    for (index, (shard, &offset)) in shards.iter().zip(&offsets).enumerate() {
+        shard_index[offset as usize..offset as usize + shard.counts.len()].fill(index);
+    }
+
+    let indices = triangles
+        .iter()
+        .flatten()
+        .map(|&cluster| {
+            let cluster = cluster as usize;
+            if remap[cluster] == u32::MAX {
+                remap[cluster] = (vertices.len() / 3) as u32;
+                let shard = &shards[shard_index[cluster]];
+                let local = cluster - offsets[shard_index[cluster]] as usize;
+                let count = shard.counts[local] as f64;
+                vertices.extend(shard.positions[local].map(|sum| (sum / count) as f32));
+                if let Some(normals) = normals.as_mut() {
+                    let sum = shard.normals[local];
+                    let length = sum.iter().map(|v| v * v).sum::<f64>().sqrt();
+                    let length = if length > 0.0 { length } else { 1.0 };
+                    normals.extend(sum.map(|v| (v / length) as f32));
+                }
+            }
+            remap[cluster]
+        })
+        .collect();
+
+    MeshFrame {
+        simulation_id: mesh.simulation_id.clone(),
+        frame_number: mesh.frame_number,
+        timestamp: mesh.timestamp,
+        domain_bounds: mesh.domain_bounds.clone(),
+        vertices,
+        normals,
+        indices: Some(indices),
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// A wavy `n` x `n` quad grid with normals
+    fn grid(n: usize) -> MeshFrame {
+        let mut mesh = MeshFrame::new("grid".to_string(), 7);
+        for y in 0..=n {
+            for x in 0..=n {
+                let (fx, fy) = (x as f32 / n as f32, y as f32 / n as f32);
+                mesh.vertices
+                    .extend([fx, fy, 0.05 * (fx * 12.0).sin() * (fy * 9.0).cos()]);
+            }
+        }
+        mesh.normals = Some(
+            (0..mesh.vertex_count())
+                .flat_map(|_| [0.0, 0.0, 1.0])
+                .collect(),
+        );
+
+        let mut indices = Vec::new();
+        let row = (n + 1) as u32;
+        for y in 0..n as u32 {
+            for x in 0..n as u32 {
+                let corner = y * row + x;
+                indices.extend([corner, corner + 1, corner + row]);
+                indices.extend([corner + 1, corner + row + 1, corner + row]);
+            }
+        }
+        mesh.indices = Some(indices);
+        mesh
+    }
+
+    #[test]
+    fn test_simplify_to_ratio() {
+        let mesh = grid(200);
+        let simplified = simplify(&mesh, LodTarget::Ratio(0.05), 4);
+
+        assert!(simplified.validate().is_ok());
+        assert_eq!(simplified.frame_number, 7);
+        let ratio = simplified.triangle_count() as f32 / mesh.triangle_count() as f32;
+        assert!(ratio > 0.005 && ratio < 0.07, "ratio {ratio}");
+
+        let normals = simplified.normals.as_ref().unwrap();
+        assert_eq!(normals.len(), simplified.vertices.len());
+        assert!(normals.chunks_exact(3).all(|n| (n[2] - 1.0).abs() < 1e-6));
+
+        // Sharding the work does not change the result
+        let serial = simplify(&mesh, LodTarget::Ratio(0.05), 1);
+        assert_eq!(serial.triangle_count(), simplified.triangle_count());
+        assert_eq!(serial.vertex_count(), simplified.vertex_count());
+    }
+
+    #[test]
+    fn test_simplify_to_error_and_soup() {
+        let mesh = grid(100);
+        let simplified = simplify(&mesh, LodTarget::Error(0.02), 3);
+        assert!(simplified.triangle_count() < mesh.triangle_count() / 2);
+
+        // Positions stay within the error bound of the original surface
+        let diagonal = 2f32.sqrt();
+        for vertex in simplified.vertices.chunks_exact(3) {
+            assert!((0.0..=1.0).contains(&vertex[0]) && (0.0..=1.0).contains(&vertex[1]));
+            assert!(vertex[2].abs() <= 0.05 + 0.02 * diagonal);
+        }
+
+        // Unindexed triangle soup simplifies the same way
+        let indices = mesh.indices.clone().unwrap();
+        let mut soup = MeshFrame::new("soup".to_string(), 0);
+        soup.vertices = indices
+            .iter()
+            .flat_map(|&i| mesh.vertices[i as usize * 3..i as usize * 3 + 3].to_vec())
+            .collect();
+        let from_soup = simplify(&soup, LodTarget::Error(0.02), 3);
+        assert_eq!(from_soup.triangle_count(), simplified.triangle_count());
+        assert!(from_soup.validate().is_ok());
+    }
+}
@@ -0,0 +1,633 @@
+//! Particle frames
+//!
+//! SPH and DEM runs produce tens of millions of particles per frame. Faked
+//! as degenerate triangles they need three vertices each; a [`PointFrame`]
+//! sends every particle once, quantized and sorted so it packs tightly:
+//!
+//! - Positions are quantized to 16 bits per axis relative to the domain
+//!   bounds, so the precision is the domain extent / 65535.
+//! - Particles are sorted by the Morton code of their quantized position,
+//!   which puts neighbours in space next to each other in the frame. The
+//!   codes are sent as varint deltas, which shrink as particles get denser:
+//!   about 4 bytes per particle at tens of millions, instead of 12.
+//! - Per-particle scalars (density, pressure, ...) are quantized to 16 bits
+//!   over their range and sent in the same order as zigzag varint deltas,
+//!   which stay small for fields that vary smoothly in space.
+//!
+//! Particles arrive in Morton order, not in the order they were sent. The
+//! receiver decodes a frame into a [`PointCloud`], which keeps the
+//! quantized positions (6 bytes per particle) for a viewer to upload as
+//! they are and scale on the GPU.
+
+use crate::lod;
+use crate::protocol::{EncodedMessage, MessageType, NetworkMessage, ProtocolError};
+use crate::types::{DomainBounds, FrameHeader};
+
+use serde::{Deserialize, Serialize};
+use std::thread;
+
+/// Largest quantized coordinate or scalar
+const QUANTIZED_MAX: f32 = u16::MAX as f32;
+
+/// Top bits of the Morton codes that split them into buckets for sorting
+const SORT_BUCKET_BITS: u32 = 12;
+
+/// A per-particle value to send with the positions
+#[derive(Debug, Clone, Copy)]
+pub struct PointScalars<'a> {
+    /// Name of the value, such as "density"
+    pub name: &'a str,
+    /// One value per particle, in the order of the positions
+    pub values: &'a [f32],
+}
+
+/// A per-particle value of a [`PointFrame`]
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct EncodedScalars {
+    /// Name of the value
+    pub name: String,
+    /// Values of quantized 0 and 65535
+    pub range: [f32; 2],
+    /// Quantized values in particle order, as zigzag varint deltas
+    pub deltas: Vec<u8>,
+}
+
+/// Particle positions and values, quantized and in Morton order
+///
+/// Starts with the same fields as a frame, so its header decodes like one.
+#[derive(Debug, Clone, Serialize, Deserialize)]
+pub struct PointFrame {
+    /// Simulation identifier
+    pub simulation_id: String,
+    /// Frame number
+    pub frame_number: u32,
+    /// Timestamp
+    pub timestamp: u64,
+    /// Bounds the positions are quantized relative to
+    pub domain_bounds: DomainBounds,
+    /// Number of particles
+    pub point_count: u32,
+    /// Morton codes of the quantized positions, ascending, as varint deltas
+    pub codes: Vec<u8>,
+    /// Per-particle values
+    pub scalars: Vec<EncodedScalars>,
+}
+
+/// A per-particle value of a [`PointCloud`]
+#[derive(Debug, Clone, PartialEq)]
+pub struct QuantizedScalars {
+    /// Name of the value
+    pub name: String,
+    /// Values of quantized 0 and 65535
+    pub range: [f32; 2],
+    /// Quantized value of each particle
+    pub values: Vec<u16>,
+}
+
+impl QuantizedScalars {
+    /// Value of particle `index`
+    pub fn value(&self, index: usize) -> f32 {
+        dequantize(self.values[index], self.range[0], self.range[1])
+    }
+}
+
+/// Decoded particles, still quantized
+#[derive(Debug, Clone)]
+pub struct PointCloud {
+    /// Simulation identifier
+    pub simulation_id: String,
+    /// Frame number
+    pub frame_number: u32,
+    /// Timestamp
+    pub timestamp: u64,
+    /// Bounds the positions are quantized relative to
+    pub domain_bounds: DomainBounds,
+    /// Quantized position of each particle, in Morton order
+    pub positions: Vec<[u16; 3]>,
+    /// Per-particle values
+    pub scalars: Vec<QuantizedScalars>,
+}
+
+impl PointCloud {
+    /// Number of particles
+    pub fn len(&self) -> usize {
+        self.positions.len()
+    }
+
+    /// Whether the frame has no particles
+    pub fn is_empty(&self) -> bool {
+        self.positions.is_empty()
+    }
+
+    /// Position of particle `index` in the domain
+    pub fn position(&self, index: usize) -> [f32; 3] {
+        let DomainBounds { min, max } = &self.domain_bounds;
+        let q = self.positions[index];
+        [0, 1, 2].map(|axis| dequantize(q[axis], min[axis], max[axis]))
+    }
+
+    /// Positions of all particles, 3 floats each
+    pub fn positions_f32(&self) -> Vec<f32> {
+        (0..self.len())
+            .flat_map(|index| self.position(index))
+            .collect()
+    }
+
+    /// Values with the given name
+    pub fn scalar(&self, name: &str) -> Option<&QuantizedScalars> {
+        self.scalars.iter().find(|scalars| scalars.name == name)
+    }
+}
+
+impl PointFrame {
+    /// Quantize and sort particles
+    ///
+    /// `positions` holds 3 floats per particle; positions outside `bounds`
+    /// are clamped to them. Every entry of `scalars` needs one value per
+    /// particle.
+    pub fn encode(
+        simulation_id: String,
+        frame_number: u32,
+        bounds: DomainBounds,
+        positions: &[f32],
+        scalars: &[PointScalars],
+    ) -> Result<Self, ProtocolError> {
+        let count = positions.len() / 3;
+        let valid_bounds = (0..3).all(|axis| {
+            bounds.min[axis].is_finite()
+                && bounds.max[axis].is_finite()
+                && bounds.max[axis] >= bounds.min[axis]
+        });
+        if positions.len() % 3 != 0
+            || count > u32::MAX as usize
+            || !valid_bounds
+            || scalars.iter().any(|scalars| scalars.values.len() != count)
+        {
+            return Err(ProtocolError::InvalidFormat);
+        }
+
+        let workers = lod::default_workers();
+        let scale = [0, 1, 2].map(|axis| {
+            let extent = bounds.max[axis] - bounds.min[axis];
+            if extent > 0.0 {
+                QUANTIZED_MAX / extent
+            } else {
+                0.0
+            }
+        });
+        let mut keys: Vec<(u64, u32)> = lod::parallel_ranges(count, workers, |range| {
+            range
+                .map(|index| {
+                    let q = [0, 1, 2].map(|axis| {
+                        ((positions[index * 3 + axis] - bounds.min[axis]) * scale[axis])
+                            .round()
+                            .clamp(0.0, QUANTIZED_MAX) as u16
+                    });
+                    (morton_encode(q), index as u32)
+                })
+                .collect::<Vec<_>>()
+        })
+        .concat();
+        radix_sort(&mut keys, workers);
+
+        let codes = encode_deltas(
+            &keys,
+            workers,
+            |&(code, _)| code,
+            |previous, code| code - previous,
+        );
+        let scalars = scalars
+            .iter()
+            .map(|scalars| {
+                let (min, max) = value_range(scalars.values);
+                let scale = QUANTIZED_MAX / (max - min);
+                let quantize = |index: u32| {
+                    ((scalars.values[index as usize] - min) * scale)
+                        .round()
+                        .clamp(0.0, QUANTIZED_MAX) as u64
+                };
+                EncodedScalars {
+                    name: scalars.name.to_string(),
+                    range: [min, max],
+                    deltas: encode_deltas(
+                        &keys,
+                        workers,
+                        |&(_, index)| quantize(index),
+                        |previous, value| zigzag(value as i64 - previous as i64),
+                    ),
+                }
+            })
+            .collect();
+
+        Ok(Self {
+            simulation_id,
+            frame_number,
+            timestamp: 0,
+            domain_bounds: bounds,
+            point_count: count as u32,
+            codes,
+            scalars,
+        })
+    }
+
+    /// Decode the quantized particles
+    pub fn decode(&self) -> Result<PointCloud, ProtocolError> {
+        // Every particle takes at least a byte of each varint stream
+        let count = self.point_count as usize;
+        if count > self.codes.len()
+            || self
+                .scalars
+                .iter()
+                .any(|scalars| count > scalars.deltas.len())
+        {
+            return Err(ProtocolError::InvalidFormat);
+        }
+        let mut positions = Vec::with_capacity(count);
+        let mut code = 0u64;
+        let mut reader = VarintReader::new(&self.codes);
+        for _ in 0..count {
+            code = code
+                .checked_add(reader.next()?)
+                .ok_or(ProtocolError::InvalidFormat)?;
+            positions.push(morton_decode(code));
+        }
+        reader.finish()?;
+
+        let scalars = self
+            .scalars
+            .iter()
+            .map(|scalars| {
+                let mut values = Vec::with_capacity(count);
+                let mut value = 0i64;
+                let mut reader = VarintReader::new(&scalars.deltas);
+                for _ in 0..count {
+                    value = value
+                        .checked_add(unzigzag(reader.next()?))
+                        .ok_or(ProtocolError::InvalidFormat)?;
+                    values.push(u16::try_from(value).map_err(|_| ProtocolError::InvalidFormat)?);
+                }
+                reader.finish()?;
+                Ok(QuantizedScalars {
+                    name: scalars.name.clone(),
+                    range: scalars.range,
+                    values,
+                })
+            })
+            .collect::<Result<_, ProtocolError>>()?;
+
+        Ok(PointCloud {
+            simulation_id: self.simulation_id.clone(),
+            frame_number: self.frame_number,
+            timestamp: self.timestamp,
+            domain_bounds: self.domain_bounds,
+            positions,
+            scalars,
+        })
+    }
+
+    /// Create the message carrying this frame
+    pub fn to_message(&self) -> Result<NetworkMessage, ProtocolError> {
+        Ok(NetworkMessage::new(
+            MessageType::PointFrame,
+            bincode::serialize(self)?,
+        ))
+    }
+
+    /// Create the message carrying this frame, already in its wire encoding
+    pub fn to_encoded(&self) -> Result<EncodedMessage, ProtocolError> {
+        EncodedMessage::bincode(MessageType::PointFrame, self)
+    }
+
+    /// Parse a point frame payload
+    pub fn from_payload(payload: &[u8]) -> Result<Self, ProtocolError> {
+        Ok(bincode::deserialize(payload)?)
+    }
+}
+
+/// Decode only the header of a point frame payload
+pub fn decode_header(payload: &[u8]) -> Result<FrameHeader, ProtocolError> {
+    Ok(bincode::deserialize(payload)?)
+}
+
+fn dequantize(value: u16, min: f32, max: f32) -> f32 {
+    min + value as f32 * ((max - min) / QUANTIZED_MAX)
+}
+
+/// Range of the finite values, widened so it is never empty
+fn value_range(values: &[f32]) -> (f32, f32) {
+    let (min, max) = values
+        .iter()
+        .filter(|v| v.is_finite())
+        .fold((f32::INFINITY, f32::NEG_INFINITY), |(min, max), &v| {
+            (min.min(v), max.max(v))
+        });
+    match (min.is_finite(), max > min) {
+        (false, _) => (0.0, 1.0),
+        (true, false) => (min, min + 1.0),
+        (true, true) => (min, max),
+    }
+}
+
+/// Spread the low 21 bits of `v` to every third bit
+fn spread_bits(v: u64) -> u64 {
+    let mut x = v & 0x1f_ffff;
+    x = (x | x << 32) & 0x001f_0000_0000_ffff;
+    x = (x | x << 16) & 0x001f_0000_ff00_00ff;
+    x = (x | x << 8) & 0x100f_00f0_0f00_f00f;
+    x = (x | x << 4) & 0x10c3_0c30_c30c_30c3;
+    (x | x << 2) & 0x1249_2492_4924_9249
+}
+
+/// Gather every third bit of `x` into the low bits
+fn compact_bits(x: u64) -> u64 {
+    let mut x = x & 0x1249_2492_4924_9249;
+    x = (x ^ x >> 2) & 0x10c3_0c30_c30c_30c3;
+    x = (x ^ x >> 4) & 0x100f_00f0_0f00_f00f;
+    x = (x ^ x >> 8) & 0x001f_0000_ff00_00ff;
+    x = (x ^ x >> 16) & 0x001f_0000_0000_ffff;
+    (x ^ x >> 32) & 0x1f_ffff
+}
+
+fn morton_encode(q: [u16; 3]) -> u64 {
+    spread_bits(q[0] as u64) | spread_bits(q[1] as u64) << 1 | spread_bits(q[2] as u64) << 2
+}
+
+fn morton_decode(code: u64) -> [u16; 3] {
+    [0, 1, 2].map(|axis| compact_bits(code >> axis) as u16)
+}
+
+/// Sort by code on worker threads, keeping equal codes in their order
+///
+/// Each worker scatters its chunk of keys by the top bits of their codes
+/// into its own run of every bucket, so the buckets come out contiguous and
+/// in order. The buckets are then sorted on the workers, a run of whole
+/// buckets holding about an equal share of the keys each.
+fn radix_sort(keys: &mut Vec<(u64, u32)>, workers: usize) {
+    let workers = workers.max(1);
+    let bits = keys.iter().fold(0, |bits, &(code, _)| bits | code);
+    let used = u64::BITS - bits.leading_zeros();
+    let shift = used.saturating_sub(SORT_BUCKET_BITS);
+    let buckets = 1usize << (used - shift);
+    let bucket = move |code: u64| (code >> shift) as usize;
+
+    let chunks: Vec<&[(u64, u32)]> = keys.chunks(keys.len().div_ceil(workers).max(1)).collect();
+    let counts: Vec<Vec<usize>> = lod::parallel_ranges(chunks.len(), workers, |range| {
+        range
+            .map(|index| {
+                let mut counts = vec![0usize; buckets];
+                for &(code, _) in chunks[index] {
+                    counts[bucket(code)] += 1;
+                }
+                counts
+            })
+            .collect::<Vec<_>>()
+    })
+    .concat();
+
+    // The run of each chunk in each bucket, bucket by bucket
+    let mut sorted = vec![(0, 0); keys.len()];
+    let mut runs: Vec<Vec<&mut [(u64, u32)]>> = chunks.iter().map(|_| Vec::new()).collect();
+    let mut rest = sorted.as_mut_slice();
+    for index in 0..buckets {
+        for (runs, counts) in runs.iter_mut().zip(&counts) {
+            let (run, tail) = std::mem::take(&mut rest).split_at_mut(counts[index]);
+            runs.push(run);
+            rest = tail;
+        }
+    }
+    thread::scope(|scope| {
+        for (&chunk, mut runs) in chunks.iter().zip(runs) {
+            scope.spawn(move || {
+                let mut filled = vec![0usize; runs.len()];
+                for &key in chunk {
+                    let index = bucket(key.0);
+                    runs[index][filled[index]] = key;
+                    filled[index] += 1;
+                }
+            });
+        }
+    });
+
+    // Within a bucket keys are in their original order, so sorting by code
+    // and then index keeps that order for equal codes
+    let totals: Vec<usize> = (0..buckets)
+        .map(|index| counts.iter().map(|counts| counts[index]).sum())
+        .collect();
+    thread::scope(|scope| {
+        let mut rest = sorted.as_mut_slice();
+        let (mut first, mut taken) = (0, 0);
+        for worker in 1..=workers {
+            let share = keys.len() * worker / workers;
+            let mut last = first;
+            while last < buckets && (taken < share || worker == workers) {
+                taken += totals[last];
+                last += 1;
+            }
+            let len = totals[first..last].iter().sum();
+            let (mut run, tail) = std::mem::take(&mut rest).split_at_mut(len);
+            rest = tail;
+            let sizes = &totals[first..last];
+            first = last;
+            scope.spawn(move || {
+                for &size in sizes {
+                    let (bucket, tail) = std::mem::take(&mut run).split_at_mut(size);
+                    bucket.sort_unstable();
+                    run = tail;
+                }
+            });
+        }
+    });
+    *keys = sorted;
+}
+
+/// Varint-encode `delta(previous, value)` of consecutive values, in chunks
+/// on worker threads
+fn encode_deltas<T: Sync>(
+    items: &[T],
+    workers: usize,
+    value: impl Fn(&T) -> u64 + Sync,
+    delta: impl Fn(u64, u64) -> u64 + Sync,
+) -> Vec<u8> {
+    lod::parallel_ranges(items.len(), workers, |range| {
+        let mut previous = range.start.checked_sub(1).map_or(0, |i| value(&items[i]));
+        let mut out = Vec::with_capacity(range.len() * 3);
+        for item in &items[range] {
+            let current = value(item);
+            write_varint(&mut out, delta(previous, current));
+            previous = current;
+        }
+        out
+    })
+    .concat()
+}
+
+fn zigzag(v: i64) -> u64 {
+    ((v << 1) ^ (v >> 63)) as u64
+}
+
+fn unzigzag(v: u64) -> i64 {
+    (v >> 1) as i64 ^ -((v & 1) as i64)
+}
+
+fn write_varint(out: &mut Vec<u8>, mut v: u64) {
+    while v >= 0x80 {
+        out.push(v as u8 | 0x80);
+        v >>= 7;
+    }
+    out.push(v as u8);
+}
+
+/// Reads LEB128 varints, failing on truncated or trailing data
+struct VarintReader<'a> {
+    bytes: &'a [u8],
+    pos: usize,
+}
+
+impl<'a> VarintReader<'a> {
+    fn new(bytes: &'a [u8]) -> Self {
+        Self { bytes, pos: 0 }
+    }
+
+    fn next(&mut self) -> Result<u64, ProtocolError> {
+        let mut value = 0u64;
+        for shift in (0..64).step_by(7) {
+            let byte = *self
+                .bytes
+                .get(self.pos)
+                .ok_or(ProtocolError::InvalidFormat)?;
+            self.pos += 1;
+            value |= ((byte & 0x7f) as u64) << shift;
+            if byte & 0x80 == 0 {
+                return Ok(value);
+            }
+        }
+        Err(ProtocolError::InvalidFormat)
+    }
+
+    fn finish(self) -> Result<(), ProtocolError> {
+        if self.pos == self.bytes.len() {
+            Ok(())
+        } else {
+            Err(ProtocolError::InvalidFormat)
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_point_frame_round_trip() {
+        // A jittered lattice, shuffled so the encoder has to sort it
+        let n = 40;
+        let count = n * n * n;
+        let mut positions = vec![0.0f32; count * 3];
+        let mut density = vec![0.0f32; count];
+        for i in 0..count {
+            let slot = (i * 7919) % count;
+            let p = [i % n, i / n % n, i / (n * n)].map(|c| c as f32 * 0.025 + 0.003);
+            positions[slot * 3..slot * 3 + 3].copy_from_slice(&p);
+            density[slot] = 1000.0 + p[2] * 10.0;
+        }
+        let bounds = DomainBounds::new([0.0; 3], [1.0; 3]);
+
+        let frame = PointFrame::encode(
+            "sph".to_string(),
+            5,
+            bounds,
+            &positions,
+            &[PointScalars {
+                name: "density",
+                values: &density,
+            }],
+        )
+        .unwrap();
+        // Sorted codes pack well below the 12 bytes of raw positions
+        assert!(frame.codes.len() <= count * 5, "{}", frame.codes.len());
+
+        let payload = frame.to_message().unwrap().payload;
+        assert_eq!(decode_header(&payload).unwrap().frame_number, 5);
+        let cloud = PointFrame::from_payload(&payload)
+            .unwrap()
+            .decode()
+            .unwrap();
+        assert_eq!(cloud.len(), count);
+
+        // Morton order, and each lattice point once within a step
+        let codes: Vec<u64> = cloud.positions.iter().map(|&q| morton_encode(q)).collect();
+        assert!(codes.windows(2).all(|w| w[0] <= w[1]));
+        let step = 1.0 / QUANTIZED_MAX;
+        let density = cloud.scalar("density").unwrap();
+        let mut lattice: Vec<[i64; 3]> = (0..count)
+            .map(|i| {
+                let p = cloud.position(i);
+                assert!((density.value(i) - (1000.0 + p[2] * 10.0)).abs() < 0.01);
+                p.map(|c| {
+                    let k = ((c - 0.003) / 0.025).round();
+                    assert!((c - (k * 0.025 + 0.003)).abs() <= step, "{p:?}");
+                    k as i64
+                })
+            })
+            .collect();
+        lattice.sort_unstable();
+        lattice.dedup();
+        assert_eq!(lattice.len(), count);
+    }
+
+    #[test]
+    fn test_radix_sort_matches_stable_sort() {
+        // Clustered codes with many duplicates, as from a dense region
+        let mut state = 17u64;
+        let keys: Vec<(u64, u32)> = (0..50_000)
+            .map(|index| {
+                state = state.wrapping_mul(6364136223846793005).wrapping_add(1);
+                let code = if index % 3 == 0 {
+                    state >> 16
+                } else {
+                    (state >> 40) % 500
+                };
+                (code, index)
+            })
+            .collect();
+        let mut expected = keys.clone();
+        expected.sort_by_key(|&(code, _)| code);
+
+        for workers in [1, 3, 8] {
+            let mut sorted = keys.clone();
+            radix_sort(&mut sorted, workers);
+            assert_eq!(sorted, expected, "{workers} workers");
+        }
+        let mut empty = Vec::new();
+        radix_sort(&mut empty, 4);
+        assert!(empty.is_empty());
+    }
+
+    #[test]
+    fn test_decode_rejects_bad_counts_and_overflow() {
+        let bounds = DomainBounds::new([0.0; 3], [1.0; 3]);
+        let positions = [0.1, 0.2, 0.3, 0.4, 0.5, 0.6];
+        let values = [1.0, 2.0];
+        let scalars = [PointScalars {
+            name: "density",
+            values: &values,
+        }];
+        let frame = PointFrame::encode("sph".to_string(), 0, bounds, &positions, &scalars).unwrap();
+        assert_eq!(frame.decode().unwrap().len(), 2);
+
+        // More particles than the codes could hold fails before allocating
+        let mut huge = frame.clone();
+        huge.point_count = u32::MAX;
+        assert!(matches!(huge.decode(), Err(ProtocolError::InvalidFormat)));
+
+        // A delta that overflows the running value
+        let mut overflow = frame.clone();
+        overflow.scalars[0].deltas.clear();
+        write_varint(&mut overflow.scalars[0].deltas, zigzag(1));
+        write_varint(&mut overflow.scalars[0].deltas, zigzag(i64::MAX));
+        assert!(matches!(
+            overflow.decode(),
+            Err(ProtocolError::InvalidFormat)
+        ));
+    }
+}
@@ -0,0 +1,85 @@
+//! Progressive transmission of large frames
+//!
+//! A viewer waiting for a very large frame shows nothing until its last byte
+//! lands. A sender configured with a [`ProgressiveConfig`] first sends
+//! simplified versions of such a frame, coarsest first, and the full frame
+//! last. Each coarse level is an ordinary mesh frame preceded by a
+//! [`CoarseLevel`] message, so the receiver can show it at once and replace
+//! it with every finer level as it arrives. The time until something is on
+//! screen is then bounded by the size of the coarsest level.
+//!
+//! The full frame goes out unannounced, exactly as without progressive
+//! transmission, and is the only level kept for replay after a reconnect.
+//! Senders only send coarse levels to receivers that advertise
+//! [`FEATURE_PROGRESSIVE`](crate::handshake::FEATURE_PROGRESSIVE).
+
+use crate::lod::{self, LodTarget};
+use crate::protocol::{MessageType, NetworkMessage, ProtocolError};
+
+use serde::{Deserialize, Serialize};
+
+/// Progressive transmission settings for a sender
+#[derive(Debug, Clone)]
+pub struct ProgressiveConfig {
+    /// Coarse levels sent ahead of the full frame, coarsest first
+    pub levels: Vec<LodTarget>,
+    /// Frames with fewer triangles are sent in one piece
+    pub min_triangles: usize,
+    /// Worker threads used for simplification
+    pub workers: usize,
+}
+
+impl Default for ProgressiveConfig {
+    fn default() -> Self {
+        Self {
+            levels: vec![LodTarget::Ratio(0.01), LodTarget::Ratio(0.1)],
+            min_triangles: 1_000_000,
+            workers: lod::default_workers(),
+        }
+    }
+}
+
+/// Marks the next frame on a connection as a coarse level
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+pub struct CoarseLevel {
+    /// Frame this is a coarse version of
+    pub frame_number: u32,
+    /// Position of this level, 0 being the coarsest
+    pub level: u8,
+    /// Number of levels including the full frame, which is level
+    /// `levels - 1`
+    pub levels: u8,
+}
+
+impl CoarseLevel {
+    /// Create the announcement message for this level
+    pub fn to_message(&self) -> Result<NetworkMessage, ProtocolError> {
+        Ok(NetworkMessage::new(
+            MessageType::CoarseLevel,
+            bincode::serialize(self)?,
+        ))
+    }
+
+    /// Parse an announcement payload
+    pub fn from_payload(payload: &[u8]) -> Result<Self, ProtocolError> {
+        Ok(bincode::deserialize(payload)?)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_coarse_level_round_trip() {
+        let level = CoarseLevel {
+            frame_number: 42,
+            level: 1,
+            levels: 3,
+        };
+        let message = level.to_message().unwrap();
+        assert_eq!(message.msg_type, MessageType::CoarseLevel);
+        assert_eq!(CoarseLevel::from_payload(&message.payload).unwrap(), level);
+        assert!(CoarseLevel::from_payload(&[1]).is_err());
+    }
+}
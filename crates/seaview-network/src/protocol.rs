@@ -3,15 +3,27 @@
 //! This module defines the wire protocol for transmitting mesh data between
 //! simulation and visualization components.
 
-use crate::types::MeshFrame;
+use crate::buffer::{BufferPool, FrameBuffer};
+use crate::columnar;
+use crate::indices::IndexCompression;
+use crate::types::{FrameHeader, FrameRangeRequest, MeshFrame};
+use crate::volume::VolumeFrame;
 use serde::{Deserialize, Serialize};
 use std::io::{Read, Write};
+use std::sync::Arc;
 use thiserror::Error;
 use tracing::{debug, trace};
 
 /// Protocol version for compatibility checking
 pub const PROTOCOL_VERSION: u16 = 2;
 
+/// Oldest protocol version still accepted from a peer
+///
+/// Version 2 is the first this crate speaks, so the window holds only it.
+/// Messages always go out with [`PROTOCOL_VERSION`] in their header; the
+/// window only matters once a later version has to accept this one.
+pub const MIN_PROTOCOL_VERSION: u16 = 2;
+
 /// Maximum message size (100MB by default)
 pub const DEFAULT_MAX_MESSAGE_SIZE: usize = 100 * 1024 * 1024;
 
@@ -29,6 +41,35 @@ pub enum MessageType {
     EndOfStream = 0x04,
     /// Heartbeat/keepalive
     Heartbeat = 0x05,
+    /// Request for cached frames, sent from receiver to upstream
+    FrameRangeRequest = 0x06,
+    /// Start of a striped session, on the primary connection
+    StripeSetup = 0x07,
+    /// First message on each extra connection of a striped session
+    StripeJoin = 0x08,
+    /// Striped frame announcement; payload ranges follow on each stripe
+    StripedFrame = 0x09,
+    /// Capability advertisement, first message from a sender
+    Hello = 0x0A,
+    /// Negotiated settings, answer to a hello
+    HelloAck = 0x0B,
+    /// Mesh frame in the columnar encoding
+    ColumnarFrame = 0x0C,
+    /// Ask a sender streaming reduced detail for a full resolution frame
+    FullResolutionRequest = 0x0D,
+    /// Marks the next frame as a coarse level of a progressive frame
+    CoarseLevel = 0x0E,
+    /// Region and triangle budget a viewer wants, sent from receiver to
+    /// sender
+    RegionOfInterest = 0x0F,
+    /// Most frames a viewer wants, sent from receiver to sender
+    RateLimit = 0x10,
+    /// Changed vertex ranges of a frame relative to an earlier one
+    PartialUpdate = 0x11,
+    /// Scalar field the receiver extracts a surface from
+    VolumeFrame = 0x12,
+    /// Quantized particles in Morton order
+    PointFrame = 0x13,
 }
 
 impl MessageType {
@@ -40,6 +81,20 @@ impl MessageType {
             0x03 => Some(Self::Checkpoint),
             0x04 => Some(Self::EndOfStream),
             0x05 => Some(Self::Heartbeat),
+            0x06 => Some(Self::FrameRangeRequest),
+            0x07 => Some(Self::StripeSetup),
+            0x08 => Some(Self::StripeJoin),
+            0x09 => Some(Self::StripedFrame),
+            0x0A => Some(Self::Hello),
+            0x0B => Some(Self::HelloAck),
+            0x0C => Some(Self::ColumnarFrame),
+            0x0D => Some(Self::FullResolutionRequest),
+            0x0E => Some(Self::CoarseLevel),
+            0x0F => Some(Self::RegionOfInterest),
+            0x10 => Some(Self::RateLimit),
+            0x11 => Some(Self::PartialUpdate),
+            0x12 => Some(Self::VolumeFrame),
+            0x13 => Some(Self::PointFrame),
             _ => None,
         }
     }
@@ -74,8 +129,8 @@ pub enum ProtocolError {
     #[error("JSON serialization error: {0}")]
     JsonSerialization(#[from] serde_json::Error),
 
-    #[error("Invalid protocol version: expected {expected}, got {received}")]
-    InvalidVersion { expected: u16, received: u16 },
+    #[error("Unsupported protocol version {received}, expected {min}..={max}")]
+    InvalidVersion { min: u16, max: u16, received: u16 },
 
     #[error("Invalid message type: {0}")]
     InvalidMessageType(u8),
@@ -86,6 +141,12 @@ pub enum ProtocolError {
     #[error("Invalid message format")]
     InvalidFormat,
 
+    #[error("Payload is not aligned for zero-copy access")]
+    Misaligned,
+
+    #[error("Payload is compressed and cannot be accessed in place")]
+    Compressed,
+
     #[error("Unexpected end of stream")]
     UnexpectedEof,
 }
@@ -118,18 +179,90 @@ impl NetworkMessage {
     }
 }
 
+/// Size of the fixed message header: version (2) + type (1) + length (4)
+pub const HEADER_SIZE: usize = 7;
+
+/// A message kept in its wire encoding, header included
+///
+/// The bytes are shared, so one encoded message can be queued for any number
+/// of connections and written out without serializing it again.
+#[derive(Debug, Clone)]
+pub struct EncodedMessage {
+    /// Message type from the header
+    pub msg_type: MessageType,
+    /// Header followed by payload, exactly as sent on the wire
+    pub bytes: Arc<Vec<u8>>,
+}
+
+impl EncodedMessage {
+    /// Encode a message into its wire representation
+    ///
+    /// This copies the payload; large messages are better built with
+    /// [`encode`](Self::encode).
+    pub fn from_message(message: &NetworkMessage) -> Self {
+        let mut bytes = Vec::with_capacity(message.size());
+        bytes.extend_from_slice(&message.version.to_le_bytes());
+        bytes.push(message.msg_type as u8);
+        bytes.extend_from_slice(&(message.payload.len() as u32).to_le_bytes());
+        bytes.extend_from_slice(&message.payload);
+        Self {
+            msg_type: message.msg_type,
+            bytes: Arc::new(bytes),
+        }
+    }
+
+    /// Encode a message whose payload `write` appends right behind the
+    /// header, so it never has to be copied
+    pub fn encode<E>(
+        msg_type: MessageType,
+        capacity: usize,
+        write: impl FnOnce(&mut Vec<u8>) -> Result<(), E>,
+    ) -> Result<Self, E> {
+        let mut bytes = Vec::with_capacity(HEADER_SIZE + capacity);
+        bytes.extend_from_slice(&PROTOCOL_VERSION.to_le_bytes());
+        bytes.push(msg_type as u8);
+        bytes.extend_from_slice(&[0; 4]);
+        write(&mut bytes)?;
+        let size = (bytes.len() - HEADER_SIZE) as u32;
+        bytes[3..HEADER_SIZE].copy_from_slice(&size.to_le_bytes());
+        Ok(Self {
+            msg_type,
+            bytes: Arc::new(bytes),
+        })
+    }
+
+    /// Encode a message with a bincode payload
+    pub fn bincode<T: Serialize + ?Sized>(
+        msg_type: MessageType,
+        value: &T,
+    ) -> Result<Self, ProtocolError> {
+        let size = bincode::serialized_size(value)? as usize;
+        Ok(Self::encode(msg_type, size, |bytes| {
+            bincode::serialize_into(bytes, value)
+        })?)
+    }
+
+    /// The payload without the header
+    pub fn payload(&self) -> &[u8] {
+        &self.bytes[HEADER_SIZE..]
+    }
+
+    /// Total size on the wire
+    pub fn size(&self) -> usize {
+        self.bytes.len()
+    }
+}
+
 /// Protocol handler for reading and writing messages
 pub struct Protocol {
     format: WireFormat,
     max_message_size: usize,
+    index_compression: IndexCompression,
 }
 
 impl Default for Protocol {
     fn default() -> Self {
-        Self {
-            format: WireFormat::default(),
-            max_message_size: DEFAULT_MAX_MESSAGE_SIZE,
-        }
+        Self::new(WireFormat::default())
     }
 }
 
@@ -139,6 +272,7 @@ impl Protocol {
         Self {
             format,
             max_message_size: DEFAULT_MAX_MESSAGE_SIZE,
+            index_compression: IndexCompression::None,
         }
     }
 
@@ -148,6 +282,12 @@ impl Protocol {
         self
     }
 
+    /// Set how columnar frames encode their indices
+    pub fn with_index_compression(mut self, compression: IndexCompression) -> Self {
+        self.index_compression = compression;
+        self
+    }
+
     /// Serialize a mesh frame
     pub fn serialize_mesh(&self, mesh: &MeshFrame) -> Result<NetworkMessage, ProtocolError> {
         debug!(
@@ -170,17 +310,25 @@ impl Protocol {
         };
 
         debug!("Serialized payload size: {} bytes", payload.len());
-
-        if payload.len() > self.max_message_size {
-            return Err(ProtocolError::MessageTooLarge {
-                size: payload.len(),
-                max_size: self.max_message_size,
-            });
-        }
+        self.check_size(payload.len())?;
 
         Ok(NetworkMessage::new(MessageType::MeshFrame, payload))
     }
 
+    /// Serialize a mesh frame straight into its wire encoding
+    pub fn encode_mesh(&self, mesh: &MeshFrame) -> Result<EncodedMessage, ProtocolError> {
+        let message = match self.format {
+            WireFormat::Bincode => EncodedMessage::bincode(MessageType::MeshFrame, mesh)?,
+            #[cfg(feature = "json")]
+            WireFormat::Json => EncodedMessage::encode(MessageType::MeshFrame, 0, |bytes| {
+                serde_json::to_writer(bytes, mesh)
+            })?,
+        };
+        self.check_size(message.payload().len())?;
+
+        Ok(message)
+    }
+
     /// Deserialize a mesh frame
     pub fn deserialize_mesh(&self, payload: &[u8]) -> Result<MeshFrame, ProtocolError> {
         trace!("Deserializing mesh from {} bytes", payload.len());
@@ -194,6 +342,96 @@ impl Protocol {
         Ok(mesh)
     }
 
+    /// Serialize a mesh frame in the columnar encoding
+    pub fn serialize_columnar(&self, mesh: &MeshFrame) -> Result<NetworkMessage, ProtocolError> {
+        let payload = columnar::encode_with(mesh, self.index_compression);
+        self.check_size(payload.len())?;
+
+        Ok(NetworkMessage::new(MessageType::ColumnarFrame, payload))
+    }
+
+    /// Serialize a mesh frame in the columnar encoding straight into its
+    /// wire encoding
+    pub fn encode_columnar(&self, mesh: &MeshFrame) -> Result<EncodedMessage, ProtocolError> {
+        let message = EncodedMessage::encode(MessageType::ColumnarFrame, 0, |bytes| {
+            columnar::encode_into(mesh, self.index_compression, bytes);
+            Ok::<_, ProtocolError>(())
+        })?;
+        self.check_size(message.payload().len())?;
+
+        Ok(message)
+    }
+
+    /// Fail for payloads beyond the maximum message size
+    fn check_size(&self, size: usize) -> Result<(), ProtocolError> {
+        if size > self.max_message_size {
+            return Err(ProtocolError::MessageTooLarge {
+                size,
+                max_size: self.max_message_size,
+            });
+        }
+        Ok(())
+    }
+
+    /// Deserialize the payload of either kind of mesh frame message
+    ///
+    /// Volume frames are turned into their surface at the frame's iso-value.
+    pub fn decode_frame(
+        &self,
+        msg_type: MessageType,
+        payload: &[u8],
+    ) -> Result<MeshFrame, ProtocolError> {
+        match msg_type {
+            MessageType::MeshFrame => self.deserialize_mesh(payload),
+            MessageType::ColumnarFrame => columnar::decode(payload),
+            MessageType::VolumeFrame => {
+                let volume = VolumeFrame::from_payload(payload)?;
+                volume.extract_surface(volume.iso_value)
+            }
+            _ => Err(ProtocolError::InvalidFormat),
+        }
+    }
+
+    /// Decode only the header fields of a mesh frame payload
+    pub fn deserialize_frame_header(&self, payload: &[u8]) -> Result<FrameHeader, ProtocolError> {
+        let header = match self.format {
+            // Bincode ignores the trailing geometry
+            WireFormat::Bincode => bincode::deserialize(payload)?,
+            #[cfg(feature = "json")]
+            WireFormat::Json => serde_json::from_slice(payload)?,
+        };
+
+        Ok(header)
+    }
+
+    /// Create a frame range request message
+    pub fn create_frame_range_request(
+        &self,
+        request: &FrameRangeRequest,
+    ) -> Result<NetworkMessage, ProtocolError> {
+        let payload = match self.format {
+            WireFormat::Bincode => bincode::serialize(request)?,
+            #[cfg(feature = "json")]
+            WireFormat::Json => serde_json::to_vec(request)?,
+        };
+
+        Ok(NetworkMessage::new(MessageType::FrameRangeRequest, payload))
+    }
+
+    /// Deserialize a frame range request
+    pub fn deserialize_frame_range_request(
+        &self,
+        payload: &[u8],
+    ) -> Result<FrameRangeRequest, ProtocolError> {
+        let request = match self.format {
+            WireFormat::Bincode => bincode::deserialize(payload)?,
+            #[cfg(feature = "json")]
+            WireFormat::Json => serde_json::from_slice(payload)?,
+        };
+
+        Ok(request)
+    }
+
     /// Write a message to a stream
     pub fn write_message<W: Write>(
         &self,
@@ -222,19 +460,84 @@ impl Protocol {
     }
 
     /// Read a message from a stream
-    pub fn read_message<R: Read>(
+    pub fn read_message<R: Read>(&self, reader: &mut R) -> Result<NetworkMessage, ProtocolError> {
+        let (version, msg_type, payload_size) = self.read_header(reader)?;
+
+        // Read payload
+        let mut payload = vec![0u8; payload_size];
+        reader.read_exact(&mut payload)?;
+
+        trace!("Message read successfully");
+
+        Ok(NetworkMessage {
+            version,
+            msg_type,
+            payload,
+        })
+    }
+
+    /// Read a message into a buffer taken from `pool`
+    ///
+    /// The payload goes back to the pool once the returned buffer, and every
+    /// `Arc` sharing it, has been dropped.
+    pub fn read_pooled<R: Read>(
         &self,
         reader: &mut R,
-    ) -> Result<NetworkMessage, ProtocolError> {
+        pool: &BufferPool,
+    ) -> Result<(MessageType, FrameBuffer), ProtocolError> {
+        let (_, msg_type, payload_size) = self.read_header(reader)?;
+
+        let mut payload = pool.take(payload_size);
+        reader.read_exact(&mut payload)?;
+
+        Ok((msg_type, pool.wrap(payload)))
+    }
+
+    /// Read a message and keep it in its wire encoding
+    ///
+    /// Used when forwarding: the header and payload land in one buffer that
+    /// can be written to other connections as-is.
+    pub fn read_encoded<R: Read>(&self, reader: &mut R) -> Result<EncodedMessage, ProtocolError> {
+        let (version, msg_type, payload_size) = self.read_header(reader)?;
+
+        let mut bytes = vec![0u8; HEADER_SIZE + payload_size];
+        bytes[0..2].copy_from_slice(&version.to_le_bytes());
+        bytes[2] = msg_type as u8;
+        bytes[3..HEADER_SIZE].copy_from_slice(&(payload_size as u32).to_le_bytes());
+        reader.read_exact(&mut bytes[HEADER_SIZE..])?;
+
+        Ok(EncodedMessage {
+            msg_type,
+            bytes: Arc::new(bytes),
+        })
+    }
+
+    /// Write an already encoded message to a stream
+    pub fn write_encoded<W: Write>(
+        &self,
+        writer: &mut W,
+        message: &EncodedMessage,
+    ) -> Result<(), ProtocolError> {
+        writer.write_all(&message.bytes)?;
+        writer.flush()?;
+        Ok(())
+    }
+
+    /// Read and validate a message header, returning version, type and payload size
+    pub(crate) fn read_header<R: Read>(
+        &self,
+        reader: &mut R,
+    ) -> Result<(u16, MessageType, usize), ProtocolError> {
         use byteorder::{LittleEndian, ReadBytesExt};
 
         trace!("Reading message header");
 
         // Read header
         let version = reader.read_u16::<LittleEndian>()?;
-        if version != PROTOCOL_VERSION {
+        if !(MIN_PROTOCOL_VERSION..=PROTOCOL_VERSION).contains(&version) {
             return Err(ProtocolError::InvalidVersion {
-                expected: PROTOCOL_VERSION,
+                min: MIN_PROTOCOL_VERSION,
+                max: PROTOCOL_VERSION,
                 received: version,
             });
         }
@@ -257,17 +560,7 @@ impl Protocol {
             });
         }
 
-        // Read payload
-        let mut payload = vec![0u8; payload_size];
-        reader.read_exact(&mut payload)?;
-
-        trace!("Message read successfully");
-
-        Ok(NetworkMessage {
-            version,
-            msg_type,
-            payload,
-        })
+        Ok((version, msg_type, payload_size))
     }
 
     /// Send a heartbeat message
@@ -279,6 +572,11 @@ impl Protocol {
     pub fn create_end_of_stream(&self) -> NetworkMessage {
         NetworkMessage::new(MessageType::EndOfStream, Vec::new())
     }
+
+    /// Create a request for the next frame at full resolution
+    pub fn create_full_resolution_request(&self) -> NetworkMessage {
+        NetworkMessage::new(MessageType::FullResolutionRequest, Vec::new())
+    }
 }
 
 #[cfg(test)]
@@ -327,6 +625,85 @@ mod tests {
         assert!(matches!(result, Err(ProtocolError::MessageTooLarge { .. })));
     }
 
+    #[test]
+    fn test_encoded_round_trip() {
+        let protocol = Protocol::default();
+        let mut mesh = MeshFrame::new("encoded".to_string(), 7);
+        mesh.vertices = vec![1.0; 9];
+        let message = protocol.serialize_mesh(&mesh).unwrap();
+
+        // Encoding by hand matches what write_message puts on the wire
+        let mut written = Vec::new();
+        protocol.write_message(&mut written, &message).unwrap();
+        let encoded = EncodedMessage::from_message(&message);
+        assert_eq!(*encoded.bytes, written);
+
+        // As does serializing straight into the wire encoding
+        assert_eq!(*protocol.encode_mesh(&mesh).unwrap().bytes, written);
+        let columnar = EncodedMessage::from_message(&protocol.serialize_columnar(&mesh).unwrap());
+        assert_eq!(
+            protocol.encode_columnar(&mesh).unwrap().bytes,
+            columnar.bytes
+        );
+
+        // Reading encoded keeps the exact bytes and exposes the payload
+        let read = protocol.read_encoded(&mut Cursor::new(&written)).unwrap();
+        assert_eq!(read.msg_type, MessageType::MeshFrame);
+        assert_eq!(*read.bytes, written);
+        let decoded = protocol.deserialize_mesh(read.payload()).unwrap();
+        assert_eq!(decoded.frame_number, 7);
+    }
+
+    #[test]
+    fn test_frame_header_and_range_request() {
+        let protocol = Protocol::default();
+        let mut mesh = MeshFrame::new("header".to_string(), 12);
+        mesh.timestamp = 99;
+        mesh.vertices = vec![0.5; 9];
+        let message = protocol.serialize_mesh(&mesh).unwrap();
+
+        let header = protocol.deserialize_frame_header(&message.payload).unwrap();
+        assert_eq!(header.simulation_id, "header");
+        assert_eq!(header.frame_number, 12);
+        assert_eq!(header.timestamp, 99);
+
+        let request = FrameRangeRequest::new(3, 8);
+        let message = protocol.create_frame_range_request(&request).unwrap();
+        assert_eq!(message.msg_type, MessageType::FrameRangeRequest);
+        let decoded = protocol
+            .deserialize_frame_range_request(&message.payload)
+            .unwrap();
+        assert_eq!(decoded, request);
+    }
+
+    #[test]
+    fn test_columnar_frames_and_version_range() {
+        let protocol = Protocol::default();
+        let mut mesh = MeshFrame::new("columnar".to_string(), 3);
+        mesh.vertices = vec![2.0; 9];
+
+        let message = protocol.serialize_columnar(&mesh).unwrap();
+        assert_eq!(message.msg_type, MessageType::ColumnarFrame);
+        let decoded = protocol
+            .decode_frame(message.msg_type, &message.payload)
+            .unwrap();
+        assert_eq!(decoded.vertices, mesh.vertices);
+
+        // Every version in the supported range is read, others are rejected
+        let mut buffer = Vec::new();
+        protocol.write_message(&mut buffer, &message).unwrap();
+        for version in MIN_PROTOCOL_VERSION..=PROTOCOL_VERSION {
+            buffer[0..2].copy_from_slice(&version.to_le_bytes());
+            let read = protocol.read_message(&mut Cursor::new(&buffer)).unwrap();
+            assert_eq!(read.version, version);
+        }
+        for version in [MIN_PROTOCOL_VERSION - 1, PROTOCOL_VERSION + 1] {
+            buffer[0..2].copy_from_slice(&version.to_le_bytes());
+            let result = protocol.read_message(&mut Cursor::new(&buffer));
+            assert!(matches!(result, Err(ProtocolError::InvalidVersion { .. })));
+        }
+    }
+
     #[cfg(feature = "json")]
     #[test]
     fn test_json_format() {
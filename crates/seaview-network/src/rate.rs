@@ -0,0 +1,153 @@
+//! Frame rate limits
+//!
+//! A solver can produce frames much faster than any viewer shows them. A
+//! [`RateLimit`] caps the frames a sender actually sends, either locally
+//! through [`SenderConfig::rate_limit`](crate::SenderConfig::rate_limit) or
+//! on behalf of a receiver that advertised one with
+//! [`MeshReceiver::set_rate_limit`](crate::MeshReceiver::set_rate_limit).
+//! Frames that are not selected are dropped before they are validated or
+//! serialized, so skipping one costs little more than reading the clock.
+
+use crate::protocol::{MessageType, NetworkMessage, ProtocolError};
+
+use serde::{Deserialize, Serialize};
+use std::time::{Duration, Instant};
+
+/// Which frames to send
+#[derive(Debug, Clone, Copy, PartialEq, Serialize, Deserialize)]
+pub struct RateLimit {
+    /// Send at most this many frames per second (0 = no limit)
+    pub max_fps: f32,
+    /// Only consider every Nth frame (0 or 1 = every frame)
+    pub every_nth: u32,
+}
+
+impl RateLimit {
+    /// At most `max_fps` frames per second
+    pub fn max_fps(max_fps: f32) -> Self {
+        Self {
+            max_fps,
+            every_nth: 1,
+        }
+    }
+
+    /// Every Nth frame
+    pub fn every_nth(every_nth: u32) -> Self {
+        Self {
+            max_fps: 0.0,
+            every_nth,
+        }
+    }
+
+    /// The stricter of two limits
+    fn strictest(self, other: Self) -> Self {
+        let max_fps = match (self.max_fps > 0.0, other.max_fps > 0.0) {
+            (true, true) => self.max_fps.min(other.max_fps),
+            (true, false) => self.max_fps,
+            _ => other.max_fps,
+        };
+        Self {
+            max_fps,
+            every_nth: self.every_nth.max(other.every_nth),
+        }
+    }
+}
+
+/// Create the message advertising (or with `None`, lifting) a limit
+pub fn create_message(limit: Option<&RateLimit>) -> Result<NetworkMessage, ProtocolError> {
+    Ok(NetworkMessage::new(
+        MessageType::RateLimit,
+        bincode::serialize(&limit)?,
+    ))
+}
+
+/// Parse a rate limit message payload
+pub fn parse_message(payload: &[u8]) -> Result<Option<RateLimit>, ProtocolError> {
+    Ok(bincode::deserialize(payload)?)
+}
+
+/// Selects the frames a sender sends
+#[derive(Debug, Default)]
+pub(crate) struct RateLimiter {
+    /// Limit configured on the sender
+    local: Option<RateLimit>,
+    /// Limit advertised by the receiver
+    remote: Option<RateLimit>,
+    /// Frames offered so far
+    offered: u64,
+    /// Earliest time the next frame may go out
+    next_due: Option<Instant>,
+}
+
+impl RateLimiter {
+    pub(crate) fn new(local: Option<RateLimit>) -> Self {
+        Self {
+            local,
+            ..Self::default()
+        }
+    }
+
+    /// Apply the limit advertised by the receiver
+    pub(crate) fn set_remote(&mut self, remote: Option<RateLimit>) {
+        self.remote = remote;
+    }
+
+    /// Whether the frame offered at `now` should be sent
+    pub(crate) fn admit(&mut self, now: Instant) -> bool {
+        let limit = match (self.local, self.remote) {
+            (None, None) => return true,
+            (Some(limit), None) | (None, Some(limit)) => limit,
+            (Some(local), Some(remote)) => local.strictest(remote),
+        };
+
+        let offered = self.offered;
+        self.offered += 1;
+        if limit.every_nth > 1 && offered % limit.every_nth as u64 != 0 {
+            return false;
+        }
+
+        if limit.max_fps > 0.0 {
+            let interval = Duration::from_secs_f32(1.0 / limit.max_fps);
+            if self.next_due.is_some_and(|due| now < due) {
+                return false;
+            }
+            // Keep the cadence, unless the solver fell behind it
+            let next = self.next_due.map_or(now, |due| due) + interval;
+            self.next_due = Some(if next < now { now + interval } else { next });
+        }
+        true
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_rate_limiter() {
+        let start = Instant::now();
+        let at = |ms: u64| start + Duration::from_millis(ms);
+
+        // 200 frames/s against a 50 frames/s limit
+        let mut limiter = RateLimiter::new(Some(RateLimit::max_fps(50.0)));
+        let admitted = (0..200).filter(|&i| limiter.admit(at(i * 5))).count();
+        assert!((49..=51).contains(&admitted), "{admitted}");
+
+        // The receiver asks for every 4th frame on top
+        let mut limiter = RateLimiter::new(None);
+        limiter.set_remote(Some(RateLimit::every_nth(4)));
+        let admitted: Vec<u64> = (0..12).filter(|&i| limiter.admit(at(i))).collect();
+        assert_eq!(admitted, vec![0, 4, 8]);
+
+        // The stricter of both applies
+        let mut limiter = RateLimiter::new(Some(RateLimit::max_fps(10.0)));
+        limiter.set_remote(Some(RateLimit::max_fps(100.0)));
+        assert_eq!((0..100).filter(|&i| limiter.admit(at(i * 10))).count(), 10);
+
+        let message = create_message(Some(&RateLimit::every_nth(3))).unwrap();
+        assert_eq!(
+            parse_message(&message.payload).unwrap(),
+            Some(RateLimit::every_nth(3))
+        );
+    }
+}
@@ -1,12 +1,47 @@
 //! Network receiver for streaming mesh data
-
-use crate::protocol::{MessageType, Protocol, ProtocolError, WireFormat};
-use crate::types::MeshFrame;
-
-use std::net::{TcpListener, TcpStream, ToSocketAddrs};
-use std::sync::mpsc;
+//!
+//! Received payloads live in pooled, reference-counted buffers. A frame can
+//! be handed to any number of consumers as an `Arc` (see
+//! [`FrameSubscribers`]) without copying its geometry, and its buffer is
+//! recycled once the last consumer drops it.
+//!
+//! Coarse levels of progressive frames (see [`crate::progressive`]) arrive
+//! as ordinary frames with their [`CoarseLevel`] attached. With partial
+//! updates enabled the receiver keeps the last frame and patches it with
+//! every [`PartialUpdate`] (see [`crate::delta`]). Volume frames (see
+//! [`crate::volume`]) arrive as the surface extracted from them;
+//! [`MeshReceiver`] keeps the last volume so the surface can be extracted
+//! again at another iso-value. With point frames enabled, point frames (see
+//! [`crate::points`]) arrive as a [`PointCloud`] next to a frame holding
+//! only their header.
+
+use crate::buffer::{BufferPool, FrameBuffer};
+use crate::columnar::{self, MeshFrameView};
+use crate::delta::{self, PartialUpdate};
+use crate::handshake::{
+    self, Capabilities, FEATURE_COMPACT_INDICES, FEATURE_PARTIAL_UPDATES, FEATURE_POINT_FRAMES,
+    FEATURE_PROGRESSIVE, FEATURE_STRIPING, FEATURE_VOLUME_FRAMES,
+};
+use crate::isosurface::{IsoSurface, ScalarField};
+use crate::lod;
+use crate::points::{self, PointCloud, PointFrame};
+use crate::progressive::CoarseLevel;
+use crate::rate::{self, RateLimit};
+use crate::roi::{self, RegionOfInterest};
+use crate::protocol::{
+    MessageType, NetworkMessage, Protocol, ProtocolError, WireFormat, HEADER_SIZE,
+};
+use crate::stripe::{self, StripeJoin, StripeSetup, StripedFrameHeader};
+use crate::types::{FrameHeader, FrameRangeRequest, MeshFrame};
+use crate::uring::{self, IoBackend, UringStream};
+use crate::volume::{self, VolumeFrame};
+
+use std::collections::VecDeque;
+use std::net::{SocketAddr, TcpListener, TcpStream, ToSocketAddrs};
+use std::ops::Range;
+use std::sync::{mpsc, Arc, Mutex};
 use std::thread;
-use std::time::Duration;
+use std::time::{Duration, Instant};
 use thiserror::Error;
 use tracing::{debug, error, info, trace, warn};
 
@@ -30,6 +65,9 @@ pub enum ReceiveError {
 
     #[error("Channel send error")]
     ChannelSend,
+
+    #[error("No sender connected")]
+    NotConnected,
 }
 
 /// Configuration for the mesh receiver
@@ -47,6 +85,18 @@ pub struct ReceiverConfig {
     pub read_timeout: Option<Duration>,
     /// Accept timeout for new connections
     pub accept_timeout: Option<Duration>,
+    /// Idle payload buffers kept for reuse
+    pub pooled_buffers: usize,
+    /// Socket I/O backend for accepted connections
+    pub io_backend: IoBackend,
+    /// Accept partial updates, keeping the last frame to apply them to
+    pub partial_updates: bool,
+    /// Accept point frames, which arrive in [`ReceivedMesh::points`] with
+    /// an empty frame
+    pub point_frames: bool,
+    /// Longest to wait for the extra connections of a striped session
+    /// before going on over the primary connection alone
+    pub stripe_timeout: Duration,
 }
 
 impl Default for ReceiverConfig {
@@ -58,26 +108,276 @@ impl Default for ReceiverConfig {
             recv_buffer_size: Some(1024 * 1024), // 1MB
             read_timeout: Some(Duration::from_secs(30)),
             accept_timeout: None, // Block by default
+            pooled_buffers: 8,
+            io_backend: IoBackend::default(),
+            partial_updates: false,
+            point_frames: false,
+            stripe_timeout: Duration::from_secs(5),
         }
     }
 }
 
 /// Received mesh data with connection metadata
+///
+/// Cloning is cheap: the frame itself is shared. `frame` became an
+/// `Arc<MeshFrame>` for that; code that took an owned `MeshFrame` out of
+/// it should call [`into_frame`](Self::into_frame), and
+/// [`frame`](Self::frame) borrows it either way.
 #[derive(Debug, Clone)]
 pub struct ReceivedMesh {
     /// The mesh frame data
-    pub frame: MeshFrame,
+    pub frame: Arc<MeshFrame>,
+    /// Source address of the sender
+    pub source_addr: std::net::SocketAddr,
+    /// Timestamp when received
+    pub received_at: std::time::Instant,
+    /// Set for a coarse level that a finer one of the same frame follows
+    pub level: Option<CoarseLevel>,
+    /// Vertex ranges that changed, if the frame arrived as a partial update
+    pub dirty: Option<Vec<Range<usize>>>,
+    /// Particles of a point frame; `frame` then has no geometry
+    pub points: Option<Arc<PointCloud>>,
+}
+
+/// A received frame still in its wire encoding
+///
+/// Nothing is decoded until asked for: [`view`](Self::view) borrows the
+/// geometry in place, [`decode`](Self::decode) builds an owned frame.
+/// Share it as a [`SharedFrame`] to hand it to several consumers.
+#[derive(Debug)]
+pub struct ReceivedFrame {
+    /// `MeshFrame`, `ColumnarFrame`, `PartialUpdate`, `VolumeFrame` or
+    /// `PointFrame`
+    pub msg_type: MessageType,
+    /// Frame payload exactly as received, in a pooled buffer
+    pub payload: FrameBuffer,
     /// Source address of the sender
     pub source_addr: std::net::SocketAddr,
     /// Timestamp when received
     pub received_at: std::time::Instant,
+    /// Set for a coarse level that a finer one of the same frame follows
+    pub level: Option<CoarseLevel>,
+    /// Format of `MeshFrame` payloads on this receiver
+    format: WireFormat,
+}
+
+impl ReceivedMesh {
+    /// The received frame
+    pub fn frame(&self) -> &MeshFrame {
+        &self.frame
+    }
+
+    /// Take the frame, copying it only if a clone still shares it
+    pub fn into_frame(self) -> MeshFrame {
+        Arc::unwrap_or_clone(self.frame)
+    }
+}
+
+impl ReceivedFrame {
+    /// Borrow the frame without copying its geometry
+    ///
+    /// Only columnar frames are laid out for this; other frames fail with
+    /// [`ProtocolError::InvalidMessageType`], and columnar frames with coded
+    /// indices with [`ProtocolError::Compressed`].
+    pub fn view(&self) -> Result<MeshFrameView<'_>, ProtocolError> {
+        match self.msg_type {
+            MessageType::ColumnarFrame => MeshFrameView::parse(&self.payload),
+            other => Err(ProtocolError::InvalidMessageType(other as u8)),
+        }
+    }
+
+    /// Decode into an owned mesh frame
+    ///
+    /// Partial updates only decode against their base frame, which
+    /// [`MeshReceiver::receive_one`] does. Volume frames decode into their
+    /// surface at the frame's iso-value. Point frames decode with
+    /// [`points`](Self::points) instead.
+    pub fn decode(&self) -> Result<MeshFrame, ProtocolError> {
+        Protocol::new(self.format).decode_frame(self.msg_type, &self.payload)
+    }
+
+    /// Decode the particles of a point frame
+    pub fn points(&self) -> Result<PointCloud, ProtocolError> {
+        match self.msg_type {
+            MessageType::PointFrame => PointFrame::from_payload(&self.payload)?.decode(),
+            other => Err(ProtocolError::InvalidMessageType(other as u8)),
+        }
+    }
+
+    /// Decode only the frame header
+    pub fn header(&self) -> Result<FrameHeader, ProtocolError> {
+        match self.msg_type {
+            MessageType::ColumnarFrame => columnar::decode_header(&self.payload),
+            MessageType::PartialUpdate => delta::decode_header(&self.payload),
+            MessageType::VolumeFrame => volume::decode_header(&self.payload),
+            MessageType::PointFrame => points::decode_header(&self.payload),
+            _ => Protocol::new(self.format).deserialize_frame_header(&self.payload),
+        }
+    }
+
+    /// Decode into a received mesh
+    fn into_mesh(self) -> Result<ReceivedMesh, ProtocolError> {
+        let (frame, points) = if self.msg_type == MessageType::PointFrame {
+            let points = self.points()?;
+            let mut frame = MeshFrame::new(points.simulation_id.clone(), points.frame_number);
+            frame.timestamp = points.timestamp;
+            frame.domain_bounds = points.domain_bounds;
+            (frame, Some(Arc::new(points)))
+        } else {
+            (self.decode()?, None)
+        };
+
+        Ok(ReceivedMesh {
+            frame: Arc::new(frame),
+            source_addr: self.source_addr,
+            received_at: self.received_at,
+            level: self.level,
+            dirty: None,
+            points,
+        })
+    }
+}
+
+/// A received frame shared between consumers
+pub type SharedFrame = Arc<ReceivedFrame>;
+
+/// A consumer registered with [`FrameSubscribers`]
+struct Subscription {
+    /// Only frames of this simulation, or every frame if `None`
+    simulation_id: Option<String>,
+    sender: mpsc::Sender<SharedFrame>,
+}
+
+/// Fans received frames out to any number of in-process consumers
+///
+/// Every subscriber gets its own channel. Publishing a frame sends each of
+/// them the same [`SharedFrame`], so adding a consumer costs a reference
+/// count rather than a copy. Subscribers that drop their channel are
+/// removed on the next publish.
+#[derive(Clone, Default)]
+pub struct FrameSubscribers {
+    subscriptions: Arc<Mutex<Vec<Subscription>>>,
+}
+
+impl FrameSubscribers {
+    /// Create an empty subscriber list
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Receive every published frame
+    pub fn subscribe(&self) -> mpsc::Receiver<SharedFrame> {
+        self.add(None)
+    }
+
+    /// Receive only the frames of one simulation
+    pub fn subscribe_stream(
+        &self,
+        simulation_id: impl Into<String>,
+    ) -> mpsc::Receiver<SharedFrame> {
+        self.add(Some(simulation_id.into()))
+    }
+
+    /// Number of live subscriptions
+    pub fn len(&self) -> usize {
+        self.subscriptions.lock().unwrap().len()
+    }
+
+    /// Whether nobody is subscribed
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Send a frame to every interested subscriber
+    ///
+    /// Returns the number of subscribers it was delivered to.
+    pub fn publish(&self, frame: &SharedFrame) -> usize {
+        let mut subscriptions = self.subscriptions.lock().unwrap();
+
+        // Only decode the header when some subscriber filters on it
+        let simulation_id = if subscriptions.iter().any(|s| s.simulation_id.is_some()) {
+            match frame.header() {
+                Ok(header) => Some(header.simulation_id),
+                Err(e) => {
+                    warn!("Cannot route frame to stream subscribers: {}", e);
+                    None
+                }
+            }
+        } else {
+            None
+        };
+
+        let mut delivered = 0;
+        subscriptions.retain(|subscription| {
+            let wanted = match &subscription.simulation_id {
+                Some(id) => simulation_id.as_ref() == Some(id),
+                None => true,
+            };
+            if !wanted {
+                return true;
+            }
+
+            let alive = subscription.sender.send(Arc::clone(frame)).is_ok();
+            delivered += alive as usize;
+            alive
+        });
+        delivered
+    }
+
+    /// Register a new subscription
+    fn add(&self, simulation_id: Option<String>) -> mpsc::Receiver<SharedFrame> {
+        let (sender, receiver) = mpsc::channel();
+        self.subscriptions.lock().unwrap().push(Subscription {
+            simulation_id,
+            sender,
+        });
+        receiver
+    }
+
+    /// Whether no handle other than this one, and no subscription, is left
+    fn abandoned(&self) -> bool {
+        Arc::strong_count(&self.subscriptions) == 1 && self.is_empty()
+    }
+}
+
+/// An accepted sender, with any extra connections of a striped session
+struct Connection {
+    /// Drives `stream` through io_uring; declared first so it is dropped
+    /// before the stream it borrows
+    uring: Option<UringStream>,
+    stream: TcpStream,
+    addr: std::net::SocketAddr,
+    stripes: Vec<TcpStream>,
+    /// First message, read while waiting for the stripes of another sender
+    pending: Option<NetworkMessage>,
 }
 
 /// TCP-based mesh data receiver
+///
+/// A sender may stream any number of frames over one connection; the
+/// receiver keeps reading from it until the sender disconnects or sends an
+/// end-of-stream marker, then accepts the next connection. Senders that
+/// stripe large frames across several connections are reassembled here
+/// (see [`crate::stripe`]).
 pub struct MeshReceiver {
     listener: TcpListener,
     protocol: Protocol,
+    capabilities: Capabilities,
+    pool: BufferPool,
     config: ReceiverConfig,
+    connection: Option<Connection>,
+    /// Connections that arrived while waiting for stripes, served next
+    backlog: VecDeque<(TcpStream, SocketAddr, Option<NetworkMessage>)>,
+    /// Subscription sent to every sender that connects
+    region_of_interest: Option<RegionOfInterest>,
+    /// Rate limit advertised to every sender that connects
+    rate_limit: Option<RateLimit>,
+    /// Last complete frame, which partial updates apply to
+    retained: Option<Arc<MeshFrame>>,
+    /// Last volume frame, ready to extract at another iso-value
+    volume: Option<(FrameHeader, IsoSurface)>,
+    /// Iso-value overriding the one of each volume frame
+    iso_value: Option<f32>,
     frames_received: u64,
     bytes_received: u64,
 }
@@ -106,11 +406,30 @@ impl MeshReceiver {
 
         let protocol =
             Protocol::new(config.format).with_max_message_size(config.max_message_size);
+        let mut features = FEATURE_STRIPING
+            | FEATURE_PROGRESSIVE
+            | FEATURE_COMPACT_INDICES
+            | FEATURE_VOLUME_FRAMES;
+        if config.partial_updates {
+            features |= FEATURE_PARTIAL_UPDATES;
+        }
+        if config.point_frames {
+            features |= FEATURE_POINT_FRAMES;
+        }
 
         Ok(Self {
             listener,
             protocol,
+            capabilities: Capabilities::new(config.format, config.max_message_size, features),
+            pool: BufferPool::new(config.pooled_buffers),
             config,
+            connection: None,
+            backlog: VecDeque::new(),
+            region_of_interest: None,
+            rate_limit: None,
+            retained: None,
+            volume: None,
+            iso_value: None,
             frames_received: 0,
             bytes_received: 0,
         })
@@ -121,11 +440,241 @@ impl MeshReceiver {
         Ok(self.listener.local_addr()?)
     }
 
-    /// Accept a single connection and receive one mesh frame
+    /// Receive the next mesh frame
+    ///
+    /// Reads from the current connection if there is one, otherwise waits
+    /// for a sender to connect. Partial updates are applied to the previous
+    /// frame; one that does not fit it is dropped and a full frame requested.
+    /// Volume frames arrive as their surface, extracted at the iso-value set
+    /// with [`set_iso_value`](Self::set_iso_value).
     pub fn receive_one(&mut self) -> Result<ReceivedMesh, ReceiveError> {
+        let mesh = loop {
+            let frame = self.receive_frame()?;
+            if frame.msg_type == MessageType::VolumeFrame {
+                break self.extract_volume(frame)?;
+            }
+            if frame.msg_type != MessageType::PartialUpdate {
+                let mesh = frame.into_mesh()?;
+                if self.config.partial_updates && mesh.level.is_none() && mesh.points.is_none() {
+                    self.retained = Some(mesh.frame.clone());
+                }
+                break mesh;
+            }
+
+            let update = PartialUpdate::from_payload(&frame.payload)?;
+            let Some(base) = self.retained.as_mut() else {
+                warn!(
+                    "Dropping partial update of frame {} without a base frame",
+                    update.frame_number
+                );
+                self.request_full_resolution()?;
+                continue;
+            };
+            if let Err(e) = update.apply(Arc::make_mut(base)) {
+                warn!(
+                    "Dropping partial update of frame {} against frame {}: {}",
+                    update.frame_number, update.base_frame, e
+                );
+                self.request_full_resolution()?;
+                continue;
+            }
+            break ReceivedMesh {
+                frame: base.clone(),
+                source_addr: frame.source_addr,
+                received_at: frame.received_at,
+                level: None,
+                dirty: Some(update.dirty_ranges()),
+                points: None,
+            };
+        };
+
+        debug!(
+            "Received frame {} from {} ({} vertices)",
+            mesh.frame.frame_number,
+            mesh.source_addr,
+            mesh.frame.vertex_count()
+        );
+
+        Ok(mesh)
+    }
+
+    /// Extract the surface of a volume frame, keeping the volume
+    fn extract_volume(&mut self, frame: ReceivedFrame) -> Result<ReceivedMesh, ReceiveError> {
+        let volume = VolumeFrame::from_payload(&frame.payload)?;
+        let field = ScalarField::from_volume(&volume)?;
+        let mut surface = IsoSurface::new(field, lod::default_workers());
+        let header = volume.header();
+        let iso_value = self.iso_value.unwrap_or(volume.iso_value);
+        let mesh = labelled(&header, surface.extract(iso_value));
+        self.volume = Some((header, surface));
+
+        Ok(ReceivedMesh {
+            frame: Arc::new(mesh),
+            source_addr: frame.source_addr,
+            received_at: frame.received_at,
+            level: frame.level,
+            dirty: None,
+            points: None,
+        })
+    }
+
+    /// Extract volume frames at `iso_value` instead of their own
+    ///
+    /// Returns the surface of the last volume frame at the new iso-value,
+    /// extracted again from only the blocks it passes through. `None` goes
+    /// back to the iso-value each frame carries.
+    pub fn set_iso_value(&mut self, iso_value: Option<f32>) -> Option<Arc<MeshFrame>> {
+        self.iso_value = iso_value;
+        let (header, surface) = self.volume.as_mut()?;
+        let iso_value = iso_value.or(surface.iso_value())?;
+        Some(Arc::new(labelled(header, surface.extract(iso_value))))
+    }
+
+    /// Receive the next frame without decoding it
+    ///
+    /// Like [`receive_one`](Self::receive_one), but leaves the payload as
+    /// received so it can be viewed in place or forwarded.
+    pub fn receive_frame(&mut self) -> Result<ReceivedFrame, ReceiveError> {
+        loop {
+            let mut connection = match self.connection.take() {
+                Some(connection) => connection,
+                None => {
+                    let (mut stream, addr, pending) = match self.backlog.pop_front() {
+                        Some(waiting) => waiting,
+                        None => {
+                            let (stream, addr) = self.accept()?;
+                            (stream, addr, None)
+                        }
+                    };
+                    if let Err(e) = self.send_subscription(&mut stream) {
+                        warn!("Dropping connection from {}: {}", addr, e);
+                        continue;
+                    }
+                    Connection {
+                        uring: uring::attach(
+                            self.config.io_backend,
+                            &stream,
+                            self.config.read_timeout,
+                        ),
+                        stream,
+                        addr,
+                        stripes: Vec::new(),
+                        pending,
+                    }
+                }
+            };
+
+            match self.receive_from_stream(&mut connection) {
+                Ok(frame) => {
+                    self.connection = Some(connection);
+                    return Ok(frame);
+                }
+                Err(e) if is_disconnect(&e) => {
+                    debug!("Connection from {} finished", connection.addr);
+                    continue;
+                }
+                Err(e) => return Err(e),
+            }
+        }
+    }
+
+    /// Ask the connected upstream to resend frames `first..=last`
+    ///
+    /// Only an upstream that caches frames, such as a relay, answers; the
+    /// frames then arrive through [`receive_one`](Self::receive_one).
+    pub fn request_frames(&mut self, first: u32, last: u32) -> Result<(), ReceiveError> {
+        let Some(connection) = self.connection.as_mut() else {
+            return Err(ReceiveError::NotConnected);
+        };
+
+        debug!(
+            "Requesting frames {}..={} from {}",
+            first, last, connection.addr
+        );
+        let message = self
+            .protocol
+            .create_frame_range_request(&FrameRangeRequest::new(first, last))?;
+        self.protocol
+            .write_message(&mut connection.stream, &message)?;
+        Ok(())
+    }
+
+    /// Ask the connected sender for its next frame at full resolution
+    ///
+    /// Only matters for a sender streaming reduced detail (see
+    /// [`LodConfig`](crate::lod::LodConfig)); others ignore it.
+    pub fn request_full_resolution(&mut self) -> Result<(), ReceiveError> {
+        let Some(connection) = self.connection.as_mut() else {
+            return Err(ReceiveError::NotConnected);
+        };
+
+        debug!("Requesting full resolution from {}", connection.addr);
+        let message = self.protocol.create_full_resolution_request();
+        self.protocol
+            .write_message(&mut connection.stream, &message)?;
+        Ok(())
+    }
+
+    /// Receive only the part of each frame inside a region
+    ///
+    /// The subscription goes to the connected sender right away and to
+    /// every sender that connects later; `None` cancels it. Senders clip
+    /// frames with [`roi::clip`] before sending them.
+    pub fn set_region_of_interest(
+        &mut self,
+        region_of_interest: Option<RegionOfInterest>,
+    ) -> Result<(), ReceiveError> {
+        self.region_of_interest = region_of_interest;
+        let Some(connection) = self.connection.as_mut() else {
+            return Ok(());
+        };
+
+        debug!(
+            "Sending region of interest {:?} to {}",
+            region_of_interest, connection.addr
+        );
+        let message = roi::create_message(region_of_interest.as_ref())?;
+        self.protocol
+            .write_message(&mut connection.stream, &message)?;
+        Ok(())
+    }
+
+    /// Ask senders to send at most this many frames
+    ///
+    /// Like a region of interest, the limit goes to the connected sender
+    /// and every later one; `None` lifts it. Senders skip the frames beyond
+    /// it before doing any work on them.
+    pub fn set_rate_limit(&mut self, rate_limit: Option<RateLimit>) -> Result<(), ReceiveError> {
+        self.rate_limit = rate_limit;
+        let Some(connection) = self.connection.as_mut() else {
+            return Ok(());
+        };
+
+        debug!("Sending rate limit {:?} to {}", rate_limit, connection.addr);
+        let message = rate::create_message(rate_limit.as_ref())?;
+        self.protocol
+            .write_message(&mut connection.stream, &message)?;
+        Ok(())
+    }
+
+    /// Tell a newly connected sender what this receiver subscribed to
+    fn send_subscription(&self, stream: &mut TcpStream) -> Result<(), ReceiveError> {
+        if let Some(region_of_interest) = &self.region_of_interest {
+            let message = roi::create_message(Some(region_of_interest))?;
+            self.protocol.write_message(stream, &message)?;
+        }
+        if let Some(rate_limit) = &self.rate_limit {
+            let message = rate::create_message(Some(rate_limit))?;
+            self.protocol.write_message(stream, &message)?;
+        }
+        Ok(())
+    }
+
+    /// Accept and configure the next sender connection
+    fn accept(&mut self) -> Result<(TcpStream, std::net::SocketAddr), ReceiveError> {
         debug!("Waiting for connection...");
 
-        let (mut stream, addr) = if let Some(timeout) = self.config.accept_timeout {
+        let (stream, addr) = if let Some(timeout) = self.config.accept_timeout {
             // Non-blocking accept with timeout
             let start = std::time::Instant::now();
             loop {
@@ -147,55 +696,207 @@ impl MeshReceiver {
 
         info!("Accepted connection from {}", addr);
 
-        // Configure the stream
-        stream.set_nodelay(self.config.tcp_nodelay)?;
+        configure_stream(&stream, &self.config)?;
 
-        // Note: TcpStream doesn't have set_recv_buffer_size method
-        // Buffer size would need to be set at socket level using platform-specific APIs
-        let _ = self.config.recv_buffer_size;
+        Ok((stream, addr))
+    }
 
-        if let Some(timeout) = self.config.read_timeout {
-            stream.set_read_timeout(Some(timeout))?;
+    /// Accept the extra connections of a striped session
+    ///
+    /// Other senders that connect meanwhile are kept for later. If not every
+    /// stripe joins within the stripe timeout, the session goes on over the
+    /// primary connection alone; the reply tells the sender which.
+    fn accept_stripes(
+        &mut self,
+        connection: &mut Connection,
+        setup: &StripeSetup,
+    ) -> Result<(), ReceiveError> {
+        let count = setup.stripe_count as usize;
+        let mut stripes: Vec<Option<TcpStream>> = (1..count).map(|_| None).collect();
+        let deadline = Instant::now() + self.config.stripe_timeout;
+
+        while stripes.iter().any(Option::is_none) {
+            let Some((mut stream, addr)) = self.accept_until(deadline)? else {
+                break;
+            };
+            let message = match self.read_first(&mut stream, deadline) {
+                Ok(message) => message,
+                Err(e) => {
+                    debug!(
+                        "Connection from {} failed before its first message: {}",
+                        addr, e
+                    );
+                    continue;
+                }
+            };
+
+            let join = message
+                .as_ref()
+                .filter(|message| message.msg_type == MessageType::StripeJoin)
+                .map(|message| stripe::parse_message::<StripeJoin>(&message.payload))
+                .transpose()?;
+            match join {
+                Some(join)
+                    if join.session_id == setup.session_id
+                        && (1..count).contains(&(join.index as usize)) =>
+                {
+                    stripes[join.index as usize - 1] = Some(stream);
+                }
+                Some(join) => warn!(
+                    "Dropping stripe {} of unknown session {} from {}",
+                    join.index, join.session_id, addr
+                ),
+                None => {
+                    debug!("Keeping connection from {} until this one ends", addr);
+                    self.backlog.push_back((stream, addr, message));
+                }
+            }
         }
 
-        // Receive mesh frame
-        let mesh = self.receive_from_stream(&mut stream, addr)?;
+        let joined = stripes.iter().all(Option::is_some);
+        self.protocol.write_message(
+            &mut connection.stream,
+            &stripe::reply_message(setup, joined)?,
+        )?;
+        if joined {
+            info!("Striped session with {} connections", count);
+            connection.stripes = stripes.into_iter().flatten().collect();
+        } else {
+            warn!(
+                "Only {} of {} stripes from {} joined, going on without striping",
+                stripes.iter().flatten().count() + 1,
+                count,
+                connection.addr
+            );
+        }
+        Ok(())
+    }
 
-        Ok(mesh)
+    /// Accept a connection, or `None` once `deadline` has passed
+    fn accept_until(
+        &mut self,
+        deadline: Instant,
+    ) -> Result<Option<(TcpStream, SocketAddr)>, ReceiveError> {
+        self.listener.set_nonblocking(true)?;
+        let accepted = loop {
+            match self.listener.accept() {
+                Ok(accepted) => break Ok(Some(accepted)),
+                Err(ref e) if e.kind() == std::io::ErrorKind::WouldBlock => {
+                    if Instant::now() >= deadline {
+                        break Ok(None);
+                    }
+                    thread::sleep(Duration::from_millis(10));
+                }
+                Err(e) => break Err(e),
+            }
+        };
+        self.listener
+            .set_nonblocking(self.config.accept_timeout.is_some())?;
+
+        let accepted = accepted?;
+        if let Some((stream, addr)) = &accepted {
+            info!("Accepted connection from {}", addr);
+            configure_stream(stream, &self.config)?;
+        }
+        Ok(accepted)
     }
 
-    /// Receive mesh data from a stream
+    /// Read the first message of a connection, or `None` if nothing has
+    /// arrived by `deadline`
+    fn read_first(
+        &self,
+        stream: &mut TcpStream,
+        deadline: Instant,
+    ) -> Result<Option<NetworkMessage>, ReceiveError> {
+        let remaining = deadline.saturating_duration_since(Instant::now());
+        stream.set_read_timeout(Some(remaining.max(Duration::from_millis(1))))?;
+        let arrived = match stream.peek(&mut [0u8; 1]) {
+            Ok(_) => true,
+            Err(ref e)
+                if matches!(
+                    e.kind(),
+                    std::io::ErrorKind::WouldBlock | std::io::ErrorKind::TimedOut
+                ) =>
+            {
+                false
+            }
+            Err(e) => return Err(e.into()),
+        };
+        let message = arrived
+            .then(|| self.protocol.read_message(stream))
+            .transpose()?;
+        stream.set_read_timeout(self.config.read_timeout)?;
+        Ok(message)
+    }
+
+    /// Receive the next frame from a connection
     fn receive_from_stream(
         &mut self,
-        stream: &mut TcpStream,
-        source_addr: std::net::SocketAddr,
-    ) -> Result<ReceivedMesh, ReceiveError> {
+        connection: &mut Connection,
+    ) -> Result<ReceivedFrame, ReceiveError> {
         let received_at = std::time::Instant::now();
+        let source_addr = connection.addr;
+        let mut level = None;
 
         loop {
-            let message = self.protocol.read_message(stream)?;
-            self.bytes_received += message.size() as u64;
-
-            match message.msg_type {
-                MessageType::MeshFrame => {
-                    trace!("Received mesh frame message");
-                    let frame = self.protocol.deserialize_mesh(&message.payload)?;
-
-                    self.frames_received += 1;
-
-                    debug!(
-                        "Received frame {} from {} ({} vertices, {} bytes)",
-                        frame.frame_number,
-                        source_addr,
-                        frame.vertex_count(),
-                        message.size()
-                    );
+            let (msg_type, message) = match connection.pending.take() {
+                Some(pending) => (pending.msg_type, self.pool.wrap(pending.payload)),
+                None => match connection.uring.as_mut() {
+                    Some(uring) => uring.read_pooled(&self.protocol, &self.pool)?,
+                    None => self
+                        .protocol
+                        .read_pooled(&mut connection.stream, &self.pool)?,
+                },
+            };
+            self.bytes_received += (HEADER_SIZE + message.len()) as u64;
+
+            let (frame_type, payload) = match msg_type {
+                MessageType::MeshFrame
+                | MessageType::ColumnarFrame
+                | MessageType::PartialUpdate
+                | MessageType::VolumeFrame
+                | MessageType::PointFrame => {
+                    trace!("Received {:?} message", msg_type);
+                    (msg_type, message)
+                }
+                MessageType::StripedFrame => {
+                    let header: StripedFrameHeader = stripe::parse_message(&message)?;
+                    let payload_len = header.payload_len as usize;
+                    if payload_len > self.config.max_message_size {
+                        return Err(ProtocolError::MessageTooLarge {
+                            size: payload_len,
+                            max_size: self.config.max_message_size,
+                        }
+                        .into());
+                    }
 
-                    return Ok(ReceivedMesh {
-                        frame,
-                        source_addr,
-                        received_at,
-                    });
+                    trace!("Receiving striped frame of {} bytes", payload_len);
+                    let mut payload = self.pool.take(payload_len);
+                    stripe::read_striped_into(
+                        &mut connection.stream,
+                        &mut connection.stripes,
+                        &mut payload,
+                    )?;
+                    self.bytes_received += payload_len as u64;
+                    (header.frame_type, self.pool.wrap(payload))
+                }
+                MessageType::StripeSetup => {
+                    let setup: StripeSetup = stripe::parse_message(&message)?;
+                    self.accept_stripes(connection, &setup)?;
+                    continue;
+                }
+                MessageType::CoarseLevel => {
+                    level = Some(CoarseLevel::from_payload(&message)?);
+                    continue;
+                }
+                MessageType::Hello => {
+                    handshake::answer_hello(
+                        &self.protocol,
+                        &self.capabilities,
+                        &mut connection.stream,
+                        &message,
+                    )?;
+                    continue;
                 }
                 MessageType::Heartbeat => {
                     trace!("Received heartbeat");
@@ -203,16 +904,31 @@ impl MeshReceiver {
                 }
                 MessageType::EndOfStream => {
                     info!("Received end-of-stream marker from {}", source_addr);
-                    return Err(ReceiveError::Io(std::io::Error::new(
-                        std::io::ErrorKind::UnexpectedEof,
-                        "End of stream",
-                    )));
+                    return Err(end_of_stream());
                 }
                 _ => {
-                    warn!("Ignoring unexpected message type: {:?}", message.msg_type);
+                    warn!("Ignoring unexpected message type: {:?}", msg_type);
                     continue;
                 }
-            }
+            };
+
+            self.frames_received += 1;
+
+            trace!(
+                "Received {:?} from {} ({} bytes)",
+                frame_type,
+                source_addr,
+                payload.len()
+            );
+
+            return Ok(ReceivedFrame {
+                msg_type: frame_type,
+                payload,
+                source_addr,
+                received_at,
+                level,
+                format: self.config.format,
+            });
         }
     }
 
@@ -264,6 +980,45 @@ impl MeshReceiver {
         (rx, handle)
     }
 
+    /// Start receiver in a background thread that publishes every frame
+    ///
+    /// Frames are shared with all subscribers of the returned handle rather
+    /// than copied. The thread stops after the next frame once the handle,
+    /// all its clones and every subscription have been dropped.
+    pub fn run_shared(mut self) -> (FrameSubscribers, thread::JoinHandle<()>) {
+        let subscribers = FrameSubscribers::new();
+        let publisher = subscribers.clone();
+
+        let handle = thread::spawn(move || {
+            info!("Starting shared mesh receiver loop");
+
+            loop {
+                match self.receive_frame() {
+                    Ok(frame) => {
+                        publisher.publish(&Arc::new(frame));
+                        if publisher.abandoned() {
+                            info!("All subscribers gone");
+                            break;
+                        }
+                    }
+                    Err(ReceiveError::AcceptTimeout) => {
+                        trace!("Accept timeout, continuing");
+                    }
+                    Err(e) => {
+                        error!("Error receiving frame: {}", e);
+                    }
+                }
+            }
+
+            info!(
+                "Shared mesh receiver stopped. Received {} frames, {} bytes",
+                self.frames_received, self.bytes_received
+            );
+        });
+
+        (subscribers, handle)
+    }
+
     /// Get statistics about received data
     pub fn stats(&self) -> ReceiverStats {
         ReceiverStats {
@@ -274,10 +1029,16 @@ impl MeshReceiver {
 }
 
 /// Non-blocking mesh receiver that can be polled
+///
+/// Any number of senders can stay connected at once; each poll services
+/// whichever connection has data waiting.
 pub struct NonBlockingMeshReceiver {
     listener: TcpListener,
     protocol: Protocol,
+    capabilities: Capabilities,
+    pool: BufferPool,
     config: ReceiverConfig,
+    connections: Vec<(TcpStream, std::net::SocketAddr)>,
 }
 
 impl NonBlockingMeshReceiver {
@@ -302,89 +1063,163 @@ impl NonBlockingMeshReceiver {
 
         let protocol =
             Protocol::new(config.format).with_max_message_size(config.max_message_size);
+        // Striped sessions need the blocking receiver
+        let mut features = FEATURE_PROGRESSIVE | FEATURE_COMPACT_INDICES | FEATURE_VOLUME_FRAMES;
+        if config.point_frames {
+            features |= FEATURE_POINT_FRAMES;
+        }
 
         Ok(Self {
             listener,
             protocol,
+            capabilities: Capabilities::new(config.format, config.max_message_size, features),
+            pool: BufferPool::new(config.pooled_buffers),
             config,
+            connections: Vec::new(),
         })
     }
 
     /// Try to receive a mesh without blocking
+    ///
+    /// Only blocks (up to the read timeout) once a message has started to
+    /// arrive, so a partially sent frame is always read in full.
     pub fn try_receive(&mut self) -> Result<Option<ReceivedMesh>, ReceiveError> {
-        match self.listener.accept() {
-            Ok((mut stream, addr)) => {
-                debug!("Accepted connection from {}", addr);
-
-                // Configure the stream
-                stream.set_nodelay(self.config.tcp_nodelay)?;
-
-                // Note: TcpStream doesn't have set_recv_buffer_size method
-                // Buffer size would need to be set at socket level using platform-specific APIs
-                let _ = self.config.recv_buffer_size;
+        match self.try_receive_frame()? {
+            Some(frame) => {
+                let mesh = frame.into_mesh()?;
+                debug!(
+                    "Received frame {} from {} ({} vertices)",
+                    mesh.frame.frame_number,
+                    mesh.source_addr,
+                    mesh.frame.vertex_count()
+                );
+                Ok(Some(mesh))
+            }
+            None => Ok(None),
+        }
+    }
 
-                if let Some(timeout) = self.config.read_timeout {
-                    stream.set_read_timeout(Some(timeout))?;
+    /// Try to receive a frame without blocking or decoding it
+    pub fn try_receive_frame(&mut self) -> Result<Option<ReceivedFrame>, ReceiveError> {
+        self.accept_pending()?;
+
+        let mut index = 0;
+        while index < self.connections.len() {
+            let (stream, addr) = &mut self.connections[index];
+            let addr = *addr;
+
+            let result = match has_pending_data(stream) {
+                Ok(true) => Self::read_available(
+                    &self.protocol,
+                    &self.capabilities,
+                    &self.pool,
+                    self.config.format,
+                    stream,
+                    addr,
+                ),
+                Ok(false) => Ok(None),
+                Err(e) => Err(e.into()),
+            };
+
+            match result {
+                Ok(Some(frame)) => return Ok(Some(frame)),
+                Ok(None) => index += 1,
+                Err(e) => {
+                    self.connections.swap_remove(index);
+                    if !is_disconnect(&e) {
+                        return Err(e);
+                    }
+                    debug!("Connection from {} finished", addr);
                 }
+            }
+        }
+
+        Ok(None)
+    }
 
-                // Switch to blocking mode for reading
-                stream.set_nonblocking(false)?;
+    /// Number of senders currently connected
+    pub fn connection_count(&self) -> usize {
+        self.connections.len()
+    }
 
-                // Try to receive mesh
-                match self.receive_from_stream(&mut stream, addr) {
-                    Ok(mesh) => Ok(Some(mesh)),
-                    Err(e) => Err(e),
+    /// Accept every connection waiting on the listener
+    fn accept_pending(&mut self) -> Result<(), ReceiveError> {
+        loop {
+            match self.listener.accept() {
+                Ok((stream, addr)) => {
+                    debug!("Accepted connection from {}", addr);
+                    configure_stream(&stream, &self.config)?;
+                    self.connections.push((stream, addr));
                 }
+                Err(ref e) if e.kind() == std::io::ErrorKind::WouldBlock => return Ok(()),
+                Err(e) => return Err(e.into()),
             }
-            Err(ref e) if e.kind() == std::io::ErrorKind::WouldBlock => Ok(None),
-            Err(e) => Err(e.into()),
         }
     }
 
-    /// Receive mesh data from a stream
-    fn receive_from_stream(
-        &mut self,
+    /// Read messages while data is waiting, stopping at the first mesh frame
+    fn read_available(
+        protocol: &Protocol,
+        capabilities: &Capabilities,
+        pool: &BufferPool,
+        format: WireFormat,
         stream: &mut TcpStream,
         source_addr: std::net::SocketAddr,
-    ) -> Result<ReceivedMesh, ReceiveError> {
+    ) -> Result<Option<ReceivedFrame>, ReceiveError> {
         let received_at = std::time::Instant::now();
+        let mut level = None;
 
         loop {
-            let message = self.protocol.read_message(stream)?;
-
-            match message.msg_type {
-                MessageType::MeshFrame => {
-                    let frame = self.protocol.deserialize_mesh(&message.payload)?;
-
-                    debug!(
-                        "Received frame {} from {} ({} vertices)",
-                        frame.frame_number,
-                        source_addr,
-                        frame.vertex_count()
-                    );
-
-                    return Ok(ReceivedMesh {
-                        frame,
+            let (msg_type, message) = protocol.read_pooled(stream, pool)?;
+
+            match msg_type {
+                MessageType::MeshFrame
+                | MessageType::ColumnarFrame
+                | MessageType::VolumeFrame
+                | MessageType::PointFrame => {
+                    return Ok(Some(ReceivedFrame {
+                        msg_type,
+                        payload: message,
                         source_addr,
                         received_at,
-                    });
+                        level,
+                        format,
+                    }));
+                }
+                MessageType::CoarseLevel => {
+                    // The frame it announces was sent right behind it
+                    level = Some(CoarseLevel::from_payload(&message)?);
+                    continue;
                 }
                 MessageType::Heartbeat => {
                     trace!("Received heartbeat");
-                    continue;
+                }
+                MessageType::Hello => {
+                    handshake::answer_hello(protocol, capabilities, stream, &message)?;
                 }
                 MessageType::EndOfStream => {
                     info!("Received end-of-stream marker from {}", source_addr);
-                    return Err(ReceiveError::Io(std::io::Error::new(
-                        std::io::ErrorKind::UnexpectedEof,
-                        "End of stream",
-                    )));
+                    return Err(end_of_stream());
+                }
+                MessageType::StripeSetup => {
+                    // Striped sessions need MeshReceiver; the sender goes on
+                    // over this connection alone
+                    let setup: StripeSetup = stripe::parse_message(&message)?;
+                    debug!("Declining striped session from {}", source_addr);
+                    protocol.write_message(stream, &stripe::reply_message(&setup, false)?)?;
+                }
+                MessageType::StripeJoin => {
+                    debug!("Closing stripe connection from {}", source_addr);
+                    return Err(end_of_stream());
                 }
                 _ => {
-                    warn!("Ignoring unexpected message type: {:?}", message.msg_type);
-                    continue;
+                    warn!("Ignoring unexpected message type: {:?}", msg_type);
                 }
             }
+
+            if !has_pending_data(stream)? {
+                return Ok(None);
+            }
         }
     }
 
@@ -394,6 +1229,107 @@ impl NonBlockingMeshReceiver {
     }
 }
 
+/// Apply the receiver configuration to an accepted stream
+fn configure_stream(stream: &TcpStream, config: &ReceiverConfig) -> Result<(), ReceiveError> {
+    // Accepted sockets may inherit non-blocking mode from the listener
+    stream.set_nonblocking(false)?;
+    stream.set_nodelay(config.tcp_nodelay)?;
+
+    // Note: TcpStream doesn't have set_recv_buffer_size method
+    // Buffer size would need to be set at socket level using platform-specific APIs
+    let _ = config.recv_buffer_size;
+
+    if let Some(timeout) = config.read_timeout {
+        stream.set_read_timeout(Some(timeout))?;
+    }
+
+    Ok(())
+}
+
+/// Check whether a stream has unread data without consuming it
+///
+/// A closed connection counts as pending so the following read reports it.
+pub(crate) fn has_pending_data(stream: &TcpStream) -> std::io::Result<bool> {
+    let mut byte = [0u8; 1];
+    match peek_nonblocking(stream, &mut byte) {
+        Ok(_) => Ok(true),
+        Err(ref e)
+            if matches!(
+                e.kind(),
+                std::io::ErrorKind::WouldBlock | std::io::ErrorKind::Interrupted
+            ) =>
+        {
+            Ok(false)
+        }
+        Err(e) => Err(e),
+    }
+}
+
+/// Peek at a blocking stream without waiting, in a single system call
+#[cfg(unix)]
+fn peek_nonblocking(stream: &TcpStream, buf: &mut [u8]) -> std::io::Result<usize> {
+    use std::os::unix::io::AsRawFd;
+
+    // SAFETY: `buf` is valid for writes of `buf.len()` bytes and the
+    // descriptor stays open for as long as `stream` is borrowed.
+    let read = unsafe {
+        libc::recv(
+            stream.as_raw_fd(),
+            buf.as_mut_ptr().cast(),
+            buf.len(),
+            libc::MSG_PEEK | libc::MSG_DONTWAIT,
+        )
+    };
+    if read < 0 {
+        Err(std::io::Error::last_os_error())
+    } else {
+        Ok(read as usize)
+    }
+}
+
+/// Peek at a blocking stream without waiting
+#[cfg(not(unix))]
+fn peek_nonblocking(stream: &TcpStream, buf: &mut [u8]) -> std::io::Result<usize> {
+    stream.set_nonblocking(true)?;
+    let result = stream.peek(buf);
+    stream.set_nonblocking(false)?;
+    result
+}
+
+/// Error returned when a sender ends its stream
+fn end_of_stream() -> ReceiveError {
+    ReceiveError::Io(std::io::Error::new(
+        std::io::ErrorKind::UnexpectedEof,
+        "End of stream",
+    ))
+}
+
+/// Give an extracted surface the header of its volume frame
+fn labelled(header: &FrameHeader, mut mesh: MeshFrame) -> MeshFrame {
+    mesh.simulation_id.clone_from(&header.simulation_id);
+    mesh.frame_number = header.frame_number;
+    mesh.timestamp = header.timestamp;
+    mesh
+}
+
+/// Whether an error just means the sender went away
+fn is_disconnect(error: &ReceiveError) -> bool {
+    use std::io::ErrorKind;
+
+    let io_error = match error {
+        ReceiveError::Io(e) => e,
+        ReceiveError::Protocol(ProtocolError::Io(e)) => e,
+        _ => return false,
+    };
+    matches!(
+        io_error.kind(),
+        ErrorKind::UnexpectedEof
+            | ErrorKind::ConnectionReset
+            | ErrorKind::ConnectionAborted
+            | ErrorKind::BrokenPipe
+    )
+}
+
 /// Statistics about received data
 #[derive(Debug, Clone, Copy)]
 pub struct ReceiverStats {
@@ -432,6 +1368,37 @@ mod tests {
         assert!(matches!(result, Ok(None)));
     }
 
+    #[test]
+    fn test_has_pending_data_keeps_stream_blocking() {
+        use std::io::{Read, Write};
+
+        let listener = TcpListener::bind("127.0.0.1:0").unwrap();
+        let mut client = TcpStream::connect(listener.local_addr().unwrap()).unwrap();
+        let (mut server, _) = listener.accept().unwrap();
+
+        assert!(!has_pending_data(&server).unwrap());
+        client.write_all(&[7]).unwrap();
+        while !has_pending_data(&server).unwrap() {
+            std::thread::yield_now();
+        }
+
+        // Peeking consumed nothing and the stream still blocks on reads
+        server
+            .set_read_timeout(Some(Duration::from_millis(50)))
+            .unwrap();
+        let mut byte = [0u8; 2];
+        assert_eq!(server.read(&mut byte).unwrap(), 1);
+        assert_eq!(byte[0], 7);
+        let error = server.read(&mut byte).unwrap_err();
+        assert!(matches!(
+            error.kind(),
+            std::io::ErrorKind::WouldBlock | std::io::ErrorKind::TimedOut
+        ));
+
+        drop(client);
+        assert!(has_pending_data(&server).unwrap());
+    }
+
     #[test]
     fn test_receiver_stats() {
         let receiver = MeshReceiver::bind("127.0.0.1:0").unwrap();
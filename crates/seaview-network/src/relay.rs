@@ -0,0 +1,678 @@
+//! Fan-out relay for sharing one simulation stream between many viewers
+//!
+//! The relay accepts a single upstream [`MeshSender`](crate::MeshSender)
+//! connection and forwards every message it reads to any number of
+//! downstream receivers. Messages are forwarded in their wire encoding, so a
+//! frame is never re-serialized and the solver pays for exactly one send.
+//!
+//! Each subscriber has its own writer thread fed by a queue. When a
+//! subscriber falls behind and too many frames are waiting for it, new
+//! frames for that subscriber are dropped instead of stalling the upstream
+//! or the other subscribers. Every other message, such as metadata and
+//! checkpoints, is always queued.
+//!
+//! The relay also keeps a [`FrameCache`] of recent frames. A subscriber added
+//! mid-run is first replayed the cached metadata, checkpoint and frames, and
+//! can later ask for specific frame ranges with a
+//! [`FrameRangeRequest`](crate::types::FrameRangeRequest) message.
+//!
+//! Requests for full resolution from any subscriber are passed on to the
+//! upstream sender. Region of interest subscriptions and rate limits are
+//! refused: every subscriber gets the same stream, so one viewer cannot
+//! narrow it for the others.
+
+use crate::cache::FrameCache;
+use crate::handshake::{self, Capabilities, FrameEncoding};
+use crate::protocol::{
+    EncodedMessage, MessageType, NetworkMessage, Protocol, ProtocolError, WireFormat,
+};
+
+use std::net::{SocketAddr, TcpListener, TcpStream, ToSocketAddrs};
+use std::sync::atomic::{AtomicU64, AtomicUsize, Ordering};
+use std::sync::mpsc::{self, Receiver, SendError, Sender, TrySendError};
+use std::sync::{Arc, Mutex};
+use std::thread;
+use std::time::Duration;
+use thiserror::Error;
+use tracing::{debug, error, info, trace, warn};
+
+/// Errors that can occur in the relay
+#[derive(Error, Debug)]
+pub enum RelayError {
+    #[error("IO error: {0}")]
+    Io(#[from] std::io::Error),
+
+    #[error("Protocol error: {0}")]
+    Protocol(#[from] ProtocolError),
+
+    #[error("Bind error: {0}")]
+    Bind(String),
+
+    #[error("Invalid address: {0}")]
+    InvalidAddress(String),
+}
+
+/// Configuration for the mesh relay
+#[derive(Debug, Clone)]
+pub struct RelayConfig {
+    /// Maximum message size in bytes
+    pub max_message_size: usize,
+    /// Frames queued per subscriber before new ones are dropped
+    pub queue_depth: usize,
+    /// Recent frames kept for late joiners and range requests (0 disables)
+    pub cache_frames: usize,
+    /// TCP no-delay setting for all connections
+    pub tcp_nodelay: bool,
+    /// Read timeout for the upstream connection
+    pub read_timeout: Option<Duration>,
+    /// Connection timeout for subscribers
+    pub connect_timeout: Option<Duration>,
+    /// Write timeout for subscribers
+    pub write_timeout: Option<Duration>,
+}
+
+impl Default for RelayConfig {
+    fn default() -> Self {
+        Self {
+            max_message_size: 100 * 1024 * 1024, // 100MB
+            queue_depth: 8,
+            cache_frames: 64,
+            tcp_nodelay: true,
+            read_timeout: None, // Simulations may pause between frames
+            connect_timeout: Some(Duration::from_secs(10)),
+            write_timeout: Some(Duration::from_secs(30)),
+        }
+    }
+}
+
+/// A downstream receiver fed by the relay
+struct Subscriber {
+    addr: SocketAddr,
+    queue: SubscriberQueue,
+    dropped: u64,
+}
+
+/// Messages waiting for one subscriber's writer
+///
+/// Only whole frames count against the depth; anything else is always
+/// queued, so a slow subscriber loses frames but never the metadata,
+/// checkpoints or replies that go with them.
+#[derive(Clone)]
+struct SubscriberQueue {
+    messages: Sender<EncodedMessage>,
+    /// Frames queued and not yet written
+    frames: Arc<AtomicUsize>,
+    depth: usize,
+}
+
+impl SubscriberQueue {
+    fn new(depth: usize) -> (Self, Receiver<EncodedMessage>, Arc<AtomicUsize>) {
+        let (messages, receiver) = mpsc::channel();
+        let frames = Arc::new(AtomicUsize::new(0));
+        let queue = Self {
+            messages,
+            frames: Arc::clone(&frames),
+            depth: depth.max(1),
+        };
+        (queue, receiver, frames)
+    }
+
+    /// Queue a message, failing with [`TrySendError::Full`] for a frame
+    /// while `depth` frames are already waiting
+    fn try_send(&self, message: EncodedMessage) -> Result<(), TrySendError<EncodedMessage>> {
+        if is_frame(message.msg_type) && self.frames.load(Ordering::Relaxed) >= self.depth {
+            return Err(TrySendError::Full(message));
+        }
+        self.send(message)
+            .map_err(|SendError(message)| TrySendError::Disconnected(message))
+    }
+
+    /// Queue a message whether or not the subscriber keeps up
+    fn send(&self, message: EncodedMessage) -> Result<(), SendError<EncodedMessage>> {
+        let frame = is_frame(message.msg_type);
+        if frame {
+            self.frames.fetch_add(1, Ordering::Relaxed);
+        }
+        let result = self.messages.send(message);
+        if frame && result.is_err() {
+            self.frames.fetch_sub(1, Ordering::Relaxed);
+        }
+        result
+    }
+}
+
+/// Whether a message is a whole frame, which a slow subscriber can miss
+fn is_frame(msg_type: MessageType) -> bool {
+    matches!(
+        msg_type,
+        MessageType::MeshFrame
+            | MessageType::ColumnarFrame
+            | MessageType::VolumeFrame
+            | MessageType::PointFrame
+    )
+}
+
+/// Subscribers and cache, locked together so a joining subscriber sees
+/// every message exactly once: either in its replay or through its queue
+struct RelayState {
+    subscribers: Vec<Subscriber>,
+    cache: FrameCache,
+}
+
+/// State shared between the relay loop and its handles
+struct RelayShared {
+    state: Mutex<RelayState>,
+    /// Connection to the current upstream sender, for requests passed on
+    /// from subscribers
+    upstream: Mutex<Option<TcpStream>>,
+    messages_received: AtomicU64,
+    frames_relayed: AtomicU64,
+    bytes_relayed: AtomicU64,
+    messages_dropped: AtomicU64,
+    subscribers_lost: AtomicU64,
+}
+
+impl RelayShared {
+    fn new(cache_frames: usize) -> Self {
+        Self {
+            state: Mutex::new(RelayState {
+                subscribers: Vec::new(),
+                cache: FrameCache::new(cache_frames),
+            }),
+            upstream: Mutex::new(None),
+            messages_received: AtomicU64::new(0),
+            frames_relayed: AtomicU64::new(0),
+            bytes_relayed: AtomicU64::new(0),
+            messages_dropped: AtomicU64::new(0),
+            subscribers_lost: AtomicU64::new(0),
+        }
+    }
+
+    /// Queue a message for every subscriber, dropping frames for those
+    /// that fell behind
+    fn broadcast(&self, message: &EncodedMessage) {
+        let mut state = self.state.lock().unwrap();
+        state.cache.record(message);
+
+        state.subscribers.retain_mut(|subscriber| {
+            match subscriber.queue.try_send(message.clone()) {
+                Ok(()) => {
+                    self.bytes_relayed
+                        .fetch_add(message.size() as u64, Ordering::Relaxed);
+                    true
+                }
+                Err(TrySendError::Full(_)) => {
+                    if subscriber.dropped == 0 {
+                        warn!(
+                            "Subscriber {} is falling behind, dropping frames",
+                            subscriber.addr
+                        );
+                    }
+                    subscriber.dropped += 1;
+                    self.messages_dropped.fetch_add(1, Ordering::Relaxed);
+                    true
+                }
+                Err(TrySendError::Disconnected(_)) => {
+                    info!(
+                        "Subscriber {} disconnected ({} messages dropped)",
+                        subscriber.addr, subscriber.dropped
+                    );
+                    self.subscribers_lost.fetch_add(1, Ordering::Relaxed);
+                    false
+                }
+            }
+        });
+
+        if message.msg_type == MessageType::MeshFrame {
+            self.frames_relayed.fetch_add(1, Ordering::Relaxed);
+        }
+    }
+}
+
+/// Handle for managing subscribers while the relay is running
+#[derive(Clone)]
+pub struct RelayHandle {
+    shared: Arc<RelayShared>,
+    config: RelayConfig,
+}
+
+impl RelayHandle {
+    /// Connect to a downstream receiver and start forwarding to it
+    pub fn add_subscriber<A: ToSocketAddrs>(&self, addr: A) -> Result<SocketAddr, RelayError> {
+        let socket_addr = addr
+            .to_socket_addrs()?
+            .next()
+            .ok_or_else(|| RelayError::InvalidAddress("No valid address".to_string()))?;
+
+        let stream = match self.config.connect_timeout {
+            Some(timeout) => TcpStream::connect_timeout(&socket_addr, timeout)?,
+            None => TcpStream::connect(socket_addr)?,
+        };
+        stream.set_nodelay(self.config.tcp_nodelay)?;
+        if let Some(timeout) = self.config.write_timeout {
+            stream.set_write_timeout(Some(timeout))?;
+        }
+
+        let (queue, messages, frames) = SubscriberQueue::new(self.config.queue_depth);
+
+        // Range requests arrive on the same connection
+        let requests = stream.try_clone()?;
+        let shared = Arc::clone(&self.shared);
+        let request_queue = queue.clone();
+        let max_message_size = self.config.max_message_size;
+        thread::Builder::new()
+            .name(format!("relay-requests-{socket_addr}"))
+            .spawn(move || {
+                serve_requests(
+                    requests,
+                    socket_addr,
+                    shared,
+                    request_queue,
+                    max_message_size,
+                )
+            })?;
+
+        let mut state = self.shared.state.lock().unwrap();
+        let replay = state.cache.replay();
+        debug!(
+            "Replaying {} cached messages to {}",
+            replay.len(),
+            socket_addr
+        );
+        thread::Builder::new()
+            .name(format!("relay-{socket_addr}"))
+            .spawn(move || write_subscriber(stream, socket_addr, replay, messages, frames))?;
+
+        state.subscribers.push(Subscriber {
+            addr: socket_addr,
+            queue,
+            dropped: 0,
+        });
+        drop(state);
+
+        info!("Added relay subscriber {}", socket_addr);
+        Ok(socket_addr)
+    }
+
+    /// Number of subscribers currently attached
+    pub fn subscriber_count(&self) -> usize {
+        self.shared.state.lock().unwrap().subscribers.len()
+    }
+
+    /// Lowest and highest frame numbers currently cached
+    pub fn cached_frame_range(&self) -> Option<(u32, u32)> {
+        self.shared.state.lock().unwrap().cache.frame_range()
+    }
+
+    /// Get statistics about relayed data
+    pub fn stats(&self) -> RelayStats {
+        RelayStats {
+            messages_received: self.shared.messages_received.load(Ordering::Relaxed),
+            frames_relayed: self.shared.frames_relayed.load(Ordering::Relaxed),
+            bytes_relayed: self.shared.bytes_relayed.load(Ordering::Relaxed),
+            messages_dropped: self.shared.messages_dropped.load(Ordering::Relaxed),
+            subscribers: self.subscriber_count(),
+            cached_frames: self.shared.state.lock().unwrap().cache.len(),
+            subscribers_lost: self.shared.subscribers_lost.load(Ordering::Relaxed),
+        }
+    }
+}
+
+/// Relay that serves one upstream sender to many downstream receivers
+pub struct MeshRelay {
+    listener: TcpListener,
+    protocol: Protocol,
+    handle: RelayHandle,
+}
+
+impl MeshRelay {
+    /// Create a relay accepting the upstream sender on the specified address
+    pub fn bind<A: ToSocketAddrs>(addr: A) -> Result<Self, RelayError> {
+        Self::bind_with_config(addr, RelayConfig::default())
+    }
+
+    /// Create a relay with custom configuration
+    pub fn bind_with_config<A: ToSocketAddrs>(
+        addr: A,
+        config: RelayConfig,
+    ) -> Result<Self, RelayError> {
+        let listener = TcpListener::bind(addr)
+            .map_err(|e| RelayError::Bind(format!("Failed to bind: {e}")))?;
+
+        info!("Mesh relay listening on {}", listener.local_addr()?);
+
+        let protocol = Protocol::default().with_max_message_size(config.max_message_size);
+
+        Ok(Self {
+            listener,
+            protocol,
+            handle: RelayHandle {
+                shared: Arc::new(RelayShared::new(config.cache_frames)),
+                config,
+            },
+        })
+    }
+
+    /// Get the address upstream senders should connect to
+    pub fn local_addr(&self) -> Result<SocketAddr, RelayError> {
+        Ok(self.listener.local_addr()?)
+    }
+
+    /// Get a handle for adding subscribers and reading statistics
+    pub fn handle(&self) -> RelayHandle {
+        self.handle.clone()
+    }
+
+    /// Accept one upstream connection and relay it until it ends
+    pub fn relay_one(&mut self) -> Result<(), RelayError> {
+        let (mut stream, addr) = self.listener.accept()?;
+        info!("Accepted upstream connection from {}", addr);
+
+        stream.set_nodelay(self.handle.config.tcp_nodelay)?;
+        stream.set_read_timeout(self.handle.config.read_timeout)?;
+
+        *self.handle.shared.upstream.lock().unwrap() = Some(stream.try_clone()?);
+        let result = self.relay_stream(&mut stream, addr);
+        *self.handle.shared.upstream.lock().unwrap() = None;
+        result
+    }
+
+    /// Relay messages from one upstream connection until it ends
+    fn relay_stream(&self, stream: &mut TcpStream, addr: SocketAddr) -> Result<(), RelayError> {
+        let shared = &self.handle.shared;
+        loop {
+            let message = match self.protocol.read_encoded(stream) {
+                Ok(message) => message,
+                Err(ProtocolError::Io(e)) if e.kind() == std::io::ErrorKind::UnexpectedEof => {
+                    info!("Upstream {} disconnected", addr);
+                    return Ok(());
+                }
+                Err(e) => return Err(e.into()),
+            };
+
+            trace!(
+                "Relaying {:?} ({} bytes) from {}",
+                message.msg_type,
+                message.size(),
+                addr
+            );
+            shared.messages_received.fetch_add(1, Ordering::Relaxed);
+
+            // Subscribers stay attached across upstream sessions, so the
+            // end-of-stream marker is not forwarded
+            if message.msg_type == MessageType::EndOfStream {
+                info!("Upstream {} ended its stream", addr);
+                return Ok(());
+            }
+
+            // Frames are forwarded as received, so only the plain format
+            // every viewer decodes is offered
+            if message.msg_type == MessageType::Hello {
+                let capabilities = Capabilities {
+                    encodings: vec![FrameEncoding::from(WireFormat::default()) as u8],
+                    ..Capabilities::new(
+                        WireFormat::default(),
+                        self.handle.config.max_message_size,
+                        0,
+                    )
+                };
+                handshake::answer_hello(&self.protocol, &capabilities, stream, message.payload())?;
+                continue;
+            }
+
+            shared.broadcast(&message);
+        }
+    }
+
+    /// Relay upstream connections one after another, forever
+    pub fn run(&mut self) -> Result<(), RelayError> {
+        info!("Starting mesh relay loop");
+
+        loop {
+            if let Err(e) = self.relay_one() {
+                error!("Error relaying upstream: {}", e);
+            }
+
+            let stats = self.handle.stats();
+            info!(
+                "Relayed {} frames to {} subscribers ({} dropped)",
+                stats.frames_relayed, stats.subscribers, stats.messages_dropped
+            );
+        }
+    }
+
+    /// Start the relay in a background thread
+    pub fn run_async(mut self) -> (RelayHandle, thread::JoinHandle<()>) {
+        let handle = self.handle();
+        let thread = thread::spawn(move || {
+            let _ = self.run();
+        });
+        (handle, thread)
+    }
+}
+
+/// Replay cached messages, then drain one subscriber's queue onto its connection
+fn write_subscriber(
+    mut stream: TcpStream,
+    addr: SocketAddr,
+    replay: Vec<EncodedMessage>,
+    messages: Receiver<EncodedMessage>,
+    frames: Arc<AtomicUsize>,
+) {
+    let protocol = Protocol::default();
+
+    for message in replay {
+        if let Err(e) = protocol.write_encoded(&mut stream, &message) {
+            warn!("Failed to write to subscriber {}: {}", addr, e);
+            return;
+        }
+    }
+    for message in messages {
+        let written = protocol.write_encoded(&mut stream, &message);
+        if is_frame(message.msg_type) {
+            frames.fetch_sub(1, Ordering::Relaxed);
+        }
+        if let Err(e) = written {
+            warn!("Failed to write to subscriber {}: {}", addr, e);
+            return;
+        }
+    }
+
+    debug!("Relay writer for {} finished", addr);
+}
+
+/// Handle requests from one subscriber
+///
+/// Frame range requests are answered out of the cache, through the
+/// subscriber's own queue; replies are never dropped. Requests for full
+/// resolution go on to the upstream sender. Region of interest
+/// subscriptions and rate limits are refused with a warning, since they
+/// would change the stream for every subscriber.
+fn serve_requests(
+    mut stream: TcpStream,
+    addr: SocketAddr,
+    shared: Arc<RelayShared>,
+    queue: SubscriberQueue,
+    max_message_size: usize,
+) {
+    let protocol = Protocol::default().with_max_message_size(max_message_size);
+
+    loop {
+        let message = match protocol.read_message(&mut stream) {
+            Ok(message) => message,
+            Err(e) => {
+                debug!("Request reader for {} finished: {}", addr, e);
+                return;
+            }
+        };
+
+        match message.msg_type {
+            MessageType::FrameRangeRequest => {}
+            MessageType::FullResolutionRequest => {
+                forward_upstream(&shared, &protocol, &message, addr);
+                continue;
+            }
+            MessageType::RegionOfInterest | MessageType::RateLimit => {
+                warn!(
+                    "Refusing {:?} from subscriber {}: a relay sends every subscriber the same stream",
+                    message.msg_type, addr
+                );
+                continue;
+            }
+            other => {
+                warn!("Ignoring unexpected {:?} from subscriber {}", other, addr);
+                continue;
+            }
+        }
+
+        let request = match protocol.deserialize_frame_range_request(&message.payload) {
+            Ok(request) => request,
+            Err(e) => {
+                warn!("Invalid frame range request from {}: {}", addr, e);
+                continue;
+            }
+        };
+
+        let frames = shared.state.lock().unwrap().cache.frames_in(&request);
+        debug!(
+            "Subscriber {} requested frames {}..={}, {} cached",
+            addr,
+            request.first,
+            request.last,
+            frames.len()
+        );
+        for frame in frames {
+            if queue.send(frame).is_err() {
+                return;
+            }
+        }
+    }
+}
+
+/// Pass a subscriber's request on to the upstream sender, if one is
+/// connected
+fn forward_upstream(
+    shared: &RelayShared,
+    protocol: &Protocol,
+    message: &NetworkMessage,
+    addr: SocketAddr,
+) {
+    let mut upstream = shared.upstream.lock().unwrap();
+    let Some(stream) = upstream.as_mut() else {
+        debug!("No upstream for {:?} from {}", message.msg_type, addr);
+        return;
+    };
+    match protocol.write_message(stream, message) {
+        Ok(()) => debug!("Forwarded {:?} from {} upstream", message.msg_type, addr),
+        Err(e) => warn!(
+            "Failed to forward {:?} from {}: {}",
+            message.msg_type, addr, e
+        ),
+    }
+}
+
+/// Statistics about relayed data
+#[derive(Debug, Clone, Copy)]
+pub struct RelayStats {
+    /// Messages read from upstream
+    pub messages_received: u64,
+    /// Mesh frames forwarded
+    pub frames_relayed: u64,
+    /// Bytes queued across all subscribers
+    pub bytes_relayed: u64,
+    /// Frames dropped for slow subscribers
+    pub messages_dropped: u64,
+    /// Subscribers currently attached
+    pub subscribers: usize,
+    /// Frames held in the late-join cache
+    pub cached_frames: usize,
+    /// Subscribers that disconnected
+    pub subscribers_lost: u64,
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::types::MeshFrame;
+
+    fn encoded_frame(frame_number: u32) -> EncodedMessage {
+        let mut mesh = MeshFrame::new("relay".to_string(), frame_number);
+        mesh.vertices = vec![0.0; 9];
+        let message = Protocol::default().serialize_mesh(&mesh).unwrap();
+        EncodedMessage::from_message(&message)
+    }
+
+    fn attach(shared: &RelayShared, depth: usize) -> Receiver<EncodedMessage> {
+        let (queue, messages, _) = SubscriberQueue::new(depth);
+        shared.state.lock().unwrap().subscribers.push(Subscriber {
+            addr: "127.0.0.1:1".parse().unwrap(),
+            queue,
+            dropped: 0,
+        });
+        messages
+    }
+
+    #[test]
+    fn test_broadcast_shares_encoding() {
+        let shared = RelayShared::new(0);
+        let a = attach(&shared, 4);
+        let b = attach(&shared, 4);
+
+        let message = encoded_frame(1);
+        shared.broadcast(&message);
+
+        let from_a = a.try_recv().unwrap();
+        let from_b = b.try_recv().unwrap();
+        assert!(Arc::ptr_eq(&from_a.bytes, &message.bytes));
+        assert!(Arc::ptr_eq(&from_b.bytes, &message.bytes));
+        assert_eq!(shared.frames_relayed.load(Ordering::Relaxed), 1);
+    }
+
+    #[test]
+    fn test_slow_subscriber_drops() {
+        let shared = RelayShared::new(0);
+        let slow = attach(&shared, 1);
+        let fast = attach(&shared, 8);
+
+        for i in 0..4 {
+            shared.broadcast(&encoded_frame(i));
+        }
+
+        // The fast subscriber saw everything, the slow one only the first
+        assert_eq!(fast.try_iter().count(), 4);
+        assert_eq!(slow.try_iter().count(), 1);
+        assert_eq!(shared.messages_dropped.load(Ordering::Relaxed), 3);
+        assert_eq!(shared.state.lock().unwrap().subscribers.len(), 2);
+    }
+
+    #[test]
+    fn test_slow_subscriber_keeps_control_messages() {
+        let shared = RelayShared::new(0);
+        let slow = attach(&shared, 1);
+
+        let metadata = EncodedMessage::from_message(&NetworkMessage::new(
+            MessageType::Metadata,
+            b"meta".to_vec(),
+        ));
+        shared.broadcast(&encoded_frame(0));
+        shared.broadcast(&encoded_frame(1));
+        shared.broadcast(&metadata);
+
+        // The second frame gave way, the metadata behind it did not
+        let types: Vec<_> = slow.try_iter().map(|message| message.msg_type).collect();
+        assert_eq!(types, vec![MessageType::MeshFrame, MessageType::Metadata]);
+        assert_eq!(shared.messages_dropped.load(Ordering::Relaxed), 1);
+    }
+
+    #[test]
+    fn test_disconnected_subscriber_removed() {
+        let shared = RelayShared::new(0);
+        drop(attach(&shared, 4));
+        let _kept = attach(&shared, 4);
+
+        shared.broadcast(&encoded_frame(0));
+
+        assert_eq!(shared.state.lock().unwrap().subscribers.len(), 1);
+        assert_eq!(shared.subscribers_lost.load(Ordering::Relaxed), 1);
+    }
+}
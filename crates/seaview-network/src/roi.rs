@@ -0,0 +1,358 @@
+//! Viewer-driven region-of-interest subscriptions
+//!
+//! A viewer zoomed into part of a surface only needs the triangles it can
+//! see. It sends the sender a [`RegionOfInterest`] (an axis-aligned box or
+//! a view frustum, plus an optional triangle budget) over the existing
+//! connection, and the sender [`clip`]s every frame against it before
+//! serialization. Sending `None` goes back to complete frames.
+//!
+//! Clipping bins triangles into a coarse grid by centroid on worker
+//! threads. Whole bins inside or outside the region are kept or dropped in
+//! one go, and only triangles in bins straddling its boundary are tested
+//! one by one. A triangle is kept when its bounding box touches the region,
+//! so clipping errs on the side of sending too much.
+
+use crate::lod::{self, LodTarget};
+use crate::protocol::{MessageType, NetworkMessage, ProtocolError};
+use crate::types::MeshFrame;
+
+use serde::{Deserialize, Serialize};
+
+/// Bins along each axis of the clipping grid
+const BINS: usize = 16;
+
+/// A region of space
+#[derive(Debug, Clone, Copy, PartialEq, Serialize, Deserialize)]
+pub enum Region {
+    /// Axis-aligned box
+    Aabb { min: [f32; 3], max: [f32; 3] },
+    /// Convex volume bounded by planes `(a, b, c, d)`; a point is inside
+    /// when `a * x + b * y + c * z + d >= 0` for every plane
+    Frustum { planes: [[f32; 4]; 6] },
+}
+
+/// Where a box lies relative to a region
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum Overlap {
+    Outside,
+    Partial,
+    Inside,
+}
+
+impl Region {
+    /// Frustum of a column-major view-projection matrix
+    ///
+    /// The planes are extracted for clip-space depth in `-w..=w`, which
+    /// also contains the `0..=w` and reversed-depth conventions.
+    pub fn from_view_projection(matrix: [f32; 16]) -> Self {
+        let row = |i: usize| [matrix[i], matrix[4 + i], matrix[8 + i], matrix[12 + i]];
+        let (x, y, z, w) = (row(0), row(1), row(2), row(3));
+        let add = |a: [f32; 4], b: [f32; 4]| [a[0] + b[0], a[1] + b[1], a[2] + b[2], a[3] + b[3]];
+        let sub = |a: [f32; 4], b: [f32; 4]| [a[0] - b[0], a[1] - b[1], a[2] - b[2], a[3] - b[3]];
+
+        Region::Frustum {
+            planes: [
+                add(w, x),
+                sub(w, x),
+                add(w, y),
+                sub(w, y),
+                add(w, z),
+                sub(w, z),
+            ],
+        }
+    }
+
+    /// Classify a box against the region
+    fn overlap(&self, min: [f32; 3], max: [f32; 3]) -> Overlap {
+        match self {
+            Region::Aabb {
+                min: region_min,
+                max: region_max,
+            } => {
+                if (0..3).any(|axis| max[axis] < region_min[axis] || min[axis] > region_max[axis]) {
+                    Overlap::Outside
+                } else if (0..3)
+                    .all(|axis| min[axis] >= region_min[axis] && max[axis] <= region_max[axis])
+                {
+                    Overlap::Inside
+                } else {
+                    Overlap::Partial
+                }
+            }
+            Region::Frustum { planes } => {
+                let mut overlap = Overlap::Inside;
+                for plane in planes {
+                    // Corners furthest along and against the plane normal
+                    let (mut near, mut far) = (plane[3], plane[3]);
+                    for axis in 0..3 {
+                        let (low, high) = (plane[axis] * min[axis], plane[axis] * max[axis]);
+                        near += low.min(high);
+                        far += low.max(high);
+                    }
+                    if far < 0.0 {
+                        return Overlap::Outside;
+                    }
+                    if near < 0.0 {
+                        overlap = Overlap::Partial;
+                    }
+                }
+                overlap
+            }
+        }
+    }
+}
+
+/// What a viewer wants to receive
+#[derive(Debug, Clone, Copy, PartialEq, Serialize, Deserialize)]
+pub struct RegionOfInterest {
+    /// Only triangles touching this region are sent
+    pub region: Region,
+    /// Decimate what is left to about this many triangles (0 = no limit)
+    pub triangle_budget: u32,
+}
+
+impl RegionOfInterest {
+    /// Region without a triangle budget
+    pub fn new(region: Region) -> Self {
+        Self {
+            region,
+            triangle_budget: 0,
+        }
+    }
+}
+
+/// Create the message setting (or with `None`, clearing) a subscription
+pub fn create_message(roi: Option<&RegionOfInterest>) -> Result<NetworkMessage, ProtocolError> {
+    Ok(NetworkMessage::new(
+        MessageType::RegionOfInterest,
+        bincode::serialize(&roi)?,
+    ))
+}
+
+/// Parse a subscription message payload
+pub fn parse_message(payload: &[u8]) -> Result<Option<RegionOfInterest>, ProtocolError> {
+    Ok(bincode::deserialize(payload)?)
+}
+
+/// Keep the triangles of a frame that touch the region of interest
+///
+/// Returns an indexed frame holding only the vertices those triangles use,
+/// decimated to the triangle budget if one is set.
+pub fn clip(mesh: &MeshFrame, roi: &RegionOfInterest, workers: usize) -> MeshFrame {
+    let workers = workers.max(1);
+    let Some((origin, upper)) = lod::bounds(&mesh.vertices, workers) else {
+        return mesh.clone();
+    };
+
+    let position = |vertex: usize| {
+        let start = vertex * 3;
+        [
+            mesh.vertices[start],
+            mesh.vertices[start + 1],
+            mesh.vertices[start + 2],
+        ]
+    };
+    let corner = |triangle: usize, corner: usize| match &mesh.indices {
+        Some(indices) => indices[triangle * 3 + corner] as usize,
+        None => triangle * 3 + corner,
+    };
+    let triangle_bounds = |triangle: usize| {
+        let mut min = [f32::INFINITY; 3];
+        let mut max = [f32::NEG_INFINITY; 3];
+        for vertex in 0..3 {
+            let position = position(corner(triangle, vertex));
+            for axis in 0..3 {
+                min[axis] = min[axis].min(position[axis]);
+                max[axis] = max[axis].max(position[axis]);
+            }
+        }
+        (min, max)
+    };
+    let scale: [f32; 3] = std::array::from_fn(|axis| {
+        let extent = upper[axis] - origin[axis];
+        if extent > 0.0 {
+            BINS as f32 / extent
+        } else {
+            0.0
+        }
+    });
+
+    // Bin every triangle by centroid and grow each bin to fit its triangles
+    let binned = lod::parallel_ranges(mesh.triangle_count(), workers, |range| {
+        let mut bin_bounds = vec![([f32::INFINITY; 3], [f32::NEG_INFINITY; 3]); BINS * BINS * BINS];
+        let bins: Vec<u16> = range
+            .map(|triangle| {
+                let (min, max) = triangle_bounds(triangle);
+                let bin = (0..3).fold(0, |bin, axis| {
+                    let centroid = (min[axis] + max[axis]) * 0.5;
+                    let cell = ((centroid - origin[axis]) * scale[axis]) as usize;
+                    bin * BINS + cell.min(BINS - 1)
+                });
+                let bounds = &mut bin_bounds[bin];
+                for axis in 0..3 {
+                    bounds.0[axis] = bounds.0[axis].min(min[axis]);
+                    bounds.1[axis] = bounds.1[axis].max(max[axis]);
+                }
+                bin as u16
+            })
+            .collect();
+        (bins, bin_bounds)
+    });
+
+    let mut bin_bounds = vec![([f32::INFINITY; 3], [f32::NEG_INFINITY; 3]); BINS * BINS * BINS];
+    for (_, partial) in &binned {
+        for (bounds, partial) in bin_bounds.iter_mut().zip(partial) {
+            for axis in 0..3 {
+                bounds.0[axis] = bounds.0[axis].min(partial.0[axis]);
+                bounds.1[axis] = bounds.1[axis].max(partial.1[axis]);
+            }
+        }
+    }
+    let overlaps: Vec<Overlap> = bin_bounds
+        .iter()
+        .map(|&(min, max)| {
+            if min[0] > max[0] {
+                Overlap::Outside
+            } else {
+                roi.region.overlap(min, max)
+            }
+        })
+        .collect();
+
+    // Only triangles in bins on the boundary need a test of their own
+    let chunk = mesh.triangle_count().div_ceil(workers).max(1);
+    let kept: Vec<u32> = lod::parallel_ranges(binned.len(), workers, |range| {
+        let mut kept = Vec::new();
+        for (index, (bins, _)) in binned[range.clone()].iter().enumerate() {
+            let first = (range.start + index) * chunk;
+            for (triangle, &bin) in (first..).zip(bins) {
+                let keep = match overlaps[bin as usize] {
+                    Overlap::Inside => true,
+                    Overlap::Outside => false,
+                    Overlap::Partial => {
+                        let (min, max) = triangle_bounds(triangle);
+                        roi.region.overlap(min, max) != Overlap::Outside
+                    }
+                };
+                if keep {
+                    kept.push(triangle as u32);
+                }
+            }
+        }
+        kept
+    })
+    .concat();
+
+    // Compact the vertices the kept triangles use
+    let mut remap = vec![u32::MAX; mesh.vertex_count()];
+    let mut vertices = Vec::new();
+    let mut normals = mesh.normals.as_ref().map(|_| Vec::new());
+    let mut indices = Vec::with_capacity(kept.len() * 3);
+    for &triangle in &kept {
+        for vertex in 0..3 {
+            let vertex = corner(triangle as usize, vertex);
+            if remap[vertex] == u32::MAX {
+                remap[vertex] = (vertices.len() / 3) as u32;
+                vertices.extend_from_slice(&mesh.vertices[vertex * 3..vertex * 3 + 3]);
+                if let (Some(normals), Some(source)) = (normals.as_mut(), &mesh.normals) {
+                    normals.extend_from_slice(&source[vertex * 3..vertex * 3 + 3]);
+                }
+            }
+            indices.push(remap[vertex]);
+        }
+    }
+
+    let clipped = MeshFrame {
+        simulation_id: mesh.simulation_id.clone(),
+        frame_number: mesh.frame_number,
+        timestamp: mesh.timestamp,
+        domain_bounds: mesh.domain_bounds.clone(),
+        vertices,
+        normals,
+        indices: Some(indices),
+    };
+
+    let budget = roi.triangle_budget as usize;
+    if budget > 0 && kept.len() > budget {
+        let ratio = budget as f32 / kept.len() as f32;
+        lod::simplify(&clipped, LodTarget::Ratio(ratio), workers)
+    } else {
+        clipped
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// A flat `n` x `n` quad grid over `0..n` in x and y
+    fn grid(n: u32) -> MeshFrame {
+        let mut mesh = MeshFrame::new("grid".to_string(), 3);
+        for y in 0..=n {
+            for x in 0..=n {
+                mesh.vertices.extend([x as f32, y as f32, 0.0]);
+            }
+        }
+        let row = n + 1;
+        mesh.indices = Some(
+            (0..n)
+                .flat_map(|y| (0..n).map(move |x| y * row + x))
+                .flat_map(|c| [c, c + 1, c + row, c + 1, c + row + 1, c + row])
+                .collect(),
+        );
+        mesh
+    }
+
+    #[test]
+    fn test_clip_to_box_and_budget() {
+        let mesh = grid(100);
+        let roi = RegionOfInterest::new(Region::Aabb {
+            min: [10.0, 10.0, -1.0],
+            max: [29.5, 29.5, 1.0],
+        });
+
+        let clipped = clip(&mesh, &roi, 4);
+        assert!(clipped.validate().is_ok());
+        assert_eq!(clipped.frame_number, 3);
+        // Quads 9..=29 touch the box along each axis
+        assert_eq!(clipped.triangle_count(), 21 * 21 * 2);
+        assert_eq!(clipped.vertex_count(), 22 * 22);
+
+        let budgeted = clip(
+            &mesh,
+            &RegionOfInterest {
+                triangle_budget: 100,
+                ..roi
+            },
+            4,
+        );
+        assert!(budgeted.triangle_count() <= 125);
+        assert!(budgeted.triangle_count() > 0);
+
+        let message = create_message(Some(&roi)).unwrap();
+        assert_eq!(parse_message(&message.payload).unwrap(), Some(roi));
+    }
+
+    #[test]
+    fn test_clip_to_frustum() {
+        // Orthographic projection of x in -0.5..=20.5, y in 49.5..=99.5
+        let (l, r, b, t, n, f) = (-0.5f32, 20.5f32, 49.5f32, 99.5f32, -1.0f32, 1.0f32);
+        #[rustfmt::skip]
+        let projection = [
+            2.0 / (r - l), 0.0, 0.0, 0.0,
+            0.0, 2.0 / (t - b), 0.0, 0.0,
+            0.0, 0.0, -2.0 / (f - n), 0.0,
+            -(r + l) / (r - l), -(t + b) / (t - b), -(f + n) / (f - n), 1.0,
+        ];
+
+        let clipped = clip(
+            &grid(100),
+            &RegionOfInterest::new(Region::from_view_projection(projection)),
+            3,
+        );
+        assert_eq!(clipped.triangle_count(), 21 * 51 * 2);
+        for vertex in clipped.vertices.chunks_exact(3) {
+            assert!(vertex[0] <= 21.0 && vertex[1] >= 49.0);
+        }
+    }
+}
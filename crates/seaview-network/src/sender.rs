@@ -1,12 +1,67 @@
 //! Network sender for streaming mesh data
+//!
+//! Messages are written by a background thread. While the connection is up,
+//! sending waits once a couple of frames are queued, so a slow receiver
+//! slows the sender down and write errors reach the caller. When the
+//! connection drops, the writer reconnects with exponential backoff and
+//! sending stops waiting, so the simulation never blocks on a missing
+//! viewer. Frames sent meanwhile can be kept in a replay buffer bounded in
+//! frames and bytes (see [`ReconnectConfig`]) and are written once the
+//! receiver has answered the hello on the new connection. Frames that do
+//! not fit are counted as dropped; by default none are kept.
+//!
+//! Each connection starts with a capability hello (see [`crate::handshake`]).
+//! Frames go out in the configured format until the receiver answers, then
+//! in the fastest encoding both sides support.
+//!
+//! With a [`LodConfig`] the sender ships simplified frames and full
+//! resolution only every Nth frame, on [`request_full_resolution`], or when
+//! the receiver asks for it.
+//!
+//! [`request_full_resolution`]: MeshSender::request_full_resolution
+//!
+//! With a [`ProgressiveConfig`] large frames are preceded by coarse levels
+//! (see [`crate::progressive`]). A receiver that subscribed to a region of
+//! interest (see [`crate::roi`]) only gets the part of each frame inside it.
+//! Frames beyond the configured or advertised [`RateLimit`] are skipped
+//! before any work is done on them. With a [`DeltaConfig`] frames that
+//! only changed in places go out as partial updates (see [`crate::delta`]);
+//! those are never replayed, a new connection starts from a full frame.
+//! Volume frames (see [`crate::volume`]) go to receivers that extract the
+//! surface themselves; for others the sender extracts it. Point frames
+//! (see [`crate::points`]) only go to receivers that agreed to them.
 
-use crate::protocol::{Protocol, ProtocolError, WireFormat};
+use crate::columnar;
+use crate::delta::{DeltaConfig, DeltaEncoder};
+use crate::handshake::{
+    self, Capabilities, FrameEncoding, Negotiated, FEATURE_COMPACT_INDICES,
+    FEATURE_PARTIAL_UPDATES, FEATURE_POINT_FRAMES, FEATURE_PROGRESSIVE, FEATURE_STRIPING,
+    FEATURE_VOLUME_FRAMES,
+};
+use crate::indices::IndexCompression;
+use crate::lod::{self, LodConfig};
+use crate::points::PointFrame;
+use crate::progressive::{CoarseLevel, ProgressiveConfig};
+use crate::protocol::{EncodedMessage, MessageType, Protocol, ProtocolError, WireFormat};
+use crate::rate::{self, RateLimit, RateLimiter};
+use crate::receiver::has_pending_data;
+use crate::roi::{self, RegionOfInterest};
+use crate::stripe::{self, StripeJoin, StripeSetup};
 use crate::types::MeshFrame;
+use crate::uring::{self, IoBackend, UringStream};
+use crate::volume::VolumeFrame;
+use crate::zerocopy::{self, ZeroCopy};
+use std::borrow::Cow;
+use std::collections::VecDeque;
 use std::io::Write;
-use std::net::{TcpStream, ToSocketAddrs};
-use std::time::Duration;
+use std::net::{SocketAddr, TcpStream, ToSocketAddrs};
+use std::ops::Range;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, Condvar, Mutex, MutexGuard};
+use std::thread::{self, JoinHandle};
+use std::time::{Duration, Instant};
 use thiserror::Error;
-use tracing::{debug, error, info, trace};
+use tracing::{debug, error, info, trace, warn};
 
 /// Errors that can occur during network operations
 #[derive(Error, Debug)]
@@ -30,10 +85,12 @@ pub enum NetworkError {
 /// Configuration for the mesh sender
 #[derive(Debug, Clone)]
 pub struct SenderConfig {
-    /// Wire format to use
+    /// Wire format to use until (or unless) a faster encoding is negotiated
     pub format: WireFormat,
     /// Maximum message size in bytes
     pub max_message_size: usize,
+    /// Advertise capabilities and negotiate the frame encoding
+    pub negotiate: bool,
     /// TCP no-delay setting
     pub tcp_nodelay: bool,
     /// Send buffer size
@@ -42,6 +99,30 @@ pub struct SenderConfig {
     pub connect_timeout: Option<Duration>,
     /// Write timeout
     pub write_timeout: Option<Duration>,
+    /// Automatic reconnect after a write error, `None` to fail instead
+    pub reconnect: Option<ReconnectConfig>,
+    /// Parallel connections to stripe large frames across (1 disables)
+    pub stripes: usize,
+    /// Frame payloads at least this large are striped
+    pub stripe_threshold: usize,
+    /// Socket I/O backend for the primary connection
+    pub io_backend: IoBackend,
+    /// Send messages at least this large with `MSG_ZEROCOPY` (Linux, needs
+    /// the `zerocopy` feature); `None` disables
+    pub zerocopy_threshold: Option<usize>,
+    /// Stream simplified frames with periodic full resolution; `None`
+    /// always sends full resolution
+    pub lod: Option<LodConfig>,
+    /// Send coarse levels ahead of large frames; `None` sends every frame
+    /// in one piece
+    pub progressive: Option<ProgressiveConfig>,
+    /// Skip frames beyond this limit; receivers can advertise a stricter one
+    pub rate_limit: Option<RateLimit>,
+    /// Send frames that only changed in places as partial updates; `None`
+    /// always sends whole frames
+    pub partial_updates: Option<DeltaConfig>,
+    /// Index encoding of columnar frames, for receivers that decode it
+    pub index_compression: IndexCompression,
 }
 
 impl Default for SenderConfig {
@@ -49,21 +130,639 @@ impl Default for SenderConfig {
         Self {
             format: WireFormat::default(),
             max_message_size: 100 * 1024 * 1024, // 100MB
+            negotiate: true,
             tcp_nodelay: true,
             send_buffer_size: Some(1024 * 1024), // 1MB
             connect_timeout: Some(Duration::from_secs(10)),
             write_timeout: Some(Duration::from_secs(30)),
+            reconnect: Some(ReconnectConfig::default()),
+            stripes: 1,
+            stripe_threshold: 8 * 1024 * 1024, // 8MB
+            io_backend: IoBackend::default(),
+            zerocopy_threshold: None,
+            lod: None,
+            progressive: None,
+            rate_limit: None,
+            partial_updates: None,
+            index_compression: IndexCompression::default(),
+        }
+    }
+}
+
+impl SenderConfig {
+    /// Capabilities advertised in the hello
+    fn capabilities(&self) -> Capabilities {
+        let mut features = FEATURE_VOLUME_FRAMES | FEATURE_POINT_FRAMES;
+        if self.stripes > 1 {
+            features |= FEATURE_STRIPING;
+        }
+        if self.progressive.is_some() {
+            features |= FEATURE_PROGRESSIVE;
+        }
+        if self.partial_updates.is_some() {
+            features |= FEATURE_PARTIAL_UPDATES;
+        }
+        if self.index_compression != IndexCompression::None {
+            features |= FEATURE_COMPACT_INDICES;
+        }
+        Capabilities::new(self.format, self.max_message_size, features)
+    }
+}
+
+/// Reconnect behaviour of the mesh sender
+#[derive(Debug, Clone)]
+pub struct ReconnectConfig {
+    /// Delay before the first reconnect attempt
+    pub initial_backoff: Duration,
+    /// Upper bound for the doubling backoff
+    pub max_backoff: Duration,
+    /// Most recent frames kept while disconnected and sent once
+    /// reconnected; 0 drops them
+    pub replay_frames: usize,
+    /// Most bytes of frames kept while disconnected
+    pub replay_bytes: usize,
+}
+
+impl Default for ReconnectConfig {
+    fn default() -> Self {
+        Self {
+            initial_backoff: Duration::from_millis(100),
+            max_backoff: Duration::from_secs(5),
+            replay_frames: 0,
+            replay_bytes: 64 * 1024 * 1024, // 64MB
+        }
+    }
+}
+
+/// Frames queued for the writer before sending waits for it
+const QUEUED_FRAMES: usize = 2;
+
+/// How often an idle writer looks for messages from the receiver
+const POLL_INTERVAL: Duration = Duration::from_millis(5);
+
+/// Longest a reconnected writer waits for the answer to its hello before
+/// replaying anyway
+const HELLO_TIMEOUT: Duration = Duration::from_secs(5);
+
+/// What a queued message is, as far as the writer is concerned
+#[derive(Clone)]
+enum Kind {
+    /// A whole frame, kept for replay while disconnected
+    Frame,
+    /// A partial update, only valid on the connection it was encoded for
+    PartialUpdate { generation: u64 },
+    /// A coarse level, written right behind its announcement and only on
+    /// the connection it was encoded for
+    Coarse {
+        announcement: EncodedMessage,
+        generation: u64,
+    },
+    /// Heartbeat or end of stream
+    Control,
+}
+
+impl Kind {
+    /// Counted as a frame in the statistics and the queue bounds
+    fn is_frame(&self) -> bool {
+        matches!(self, Self::Frame | Self::PartialUpdate { .. })
+    }
+
+    /// Connection the message was encoded for, if it only applies there
+    fn generation(&self) -> Option<u64> {
+        match self {
+            Self::PartialUpdate { generation } | Self::Coarse { generation, .. } => {
+                Some(*generation)
+            }
+            Self::Frame | Self::Control => None,
+        }
+    }
+}
+
+/// A message waiting for the writer
+#[derive(Clone)]
+struct Outgoing {
+    seq: u64,
+    message: EncodedMessage,
+    kind: Kind,
+}
+
+/// The writer's view of the current connection
+#[derive(Debug, Clone, Copy, Default)]
+struct PeerState {
+    /// Counts connections, so messages encoded for one are not written to
+    /// the next
+    generation: u64,
+    connected: bool,
+    local_addr: Option<SocketAddr>,
+    /// Settings agreed with the receiver
+    negotiated: Option<Negotiated>,
+    /// The receiver wants its next frame at full resolution
+    full_requested: bool,
+    /// Part of each frame the receiver wants
+    region_of_interest: Option<RegionOfInterest>,
+    /// Most frames the receiver wants
+    rate_limit: Option<RateLimit>,
+}
+
+impl PeerState {
+    /// State of a new connection
+    fn connected(generation: u64, connection: &Connection) -> Self {
+        Self {
+            generation,
+            connected: true,
+            local_addr: connection.primary.local_addr().ok(),
+            // A new viewer starts from a complete frame
+            full_requested: true,
+            ..Self::default()
+        }
+    }
+}
+
+/// Primary stream plus any extra striping streams
+struct Connection {
+    /// Writes to `primary` through io_uring; declared first so it is
+    /// dropped before the stream it borrows
+    uring: Option<UringStream>,
+    /// Zero-copy sends of large messages on `primary`
+    zerocopy: Option<ZeroCopy>,
+    primary: TcpStream,
+    stripes: Vec<TcpStream>,
+    /// Stripes waiting for the receiver to confirm the session
+    pending_stripes: Option<(u64, Vec<TcpStream>)>,
+    stripe_threshold: usize,
+    /// Waiting for the answer to our hello
+    hello_pending: bool,
+    /// Settings agreed with the receiver
+    negotiated: Option<Negotiated>,
+    /// The receiver wants its next frame at full resolution
+    full_requested: bool,
+    /// Part of each frame the receiver wants
+    region_of_interest: Option<RegionOfInterest>,
+    /// Most frames the receiver wants
+    rate_limit: Option<RateLimit>,
+}
+
+impl Connection {
+    /// Connect to the receiver
+    ///
+    /// With `hello` the connection opens with a capability hello and a
+    /// striped session is only set up once the receiver agrees to it;
+    /// without, a configured striped session is set up right away.
+    fn open(peer: SocketAddr, config: &SenderConfig, hello: bool) -> Result<Self, NetworkError> {
+        let primary = open_stream(peer, config)?;
+        let mut connection = Self {
+            uring: uring::attach(config.io_backend, &primary, config.write_timeout),
+            zerocopy: zerocopy::attach(config.zerocopy_threshold, &primary),
+            primary,
+            stripes: Vec::new(),
+            pending_stripes: None,
+            stripe_threshold: config.stripe_threshold,
+            hello_pending: false,
+            negotiated: None,
+            full_requested: false,
+            region_of_interest: None,
+            rate_limit: None,
+        };
+
+        if hello {
+            Protocol::new(config.format)
+                .write_message(&mut connection.primary, &config.capabilities().to_hello()?)?;
+            connection.hello_pending = true;
+        } else if config.stripes > 1 {
+            connection.open_stripes(peer, config)?;
+        }
+
+        Ok(connection)
+    }
+
+    /// Open the extra connections of a striped session
+    ///
+    /// Frames stay on the primary connection until the receiver confirms
+    /// the session.
+    fn open_stripes(
+        &mut self,
+        peer: SocketAddr,
+        config: &SenderConfig,
+    ) -> Result<(), NetworkError> {
+        let protocol = Protocol::new(config.format);
+        let setup = StripeSetup {
+            session_id: stripe::new_session_id(),
+            stripe_count: config.stripes.min(u16::MAX as usize) as u16,
+        };
+
+        // Connect every stripe before announcing the session, so a failure
+        // leaves the primary connection usable on its own
+        let mut stripes = (1..setup.stripe_count)
+            .map(|_| open_stream(peer, config))
+            .collect::<Result<Vec<_>, _>>()?;
+
+        protocol.write_message(
+            &mut self.primary,
+            &stripe::create_message(MessageType::StripeSetup, &setup)?,
+        )?;
+        for (stream, index) in stripes.iter_mut().zip(1..) {
+            let join = StripeJoin {
+                session_id: setup.session_id,
+                index,
+            };
+            protocol.write_message(
+                stream,
+                &stripe::create_message(MessageType::StripeJoin, &join)?,
+            )?;
+        }
+
+        debug!("Opened {} stripes to {}", setup.stripe_count, peer);
+        self.pending_stripes = Some((setup.session_id, stripes));
+        Ok(())
+    }
+
+    /// Apply the receiver's reply to our striped session
+    fn confirm_stripes(&mut self, payload: &[u8], peer: SocketAddr) -> Result<(), NetworkError> {
+        let reply: StripeSetup = stripe::parse_message(payload)?;
+        match self.pending_stripes.take() {
+            Some((session_id, stripes))
+                if session_id == reply.session_id
+                    && reply.stripe_count as usize == stripes.len() + 1 =>
+            {
+                info!("{} joined {} stripes", peer, reply.stripe_count);
+                self.stripes = stripes;
+            }
+            Some(_) => warn!("{} declined striping, using one connection", peer),
+            None => warn!("Ignoring unexpected stripe reply from {}", peer),
+        }
+        Ok(())
+    }
+
+    /// Handle whatever the receiver has sent us: the answer to our hello,
+    /// requests for full resolution, region of interest subscriptions and
+    /// rate limits
+    fn poll_incoming(
+        &mut self,
+        peer: SocketAddr,
+        config: &SenderConfig,
+    ) -> Result<(), NetworkError> {
+        while has_pending_data(&self.primary)? {
+            let message = Protocol::new(config.format).read_message(&mut self.primary)?;
+            match message.msg_type {
+                MessageType::HelloAck if self.hello_pending => {
+                    self.handle_ack(&message.payload, peer, config)?
+                }
+                MessageType::FullResolutionRequest => {
+                    debug!("{} requested full resolution", peer);
+                    self.full_requested = true;
+                }
+                MessageType::RegionOfInterest => {
+                    self.region_of_interest = roi::parse_message(&message.payload)?;
+                    debug!(
+                        "{} subscribed to region {:?}",
+                        peer, self.region_of_interest
+                    );
+                }
+                MessageType::RateLimit => {
+                    self.rate_limit = rate::parse_message(&message.payload)?;
+                    debug!("{} limited frames to {:?}", peer, self.rate_limit);
+                }
+                MessageType::StripeSetup => self.confirm_stripes(&message.payload, peer)?,
+                other => warn!("Ignoring unexpected {:?} from receiver {}", other, peer),
+            }
+        }
+        Ok(())
+    }
+
+    /// Apply the receiver's answer to our hello
+    fn handle_ack(
+        &mut self,
+        payload: &[u8],
+        peer: SocketAddr,
+        config: &SenderConfig,
+    ) -> Result<(), NetworkError> {
+        self.hello_pending = false;
+        self.negotiated = handshake::parse_ack(payload)?;
+        match &self.negotiated {
+            Some(negotiated) => {
+                info!(
+                    "Negotiated {:?} frames with {} (protocol v{})",
+                    negotiated.encoding, peer, negotiated.version
+                );
+                if negotiated.has_feature(FEATURE_STRIPING) && config.stripes > 1 {
+                    if let Err(e) = self.open_stripes(peer, config) {
+                        warn!("Striping to {} unavailable: {}", peer, e);
+                    }
+                }
+            }
+            None => warn!(
+                "Receiver {} rejected our capabilities, staying on {:?}",
+                peer, config.format
+            ),
+        }
+
+        Ok(())
+    }
+
+    /// Whether the receiver agreed to columnar frames
+    fn columnar(&self) -> bool {
+        self.negotiated
+            .is_some_and(|negotiated| negotiated.encoding == FrameEncoding::Columnar)
+    }
+
+    /// Whether a columnar frame payload can go out on this connection as is
+    fn accepts_columnar(&self, payload: &[u8]) -> bool {
+        self.columnar()
+            && (self
+                .negotiated
+                .is_some_and(|negotiated| negotiated.has_feature(FEATURE_COMPACT_INDICES))
+                || !columnar::has_compact_indices(payload).unwrap_or(false))
+    }
+
+    /// Whether the receiver agreed to volume frames
+    fn accepts_volumes(&self) -> bool {
+        self.negotiated
+            .is_some_and(|negotiated| negotiated.has_feature(FEATURE_VOLUME_FRAMES))
+    }
+
+    /// Whether the receiver agreed to point frames
+    fn accepts_points(&self) -> bool {
+        self.negotiated
+            .is_some_and(|negotiated| negotiated.has_feature(FEATURE_POINT_FRAMES))
+    }
+
+    /// Whether the receiver agreed to partial updates
+    fn accepts_partial_updates(&self) -> bool {
+        self.negotiated
+            .is_some_and(|negotiated| negotiated.has_feature(FEATURE_PARTIAL_UPDATES))
+    }
+
+    /// Serialize a mesh in the encoding agreed on this connection
+    fn encode_mesh(
+        &self,
+        protocol: &Protocol,
+        mesh: &MeshFrame,
+    ) -> Result<EncodedMessage, ProtocolError> {
+        if self.columnar() {
+            protocol.encode_columnar(mesh)
+        } else {
+            protocol.encode_mesh(mesh)
+        }
+    }
+
+    /// Write a message, striping large mesh frames
+    fn write(
+        &mut self,
+        protocol: &Protocol,
+        message: &EncodedMessage,
+    ) -> Result<(), ProtocolError> {
+        // Frames encoded for an earlier connection may be replayed on one
+        // that has not agreed to columnar frames, compact indices or volume
+        // frames (yet)
+        let transcoded;
+        let message = if message.msg_type == MessageType::ColumnarFrame
+            && !self.accepts_columnar(message.payload())
+        {
+            let mesh = columnar::decode(message.payload())?;
+            transcoded = self.encode_mesh(protocol, &mesh)?;
+            &transcoded
+        } else if message.msg_type == MessageType::VolumeFrame && !self.accepts_volumes() {
+            let mesh = protocol.decode_frame(message.msg_type, message.payload())?;
+            transcoded = self.encode_mesh(protocol, &mesh)?;
+            &transcoded
+        } else if message.msg_type == MessageType::PointFrame && !self.accepts_points() {
+            trace!("Not replaying a point frame to a receiver without point frames");
+            return Ok(());
+        } else if message.msg_type == MessageType::PartialUpdate && !self.accepts_partial_updates()
+        {
+            // The sender forces a full frame next, the receiver cannot apply it
+            trace!("Not sending a partial update to a receiver without partial updates");
+            return Ok(());
+        } else {
+            message
+        };
+
+        if !self.stripes.is_empty()
+            && matches!(
+                message.msg_type,
+                MessageType::MeshFrame
+                    | MessageType::ColumnarFrame
+                    | MessageType::VolumeFrame
+                    | MessageType::PointFrame
+            )
+            && message.payload().len() >= self.stripe_threshold
+        {
+            stripe::write_striped(
+                protocol,
+                &mut self.primary,
+                &mut self.stripes,
+                message.msg_type,
+                message.payload(),
+            )
+        } else if let Some(zerocopy) = self
+            .zerocopy
+            .as_mut()
+            .filter(|zerocopy| zerocopy.applies(message.size()))
+        {
+            Ok(zerocopy.send(&message.bytes)?)
+        } else if let Some(uring) = self.uring.as_mut() {
+            Ok(uring.send_all(&message.bytes)?)
+        } else {
+            protocol.write_encoded(&mut self.primary, message)
+        }
+    }
+
+    fn streams(&self) -> impl Iterator<Item = &TcpStream> {
+        std::iter::once(&self.primary).chain(self.stripes.iter())
+    }
+
+    /// Pass what the receiver asked for on to the sender
+    fn publish(&mut self, peer: &mut PeerState) {
+        peer.negotiated = self.negotiated;
+        peer.region_of_interest = self.region_of_interest;
+        peer.rate_limit = self.rate_limit;
+        peer.full_requested |= std::mem::take(&mut self.full_requested);
+    }
+
+    /// Flush every stream and wait, up to `timeout`, until the kernel has
+    /// released every message sent zero-copy
+    fn flush(&mut self, timeout: Option<Duration>) -> Result<(), NetworkError> {
+        for mut stream in self.streams() {
+            stream.flush()?;
+        }
+        if let Some(zerocopy) = self.zerocopy.as_mut() {
+            if !zerocopy.flush(timeout)? {
+                debug!("{} zero-copy sends still in flight", zerocopy.pending());
+            }
+        }
+        Ok(())
+    }
+
+    /// Flush and shut down every stream
+    fn close(&self) -> Result<(), NetworkError> {
+        for mut stream in self.streams() {
+            let _ = stream.flush();
+            stream.shutdown(std::net::Shutdown::Both)?;
+        }
+        Ok(())
+    }
+}
+
+/// Queue shared between the sender and its writer thread
+struct Link {
+    /// Messages not written yet, in the order they were sent
+    queue: VecDeque<Outgoing>,
+    /// Most frames kept while disconnected
+    replay_frames: usize,
+    /// Most bytes of frames kept while disconnected
+    replay_bytes: usize,
+    /// Sequence number for the next message
+    next_seq: u64,
+    /// Message the writer is writing
+    in_flight: Option<u64>,
+    /// The writer's view of the current connection
+    peer: PeerState,
+    /// The writer holds messages back until the receiver answers its hello,
+    /// so sending does not wait for it
+    holding: bool,
+    /// Error that stopped the writer, returned by the next call
+    error: Option<NetworkError>,
+    /// TCP no-delay setting for the writer to apply
+    nodelay: Option<bool>,
+    /// Cleared by the writer once everything queued is written and flushed
+    flush_requested: bool,
+    /// The writer is to write what is queued, then stop
+    closing: bool,
+    /// The writer has stopped
+    finished: bool,
+}
+
+impl Link {
+    /// Queue a message
+    fn push(&mut self, message: EncodedMessage, kind: Kind) {
+        self.queue.push_back(Outgoing {
+            seq: self.next_seq,
+            message,
+            kind,
+        });
+        self.next_seq += 1;
+    }
+
+    /// Whether sending has to wait for the writer to catch up
+    fn full(&self) -> bool {
+        self.peer.connected && !self.holding && self.frames() >= QUEUED_FRAMES
+    }
+
+    /// Evict the oldest messages until the frames fit the replay bounds,
+    /// returning how many frames were dropped
+    fn trim(&mut self) -> u64 {
+        let mut dropped = 0;
+        while self.frames() > self.replay_frames || self.frame_bytes() > self.replay_bytes {
+            let Some(oldest) = self.queue.pop_front() else {
+                break;
+            };
+            if oldest.kind.is_frame() && self.in_flight != Some(oldest.seq) {
+                dropped += 1;
+            }
+        }
+        dropped
+    }
+
+    /// First queued message at or after `seq`
+    fn next_from(&self, seq: u64) -> Option<Outgoing> {
+        self.queue
+            .iter()
+            .find(|outgoing| outgoing.seq >= seq)
+            .cloned()
+    }
+
+    /// Remove a message once written
+    fn written(&mut self, seq: u64) {
+        if let Some(index) = self.queue.iter().position(|outgoing| outgoing.seq == seq) {
+            self.queue.remove(index);
+        }
+    }
+
+    /// Remove a message that can no longer be written, returning true if it
+    /// was a frame
+    fn discard(&mut self, seq: u64) -> bool {
+        let Some(index) = self.queue.iter().position(|outgoing| outgoing.seq == seq) else {
+            return false;
+        };
+        self.queue
+            .remove(index)
+            .is_some_and(|outgoing| outgoing.kind.is_frame())
+    }
+
+    /// Number of frames waiting for the writer
+    fn frames(&self) -> usize {
+        self.queue
+            .iter()
+            .filter(|outgoing| outgoing.kind.is_frame())
+            .count()
+    }
+
+    /// Size of the frames waiting for the writer
+    fn frame_bytes(&self) -> usize {
+        self.queue
+            .iter()
+            .filter(|outgoing| outgoing.kind.is_frame())
+            .map(|outgoing| outgoing.message.size())
+            .sum()
+    }
+}
+
+/// State shared between the sender and its writer thread
+struct SenderShared {
+    link: Mutex<Link>,
+    /// Signals changes to `link` in either direction
+    changed: Condvar,
+    frames_sent: AtomicU64,
+    bytes_sent: AtomicU64,
+    reconnects: AtomicU64,
+    frames_dropped: AtomicU64,
+    frames_skipped: AtomicU64,
+}
+
+impl SenderShared {
+    fn record_sent(&self, message: &EncodedMessage) {
+        self.frames_sent.fetch_add(1, Ordering::Relaxed);
+        self.bytes_sent
+            .fetch_add(message.size() as u64, Ordering::Relaxed);
+    }
+
+    /// Wait, up to `timeout`, while `condition` holds; also returns
+    /// whether it still does
+    fn wait_while<'a>(
+        &self,
+        link: MutexGuard<'a, Link>,
+        timeout: Option<Duration>,
+        condition: impl FnMut(&mut Link) -> bool,
+    ) -> (MutexGuard<'a, Link>, bool) {
+        match timeout {
+            Some(timeout) => {
+                let (link, result) = self
+                    .changed
+                    .wait_timeout_while(link, timeout, condition)
+                    .unwrap();
+                (link, result.timed_out())
+            }
+            None => (self.changed.wait_while(link, condition).unwrap(), false),
         }
     }
 }
 
 /// TCP-based mesh data sender
 pub struct MeshSender {
-    stream: TcpStream,
+    shared: Arc<SenderShared>,
     protocol: Protocol,
-    _config: SenderConfig,
-    frames_sent: u64,
-    bytes_sent: u64,
+    peer: SocketAddr,
+    config: SenderConfig,
+    /// Reduced frames sent since the last full resolution one
+    since_full: u32,
+    /// Full resolution requested through the API
+    full_requested: bool,
+    /// Picks the frames to send
+    rate: RateLimiter,
+    /// Finds what changed since the previous frame
+    delta: Option<DeltaEncoder>,
+    /// Writes queued messages, `None` once closed
+    writer: Option<JoinHandle<()>>,
 }
 
 impl MeshSender {
@@ -79,44 +778,93 @@ impl MeshSender {
     ) -> Result<Self, NetworkError> {
         info!("Connecting to mesh receiver...");
 
-        let stream = if let Some(timeout) = config.connect_timeout {
-            // Convert address to SocketAddr for timeout connection
-            let socket_addr = addr
-                .to_socket_addrs()?
-                .next()
-                .ok_or_else(|| NetworkError::InvalidAddress("No valid address".to_string()))?;
-
-            TcpStream::connect_timeout(&socket_addr, timeout)?
-        } else {
-            TcpStream::connect(addr)?
-        };
-
-        info!("Connected to {}", stream.peer_addr()?);
-
-        // Configure the stream
-        stream.set_nodelay(config.tcp_nodelay)?;
+        // Resolve once so reconnects go to the same peer
+        let peer = addr
+            .to_socket_addrs()?
+            .next()
+            .ok_or_else(|| NetworkError::InvalidAddress("No valid address".to_string()))?;
 
-        // Note: TcpStream doesn't have set_send_buffer_size method
-        // Buffer size would need to be set at socket level using platform-specific APIs
-        let _ = config.send_buffer_size;
-
-        if let Some(timeout) = config.write_timeout {
-            stream.set_write_timeout(Some(timeout))?;
-        }
+        let connection = Connection::open(peer, &config, config.negotiate)?;
+        info!("Connected to {}", peer);
 
         let protocol = Protocol::new(config.format).with_max_message_size(config.max_message_size);
 
+        let (replay_frames, replay_bytes) = config.reconnect.as_ref().map_or((0, 0), |reconnect| {
+            (reconnect.replay_frames, reconnect.replay_bytes)
+        });
+        let shared = Arc::new(SenderShared {
+            link: Mutex::new(Link {
+                queue: VecDeque::new(),
+                replay_frames,
+                replay_bytes,
+                next_seq: 0,
+                in_flight: None,
+                peer: PeerState::connected(0, &connection),
+                holding: false,
+                error: None,
+                nodelay: None,
+                flush_requested: false,
+                closing: false,
+                finished: false,
+            }),
+            changed: Condvar::new(),
+            frames_sent: AtomicU64::new(0),
+            bytes_sent: AtomicU64::new(0),
+            reconnects: AtomicU64::new(0),
+            frames_dropped: AtomicU64::new(0),
+            frames_skipped: AtomicU64::new(0),
+        });
+        let writer = spawn_writer(Arc::clone(&shared), peer, config.clone(), connection)?;
+
         Ok(Self {
-            stream,
+            shared,
             protocol,
-            _config: config,
-            frames_sent: 0,
-            bytes_sent: 0,
+            peer,
+            since_full: 0,
+            full_requested: false,
+            rate: RateLimiter::new(config.rate_limit),
+            delta: config.partial_updates.clone().map(DeltaEncoder::new),
+            writer: Some(writer),
+            config,
         })
     }
 
     /// Send a mesh frame
+    ///
+    /// The frame is queued for the writer thread. While connected this
+    /// waits once the writer falls behind, and a write error fails the
+    /// next call unless reconnect is enabled. While the connection is down
+    /// this never waits: the frame is kept for replay if the buffer has
+    /// room, and dropped otherwise. Frames beyond the rate limit are
+    /// skipped without being looked at.
     pub fn send_mesh(&mut self, mesh: &MeshFrame) -> Result<(), NetworkError> {
+        self.send_frame(mesh, None)
+    }
+
+    /// Send a mesh frame that only changed in the given vertex ranges
+    ///
+    /// The topology must be that of the previous frame. With partial
+    /// updates configured and agreed this saves hashing the frame to find
+    /// the changes; otherwise it is the same as [`send_mesh`](Self::send_mesh).
+    pub fn send_mesh_dirty(
+        &mut self,
+        mesh: &MeshFrame,
+        dirty: &[Range<usize>],
+    ) -> Result<(), NetworkError> {
+        self.send_frame(mesh, Some(dirty))
+    }
+
+    /// Send a frame, with the changed vertex ranges if the caller knows them
+    fn send_frame(
+        &mut self,
+        mesh: &MeshFrame,
+        dirty: Option<&[Range<usize>]>,
+    ) -> Result<(), NetworkError> {
+        if !self.rate.admit(Instant::now()) {
+            self.shared.frames_skipped.fetch_add(1, Ordering::Relaxed);
+            return Ok(());
+        }
+
         trace!(
             "Sending mesh frame: sim_id={}, frame={}, vertices={}",
             mesh.simulation_id,
@@ -130,89 +878,728 @@ impl MeshSender {
             return Err(NetworkError::Protocol(ProtocolError::InvalidFormat));
         }
 
-        // Serialize the mesh
-        let message = self.protocol.serialize_mesh(mesh)?;
-        let message_size = message.size();
+        let peer = self.peer_state()?;
+        let negotiated = peer.negotiated;
+        self.rate.set_remote(peer.rate_limit);
+
+        let full_requested = std::mem::take(&mut self.full_requested) | self.take_full_request();
+
+        let clipped = peer
+            .region_of_interest
+            .map(|region| roi::clip(mesh, &region, lod::default_workers()));
+        let mesh = self.level_of_detail(clipped.as_ref().unwrap_or(mesh), full_requested);
+
+        // Dirty ranges only describe the caller's own frame
+        let dirty = dirty.filter(|_| clipped.is_none() && matches!(mesh, Cow::Borrowed(_)));
+        let partial = negotiated.is_some_and(|n| n.has_feature(FEATURE_PARTIAL_UPDATES));
+        let update = self
+            .delta
+            .as_mut()
+            .and_then(|delta| delta.encode(&mesh, dirty, full_requested || !partial));
+
+        let (message, kind) = match update {
+            Some(update) => {
+                trace!(
+                    "Sending frame {} as {} changed ranges",
+                    update.frame_number,
+                    update.ranges.len()
+                );
+                let kind = Kind::PartialUpdate {
+                    generation: peer.generation,
+                };
+                (update.to_encoded()?, kind)
+            }
+            None => {
+                if negotiated.is_some_and(|n| n.has_feature(FEATURE_PROGRESSIVE)) {
+                    self.send_coarse_levels(&mesh, &peer)?;
+                }
+                (self.encode(&mesh, negotiated)?, Kind::Frame)
+            }
+        };
+        self.enqueue(message, kind)?;
+
+        debug!(
+            "Queued frame {} (sent so far: {} frames, {} bytes)",
+            mesh.frame_number,
+            self.shared.frames_sent.load(Ordering::Relaxed),
+            self.shared.bytes_sent.load(Ordering::Relaxed)
+        );
+
+        Ok(())
+    }
+
+    /// Send a scalar-field volume frame
+    ///
+    /// A receiver that agreed to volume frames extracts the surface itself
+    /// and can pick its own iso-value. For any other receiver the surface
+    /// is extracted here at the frame's iso-value and sent as a mesh. Volume
+    /// frames are rate limited and replayed like mesh frames, but not
+    /// clipped to a region of interest or simplified.
+    pub fn send_volume(&mut self, volume: &VolumeFrame) -> Result<(), NetworkError> {
+        if !self.rate.admit(Instant::now()) {
+            self.shared.frames_skipped.fetch_add(1, Ordering::Relaxed);
+            return Ok(());
+        }
+
+        trace!(
+            "Sending volume frame: sim_id={}, frame={}, dims={:?}",
+            volume.simulation_id,
+            volume.frame_number,
+            volume.grid.dims
+        );
+
+        if let Err(e) = volume.validate() {
+            error!("Invalid volume data: {}", e);
+            return Err(NetworkError::Protocol(ProtocolError::InvalidFormat));
+        }
+
+        let peer = self.peer_state()?;
+        let negotiated = peer.negotiated;
+        self.rate.set_remote(peer.rate_limit);
+
+        let message = if negotiated.is_some_and(|n| n.has_feature(FEATURE_VOLUME_FRAMES)) {
+            volume.to_encoded()?
+        } else {
+            let mesh = volume.extract_surface(volume.iso_value)?;
+            trace!(
+                "Extracted {} triangles from volume frame {}",
+                mesh.triangle_count(),
+                volume.frame_number
+            );
+            // Partial updates that follow apply to this surface
+            if let Some(delta) = self.delta.as_mut() {
+                delta.encode(&mesh, None, true);
+            }
+            self.encode(&mesh, negotiated)?
+        };
+        self.enqueue(message, Kind::Frame)?;
+
+        debug!(
+            "Queued volume frame {} (sent so far: {} frames, {} bytes)",
+            volume.frame_number,
+            self.shared.frames_sent.load(Ordering::Relaxed),
+            self.shared.bytes_sent.load(Ordering::Relaxed)
+        );
+
+        Ok(())
+    }
+
+    /// Send a particle frame
+    ///
+    /// Receivers that have not agreed to point frames, including any that
+    /// has not answered the hello yet, cannot show them; the frame is then
+    /// skipped with a warning, as it is when replayed to such a receiver
+    /// after a reconnect. Point frames are rate limited like mesh frames.
+    pub fn send_points(&mut self, points: &PointFrame) -> Result<(), NetworkError> {
+        if !self.rate.admit(Instant::now()) {
+            self.shared.frames_skipped.fetch_add(1, Ordering::Relaxed);
+            return Ok(());
+        }
+
+        trace!(
+            "Sending point frame: sim_id={}, frame={}, points={}",
+            points.simulation_id,
+            points.frame_number,
+            points.point_count
+        );
+
+        let peer = self.peer_state()?;
+        self.rate.set_remote(peer.rate_limit);
 
-        // Send the message
-        self.protocol.write_message(&mut self.stream, &message)?;
+        if !peer
+            .negotiated
+            .is_some_and(|n| n.has_feature(FEATURE_POINT_FRAMES))
+        {
+            warn!(
+                "Skipping point frame {}: the receiver does not accept point frames",
+                points.frame_number
+            );
+            self.shared.frames_skipped.fetch_add(1, Ordering::Relaxed);
+            return Ok(());
+        }
 
-        self.frames_sent += 1;
-        self.bytes_sent += message_size as u64;
+        let message = points.to_encoded()?;
+        self.enqueue(message, Kind::Frame)?;
 
         debug!(
-            "Sent frame {} ({} bytes, total: {} frames, {} bytes)",
-            mesh.frame_number, message_size, self.frames_sent, self.bytes_sent
+            "Queued point frame {} (sent so far: {} frames, {} bytes)",
+            points.frame_number,
+            self.shared.frames_sent.load(Ordering::Relaxed),
+            self.shared.bytes_sent.load(Ordering::Relaxed)
         );
 
         Ok(())
     }
 
+    /// Serialize a mesh in the encoding agreed with the receiver
+    fn encode(
+        &self,
+        mesh: &MeshFrame,
+        negotiated: Option<Negotiated>,
+    ) -> Result<EncodedMessage, NetworkError> {
+        let max_message_size = negotiated.map_or(self.config.max_message_size, |negotiated| {
+            self.config
+                .max_message_size
+                .min(negotiated.max_message_size as usize)
+        });
+        let index_compression = match negotiated {
+            Some(n) if n.has_feature(FEATURE_COMPACT_INDICES) => self.config.index_compression,
+            _ => IndexCompression::None,
+        };
+        let protocol = Protocol::new(self.config.format)
+            .with_max_message_size(max_message_size)
+            .with_index_compression(index_compression);
+        let message = if negotiated.is_some_and(|n| n.encoding == FrameEncoding::Columnar) {
+            protocol.encode_columnar(mesh)?
+        } else {
+            protocol.encode_mesh(mesh)?
+        };
+        Ok(message)
+    }
+
+    /// Send the configured coarse levels of a large frame, coarsest first
+    ///
+    /// Each level is simplified only once the previous one is queued. Coarse
+    /// levels are neither buffered nor replayed, and are dropped if the
+    /// connection is replaced before they are written.
+    fn send_coarse_levels(
+        &mut self,
+        mesh: &MeshFrame,
+        peer: &PeerState,
+    ) -> Result<(), NetworkError> {
+        let Some(config) = self.config.progressive.clone() else {
+            return Ok(());
+        };
+        if config.levels.is_empty() || mesh.triangle_count() < config.min_triangles {
+            return Ok(());
+        }
+
+        let levels = (config.levels.len() + 1).min(u8::MAX as usize) as u8;
+        for (level, &target) in config.levels.iter().take(levels as usize - 1).enumerate() {
+            let coarse = lod::simplify(mesh, target, config.workers);
+            if coarse.triangle_count() >= mesh.triangle_count() {
+                continue;
+            }
+
+            let announcement = CoarseLevel {
+                frame_number: mesh.frame_number,
+                level: level as u8,
+                levels,
+            };
+            trace!(
+                "Sending level {} of frame {} with {} triangles",
+                level,
+                mesh.frame_number,
+                coarse.triangle_count()
+            );
+            let kind = Kind::Coarse {
+                announcement: EncodedMessage::from_message(&announcement.to_message()?),
+                generation: peer.generation,
+            };
+            let frame = self.encode(&coarse, peer.negotiated)?;
+            if !self.enqueue(frame, kind)? {
+                break;
+            }
+        }
+        Ok(())
+    }
+
+    /// Pick the resolution of the next frame and simplify it if needed
+    fn level_of_detail<'a>(&mut self, mesh: &'a MeshFrame, requested: bool) -> Cow<'a, MeshFrame> {
+        let Some(config) = &self.config.lod else {
+            return Cow::Borrowed(mesh);
+        };
+
+        if requested || (config.full_every > 0 && self.since_full + 1 >= config.full_every) {
+            self.since_full = 0;
+            return Cow::Borrowed(mesh);
+        }
+
+        self.since_full += 1;
+        let reduced = lod::simplify(mesh, config.target, config.workers);
+        trace!(
+            "Reduced frame {} from {} to {} triangles",
+            mesh.frame_number,
+            mesh.triangle_count(),
+            reduced.triangle_count()
+        );
+        Cow::Owned(reduced)
+    }
+
+    /// Change the level-of-detail settings of this stream
+    ///
+    /// `None` goes back to sending every frame at full resolution.
+    pub fn set_lod(&mut self, lod: Option<LodConfig>) {
+        self.config.lod = lod;
+        self.since_full = 0;
+    }
+
+    /// Send the next frame at full resolution
+    pub fn request_full_resolution(&mut self) {
+        self.full_requested = true;
+    }
+
     /// Send a heartbeat message
+    ///
+    /// Heartbeats are not buffered; while disconnected this is a no-op.
     pub fn send_heartbeat(&mut self) -> Result<(), NetworkError> {
         trace!("Sending heartbeat");
         let message = self.protocol.create_heartbeat();
-        self.protocol.write_message(&mut self.stream, &message)?;
-        Ok(())
+        self.enqueue(EncodedMessage::from_message(&message), Kind::Control)
+            .map(drop)
     }
 
     /// Send end-of-stream marker
     pub fn send_end_of_stream(&mut self) -> Result<(), NetworkError> {
         info!("Sending end-of-stream marker");
         let message = self.protocol.create_end_of_stream();
-        self.protocol.write_message(&mut self.stream, &message)?;
-        Ok(())
+        self.enqueue(EncodedMessage::from_message(&message), Kind::Control)
+            .map(drop)
+    }
+
+    /// The writer's view of the current connection, failing if the writer
+    /// stopped
+    fn peer_state(&self) -> Result<PeerState, NetworkError> {
+        let mut link = self.shared.link.lock().unwrap();
+        if let Some(error) = link.error.take() {
+            return Err(error);
+        }
+        if !link.peer.connected && self.config.reconnect.is_none() {
+            return Err(NetworkError::ConnectionClosed);
+        }
+        Ok(link.peer)
+    }
+
+    /// Whether the receiver asked for full resolution since last time
+    fn take_full_request(&self) -> bool {
+        std::mem::take(&mut self.shared.link.lock().unwrap().peer.full_requested)
+    }
+
+    /// Queue a message for the writer, returning false if it was not kept
+    ///
+    /// While connected a frame waits until the writer has room for it.
+    /// While disconnected, or while the writer waits for the answer to its
+    /// hello, only frames are kept, up to the replay bounds, and the oldest
+    /// give way to newer ones.
+    fn enqueue(&self, message: EncodedMessage, kind: Kind) -> Result<bool, NetworkError> {
+        let mut link = self.shared.link.lock().unwrap();
+        if kind.is_frame() {
+            link = self
+                .shared
+                .changed
+                .wait_while(link, |link| {
+                    link.error.is_none() && !link.finished && link.full()
+                })
+                .unwrap();
+        }
+        if let Some(error) = link.error.take() {
+            return Err(error);
+        }
+        if !link.peer.connected {
+            if self.config.reconnect.is_none() {
+                return Err(NetworkError::ConnectionClosed);
+            }
+            if !matches!(kind, Kind::Frame) {
+                return Ok(false);
+            }
+        }
+
+        link.push(message, kind);
+        if !link.peer.connected || link.holding {
+            let dropped = link.trim();
+            if dropped > 0 {
+                self.shared
+                    .frames_dropped
+                    .fetch_add(dropped, Ordering::Relaxed);
+            }
+        }
+        // Trimming evicts the oldest first, so the message was kept unless
+        // everything went
+        let kept = !link.queue.is_empty();
+        drop(link);
+        self.shared.changed.notify_all();
+        Ok(kept)
     }
 
     /// Flush any buffered data
+    ///
+    /// Waits, up to the write timeout, until the writer has written every
+    /// queued message and the kernel has released every message sent
+    /// zero-copy. Returns right away while disconnected.
     pub fn flush(&mut self) -> Result<(), NetworkError> {
-        self.stream.flush()?;
-        Ok(())
+        let mut link = self.shared.link.lock().unwrap();
+        if link.peer.connected {
+            link.flush_requested = true;
+            self.shared.changed.notify_all();
+            let timed_out;
+            (link, timed_out) = self
+                .shared
+                .wait_while(link, self.config.write_timeout, |link| {
+                    link.flush_requested && link.peer.connected
+                });
+            if timed_out {
+                return Err(NetworkError::SendTimeout(
+                    self.config.write_timeout.unwrap_or_default(),
+                ));
+            }
+        }
+        link.error.take().map_or(Ok(()), Err)
+    }
+
+    /// Settings agreed with the receiver on the current connection
+    ///
+    /// `None` until the receiver has answered the hello, and for receivers
+    /// that predate the handshake.
+    pub fn negotiated(&self) -> Option<Negotiated> {
+        self.shared.link.lock().unwrap().peer.negotiated
+    }
+
+    /// Check whether the connection is currently up
+    pub fn is_connected(&self) -> bool {
+        self.shared.link.lock().unwrap().peer.connected
     }
 
     /// Get statistics about sent data
+    ///
+    /// Frames count as sent once the writer has written them; call
+    /// [`flush`](Self::flush) first to include everything queued.
     pub fn stats(&self) -> SenderStats {
+        let link = self.shared.link.lock().unwrap();
         SenderStats {
-            frames_sent: self.frames_sent,
-            bytes_sent: self.bytes_sent,
+            frames_sent: self.shared.frames_sent.load(Ordering::Relaxed),
+            bytes_sent: self.shared.bytes_sent.load(Ordering::Relaxed),
+            reconnects: self.shared.reconnects.load(Ordering::Relaxed),
+            frames_dropped: self.shared.frames_dropped.load(Ordering::Relaxed),
+            frames_skipped: self.shared.frames_skipped.load(Ordering::Relaxed),
+            frames_buffered: link.frames(),
+            connected: link.peer.connected,
         }
     }
 
     /// Get the peer address
     pub fn peer_addr(&self) -> Result<std::net::SocketAddr, NetworkError> {
-        Ok(self.stream.peer_addr()?)
+        Ok(self.peer)
     }
 
     /// Get the local address
     pub fn local_addr(&self) -> Result<std::net::SocketAddr, NetworkError> {
-        Ok(self.stream.local_addr()?)
+        self.shared
+            .link
+            .lock()
+            .unwrap()
+            .peer
+            .local_addr
+            .ok_or(NetworkError::ConnectionClosed)
     }
 
     /// Set TCP no-delay option
-    pub fn set_nodelay(&self, nodelay: bool) -> Result<(), NetworkError> {
-        self.stream.set_nodelay(nodelay)?;
+    ///
+    /// The writer applies it to the current connection and any later one.
+    pub fn set_nodelay(&mut self, nodelay: bool) -> Result<(), NetworkError> {
+        self.config.tcp_nodelay = nodelay;
+        self.shared.link.lock().unwrap().nodelay = Some(nodelay);
+        self.shared.changed.notify_all();
         Ok(())
     }
 
     /// Shutdown the connection gracefully
+    ///
+    /// Waits, up to the write timeout, for the writer to send what is
+    /// queued. Frames still waiting for a reconnect are discarded.
     pub fn shutdown(mut self) -> Result<(), NetworkError> {
         debug!("Shutting down mesh sender");
 
         // Try to send end-of-stream marker
         let _ = self.send_end_of_stream();
+        let result = self.close();
 
-        // Flush any remaining data
-        let _ = self.stream.flush();
-
-        // Shutdown the TCP connection
-        self.stream.shutdown(std::net::Shutdown::Both)?;
-
+        let stats = self.stats();
         info!(
-            "Mesh sender shutdown complete. Sent {} frames, {} bytes",
-            self.frames_sent, self.bytes_sent
+            "Mesh sender shutdown complete. Sent {} frames, {} bytes ({} reconnects, {} dropped)",
+            stats.frames_sent, stats.bytes_sent, stats.reconnects, stats.frames_dropped
         );
 
-        Ok(())
+        result
+    }
+
+    /// Let the writer send what is queued and stop, waiting for it up to
+    /// the write timeout
+    fn close(&mut self) -> Result<(), NetworkError> {
+        let Some(writer) = self.writer.take() else {
+            return Ok(());
+        };
+
+        let mut link = self.shared.link.lock().unwrap();
+        link.closing = true;
+        self.shared.changed.notify_all();
+        let (mut link, timed_out) =
+            self.shared
+                .wait_while(link, self.config.write_timeout, |link| !link.finished);
+        if timed_out {
+            warn!("Gave up sending the last frames to {}", self.peer);
+            return Err(NetworkError::SendTimeout(
+                self.config.write_timeout.unwrap_or_default(),
+            ));
+        }
+        let error = link.error.take();
+        drop(link);
+
+        let _ = writer.join();
+        error.map_or(Ok(()), Err)
+    }
+}
+
+impl Drop for MeshSender {
+    fn drop(&mut self) {
+        let _ = self.close();
+    }
+}
+
+/// Connect and configure a stream to the receiver
+fn open_stream(peer: SocketAddr, config: &SenderConfig) -> Result<TcpStream, NetworkError> {
+    let stream = if let Some(timeout) = config.connect_timeout {
+        TcpStream::connect_timeout(&peer, timeout)?
+    } else {
+        TcpStream::connect(peer)?
+    };
+
+    // Configure the stream
+    stream.set_nodelay(config.tcp_nodelay)?;
+
+    // Note: TcpStream doesn't have set_send_buffer_size method
+    // Buffer size would need to be set at socket level using platform-specific APIs
+    let _ = config.send_buffer_size;
+
+    if let Some(timeout) = config.write_timeout {
+        stream.set_write_timeout(Some(timeout))?;
+    }
+
+    Ok(stream)
+}
+
+/// Start the thread that writes queued messages
+fn spawn_writer(
+    shared: Arc<SenderShared>,
+    peer: SocketAddr,
+    config: SenderConfig,
+    connection: Connection,
+) -> Result<JoinHandle<()>, NetworkError> {
+    Ok(thread::Builder::new()
+        .name("seaview-sender".to_string())
+        .spawn(move || run_writer(&shared, peer, config, connection))?)
+}
+
+/// Write queued messages until the sender closes, reconnecting with
+/// exponential backoff after a lost connection if enabled
+fn run_writer(
+    shared: &SenderShared,
+    peer: SocketAddr,
+    mut config: SenderConfig,
+    mut connection: Connection,
+) {
+    let protocol = Protocol::new(config.format).with_max_message_size(config.max_message_size);
+    let mut generation = 0;
+    let mut reconnected = false;
+
+    loop {
+        let error = match write_queued(
+            shared,
+            peer,
+            &mut config,
+            &protocol,
+            &mut connection,
+            generation,
+            reconnected,
+        ) {
+            Ok(()) => {
+                if let Err(e) = connection.close() {
+                    shared.link.lock().unwrap().error = Some(e);
+                }
+                break;
+            }
+            Err(e) => e,
+        };
+
+        let mut link = shared.link.lock().unwrap();
+        link.peer = PeerState {
+            generation,
+            ..PeerState::default()
+        };
+        link.in_flight = None;
+        link.holding = false;
+        link.flush_requested = false;
+        let Some(reconnect) = config.reconnect.clone() else {
+            link.error = Some(error);
+            break;
+        };
+        // Frames queued while connected are now subject to the replay bounds
+        let dropped = link.trim();
+        drop(link);
+        shared.frames_dropped.fetch_add(dropped, Ordering::Relaxed);
+        shared.changed.notify_all();
+        warn!("Connection to {} lost: {}", peer, error);
+
+        // A receiver that closed the connection without answering the hello
+        // may predate the handshake, so the next connection goes without
+        // one; the one after that tries again
+        let hello = config.negotiate && !connection.hello_pending;
+        if config.negotiate && !hello {
+            info!(
+                "{} closed the connection before answering our hello, reconnecting without one",
+                peer
+            );
+        }
+        let Some(reopened) = reopen(shared, peer, &config, &reconnect, hello) else {
+            break;
+        };
+        connection = reopened;
+        generation += 1;
+        reconnected = true;
+
+        shared.link.lock().unwrap().peer = PeerState::connected(generation, &connection);
+        shared.changed.notify_all();
+    }
+
+    let mut link = shared.link.lock().unwrap();
+    link.peer.connected = false;
+    link.finished = true;
+    drop(link);
+    shared.changed.notify_all();
+}
+
+/// Write queued messages to a connection until the sender closes or the
+/// connection fails
+///
+/// After a reconnect nothing is written until the receiver has answered
+/// the hello, so the replay goes out in the agreed encoding; a receiver
+/// that never answers gets it after [`HELLO_TIMEOUT`].
+fn write_queued(
+    shared: &SenderShared,
+    peer: SocketAddr,
+    config: &mut SenderConfig,
+    protocol: &Protocol,
+    connection: &mut Connection,
+    generation: u64,
+    reconnected: bool,
+) -> Result<(), NetworkError> {
+    let hold_until = reconnected.then(|| Instant::now() + HELLO_TIMEOUT);
+    let mut next_seq = 0;
+
+    loop {
+        connection.poll_incoming(peer, config)?;
+
+        let mut link = shared.link.lock().unwrap();
+        connection.publish(&mut link.peer);
+        if let Some(nodelay) = link.nodelay.take() {
+            config.tcp_nodelay = nodelay;
+            for stream in connection.streams() {
+                stream.set_nodelay(nodelay)?;
+            }
+        }
+
+        let holding =
+            connection.hello_pending && hold_until.is_some_and(|until| Instant::now() < until);
+        if link.holding != holding {
+            link.holding = holding;
+            shared.changed.notify_all();
+        }
+        let next = link.next_from(next_seq);
+        let drained = next.is_none();
+        let Some(outgoing) = next.filter(|_| !holding) else {
+            if link.flush_requested && !holding {
+                drop(link);
+                connection.flush(config.write_timeout)?;
+                shared.link.lock().unwrap().flush_requested = false;
+                shared.changed.notify_all();
+                continue;
+            }
+            if link.closing && drained {
+                return Ok(());
+            }
+            drop(shared.changed.wait_timeout(link, POLL_INTERVAL).unwrap());
+            continue;
+        };
+        next_seq = outgoing.seq + 1;
+
+        // Encoded for an earlier connection, or for a receiver that has
+        // not (yet) agreed to partial updates
+        let stale = outgoing
+            .kind
+            .generation()
+            .is_some_and(|encoded_for| encoded_for != generation)
+            || (matches!(outgoing.kind, Kind::PartialUpdate { .. })
+                && !connection.accepts_partial_updates());
+        if stale {
+            trace!("Dropping a message encoded for an earlier connection");
+            if link.discard(outgoing.seq) {
+                shared.frames_dropped.fetch_add(1, Ordering::Relaxed);
+            }
+            continue;
+        }
+
+        // Write outside the lock, so the sender keeps queueing
+        link.in_flight = Some(outgoing.seq);
+        drop(link);
+        let written = match &outgoing.kind {
+            Kind::Coarse { announcement, .. } => connection
+                .write(protocol, announcement)
+                .and_then(|()| connection.write(protocol, &outgoing.message)),
+            _ => connection.write(protocol, &outgoing.message),
+        };
+
+        let mut link = shared.link.lock().unwrap();
+        link.in_flight = None;
+        written?;
+        link.written(outgoing.seq);
+        drop(link);
+
+        match &outgoing.kind {
+            Kind::Frame | Kind::PartialUpdate { .. } => shared.record_sent(&outgoing.message),
+            Kind::Coarse { announcement, .. } => {
+                shared.bytes_sent.fetch_add(
+                    (announcement.size() + outgoing.message.size()) as u64,
+                    Ordering::Relaxed,
+                );
+            }
+            Kind::Control => {}
+        }
+        shared.changed.notify_all();
+    }
+}
+
+/// Reconnect with exponential backoff; `None` once the sender closes
+fn reopen(
+    shared: &SenderShared,
+    peer: SocketAddr,
+    config: &SenderConfig,
+    reconnect: &ReconnectConfig,
+    hello: bool,
+) -> Option<Connection> {
+    let mut backoff = reconnect.initial_backoff;
+
+    loop {
+        let link = shared.link.lock().unwrap();
+        let (link, _) = shared
+            .changed
+            .wait_timeout_while(link, backoff, |link| !link.closing)
+            .unwrap();
+        if link.closing {
+            return None;
+        }
+        drop(link);
+        backoff = (backoff * 2).min(reconnect.max_backoff);
+
+        match Connection::open(peer, config, hello) {
+            Ok(connection) => {
+                info!("Reconnected to {}", peer);
+                shared.reconnects.fetch_add(1, Ordering::Relaxed);
+                return Some(connection);
+            }
+            Err(e) => debug!(
+                "Reconnect to {} failed: {}, retrying in {:?}",
+                peer, e, backoff
+            ),
+        }
     }
 }
 
@@ -223,6 +1610,18 @@ pub struct SenderStats {
     pub frames_sent: u64,
     /// Total bytes sent
     pub bytes_sent: u64,
+    /// Successful reconnects after a lost connection
+    pub reconnects: u64,
+    /// Frames discarded because the replay buffer was full while
+    /// disconnected, or that no longer applied once the connection was
+    /// replaced
+    pub frames_dropped: u64,
+    /// Frames not sent because of a rate limit
+    pub frames_skipped: u64,
+    /// Frames waiting for the writer, including those kept for replay
+    pub frames_buffered: usize,
+    /// Whether the connection is currently up
+    pub connected: bool,
 }
 
 #[cfg(test)]
@@ -251,9 +1650,11 @@ mod tests {
         let listener = TcpListener::bind("127.0.0.1:0").unwrap();
         let addr = listener.local_addr().unwrap();
 
-        // Accept connections in background
+        // Accept connections in background, keeping them open so the hello
+        // written on connect does not hit a closed socket
         thread::spawn(move || {
-            let _ = listener.accept();
+            let _connection = listener.accept();
+            thread::sleep(std::time::Duration::from_secs(1));
         });
 
         // Connect should succeed
@@ -267,7 +1668,8 @@ mod tests {
         let addr = listener.local_addr().unwrap();
 
         thread::spawn(move || {
-            let _ = listener.accept();
+            let _connection = listener.accept();
+            thread::sleep(std::time::Duration::from_secs(1));
         });
 
         let sender = MeshSender::connect(addr).unwrap();
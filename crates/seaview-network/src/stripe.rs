@@ -0,0 +1,243 @@
+//! Striping of large frames across parallel connections
+//!
+//! A single TCP stream cannot saturate a fast interconnect with multi-gigabyte
+//! frames. A striped sender opens `K` connections to the same receiver: the
+//! primary one announces a session with [`StripeSetup`], and each extra one
+//! identifies itself with [`StripeJoin`]. Frames above a size threshold are
+//! then announced on the primary with a [`StripedFrameHeader`] and their
+//! payload is split into `K` contiguous ranges, each written raw on its own
+//! connection in parallel. The receiver preallocates the payload buffer and
+//! reads every range directly into place.
+//!
+//! The receiver answers the setup with a [`StripeSetup`] of its own, see
+//! [`reply_message`]: the full stripe count once every stripe joined, or 1
+//! when they did not join in time or it does not take striped sessions.
+//! The sender stripes only after a full answer; until then, and after any
+//! other, frames go over the primary connection alone.
+//!
+//! Striping is a point-to-point feature between [`MeshSender`] and
+//! [`MeshReceiver`]; relays do not accept striped sessions, and the
+//! non-blocking receiver declines them.
+//!
+//! [`MeshSender`]: crate::MeshSender
+//! [`MeshReceiver`]: crate::MeshReceiver
+
+use crate::protocol::{MessageType, NetworkMessage, Protocol, ProtocolError};
+
+use serde::{Deserialize, Serialize};
+use std::io::{Read, Write};
+use std::net::TcpStream;
+use std::ops::Range;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::thread;
+use std::time::{SystemTime, UNIX_EPOCH};
+use tracing::debug;
+
+/// Announces a striped session on the primary connection
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+pub struct StripeSetup {
+    /// Identifier shared by all connections of the session
+    pub session_id: u64,
+    /// Total number of connections, including the primary
+    pub stripe_count: u16,
+}
+
+/// First message on each extra connection of a striped session
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+pub struct StripeJoin {
+    /// Session this connection belongs to
+    pub session_id: u64,
+    /// Position of this connection, 1..stripe_count
+    pub index: u16,
+}
+
+/// Announces a striped frame; the payload ranges follow raw on each stripe
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+pub struct StripedFrameHeader {
+    /// Length of the full mesh frame payload
+    pub payload_len: u64,
+    /// Message type the payload would have been sent as unstriped
+    pub frame_type: MessageType,
+}
+
+/// Answer to a [`StripeSetup`]: the whole session if every stripe
+/// `joined`, otherwise just the primary connection
+pub fn reply_message(setup: &StripeSetup, joined: bool) -> Result<NetworkMessage, ProtocolError> {
+    let reply = StripeSetup {
+        session_id: setup.session_id,
+        stripe_count: if joined { setup.stripe_count } else { 1 },
+    };
+    create_message(MessageType::StripeSetup, &reply)
+}
+
+/// Split `len` bytes into `count` contiguous ranges
+///
+/// Sender and receiver both derive the ranges from the payload length, so
+/// they never need to be sent.
+pub fn stripe_ranges(len: usize, count: usize) -> Vec<Range<usize>> {
+    let count = count.max(1);
+    let chunk = len.div_ceil(count).max(1);
+    (0..count)
+        .map(|i| (i * chunk).min(len)..((i + 1) * chunk).min(len))
+        .collect()
+}
+
+/// Create a session identifier unlikely to collide with another sender's
+pub fn new_session_id() -> u64 {
+    static COUNTER: AtomicU64 = AtomicU64::new(0);
+    let nanos = SystemTime::now()
+        .duration_since(UNIX_EPOCH)
+        .map_or(0, |d| d.as_nanos() as u64);
+    nanos ^ ((std::process::id() as u64) << 32) ^ COUNTER.fetch_add(1, Ordering::Relaxed)
+}
+
+/// Serialize a stripe control payload into a message
+pub fn create_message<T: Serialize>(
+    msg_type: MessageType,
+    value: &T,
+) -> Result<NetworkMessage, ProtocolError> {
+    Ok(NetworkMessage::new(msg_type, bincode::serialize(value)?))
+}
+
+/// Deserialize a stripe control payload
+pub fn parse_message<T: for<'de> Deserialize<'de>>(payload: &[u8]) -> Result<T, ProtocolError> {
+    Ok(bincode::deserialize(payload)?)
+}
+
+/// Write a frame payload striped across the primary and extra connections
+pub fn write_striped(
+    protocol: &Protocol,
+    primary: &mut TcpStream,
+    stripes: &mut [TcpStream],
+    frame_type: MessageType,
+    payload: &[u8],
+) -> Result<(), ProtocolError> {
+    let header = StripedFrameHeader {
+        payload_len: payload.len() as u64,
+        frame_type,
+    };
+    protocol.write_message(
+        primary,
+        &create_message(MessageType::StripedFrame, &header)?,
+    )?;
+
+    let ranges = stripe_ranges(payload.len(), stripes.len() + 1);
+    debug!(
+        "Writing {} bytes across {} stripes",
+        payload.len(),
+        ranges.len()
+    );
+
+    thread::scope(|scope| {
+        let handles: Vec<_> = std::iter::once(primary)
+            .chain(stripes.iter_mut())
+            .zip(ranges)
+            .map(|(stream, range)| {
+                let chunk = &payload[range];
+                scope.spawn(move || {
+                    stream.write_all(chunk)?;
+                    stream.flush()
+                })
+            })
+            .collect();
+
+        for handle in handles {
+            handle.join().expect("stripe writer panicked")?;
+        }
+        Ok(())
+    })
+}
+
+/// Read a striped frame payload into one preallocated buffer
+pub fn read_striped(
+    primary: &mut TcpStream,
+    stripes: &mut [TcpStream],
+    payload_len: usize,
+) -> Result<Vec<u8>, ProtocolError> {
+    let mut payload = vec![0u8; payload_len];
+    read_striped_into(primary, stripes, &mut payload)?;
+    Ok(payload)
+}
+
+/// Read a striped frame payload into a caller-provided buffer
+///
+/// The buffer must be exactly as long as the payload.
+pub fn read_striped_into(
+    primary: &mut TcpStream,
+    stripes: &mut [TcpStream],
+    payload: &mut [u8],
+) -> Result<(), ProtocolError> {
+    let ranges = stripe_ranges(payload.len(), stripes.len() + 1);
+
+    // Carve the buffer into disjoint slices, one per connection
+    let mut slices = Vec::with_capacity(ranges.len());
+    let mut rest = payload;
+    for range in &ranges {
+        let (slice, tail) = rest.split_at_mut(range.len());
+        slices.push(slice);
+        rest = tail;
+    }
+
+    thread::scope(|scope| {
+        let handles: Vec<_> = std::iter::once(primary)
+            .chain(stripes.iter_mut())
+            .zip(slices)
+            .map(|(stream, slice)| scope.spawn(move || stream.read_exact(slice)))
+            .collect();
+
+        for handle in handles {
+            handle.join().expect("stripe reader panicked")?;
+        }
+        Ok(())
+    })
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::net::TcpListener;
+
+    #[test]
+    fn test_stripe_ranges_cover_payload() {
+        for (len, count) in [(0, 4), (1, 4), (10, 3), (1000, 8), (7, 1)] {
+            let ranges = stripe_ranges(len, count);
+            assert_eq!(ranges.len(), count);
+            assert_eq!(ranges.first().unwrap().start, 0);
+            assert_eq!(ranges.last().unwrap().end, len);
+            for pair in ranges.windows(2) {
+                assert_eq!(pair[0].end, pair[1].start);
+            }
+        }
+    }
+
+    #[test]
+    fn test_striped_round_trip() {
+        let listener = TcpListener::bind("127.0.0.1:0").unwrap();
+        let addr = listener.local_addr().unwrap();
+
+        let mut senders: Vec<TcpStream> =
+            (0..3).map(|_| TcpStream::connect(addr).unwrap()).collect();
+        let mut receivers: Vec<TcpStream> = (0..3).map(|_| listener.accept().unwrap().0).collect();
+
+        let payload: Vec<u8> = (0..100_000u32).map(|i| (i % 251) as u8).collect();
+        let protocol = Protocol::default();
+
+        let (primary, stripes) = senders.split_first_mut().unwrap();
+        write_striped(
+            &protocol,
+            primary,
+            stripes,
+            MessageType::MeshFrame,
+            &payload,
+        )
+        .unwrap();
+
+        let (primary, stripes) = receivers.split_first_mut().unwrap();
+        let message = protocol.read_message(primary).unwrap();
+        assert_eq!(message.msg_type, MessageType::StripedFrame);
+        let header: StripedFrameHeader = parse_message(&message.payload).unwrap();
+        assert_eq!(header.frame_type, MessageType::MeshFrame);
+        let received = read_striped(primary, stripes, header.payload_len as usize).unwrap();
+        assert_eq!(received, payload);
+    }
+}
@@ -103,6 +103,41 @@ impl MeshFrame {
     }
 }
 
+/// Leading fields of a serialized [`MeshFrame`]
+///
+/// Field order matches `MeshFrame`, so a frame payload can be decoded as a
+/// header without touching its geometry.
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct FrameHeader {
+    /// Simulation identifier
+    pub simulation_id: String,
+    /// Frame number in the simulation sequence
+    pub frame_number: u32,
+    /// Timestamp in nanoseconds since simulation start
+    pub timestamp: u64,
+}
+
+/// Request for a range of frames, sent by a receiver to its upstream
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+pub struct FrameRangeRequest {
+    /// First frame number wanted
+    pub first: u32,
+    /// Last frame number wanted (inclusive)
+    pub last: u32,
+}
+
+impl FrameRangeRequest {
+    /// Create a request for frames `first..=last`
+    pub fn new(first: u32, last: u32) -> Self {
+        Self { first, last }
+    }
+
+    /// Check whether a frame number falls inside the requested range
+    pub fn contains(&self, frame_number: u32) -> bool {
+        (self.first..=self.last).contains(&frame_number)
+    }
+}
+
 /// Spatial bounds of the mesh domain
 #[derive(Debug, Clone, Copy, Serialize, Deserialize)]
 pub struct DomainBounds {
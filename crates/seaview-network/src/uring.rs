@@ -0,0 +1,767 @@
+//! Optional io_uring transport for Linux
+//!
+//! With the `io-uring` feature, a connection can move its socket I/O onto a
+//! small io_uring of its own instead of blocking `read`/`write` calls.
+//! Receiving links each payload read to the read of the following header,
+//! so a steady stream costs one `io_uring_enter` per message and payloads
+//! land directly in pooled buffers. Sending hands each encoded message to
+//! the kernel in a single submission.
+//!
+//! The backend is picked at runtime through [`IoBackend`]. Where io_uring is
+//! not compiled in, or the kernel refuses to set up a ring (older kernels,
+//! seccomp filters in containers), connections fall back to blocking
+//! sockets.
+
+use std::net::TcpStream;
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::time::Duration;
+use tracing::{debug, warn};
+
+/// How connections perform socket I/O
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub enum IoBackend {
+    /// Blocking socket calls
+    #[default]
+    Blocking,
+    /// io_uring where available, blocking socket calls otherwise
+    Uring,
+}
+
+impl IoBackend {
+    /// Whether io_uring is compiled in and accepted by the running kernel
+    pub fn uring_available() -> bool {
+        #[cfg(all(target_os = "linux", feature = "io-uring"))]
+        {
+            sys::Ring::new(2).is_ok()
+        }
+        #[cfg(not(all(target_os = "linux", feature = "io-uring")))]
+        {
+            false
+        }
+    }
+}
+
+/// Set up io_uring for a new connection if the backend asks for it
+///
+/// `timeout` bounds each read or write, like the socket timeouts of the
+/// blocking backend. Returns `None`, and warns once per process, when
+/// io_uring cannot be used.
+pub(crate) fn attach(
+    backend: IoBackend,
+    stream: &TcpStream,
+    timeout: Option<Duration>,
+) -> Option<UringStream> {
+    static WARNED: AtomicBool = AtomicBool::new(false);
+
+    if backend != IoBackend::Uring {
+        return None;
+    }
+
+    match UringStream::new(stream, timeout) {
+        Ok(uring) => {
+            debug!("Using io_uring for connection");
+            Some(uring)
+        }
+        Err(e) => {
+            if !WARNED.swap(true, Ordering::Relaxed) {
+                warn!("io_uring unavailable ({}), using blocking sockets", e);
+            }
+            None
+        }
+    }
+}
+
+#[cfg(all(target_os = "linux", feature = "io-uring"))]
+pub(crate) use linux::UringStream;
+
+#[cfg(not(all(target_os = "linux", feature = "io-uring")))]
+pub(crate) use fallback::UringStream;
+
+/// Minimal bindings to the io_uring system calls
+#[cfg(all(target_os = "linux", feature = "io-uring"))]
+mod sys {
+    use std::io;
+    use std::mem::size_of;
+    use std::os::fd::{AsRawFd, FromRawFd, OwnedFd, RawFd};
+    use std::ptr;
+    use std::sync::atomic::{AtomicU32, Ordering};
+
+    pub const OP_TIMEOUT: u8 = 11;
+    pub const OP_ASYNC_CANCEL: u8 = 14;
+    pub const OP_SEND: u8 = 26;
+    pub const OP_RECV: u8 = 27;
+
+    /// Start the next submission only after this one completed in full
+    pub const SQE_IO_LINK: u8 = 1 << 2;
+
+    const ENTER_GETEVENTS: u32 = 1 << 0;
+    const OFF_SQ_RING: libc::off_t = 0;
+    const OFF_CQ_RING: libc::off_t = 0x800_0000;
+    const OFF_SQES: libc::off_t = 0x1000_0000;
+
+    /// Kernels with this feature (6.3+) also retry short `MSG_WAITALL`
+    /// sends and receives, which linked reads rely on
+    const FEAT_REG_REG_RING: u32 = 1 << 13;
+
+    #[repr(C)]
+    #[derive(Default)]
+    struct SqRingOffsets {
+        head: u32,
+        tail: u32,
+        ring_mask: u32,
+        ring_entries: u32,
+        flags: u32,
+        dropped: u32,
+        array: u32,
+        resv1: u32,
+        user_addr: u64,
+    }
+
+    #[repr(C)]
+    #[derive(Default)]
+    struct CqRingOffsets {
+        head: u32,
+        tail: u32,
+        ring_mask: u32,
+        ring_entries: u32,
+        overflow: u32,
+        cqes: u32,
+        flags: u32,
+        resv1: u32,
+        user_addr: u64,
+    }
+
+    #[repr(C)]
+    #[derive(Default)]
+    struct Params {
+        sq_entries: u32,
+        cq_entries: u32,
+        flags: u32,
+        sq_thread_cpu: u32,
+        sq_thread_idle: u32,
+        features: u32,
+        wq_fd: u32,
+        resv: [u32; 3],
+        sq_off: SqRingOffsets,
+        cq_off: CqRingOffsets,
+    }
+
+    /// Submission queue entry
+    #[repr(C)]
+    #[derive(Debug, Clone, Copy, Default)]
+    pub struct Sqe {
+        pub opcode: u8,
+        pub flags: u8,
+        pub ioprio: u16,
+        pub fd: i32,
+        pub off: u64,
+        pub addr: u64,
+        pub len: u32,
+        pub op_flags: u32,
+        pub user_data: u64,
+        pub buf_index: u16,
+        pub personality: u16,
+        pub file_index: i32,
+        pub addr3: u64,
+        pub pad: u64,
+    }
+
+    /// Completion queue entry
+    #[repr(C)]
+    #[derive(Debug, Clone, Copy)]
+    pub struct Cqe {
+        pub user_data: u64,
+        pub res: i32,
+        pub flags: u32,
+    }
+
+    /// `struct __kernel_timespec`
+    #[repr(C)]
+    #[derive(Debug, Default)]
+    pub struct KernelTimespec {
+        pub tv_sec: i64,
+        pub tv_nsec: i64,
+    }
+
+    /// A shared mapping of ring memory
+    struct Mmap {
+        ptr: *mut u8,
+        len: usize,
+    }
+
+    impl Mmap {
+        fn new(fd: RawFd, offset: libc::off_t, len: usize) -> io::Result<Self> {
+            // SAFETY: a fresh shared mapping of the ring fd, checked below
+            let ptr = unsafe {
+                libc::mmap(
+                    ptr::null_mut(),
+                    len,
+                    libc::PROT_READ | libc::PROT_WRITE,
+                    libc::MAP_SHARED | libc::MAP_POPULATE,
+                    fd,
+                    offset,
+                )
+            };
+            if ptr == libc::MAP_FAILED {
+                return Err(io::Error::last_os_error());
+            }
+            Ok(Self {
+                ptr: ptr.cast(),
+                len,
+            })
+        }
+
+        /// Pointer to a kernel-provided offset within the mapping
+        fn at<T>(&self, offset: u32) -> *mut T {
+            debug_assert!(offset as usize + size_of::<T>() <= self.len);
+            // SAFETY: offsets come from the kernel and lie within the mapping
+            unsafe { self.ptr.add(offset as usize).cast() }
+        }
+    }
+
+    impl Drop for Mmap {
+        fn drop(&mut self) {
+            // SAFETY: unmaps exactly what `new` mapped
+            unsafe {
+                libc::munmap(self.ptr.cast(), self.len);
+            }
+        }
+    }
+
+    /// An io_uring instance owned by a single thread at a time
+    pub struct Ring {
+        sq_head: *const AtomicU32,
+        sq_tail: *const AtomicU32,
+        sq_mask: u32,
+        sq_entries: u32,
+        sqes: *mut Sqe,
+        cq_head: *const AtomicU32,
+        cq_tail: *const AtomicU32,
+        cq_mask: u32,
+        cqes: *const Cqe,
+        /// Entries queued but not yet passed to the kernel
+        unsubmitted: u32,
+        _maps: [Mmap; 3],
+        fd: OwnedFd,
+    }
+
+    // SAFETY: the ring pointers are only used through `&mut self`
+    unsafe impl Send for Ring {}
+
+    impl Ring {
+        /// Set up a ring with room for `entries` submissions
+        pub fn new(entries: u32) -> io::Result<Self> {
+            let mut params = Params::default();
+            // SAFETY: `params` outlives the call
+            let fd = unsafe {
+                libc::syscall(
+                    libc::SYS_io_uring_setup,
+                    entries,
+                    &mut params as *mut Params,
+                )
+            };
+            if fd < 0 {
+                return Err(io::Error::last_os_error());
+            }
+            // SAFETY: the kernel just handed us this descriptor
+            let fd = unsafe { OwnedFd::from_raw_fd(fd as RawFd) };
+
+            if params.features & FEAT_REG_REG_RING == 0 {
+                return Err(io::Error::new(
+                    io::ErrorKind::Unsupported,
+                    "kernel too old for io_uring transport",
+                ));
+            }
+
+            let raw = fd.as_raw_fd();
+            let sq_map = Mmap::new(
+                raw,
+                OFF_SQ_RING,
+                params.sq_off.array as usize + params.sq_entries as usize * size_of::<u32>(),
+            )?;
+            let cq_map = Mmap::new(
+                raw,
+                OFF_CQ_RING,
+                params.cq_off.cqes as usize + params.cq_entries as usize * size_of::<Cqe>(),
+            )?;
+            let sqe_map = Mmap::new(raw, OFF_SQES, params.sq_entries as usize * size_of::<Sqe>())?;
+
+            // SAFETY: all offsets are the kernel's, inside the mappings
+            unsafe {
+                // Submission slots map one-to-one onto entries
+                let array: *mut u32 = sq_map.at(params.sq_off.array);
+                for index in 0..params.sq_entries {
+                    array.add(index as usize).write(index);
+                }
+
+                Ok(Self {
+                    sq_head: sq_map.at(params.sq_off.head),
+                    sq_tail: sq_map.at(params.sq_off.tail),
+                    sq_mask: *sq_map.at::<u32>(params.sq_off.ring_mask),
+                    sq_entries: params.sq_entries,
+                    sqes: sqe_map.at(0),
+                    cq_head: cq_map.at(params.cq_off.head),
+                    cq_tail: cq_map.at(params.cq_off.tail),
+                    cq_mask: *cq_map.at::<u32>(params.cq_off.ring_mask),
+                    cqes: cq_map.at(params.cq_off.cqes),
+                    unsubmitted: 0,
+                    _maps: [sq_map, cq_map, sqe_map],
+                    fd,
+                })
+            }
+        }
+
+        /// Queue a submission; nothing reaches the kernel until `submit`
+        ///
+        /// # Safety
+        ///
+        /// Any memory the entry points to must stay valid until its
+        /// completion has been reaped.
+        pub unsafe fn push(&mut self, sqe: Sqe) -> io::Result<()> {
+            let head = (*self.sq_head).load(Ordering::Acquire);
+            let tail = (*self.sq_tail).load(Ordering::Relaxed);
+            if tail.wrapping_sub(head) >= self.sq_entries {
+                return Err(io::Error::new(
+                    io::ErrorKind::Other,
+                    "io_uring submission queue full",
+                ));
+            }
+
+            self.sqes.add((tail & self.sq_mask) as usize).write(sqe);
+            (*self.sq_tail).store(tail.wrapping_add(1), Ordering::Release);
+            self.unsubmitted += 1;
+            Ok(())
+        }
+
+        /// Pass queued submissions to the kernel and wait for `wait`
+        /// completions
+        pub fn submit(&mut self, wait: u32) -> io::Result<()> {
+            let flags = if wait > 0 { ENTER_GETEVENTS } else { 0 };
+            loop {
+                // SAFETY: plain syscall on our own ring
+                let submitted = unsafe {
+                    libc::syscall(
+                        libc::SYS_io_uring_enter,
+                        self.fd.as_raw_fd(),
+                        self.unsubmitted,
+                        wait,
+                        flags,
+                        ptr::null::<libc::sigset_t>(),
+                        0usize,
+                    )
+                };
+                if submitted >= 0 {
+                    self.unsubmitted -= submitted as u32;
+                    return Ok(());
+                }
+
+                let error = io::Error::last_os_error();
+                if error.kind() != io::ErrorKind::Interrupted {
+                    return Err(error);
+                }
+            }
+        }
+
+        /// Take the next completion, if any
+        pub fn pop(&mut self) -> Option<Cqe> {
+            // SAFETY: head and tail point into the mapped completion ring
+            unsafe {
+                let head = (*self.cq_head).load(Ordering::Relaxed);
+                if head == (*self.cq_tail).load(Ordering::Acquire) {
+                    return None;
+                }
+                let cqe = self.cqes.add((head & self.cq_mask) as usize).read();
+                (*self.cq_head).store(head.wrapping_add(1), Ordering::Release);
+                Some(cqe)
+            }
+        }
+    }
+}
+
+#[cfg(all(target_os = "linux", feature = "io-uring"))]
+mod linux {
+    use super::sys::{
+        Cqe, KernelTimespec, Ring, Sqe, OP_ASYNC_CANCEL, OP_RECV, OP_SEND, OP_TIMEOUT, SQE_IO_LINK,
+    };
+    use crate::buffer::{BufferPool, FrameBuffer};
+    use crate::protocol::{MessageType, Protocol, ProtocolError, HEADER_SIZE};
+
+    use std::io;
+    use std::net::TcpStream;
+    use std::os::fd::{AsRawFd, RawFd};
+    use std::sync::Arc;
+    use std::time::Duration;
+
+    // Completion tags; the first three are tracked while in flight
+    const HEADER: u64 = 1 << 0;
+    const PAYLOAD: u64 = 1 << 1;
+    const SEND: u64 = 1 << 2;
+    const TIMER: u64 = 1 << 3;
+    const CANCEL: u64 = 1 << 4;
+
+    /// Socket I/O for one connection through its own ring
+    ///
+    /// Borrows the connection's descriptor: it must be dropped before the
+    /// `TcpStream` it was created from, which is why connections declare it
+    /// first.
+    pub(crate) struct UringStream {
+        ring: Ring,
+        fd: RawFd,
+        timeout: Option<Duration>,
+        timespec: KernelTimespec,
+        /// Target of the read of the next header, which may be in flight
+        header: Box<[u8; HEADER_SIZE]>,
+        /// Tags of operations the kernel has not completed yet
+        in_flight: u64,
+        /// Completions reaped while waiting for something else
+        reaped: Vec<Cqe>,
+    }
+
+    impl UringStream {
+        pub(crate) fn new(stream: &TcpStream, timeout: Option<Duration>) -> io::Result<Self> {
+            Ok(Self {
+                ring: Ring::new(8)?,
+                fd: stream.as_raw_fd(),
+                timeout,
+                timespec: KernelTimespec::default(),
+                header: Box::new([0; HEADER_SIZE]),
+                in_flight: 0,
+                reaped: Vec::new(),
+            })
+        }
+
+        /// Read the next message into a buffer taken from `pool`
+        ///
+        /// The payload read is linked to a read of the following header, so
+        /// the next call usually finds its header already there. Messages
+        /// followed by data read outside the ring (striped payloads, stripe
+        /// setup) are not linked, leaving the socket to plain reads.
+        pub(crate) fn read_pooled(
+            &mut self,
+            protocol: &Protocol,
+            pool: &BufferPool,
+        ) -> Result<(MessageType, FrameBuffer), ProtocolError> {
+            // The header read linked to the previous payload may still be
+            // running, or may have completed while we waited for that payload
+            if self.in_flight & HEADER == 0 && !self.is_reaped(HEADER) {
+                self.push_header(0)?;
+            }
+            let received = self.finish(HEADER)?;
+            expect_len(received, HEADER_SIZE)?;
+            let (_, msg_type, payload_size) = protocol.read_header(&mut &self.header[..])?;
+
+            let link_next = !matches!(
+                msg_type,
+                MessageType::StripedFrame | MessageType::StripeSetup
+            );
+
+            let mut payload = pool.take(payload_size);
+            if payload_size > 0 {
+                let sqe = Sqe {
+                    opcode: OP_RECV,
+                    flags: if link_next { SQE_IO_LINK } else { 0 },
+                    fd: self.fd,
+                    addr: payload.as_mut_ptr() as u64,
+                    len: payload_size as u32,
+                    op_flags: libc::MSG_WAITALL as u32,
+                    user_data: PAYLOAD,
+                    ..Sqe::default()
+                };
+                // SAFETY: `payload` is not freed until the read completed
+                unsafe { self.push(sqe)? };
+            }
+            if link_next {
+                self.push_header(0)?;
+            }
+
+            if payload_size == 0 {
+                self.ring.submit(0)?;
+            } else {
+                match self.finish(PAYLOAD) {
+                    Ok(received) => expect_len(received, payload_size)?,
+                    Err(e) => {
+                        if self.in_flight & PAYLOAD != 0 {
+                            // The kernel may still write into it
+                            std::mem::forget(payload);
+                        }
+                        return Err(e.into());
+                    }
+                }
+            }
+
+            Ok((msg_type, pool.wrap(payload)))
+        }
+
+        /// Write a whole encoded message
+        pub(crate) fn send_all(&mut self, bytes: &Arc<Vec<u8>>) -> io::Result<()> {
+            let mut sent = 0;
+            while sent < bytes.len() {
+                let sqe = Sqe {
+                    opcode: OP_SEND,
+                    fd: self.fd,
+                    addr: bytes[sent..].as_ptr() as u64,
+                    len: (bytes.len() - sent).min(u32::MAX as usize) as u32,
+                    op_flags: (libc::MSG_WAITALL | libc::MSG_NOSIGNAL) as u32,
+                    user_data: SEND,
+                    ..Sqe::default()
+                };
+                // SAFETY: `bytes` outlives the send, or is leaked below
+                unsafe { self.push(sqe)? };
+
+                match self.finish(SEND) {
+                    Ok(0) => return Err(io::ErrorKind::WriteZero.into()),
+                    Ok(written) => sent += written,
+                    Err(e) => {
+                        if self.in_flight & SEND != 0 {
+                            std::mem::forget(Arc::clone(bytes));
+                        }
+                        return Err(e);
+                    }
+                }
+            }
+            Ok(())
+        }
+
+        /// Queue a read of the next message header
+        fn push_header(&mut self, flags: u8) -> io::Result<()> {
+            let sqe = Sqe {
+                opcode: OP_RECV,
+                flags,
+                fd: self.fd,
+                addr: self.header.as_mut_ptr() as u64,
+                len: HEADER_SIZE as u32,
+                op_flags: libc::MSG_WAITALL as u32,
+                user_data: HEADER,
+                ..Sqe::default()
+            };
+            // SAFETY: the header buffer lives as long as `self`, and is
+            // leaked on drop if the read cannot be cancelled
+            unsafe { self.push(sqe) }
+        }
+
+        /// Whether a completion for `tag` is waiting to be picked up
+        fn is_reaped(&self, tag: u64) -> bool {
+            self.reaped.iter().any(|cqe| cqe.user_data == tag)
+        }
+
+        /// Queue a submission and track it as in flight
+        unsafe fn push(&mut self, sqe: Sqe) -> io::Result<()> {
+            let tag = sqe.user_data;
+            self.ring.push(sqe)?;
+            self.in_flight |= tag & (HEADER | PAYLOAD | SEND);
+            Ok(())
+        }
+
+        /// Wait for an operation, cancelling it if the timeout expires
+        ///
+        /// Returns the byte count the operation completed with. A header
+        /// read that times out stays queued for the next call.
+        fn finish(&mut self, tag: u64) -> io::Result<usize> {
+            let result = match self.wait(tag) {
+                Ok(Some(res)) => return completion(res),
+                Ok(None) => Err(io::Error::new(
+                    io::ErrorKind::TimedOut,
+                    "io_uring operation timed out",
+                )),
+                Err(e) => Err(e),
+            };
+
+            if tag != HEADER {
+                self.cancel(tag)?;
+            }
+            result
+        }
+
+        /// Wait for a completion, or `None` once the timeout expired
+        fn wait(&mut self, tag: u64) -> io::Result<Option<i32>> {
+            let mut timer_armed = false;
+
+            loop {
+                if let Some(index) = self.reaped.iter().position(|cqe| cqe.user_data == tag) {
+                    return Ok(Some(self.reaped.swap_remove(index).res));
+                }
+
+                while let Some(cqe) = self.ring.pop() {
+                    match cqe.user_data {
+                        TIMER if timer_armed && cqe.res == -libc::ETIME => return Ok(None),
+                        // A timer also completes once any other completion
+                        // arrives; re-arm it if we are still waiting
+                        TIMER => timer_armed = false,
+                        CANCEL => {}
+                        _ => {
+                            self.in_flight &= !cqe.user_data;
+                            self.reaped.push(cqe);
+                        }
+                    }
+                }
+                if self.is_reaped(tag) {
+                    continue;
+                }
+
+                if let (Some(timeout), false) = (self.timeout, timer_armed) {
+                    self.timespec = KernelTimespec {
+                        tv_sec: timeout.as_secs() as i64,
+                        tv_nsec: timeout.subsec_nanos() as i64,
+                    };
+                    let sqe = Sqe {
+                        opcode: OP_TIMEOUT,
+                        fd: -1,
+                        addr: &self.timespec as *const KernelTimespec as u64,
+                        len: 1,
+                        // Also complete after one other completion
+                        off: 1,
+                        user_data: TIMER,
+                        ..Sqe::default()
+                    };
+                    // SAFETY: the kernel copies the timespec on submission
+                    unsafe { self.ring.push(sqe)? };
+                    timer_armed = true;
+                }
+                self.ring.submit(1)?;
+            }
+        }
+
+        /// Cancel an operation and wait until the kernel lets go of it
+        fn cancel(&mut self, tag: u64) -> io::Result<()> {
+            if self.in_flight & tag == 0 {
+                return Ok(());
+            }
+
+            let sqe = Sqe {
+                opcode: OP_ASYNC_CANCEL,
+                fd: -1,
+                addr: tag,
+                user_data: CANCEL,
+                ..Sqe::default()
+            };
+            // SAFETY: cancellation points at no memory
+            unsafe { self.ring.push(sqe)? };
+
+            let timeout = self.timeout.take();
+            let result = self.wait(tag);
+            self.timeout = timeout;
+            result.map(|_| ())
+        }
+    }
+
+    impl Drop for UringStream {
+        fn drop(&mut self) {
+            for tag in [HEADER, PAYLOAD, SEND] {
+                let _ = self.cancel(tag);
+            }
+            if self.in_flight & HEADER != 0 {
+                // Never hand memory back that the kernel may still write to
+                std::mem::forget(std::mem::replace(
+                    &mut self.header,
+                    Box::new([0; HEADER_SIZE]),
+                ));
+            }
+        }
+    }
+
+    /// Turn a completion result into a byte count
+    fn completion(res: i32) -> io::Result<usize> {
+        if res < 0 {
+            Err(io::Error::from_raw_os_error(-res))
+        } else {
+            Ok(res as usize)
+        }
+    }
+
+    /// A `MSG_WAITALL` read only comes up short when the peer went away
+    fn expect_len(received: usize, expected: usize) -> io::Result<()> {
+        if received < expected {
+            return Err(io::ErrorKind::UnexpectedEof.into());
+        }
+        Ok(())
+    }
+
+    #[cfg(test)]
+    mod tests {
+        use super::*;
+        use crate::protocol::EncodedMessage;
+        use std::net::TcpListener;
+
+        #[test]
+        fn test_uring_round_trip_and_timeout() {
+            if !crate::uring::IoBackend::uring_available() {
+                return;
+            }
+
+            let listener = TcpListener::bind("127.0.0.1:0").unwrap();
+            let client = TcpStream::connect(listener.local_addr().unwrap()).unwrap();
+            let (server, _) = listener.accept().unwrap();
+
+            let timeout = Some(Duration::from_millis(100));
+            let mut sender = UringStream::new(&client, timeout).unwrap();
+            let mut receiver = UringStream::new(&server, timeout).unwrap();
+            let protocol = Protocol::default();
+            let pool = BufferPool::new(2);
+
+            let heartbeat = protocol.create_heartbeat();
+            let end = protocol.create_end_of_stream();
+            for message in [&heartbeat, &end, &heartbeat] {
+                let encoded = EncodedMessage::from_message(message);
+                sender.send_all(&encoded.bytes).unwrap();
+            }
+
+            let (first, _) = receiver.read_pooled(&protocol, &pool).unwrap();
+            let (second, _) = receiver.read_pooled(&protocol, &pool).unwrap();
+            let (third, _) = receiver.read_pooled(&protocol, &pool).unwrap();
+            assert_eq!(first, MessageType::Heartbeat);
+            assert_eq!(second, MessageType::EndOfStream);
+            assert_eq!(third, MessageType::Heartbeat);
+
+            // Nothing more to read: the header read times out but stays queued
+            let error = receiver.read_pooled(&protocol, &pool).unwrap_err();
+            assert!(
+                matches!(error, ProtocolError::Io(ref e) if e.kind() == io::ErrorKind::TimedOut)
+            );
+
+            let payload = vec![7u8; 1 << 20];
+            let frame = EncodedMessage::from_message(&crate::protocol::NetworkMessage::new(
+                MessageType::MeshFrame,
+                payload.clone(),
+            ));
+            sender.send_all(&frame.bytes).unwrap();
+            let (msg_type, received) = receiver.read_pooled(&protocol, &pool).unwrap();
+            assert_eq!(msg_type, MessageType::MeshFrame);
+            assert_eq!(&received[..], &payload[..]);
+        }
+    }
+}
+
+/// Stand-in where io_uring is not compiled in; never constructed
+#[cfg(not(all(target_os = "linux", feature = "io-uring")))]
+mod fallback {
+    use crate::buffer::{BufferPool, FrameBuffer};
+    use crate::protocol::{MessageType, Protocol, ProtocolError};
+
+    use std::io;
+    use std::net::TcpStream;
+    use std::sync::Arc;
+    use std::time::Duration;
+
+    pub(crate) enum UringStream {}
+
+    impl UringStream {
+        pub(crate) fn new(_stream: &TcpStream, _timeout: Option<Duration>) -> io::Result<Self> {
+            Err(io::Error::new(
+                io::ErrorKind::Unsupported,
+                "built without the io-uring feature",
+            ))
+        }
+
+        pub(crate) fn read_pooled(
+            &mut self,
+            _protocol: &Protocol,
+            _pool: &BufferPool,
+        ) -> Result<(MessageType, FrameBuffer), ProtocolError> {
+            match *self {}
+        }
+
+        pub(crate) fn send_all(&mut self, _bytes: &Arc<Vec<u8>>) -> io::Result<()> {
+            match *self {}
+        }
+    }
+}
@@ -0,0 +1,422 @@
+//! Scalar-field volume frames
+//!
+//! Level-set and density solvers hold a scalar field on a regular grid and
+//! extract a surface from it only to ship it. A [`VolumeFrame`] sends the
+//! field instead: samples are quantized to 16 bits over the frame's value
+//! range, and a sparse frame leaves out the blocks that hold nothing but
+//! the background value, which for a narrow-band level set is most of the
+//! domain. The receiver extracts the surface itself (see
+//! [`crate::isosurface`]) and can move the iso-value without another frame
+//! from the simulation.
+//!
+//! Senders whose receiver did not agree to
+//! [`FEATURE_VOLUME_FRAMES`](crate::handshake::FEATURE_VOLUME_FRAMES)
+//! extract the surface at the frame's iso-value and send that instead.
+
+use crate::isosurface::{IsoSurface, ScalarField};
+use crate::lod;
+use crate::protocol::{EncodedMessage, MessageType, NetworkMessage, ProtocolError};
+use crate::types::{DomainBounds, FrameHeader, MeshFrame};
+
+use serde::{Deserialize, Serialize};
+use std::collections::HashMap;
+
+/// Largest quantized sample
+const QUANTIZED_MAX: f32 = u16::MAX as f32;
+
+/// Most blocks a sparse volume may have, counting those left out
+const MAX_BLOCKS: u64 = 1 << 24;
+
+/// Largest side of a sparse block, in samples
+pub const MAX_BLOCK_SIZE: u32 = 64;
+
+/// Most samples a volume grid may have
+pub const MAX_SAMPLES: u64 = 1 << 30;
+
+/// Placement of a sample grid in the domain
+#[derive(Debug, Clone, Copy, PartialEq, Serialize, Deserialize)]
+pub struct VolumeGrid {
+    /// Position of the first sample
+    pub origin: [f32; 3],
+    /// Distance between neighbouring samples along each axis
+    pub spacing: [f32; 3],
+    /// Samples along each axis
+    pub dims: [u32; 3],
+}
+
+impl VolumeGrid {
+    /// Total number of samples
+    pub fn sample_count(&self) -> usize {
+        self.dims.iter().map(|&d| d as usize).product()
+    }
+
+    /// Whether the grid has at least two samples along each axis and at
+    /// most [`MAX_SAMPLES`] in all
+    pub fn is_valid(&self) -> bool {
+        self.dims.iter().all(|&d| d >= 2)
+            && self.dims.iter().map(|&d| d as u64).product::<u64>() <= MAX_SAMPLES
+    }
+
+    /// Extent of the grid in the domain
+    pub fn bounds(&self) -> DomainBounds {
+        let mut max = self.origin;
+        for axis in 0..3 {
+            max[axis] += self.spacing[axis] * (self.dims[axis].max(1) - 1) as f32;
+        }
+        DomainBounds {
+            min: self.origin,
+            max,
+        }
+    }
+}
+
+/// How [`VolumeFrame::from_values`] lays out the samples
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum VolumeLayout {
+    /// Every sample, x fastest
+    Dense,
+    /// Cubes of `block_size` samples a side, leaving out background blocks
+    Sparse { block_size: u32 },
+}
+
+/// Quantized samples of a volume frame
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub enum VolumeSamples {
+    /// Every sample, x fastest
+    Dense(Vec<u16>),
+    /// Only the blocks that differ from a background value
+    Sparse {
+        /// Samples per block side
+        block_size: u32,
+        /// Value of every sample in the blocks left out
+        background: u16,
+        /// Blocks that are not all background
+        blocks: Vec<VolumeBlock>,
+    },
+}
+
+/// One block of a sparse volume
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct VolumeBlock {
+    /// Position of the block, in blocks
+    pub position: [u32; 3],
+    /// `block_size³` samples, x fastest and repeating the last sample past
+    /// the end of the grid, or a single one for a constant block
+    pub samples: Vec<u16>,
+}
+
+/// A scalar field the receiver extracts a surface from
+///
+/// Starts with the same fields as a frame, so its header decodes like one.
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct VolumeFrame {
+    /// Simulation identifier
+    pub simulation_id: String,
+    /// Frame number
+    pub frame_number: u32,
+    /// Timestamp
+    pub timestamp: u64,
+    /// Placement of the samples
+    pub grid: VolumeGrid,
+    /// Values of quantized samples 0 and 65535
+    pub range: [f32; 2],
+    /// Value to extract the surface at unless the viewer picks another
+    pub iso_value: f32,
+    /// Quantized samples
+    pub samples: VolumeSamples,
+}
+
+impl VolumeFrame {
+    /// Quantize a field given as one value per sample, x fastest
+    ///
+    /// The quantization range is that of the finite values; others are
+    /// clamped to it.
+    pub fn from_values(
+        simulation_id: String,
+        frame_number: u32,
+        grid: VolumeGrid,
+        values: &[f32],
+        iso_value: f32,
+        layout: VolumeLayout,
+    ) -> Result<Self, ProtocolError> {
+        if !grid.is_valid() || values.len() != grid.sample_count() {
+            return Err(ProtocolError::InvalidFormat);
+        }
+        if let VolumeLayout::Sparse { block_size } = layout {
+            if block_size > MAX_BLOCK_SIZE {
+                return Err(ProtocolError::InvalidFormat);
+            }
+        }
+
+        let workers = lod::default_workers();
+        let (min, max) = lod::parallel_ranges(values.len(), workers, |range| {
+            values[range]
+                .iter()
+                .filter(|v| v.is_finite())
+                .fold((f32::INFINITY, f32::NEG_INFINITY), |(min, max), &v| {
+                    (min.min(v), max.max(v))
+                })
+        })
+        .into_iter()
+        .fold((f32::INFINITY, f32::NEG_INFINITY), |(min, max), (a, b)| {
+            (min.min(a), max.max(b))
+        });
+        let (min, max) = match (min.is_finite(), max > min) {
+            (false, _) => (0.0, 1.0),
+            (true, false) => (min, min + 1.0),
+            (true, true) => (min, max),
+        };
+        let scale = QUANTIZED_MAX / (max - min);
+        let quantize = |v: f32| ((v - min) * scale).round().clamp(0.0, QUANTIZED_MAX) as u16;
+
+        let samples = match layout {
+            VolumeLayout::Dense => VolumeSamples::Dense(
+                lod::parallel_ranges(values.len(), workers, |range| {
+                    values[range]
+                        .iter()
+                        .map(|&v| quantize(v))
+                        .collect::<Vec<_>>()
+                })
+                .concat(),
+            ),
+            VolumeLayout::Sparse { block_size } => {
+                sparse_blocks(&grid, block_size.max(1), |i| quantize(values[i]), workers)
+            }
+        };
+
+        Ok(Self {
+            simulation_id,
+            frame_number,
+            timestamp: 0,
+            grid,
+            range: [min, max],
+            iso_value,
+            samples,
+        })
+    }
+
+    /// Value of a quantized sample
+    pub fn dequantize(&self, sample: u16) -> f32 {
+        let [min, max] = self.range;
+        min + sample as f32 * ((max - min) / QUANTIZED_MAX)
+    }
+
+    /// Check the samples against the grid
+    pub fn validate(&self) -> Result<(), ProtocolError> {
+        let [min, max] = self.range;
+        if !self.grid.is_valid() || !(min.is_finite() && max.is_finite() && max > min) {
+            return Err(ProtocolError::InvalidFormat);
+        }
+
+        let valid = match &self.samples {
+            VolumeSamples::Dense(samples) => samples.len() == self.grid.sample_count(),
+            VolumeSamples::Sparse {
+                block_size, blocks, ..
+            } => {
+                let block = *block_size as usize;
+                let blocks_per_axis = self.grid.dims.map(|d| d.div_ceil((*block_size).max(1)));
+                (1..=MAX_BLOCK_SIZE).contains(block_size)
+                    && blocks_per_axis.iter().map(|&b| b as u64).product::<u64>() <= MAX_BLOCKS
+                    && blocks.iter().all(|b| {
+                        (b.samples.len() == 1 || b.samples.len() == block * block * block)
+                            && (0..3).all(|axis| b.position[axis] < blocks_per_axis[axis])
+                    })
+            }
+        };
+        if valid {
+            Ok(())
+        } else {
+            Err(ProtocolError::InvalidFormat)
+        }
+    }
+
+    /// Extract the surface at `iso_value` as an indexed mesh with normals
+    pub fn extract_surface(&self, iso_value: f32) -> Result<MeshFrame, ProtocolError> {
+        let field = ScalarField::from_volume(self)?;
+        let mut mesh = IsoSurface::new(field, lod::default_workers()).extract(iso_value);
+        mesh.simulation_id.clone_from(&self.simulation_id);
+        mesh.frame_number = self.frame_number;
+        mesh.timestamp = self.timestamp;
+        Ok(mesh)
+    }
+
+    /// Header of the frame
+    pub fn header(&self) -> FrameHeader {
+        FrameHeader {
+            simulation_id: self.simulation_id.clone(),
+            frame_number: self.frame_number,
+            timestamp: self.timestamp,
+        }
+    }
+
+    /// Create the message carrying this volume
+    pub fn to_message(&self) -> Result<NetworkMessage, ProtocolError> {
+        Ok(NetworkMessage::new(
+            MessageType::VolumeFrame,
+            bincode::serialize(self)?,
+        ))
+    }
+
+    /// Create the message carrying this volume, already in its wire encoding
+    pub fn to_encoded(&self) -> Result<EncodedMessage, ProtocolError> {
+        EncodedMessage::bincode(MessageType::VolumeFrame, self)
+    }
+
+    /// Parse a volume payload
+    pub fn from_payload(payload: &[u8]) -> Result<Self, ProtocolError> {
+        Ok(bincode::deserialize(payload)?)
+    }
+}
+
+/// Decode only the header of a volume payload
+pub fn decode_header(payload: &[u8]) -> Result<FrameHeader, ProtocolError> {
+    Ok(bincode::deserialize(payload)?)
+}
+
+/// Split quantized samples into blocks, leaving out the most common
+/// constant block
+fn sparse_blocks(
+    grid: &VolumeGrid,
+    block_size: u32,
+    sample: impl Fn(usize) -> u16 + Sync,
+    workers: usize,
+) -> VolumeSamples {
+    let block = block_size as usize;
+    let dims = grid.dims.map(|d| d as usize);
+    let blocks_per_axis = dims.map(|d| d.div_ceil(block));
+    let count: usize = blocks_per_axis.iter().product();
+
+    let mut blocks: Vec<VolumeBlock> = lod::parallel_ranges(count, workers, |range| {
+        range
+            .map(|index| {
+                let position = [
+                    index % blocks_per_axis[0],
+                    index / blocks_per_axis[0] % blocks_per_axis[1],
+                    index / (blocks_per_axis[0] * blocks_per_axis[1]),
+                ];
+                let start = position.map(|p| p * block);
+                let mut samples = Vec::with_capacity(block * block * block);
+                for z in 0..block {
+                    let z = (start[2] + z).min(dims[2] - 1);
+                    for y in 0..block {
+                        let y = (start[1] + y).min(dims[1] - 1);
+                        let row = (z * dims[1] + y) * dims[0];
+                        samples.extend(
+                            (0..block).map(|x| sample(row + (start[0] + x).min(dims[0] - 1))),
+                        );
+                    }
+                }
+                if samples.iter().all(|&s| s == samples[0]) {
+                    samples.truncate(1);
+                }
+                VolumeBlock {
+                    position: position.map(|p| p as u32),
+                    samples,
+                }
+            })
+            .collect::<Vec<_>>()
+    })
+    .concat();
+
+    let mut constants: HashMap<u16, usize> = HashMap::new();
+    for block in blocks.iter().filter(|block| block.samples.len() == 1) {
+        *constants.entry(block.samples[0]).or_default() += 1;
+    }
+    let background = constants
+        .into_iter()
+        .max_by_key(|&(value, count)| (count, value))
+        .map_or(0, |(value, _)| value);
+    blocks.retain(|block| block.samples != [background]);
+
+    VolumeSamples::Sparse {
+        block_size,
+        background,
+        blocks,
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_sparse_volume_round_trip() {
+        let grid = VolumeGrid {
+            origin: [0.0; 3],
+            spacing: [0.5; 3],
+            dims: [20, 12, 9],
+        };
+        // A slab of varying values in an otherwise constant field
+        let values: Vec<f32> = (0..grid.sample_count())
+            .map(|i| if i % 20 < 3 { (i % 7) as f32 } else { 10.0 })
+            .collect();
+        let volume = VolumeFrame::from_values(
+            "sim".to_string(),
+            3,
+            grid,
+            &values,
+            5.0,
+            VolumeLayout::Sparse { block_size: 4 },
+        )
+        .unwrap();
+        volume.validate().unwrap();
+
+        let VolumeSamples::Sparse { blocks, .. } = &volume.samples else {
+            panic!("not sparse");
+        };
+        // Only the column of blocks along x = 0 is sent
+        assert_eq!(blocks.len(), 3 * 3);
+
+        let decoded = VolumeFrame::from_payload(&volume.to_message().unwrap().payload).unwrap();
+        assert_eq!(decoded, volume);
+        let header = decode_header(&volume.to_message().unwrap().payload).unwrap();
+        assert_eq!(header.frame_number, 3);
+
+        let field = ScalarField::from_volume(&decoded).unwrap();
+        let step = (volume.range[1] - volume.range[0]) / QUANTIZED_MAX;
+        for (i, &value) in values.iter().enumerate() {
+            let [x, y, z] = [i % 20, i / 20 % 12, i / 240];
+            assert!((field.sample(x, y, z) - value).abs() <= step, "sample {i}");
+        }
+    }
+
+    #[test]
+    fn test_oversized_volumes_are_rejected() {
+        let grid = VolumeGrid {
+            origin: [0.0; 3],
+            spacing: [1.0; 3],
+            dims: [4, 4, 4],
+        };
+        let values = vec![1.0; grid.sample_count()];
+        let sparse = |block_size| {
+            VolumeFrame::from_values(
+                "sim".to_string(),
+                0,
+                grid,
+                &values,
+                0.5,
+                VolumeLayout::Sparse { block_size },
+            )
+        };
+        assert!(sparse(MAX_BLOCK_SIZE).is_ok());
+        assert!(matches!(
+            sparse(MAX_BLOCK_SIZE + 1),
+            Err(ProtocolError::InvalidFormat)
+        ));
+
+        // A peer may claim any block size or grid for a few bytes of payload
+        let mut volume = sparse(4).unwrap();
+        let VolumeSamples::Sparse { block_size, .. } = &mut volume.samples else {
+            panic!("not sparse");
+        };
+        *block_size = 1 << 20;
+        assert!(volume.validate().is_err());
+        assert!(ScalarField::from_volume(&volume).is_err());
+
+        // Few enough blocks, but too many samples in all
+        let mut volume = sparse(MAX_BLOCK_SIZE).unwrap();
+        volume.grid.dims = [1 << 11; 3];
+        assert!(volume.validate().is_err());
+        assert!(ScalarField::from_volume(&volume).is_err());
+    }
+}
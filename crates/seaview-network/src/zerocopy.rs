@@ -0,0 +1,409 @@
+//! Zero-copy transmit of large messages on Linux
+//!
+//! With the `zerocopy` feature and [`SenderConfig::zerocopy_threshold`]
+//! set, large messages are sent with `MSG_ZEROCOPY`: the kernel transmits
+//! straight from the encoded message instead of copying it into socket
+//! buffers first. The kernel reads the pages after `send` returns, so every
+//! message sent this way stays pinned (through its shared `Arc`) until the
+//! completion notification on the socket error queue releases it. Only
+//! then can its allocation be freed or reused.
+//!
+//! Where the kernel copies anyway, as on loopback or with NICs lacking
+//! scatter-gather, the notifications say so and the connection goes back
+//! to plain sends, which are cheaper in that case.
+//!
+//! [`SenderConfig::zerocopy_threshold`]: crate::sender::SenderConfig::zerocopy_threshold
+
+use std::net::TcpStream;
+use tracing::{debug, warn};
+
+/// Set up zero-copy sends for a new connection if a threshold is configured
+///
+/// Returns `None` when zero-copy is off, not compiled in, or refused by the
+/// socket.
+pub(crate) fn attach(threshold: Option<usize>, stream: &TcpStream) -> Option<ZeroCopy> {
+    let threshold = threshold?;
+    match ZeroCopy::new(stream, threshold) {
+        Ok(zerocopy) => {
+            debug!("Zero-copy sends enabled from {} bytes", threshold);
+            Some(zerocopy)
+        }
+        Err(e) => {
+            warn!("Zero-copy sends unavailable: {}", e);
+            None
+        }
+    }
+}
+
+#[cfg(all(target_os = "linux", feature = "zerocopy"))]
+pub(crate) use linux::ZeroCopy;
+
+#[cfg(not(all(target_os = "linux", feature = "zerocopy")))]
+pub(crate) use fallback::ZeroCopy;
+
+#[cfg(all(target_os = "linux", feature = "zerocopy"))]
+mod linux {
+    use std::collections::VecDeque;
+    use std::io::{self, Write};
+    use std::mem::size_of_val;
+    use std::net::TcpStream;
+    use std::os::fd::AsRawFd;
+    use std::sync::Arc;
+    use std::time::{Duration, Instant};
+    use tracing::debug;
+
+    /// `SO_EE_ORIGIN_ZEROCOPY` from `linux/errqueue.h`
+    const SO_EE_ORIGIN_ZEROCOPY: u8 = 5;
+    /// `SO_EE_CODE_ZEROCOPY_COPIED`: the kernel fell back to copying
+    const SO_EE_CODE_ZEROCOPY_COPIED: u8 = 1;
+
+    /// Bytes allowed to wait for completion before sends block
+    const MAX_PENDING_BYTES: usize = 256 * 1024 * 1024;
+    /// Consecutive copied completions before giving up on zero-copy
+    const COPIED_LIMIT: u32 = 8;
+
+    /// A message the kernel may still be reading from
+    struct Pending {
+        /// One past the last send sequence number used for it
+        end: u32,
+        bytes: Arc<Vec<u8>>,
+    }
+
+    /// Zero-copy sends on one connection, with completion tracking
+    pub(crate) struct ZeroCopy {
+        /// Shares the connection's socket
+        stream: TcpStream,
+        threshold: usize,
+        /// Sequence number of the next zero-copy send
+        next_seq: u32,
+        /// Every send before this sequence number has completed
+        completed: u32,
+        /// Completed ranges that arrived ahead of `completed`
+        ahead: Vec<(u32, u32)>,
+        pending: VecDeque<Pending>,
+        pending_bytes: usize,
+        /// Completions in a row that the kernel served by copying
+        copied: u32,
+        enabled: bool,
+    }
+
+    impl ZeroCopy {
+        pub(crate) fn new(stream: &TcpStream, threshold: usize) -> io::Result<Self> {
+            let stream = stream.try_clone()?;
+            let one: libc::c_int = 1;
+            // SAFETY: plain setsockopt with a c_int option value
+            let result = unsafe {
+                libc::setsockopt(
+                    stream.as_raw_fd(),
+                    libc::SOL_SOCKET,
+                    libc::SO_ZEROCOPY,
+                    &one as *const libc::c_int as *const libc::c_void,
+                    size_of_val(&one) as libc::socklen_t,
+                )
+            };
+            if result != 0 {
+                return Err(io::Error::last_os_error());
+            }
+
+            Ok(Self {
+                stream,
+                threshold,
+                next_seq: 0,
+                completed: 0,
+                ahead: Vec::new(),
+                pending: VecDeque::new(),
+                pending_bytes: 0,
+                copied: 0,
+                enabled: true,
+            })
+        }
+
+        /// Whether a message of `len` bytes should go out zero-copy
+        pub(crate) fn applies(&self, len: usize) -> bool {
+            self.enabled && len >= self.threshold
+        }
+
+        /// Number of messages the kernel has not released yet
+        pub(crate) fn pending(&self) -> usize {
+            self.pending.len()
+        }
+
+        /// Send a whole encoded message without copying it
+        ///
+        /// The message is kept alive until the kernel reports it sent.
+        pub(crate) fn send(&mut self, bytes: &Arc<Vec<u8>>) -> io::Result<()> {
+            self.reap()?;
+            if self.pending_bytes + bytes.len() > MAX_PENDING_BYTES {
+                self.wait_until(None, |zerocopy| {
+                    zerocopy.pending_bytes + bytes.len() <= MAX_PENDING_BYTES
+                        || zerocopy.pending.is_empty()
+                })?;
+            }
+
+            let first_seq = self.next_seq;
+            let result = self.send_from(bytes);
+
+            // Pin the message for every send that went out zero-copy, even
+            // if a later part of it failed
+            if self.next_seq != first_seq {
+                self.pending_bytes += bytes.len();
+                self.pending.push_back(Pending {
+                    end: self.next_seq,
+                    bytes: Arc::clone(bytes),
+                });
+            }
+            result
+        }
+
+        /// Wait until the kernel has released every message, up to `timeout`
+        ///
+        /// Returns whether everything was released in time.
+        pub(crate) fn flush(&mut self, timeout: Option<Duration>) -> io::Result<bool> {
+            self.wait_until(timeout, |zerocopy| zerocopy.pending.is_empty())
+        }
+
+        fn send_from(&mut self, bytes: &[u8]) -> io::Result<()> {
+            let fd = self.stream.as_raw_fd();
+            let mut offset = 0;
+            let mut retried = false;
+
+            while offset < bytes.len() {
+                let rest = &bytes[offset..];
+                // SAFETY: `rest` stays valid until the completion, see `send`
+                let sent = unsafe {
+                    libc::send(
+                        fd,
+                        rest.as_ptr().cast(),
+                        rest.len(),
+                        libc::MSG_ZEROCOPY | libc::MSG_NOSIGNAL,
+                    )
+                };
+                if sent >= 0 {
+                    offset += sent as usize;
+                    self.next_seq = self.next_seq.wrapping_add(1);
+                    continue;
+                }
+
+                let error = io::Error::last_os_error();
+                match error.raw_os_error() {
+                    Some(libc::EINTR) => {}
+                    // Too many notifications outstanding: let some complete,
+                    // then copy what is left if that did not help
+                    Some(libc::ENOBUFS) if !retried => {
+                        retried = true;
+                        self.wait_until(Some(Duration::from_millis(100)), |zerocopy| {
+                            zerocopy.completed == zerocopy.next_seq
+                        })?;
+                    }
+                    Some(libc::ENOBUFS) => return (&self.stream).write_all(rest),
+                    _ => return Err(error),
+                }
+            }
+            Ok(())
+        }
+
+        /// Reap completions until `done` holds or the timeout expires
+        fn wait_until(
+            &mut self,
+            timeout: Option<Duration>,
+            done: impl Fn(&Self) -> bool,
+        ) -> io::Result<bool> {
+            let deadline = timeout.map(|timeout| Instant::now() + timeout);
+
+            loop {
+                self.reap()?;
+                if done(self) {
+                    return Ok(true);
+                }
+
+                let wait_ms = match deadline {
+                    Some(deadline) => {
+                        let left = deadline.saturating_duration_since(Instant::now());
+                        if left.is_zero() {
+                            return Ok(false);
+                        }
+                        left.as_millis().clamp(1, i32::MAX as u128) as libc::c_int
+                    }
+                    None => -1,
+                };
+
+                // Notifications raise POLLERR, which poll always reports
+                let mut poll = libc::pollfd {
+                    fd: self.stream.as_raw_fd(),
+                    events: 0,
+                    revents: 0,
+                };
+                // SAFETY: polls a single descriptor we own
+                if unsafe { libc::poll(&mut poll, 1, wait_ms) } < 0 {
+                    let error = io::Error::last_os_error();
+                    if error.kind() != io::ErrorKind::Interrupted {
+                        return Err(error);
+                    }
+                }
+                if poll.revents & libc::POLLHUP != 0 && !done(self) {
+                    self.reap()?;
+                    return Ok(done(self));
+                }
+            }
+        }
+
+        /// Read completion notifications and release finished messages
+        fn reap(&mut self) -> io::Result<()> {
+            let fd = self.stream.as_raw_fd();
+
+            loop {
+                let mut control = [0u64; 16];
+                // SAFETY: an all-zero msghdr is valid; only the control
+                // buffer is filled in
+                let mut message: libc::msghdr = unsafe { std::mem::zeroed() };
+                message.msg_control = control.as_mut_ptr().cast();
+                message.msg_controllen = size_of_val(&control) as _;
+
+                // SAFETY: `message` points at live buffers
+                let received = unsafe {
+                    libc::recvmsg(fd, &mut message, libc::MSG_ERRQUEUE | libc::MSG_DONTWAIT)
+                };
+                if received < 0 {
+                    let error = io::Error::last_os_error();
+                    match error.kind() {
+                        io::ErrorKind::WouldBlock => break,
+                        io::ErrorKind::Interrupted => continue,
+                        _ => return Err(error),
+                    }
+                }
+
+                // SAFETY: walks the control messages the kernel wrote
+                unsafe {
+                    let mut cmsg = libc::CMSG_FIRSTHDR(&message);
+                    while !cmsg.is_null() {
+                        let level = (*cmsg).cmsg_level;
+                        let kind = (*cmsg).cmsg_type;
+                        if (level == libc::SOL_IP && kind == libc::IP_RECVERR)
+                            || (level == libc::SOL_IPV6 && kind == libc::IPV6_RECVERR)
+                        {
+                            let error: libc::sock_extended_err =
+                                std::ptr::read_unaligned(libc::CMSG_DATA(cmsg).cast());
+                            if error.ee_origin == SO_EE_ORIGIN_ZEROCOPY && error.ee_errno == 0 {
+                                self.complete(
+                                    error.ee_info,
+                                    error.ee_data,
+                                    error.ee_code & SO_EE_CODE_ZEROCOPY_COPIED != 0,
+                                );
+                            }
+                        }
+                        cmsg = libc::CMSG_NXTHDR(&message, cmsg);
+                    }
+                }
+            }
+
+            // Sequence numbers wrap, so compare by distance
+            while let Some(front) = self.pending.front() {
+                if front.end.wrapping_sub(self.completed) as i32 > 0 {
+                    break;
+                }
+                self.pending_bytes -= front.bytes.len();
+                self.pending.pop_front();
+            }
+            Ok(())
+        }
+
+        /// Record that sends `first..=last` completed
+        fn complete(&mut self, first: u32, last: u32, copied: bool) {
+            if copied {
+                self.copied += 1;
+                if self.copied == COPIED_LIMIT && self.enabled {
+                    debug!("Kernel copies zero-copy sends on this route, using plain sends");
+                    self.enabled = false;
+                }
+            } else {
+                self.copied = 0;
+            }
+
+            self.ahead.push((first, last.wrapping_add(1)));
+            // Advance over every range that now joins up
+            while let Some(index) = self
+                .ahead
+                .iter()
+                .position(|&(start, _)| start.wrapping_sub(self.completed) as i32 <= 0)
+            {
+                let (_, end) = self.ahead.swap_remove(index);
+                if end.wrapping_sub(self.completed) as i32 > 0 {
+                    self.completed = end;
+                }
+            }
+        }
+    }
+
+    #[cfg(test)]
+    mod tests {
+        use super::*;
+        use std::io::Read;
+        use std::net::TcpListener;
+
+        #[test]
+        fn test_buffers_released_after_completion() {
+            let listener = TcpListener::bind("127.0.0.1:0").unwrap();
+            let client = TcpStream::connect(listener.local_addr().unwrap()).unwrap();
+            let (mut server, _) = listener.accept().unwrap();
+
+            let mut zerocopy = ZeroCopy::new(&client, 0).unwrap();
+            let reader = std::thread::spawn(move || {
+                let mut received = Vec::new();
+                server.read_to_end(&mut received).unwrap();
+                received
+            });
+
+            let message = Arc::new((0..4 << 20).map(|i| i as u8).collect::<Vec<u8>>());
+            for _ in 0..3 {
+                zerocopy.send(&message).unwrap();
+            }
+            assert!(zerocopy.flush(Some(Duration::from_secs(5))).unwrap());
+            assert_eq!(zerocopy.pending(), 0);
+            assert_eq!(Arc::strong_count(&message), 1);
+
+            client.shutdown(std::net::Shutdown::Write).unwrap();
+            drop(zerocopy);
+            let received = reader.join().unwrap();
+            assert_eq!(received.len(), 3 * message.len());
+            assert!(received
+                .chunks(message.len())
+                .all(|chunk| chunk == &message[..]));
+        }
+    }
+}
+
+/// Stand-in where zero-copy is not compiled in; never constructed
+#[cfg(not(all(target_os = "linux", feature = "zerocopy")))]
+mod fallback {
+    use std::io;
+    use std::net::TcpStream;
+    use std::sync::Arc;
+    use std::time::Duration;
+
+    pub(crate) enum ZeroCopy {}
+
+    impl ZeroCopy {
+        pub(crate) fn new(_stream: &TcpStream, _threshold: usize) -> io::Result<Self> {
+            Err(io::Error::new(
+                io::ErrorKind::Unsupported,
+                "built without the zerocopy feature",
+            ))
+        }
+
+        pub(crate) fn applies(&self, _len: usize) -> bool {
+            match *self {}
+        }
+
+        pub(crate) fn pending(&self) -> usize {
+            match *self {}
+        }
+
+        pub(crate) fn send(&mut self, _bytes: &Arc<Vec<u8>>) -> io::Result<()> {
+            match *self {}
+        }
+
+        pub(crate) fn flush(&mut self, _timeout: Option<Duration>) -> io::Result<bool> {
+            match *self {}
+        }
+    }
+}
@@ -1,8 +1,16 @@
 //! Integration tests for seaview-network
 
 use seaview_network::{
-    DomainBounds, MeshFrame, MeshReceiver, MeshSender, NonBlockingMeshReceiver, ReceiverConfig,
+    DeltaConfig, DomainBounds, FrameEncoding, IndexCompression, IndexSlice, IoBackend, LodConfig,
+    LodTarget, MeshFrame, MeshReceiver, MeshRelay, MeshSender, MessageType,
+    NonBlockingMeshReceiver, PointFrame, PointScalars, ProgressiveConfig, Protocol, RateLimit,
+    ReceiverConfig, ReconnectConfig, Region, RegionOfInterest, SenderConfig, VolumeFrame,
+    VolumeGrid, VolumeLayout, WireFormat,
 };
+use seaview_network::columnar;
+use seaview_network::handshake::{self, Capabilities};
+use seaview_network::stripe::{self, StripeSetup};
+use std::net::{TcpListener, TcpStream};
 use std::sync::mpsc;
 use std::thread;
 use std::time::Duration;
@@ -48,6 +56,12 @@ fn test_simple_send_receive() {
     assert_eq!(received.frame.frame_number, 42);
     assert_eq!(received.frame.vertices, mesh.vertices);
     assert_eq!(received.frame.timestamp, 123456);
+
+    // Taking the frame out leaves clones untouched
+    let shared = received.clone();
+    let frame = received.into_frame();
+    assert_eq!(frame.vertices, mesh.vertices);
+    assert_eq!(shared.frame().vertices, mesh.vertices);
 }
 
 #[test]
@@ -137,6 +151,48 @@ fn test_non_blocking_receiver() {
     assert_eq!(received.frame.simulation_id, "non-blocking");
 }
 
+#[test]
+fn test_non_blocking_receiver_declines_striping() {
+    let mut receiver = NonBlockingMeshReceiver::bind("127.0.0.1:0").expect("Failed to bind");
+    let addr = receiver.local_addr().expect("Failed to get address");
+    let protocol = Protocol::default();
+
+    let mut stream = TcpStream::connect(addr).expect("Failed to connect");
+    let setup = StripeSetup {
+        session_id: 9,
+        stripe_count: 4,
+    };
+    protocol
+        .write_message(
+            &mut stream,
+            &stripe::create_message(MessageType::StripeSetup, &setup).unwrap(),
+        )
+        .unwrap();
+    let mut mesh = MeshFrame::new("unstriped".to_string(), 1);
+    mesh.vertices = vec![0.0; 9];
+    protocol
+        .write_message(&mut stream, &protocol.serialize_mesh(&mesh).unwrap())
+        .unwrap();
+
+    // The session goes on over the one connection
+    let mut received = None;
+    for _ in 0..100 {
+        received = receiver.try_receive().expect("Try receive failed");
+        if received.is_some() {
+            break;
+        }
+        thread::sleep(Duration::from_millis(10));
+    }
+    assert_eq!(
+        received.expect("Expected mesh").frame.simulation_id,
+        "unstriped"
+    );
+
+    let reply = protocol.read_message(&mut stream).expect("No stripe reply");
+    let reply: StripeSetup = stripe::parse_message(&reply.payload).unwrap();
+    assert_eq!(reply.stripe_count, 1);
+}
+
 #[test]
 fn test_heartbeat() {
     let mut receiver = MeshReceiver::bind("127.0.0.1:0").expect("Failed to bind");
@@ -191,6 +247,7 @@ fn test_custom_config() {
             recv_buffer_size: Some(2 * 1024 * 1024),
             read_timeout: Some(Duration::from_secs(10)),
             accept_timeout: Some(Duration::from_secs(5)),
+            ..Default::default()
         };
 
         let mut receiver =
@@ -204,6 +261,8 @@ fn test_custom_config() {
             send_buffer_size: Some(2 * 1024 * 1024),
             connect_timeout: Some(Duration::from_secs(5)),
             write_timeout: Some(Duration::from_secs(10)),
+            reconnect: None,
+            ..SenderConfig::default()
         };
 
         thread::spawn(move || {
@@ -278,7 +337,8 @@ fn test_sender_stats() {
         sender.send_mesh(&mesh).expect("Failed to send");
 
         if i == 2 {
-            // Check stats on the last sender
+            // Check stats on the last sender, once the frame is written
+            sender.flush().expect("Failed to flush");
             let stats = sender.stats();
             assert_eq!(stats.frames_sent, 1);
             assert!(stats.bytes_sent > 0);
@@ -321,3 +381,1177 @@ fn test_timeout_config() {
     assert!(elapsed >= Duration::from_millis(100));
     assert!(elapsed < Duration::from_secs(1));
 }
+
+#[test]
+fn test_persistent_connection() {
+    let mut receiver = MeshReceiver::bind("127.0.0.1:0").expect("Failed to bind");
+    let addr = receiver.local_addr().expect("Failed to get address");
+
+    // One sender streams several frames over a single connection
+    thread::spawn(move || {
+        let mut sender = MeshSender::connect(addr).expect("Failed to connect");
+        for i in 0..3 {
+            let mut mesh = MeshFrame::new("persistent".to_string(), i);
+            mesh.vertices = vec![0.0; 9];
+            sender.send_mesh(&mesh).expect("Failed to send");
+        }
+        sender.shutdown().expect("Failed to shut down");
+    });
+
+    for i in 0..3 {
+        let received = receiver.receive_one().expect("Failed to receive");
+        assert_eq!(received.frame.frame_number, i);
+    }
+}
+
+#[test]
+fn test_relay_fan_out() {
+    let mut viewers = Vec::new();
+    for _ in 0..2 {
+        viewers.push(MeshReceiver::bind("127.0.0.1:0").expect("Failed to bind"));
+    }
+
+    let mut relay = MeshRelay::bind("127.0.0.1:0").expect("Failed to bind relay");
+    let relay_addr = relay.local_addr().expect("Failed to get address");
+    let handle = relay.handle();
+    for viewer in &viewers {
+        handle
+            .add_subscriber(viewer.local_addr().unwrap())
+            .expect("Failed to add subscriber");
+    }
+    let relay_thread = thread::spawn(move || relay.relay_one());
+
+    // The solver connects once and sends each frame once
+    let mut sender = MeshSender::connect(relay_addr).expect("Failed to connect");
+    for i in 0..3 {
+        let mut mesh = MeshFrame::new("relayed".to_string(), i);
+        mesh.vertices = vec![i as f32; 9];
+        sender.send_mesh(&mesh).expect("Failed to send");
+    }
+    sender.shutdown().expect("Failed to shut down");
+    relay_thread
+        .join()
+        .expect("Relay thread failed")
+        .expect("Relay failed");
+
+    for viewer in &mut viewers {
+        for i in 0..3 {
+            let received = viewer.receive_one().expect("Failed to receive");
+            assert_eq!(received.frame.frame_number, i);
+            assert_eq!(received.frame.vertices[0], i as f32);
+        }
+    }
+
+    let stats = handle.stats();
+    assert_eq!(stats.frames_relayed, 3);
+    assert_eq!(stats.messages_dropped, 0);
+}
+
+#[test]
+fn test_relay_forwards_full_resolution_requests() {
+    let mut viewer = MeshReceiver::bind("127.0.0.1:0").expect("Failed to bind");
+    let mut relay = MeshRelay::bind("127.0.0.1:0").expect("Failed to bind relay");
+    let relay_addr = relay.local_addr().expect("Failed to get address");
+    relay
+        .handle()
+        .add_subscriber(viewer.local_addr().unwrap())
+        .expect("Failed to add subscriber");
+    let relay_thread = thread::spawn(move || relay.relay_one());
+
+    // A bare upstream, to see what the relay passes on
+    let protocol = Protocol::default();
+    let mut upstream = TcpStream::connect(relay_addr).expect("Failed to connect");
+    let mut mesh = MeshFrame::new("forwarded".to_string(), 0);
+    mesh.vertices = vec![0.0; 9];
+    protocol
+        .write_message(&mut upstream, &protocol.serialize_mesh(&mesh).unwrap())
+        .unwrap();
+    viewer.receive_one().expect("Failed to receive");
+
+    viewer
+        .request_full_resolution()
+        .expect("Failed to request full resolution");
+    upstream
+        .set_read_timeout(Some(Duration::from_secs(5)))
+        .unwrap();
+    let request = protocol
+        .read_message(&mut upstream)
+        .expect("Request not forwarded");
+    assert_eq!(request.msg_type, MessageType::FullResolutionRequest);
+
+    drop(upstream);
+    relay_thread
+        .join()
+        .expect("Relay thread failed")
+        .expect("Relay failed");
+}
+
+#[test]
+fn test_relay_late_join_and_range_request() {
+    let mut relay = MeshRelay::bind("127.0.0.1:0").expect("Failed to bind relay");
+    let relay_addr = relay.local_addr().expect("Failed to get address");
+    let handle = relay.handle();
+    let relay_thread = thread::spawn(move || relay.relay_one());
+
+    // The simulation streams five frames before any viewer is attached
+    let mut sender = MeshSender::connect(relay_addr).expect("Failed to connect");
+    for i in 0..5 {
+        let mut mesh = MeshFrame::new("late-join".to_string(), i);
+        mesh.vertices = vec![i as f32; 9];
+        sender.send_mesh(&mesh).expect("Failed to send");
+    }
+    sender.shutdown().expect("Failed to shut down");
+    relay_thread
+        .join()
+        .expect("Relay thread failed")
+        .expect("Relay failed");
+    assert_eq!(handle.cached_frame_range(), Some((0, 4)));
+
+    // A late viewer is replayed the cached frames straight away
+    let mut viewer = MeshReceiver::bind("127.0.0.1:0").expect("Failed to bind");
+    handle
+        .add_subscriber(viewer.local_addr().unwrap())
+        .expect("Failed to add subscriber");
+    for i in 0..5 {
+        let received = viewer.receive_one().expect("Failed to receive");
+        assert_eq!(received.frame.frame_number, i);
+    }
+
+    // And can scrub back to a specific range
+    viewer
+        .request_frames(1, 2)
+        .expect("Failed to request frames");
+    for i in 1..=2 {
+        let received = viewer.receive_one().expect("Failed to receive");
+        assert_eq!(received.frame.frame_number, i);
+        assert_eq!(received.frame.vertices[0], i as f32);
+    }
+}
+
+#[test]
+fn test_sender_reconnects_and_replays() {
+    let mut receiver = MeshReceiver::bind("127.0.0.1:0").expect("Failed to bind");
+    let addr = receiver.local_addr().expect("Failed to get address");
+
+    let config = SenderConfig {
+        reconnect: Some(ReconnectConfig {
+            initial_backoff: Duration::from_millis(10),
+            max_backoff: Duration::from_millis(50),
+            replay_frames: 4,
+            ..ReconnectConfig::default()
+        }),
+        ..Default::default()
+    };
+    let mut sender = MeshSender::connect_with_config(addr, config).expect("Failed to connect");
+
+    let frame = |i: u32| {
+        let mut mesh = MeshFrame::new("reconnect".to_string(), i);
+        mesh.vertices = vec![i as f32; 9];
+        mesh
+    };
+
+    sender.send_mesh(&frame(0)).expect("Failed to send");
+    assert_eq!(receiver.receive_one().unwrap().frame.frame_number, 0);
+
+    // The viewer goes away; sending keeps succeeding without blocking
+    drop(receiver);
+    for i in 1..8 {
+        sender
+            .send_mesh(&frame(i))
+            .expect("Send failed during outage");
+        thread::sleep(Duration::from_millis(5));
+    }
+    assert!(sender.stats().frames_dropped > 0);
+
+    // The viewer comes back on the same address
+    let mut receiver = MeshReceiver::bind(addr).expect("Failed to rebind");
+    let start = std::time::Instant::now();
+    while !sender.is_connected() {
+        assert!(
+            start.elapsed() < Duration::from_secs(5),
+            "Never reconnected"
+        );
+        thread::sleep(Duration::from_millis(10));
+    }
+    assert_eq!(sender.stats().reconnects, 1);
+
+    // The most recent frames are replayed, ending with the latest one
+    let replayed: Vec<u32> = (0..4)
+        .map(|_| receiver.receive_one().unwrap().frame.frame_number)
+        .collect();
+    assert_eq!(replayed, vec![4, 5, 6, 7]);
+
+    sender.send_mesh(&frame(8)).expect("Failed to send");
+    assert_eq!(receiver.receive_one().unwrap().frame.frame_number, 8);
+}
+
+#[test]
+fn test_replay_waits_for_hello_answer() {
+    let listener = TcpListener::bind("127.0.0.1:0").expect("Failed to bind");
+    let addr = listener.local_addr().expect("Failed to get address");
+    let protocol = Protocol::default();
+    let local = Capabilities::new(WireFormat::default(), 1024 * 1024, 0);
+
+    let config = SenderConfig {
+        reconnect: Some(ReconnectConfig {
+            initial_backoff: Duration::from_millis(10),
+            max_backoff: Duration::from_millis(50),
+            replay_frames: 4,
+            ..ReconnectConfig::default()
+        }),
+        ..Default::default()
+    };
+    let mut sender = MeshSender::connect_with_config(addr, config).expect("Failed to connect");
+    let frame = |i: u32| {
+        let mut mesh = MeshFrame::new("replay".to_string(), i);
+        mesh.vertices = vec![i as f32; 9];
+        mesh
+    };
+
+    let (mut stream, _) = listener.accept().expect("Failed to accept");
+    let hello = protocol.read_message(&mut stream).expect("No hello");
+    assert_eq!(hello.msg_type, MessageType::Hello);
+    handshake::answer_hello(&protocol, &local, &mut stream, &hello.payload).unwrap();
+    sender.send_mesh(&frame(0)).expect("Failed to send");
+    assert_eq!(
+        protocol.read_message(&mut stream).unwrap().msg_type,
+        MessageType::MeshFrame
+    );
+
+    // The viewer goes away while frames keep coming; give the writer time to
+    // notice, frames written before that are lost with the connection
+    drop(stream);
+    thread::sleep(Duration::from_millis(100));
+    for i in 1..4 {
+        sender
+            .send_mesh(&frame(i))
+            .expect("Send failed during outage");
+        thread::sleep(Duration::from_millis(20));
+    }
+
+    // Nothing is replayed before the hello on the new connection is answered
+    let (mut stream, _) = listener.accept().expect("Failed to accept");
+    let hello = protocol.read_message(&mut stream).expect("No hello");
+    assert_eq!(hello.msg_type, MessageType::Hello);
+    stream
+        .set_read_timeout(Some(Duration::from_millis(200)))
+        .unwrap();
+    assert!(protocol.read_message(&mut stream).is_err());
+    stream.set_read_timeout(None).unwrap();
+
+    handshake::answer_hello(&protocol, &local, &mut stream, &hello.payload).unwrap();
+    let replayed: Vec<u32> = (0..3)
+        .map(|_| {
+            let message = protocol.read_message(&mut stream).unwrap();
+            protocol
+                .decode_frame(message.msg_type, &message.payload)
+                .unwrap()
+                .frame_number
+        })
+        .collect();
+    assert_eq!(replayed, vec![1, 2, 3]);
+}
+
+#[test]
+fn test_stalled_receiver_blocks_sender() {
+    let listener = TcpListener::bind("127.0.0.1:0").expect("Failed to bind");
+    let addr = listener.local_addr().expect("Failed to get address");
+
+    let config = SenderConfig {
+        negotiate: false,
+        write_timeout: Some(Duration::from_millis(500)),
+        reconnect: None,
+        ..Default::default()
+    };
+    let mut sender = MeshSender::connect_with_config(addr, config).expect("Failed to connect");
+    // Accepted but never read from
+    let (stream, _) = listener.accept().expect("Failed to accept");
+
+    // Sending waits for the writer instead of dropping frames, until the
+    // write times out and the error reaches the caller
+    let start = std::time::Instant::now();
+    let result = (0..256).try_for_each(|i| {
+        let mut mesh = MeshFrame::new("stalled".to_string(), i);
+        mesh.vertices = vec![i as f32; 9 * 20_000];
+        sender.send_mesh(&mesh)
+    });
+    assert!(result.is_err());
+    assert!(start.elapsed() >= Duration::from_millis(500));
+    assert_eq!(sender.stats().frames_dropped, 0);
+    drop(stream);
+}
+
+#[test]
+fn test_striped_frames() {
+    let mut receiver = MeshReceiver::bind("127.0.0.1:0").expect("Failed to bind");
+    let addr = receiver.local_addr().expect("Failed to get address");
+
+    let sender_thread = thread::spawn(move || {
+        let config = SenderConfig {
+            stripes: 4,
+            stripe_threshold: 64 * 1024,
+            ..Default::default()
+        };
+        let mut sender = MeshSender::connect_with_config(addr, config).expect("Failed to connect");
+
+        // Stripes are opened once the receiver has agreed to them
+        for _ in 0..200 {
+            if sender.negotiated().is_some() {
+                break;
+            }
+            thread::sleep(Duration::from_millis(10));
+        }
+
+        // One frame above the threshold, one below it
+        let mut large = MeshFrame::new("striped".to_string(), 0);
+        large.vertices = (0..300_000).map(|i| i as f32).collect();
+        sender
+            .send_mesh(&large)
+            .expect("Failed to send large frame");
+
+        let mut small = MeshFrame::new("striped".to_string(), 1);
+        small.vertices = vec![1.0; 9];
+        sender
+            .send_mesh(&small)
+            .expect("Failed to send small frame");
+        large
+    });
+
+    let first = receiver.receive_one().expect("Failed to receive");
+    let second = receiver.receive_one().expect("Failed to receive");
+    let large = sender_thread.join().unwrap();
+
+    assert_eq!(first.frame.frame_number, 0);
+    assert_eq!(first.frame.vertices, large.vertices);
+    assert_eq!(second.frame.frame_number, 1);
+}
+
+#[test]
+fn test_stripe_timeout_falls_back_to_one_connection() {
+    let config = ReceiverConfig {
+        stripe_timeout: Duration::from_millis(300),
+        ..Default::default()
+    };
+    let mut receiver =
+        MeshReceiver::bind_with_config("127.0.0.1:0", config).expect("Failed to bind");
+    let addr = receiver.local_addr().expect("Failed to get address");
+    let protocol = Protocol::default();
+    let frame = |name: &str| {
+        let mut mesh = MeshFrame::new(name.to_string(), 0);
+        mesh.vertices = vec![1.0; 9];
+        protocol.serialize_mesh(&mesh).unwrap()
+    };
+
+    // A striped session whose stripes never join, and another sender that
+    // connects while the receiver waits for them
+    let setup = StripeSetup {
+        session_id: 7,
+        stripe_count: 3,
+    };
+    let mut primary = TcpStream::connect(addr).expect("Failed to connect");
+    protocol
+        .write_message(
+            &mut primary,
+            &stripe::create_message(MessageType::StripeSetup, &setup).unwrap(),
+        )
+        .unwrap();
+    protocol
+        .write_message(&mut primary, &frame("primary"))
+        .unwrap();
+    thread::sleep(Duration::from_millis(50));
+    let mut other = TcpStream::connect(addr).expect("Failed to connect");
+    protocol.write_message(&mut other, &frame("other")).unwrap();
+
+    let first = receiver.receive_one().expect("Failed to receive");
+    assert_eq!(first.frame.simulation_id, "primary");
+
+    let reply = protocol
+        .read_message(&mut primary)
+        .expect("No stripe reply");
+    assert_eq!(reply.msg_type, MessageType::StripeSetup);
+    let reply: StripeSetup = stripe::parse_message(&reply.payload).unwrap();
+    assert_eq!(reply.session_id, 7);
+    assert_eq!(reply.stripe_count, 1);
+
+    // The other sender is served once the first one has gone
+    drop(primary);
+    let second = receiver.receive_one().expect("Failed to receive");
+    assert_eq!(second.frame.simulation_id, "other");
+}
+
+#[test]
+fn test_capability_negotiation() {
+    let mut receiver = MeshReceiver::bind("127.0.0.1:0").expect("Failed to bind");
+    let addr = receiver.local_addr().expect("Failed to get address");
+
+    let sender_thread = thread::spawn(move || {
+        let mut sender = MeshSender::connect(addr).expect("Failed to connect");
+        for i in 0..5 {
+            let mut mesh = MeshFrame::new("negotiated".to_string(), i);
+            mesh.vertices = vec![i as f32; 9];
+            sender.send_mesh(&mesh).expect("Failed to send");
+            thread::sleep(Duration::from_millis(20));
+        }
+        sender.negotiated()
+    });
+
+    // Frames sent before and after the switch arrive alike
+    for i in 0..5 {
+        let received = receiver.receive_one().expect("Failed to receive");
+        assert_eq!(received.frame.frame_number, i);
+        assert_eq!(received.frame.vertices, vec![i as f32; 9]);
+    }
+
+    let negotiated = sender_thread
+        .join()
+        .unwrap()
+        .expect("Receiver did not answer the hello");
+    assert_eq!(negotiated.encoding, FrameEncoding::Columnar);
+}
+
+#[test]
+fn test_negotiation_falls_back_for_old_receivers() {
+    let listener = TcpListener::bind("127.0.0.1:0").expect("Failed to bind");
+    let addr = listener.local_addr().expect("Failed to get address");
+
+    // Behaves like a receiver from before the handshake, which closes the
+    // connection on any message it does not know
+    let old_receiver = thread::spawn(move || {
+        let protocol = Protocol::default();
+        loop {
+            let (mut stream, _) = listener.accept().unwrap();
+            while let Ok(message) = protocol.read_message(&mut stream) {
+                match message.msg_type {
+                    MessageType::MeshFrame => {
+                        return protocol.deserialize_mesh(&message.payload).unwrap();
+                    }
+                    MessageType::Heartbeat => continue,
+                    _ => break,
+                }
+            }
+        }
+    });
+
+    let mut sender = MeshSender::connect(addr).expect("Failed to connect");
+    for i in 0..100 {
+        if old_receiver.is_finished() {
+            break;
+        }
+        let mut mesh = MeshFrame::new("legacy".to_string(), i);
+        mesh.vertices = vec![0.0; 9];
+        sender.send_mesh(&mesh).expect("Failed to send");
+        thread::sleep(Duration::from_millis(50));
+    }
+
+    let received = old_receiver.join().unwrap();
+    assert_eq!(received.simulation_id, "legacy");
+    assert!(sender.negotiated().is_none());
+}
+
+#[test]
+fn test_receive_frame_view() {
+    let mut receiver = MeshReceiver::bind("127.0.0.1:0").expect("Failed to bind");
+    let addr = receiver.local_addr().expect("Failed to get address");
+
+    thread::spawn(move || {
+        let mut sender = MeshSender::connect(addr).expect("Failed to connect");
+        for _ in 0..200 {
+            if sender.negotiated().is_some() {
+                break;
+            }
+            thread::sleep(Duration::from_millis(10));
+        }
+
+        let mut mesh = MeshFrame::new("view".to_string(), 3);
+        mesh.vertices = (0..900).map(|i| i as f32).collect();
+        mesh.normals = Some(vec![0.0; 900]);
+        sender.send_mesh(&mesh).expect("Failed to send");
+    });
+
+    let received = receiver.receive_frame().expect("Failed to receive");
+    assert_eq!(received.msg_type, MessageType::ColumnarFrame);
+
+    let view = received.view().expect("Columnar frame should be viewable");
+    assert_eq!(view.simulation_id, "view");
+    assert_eq!(view.frame_number, 3);
+    assert_eq!(view.vertex_count(), 300);
+    assert_eq!(view.vertices[899], 899.0);
+    assert_eq!(view.normals.map(<[f32]>::len), Some(900));
+
+    let owned = received.decode().expect("Failed to decode");
+    assert_eq!(owned.vertices, view.vertices);
+}
+
+#[test]
+fn test_shared_frame_subscribers() {
+    let receiver = MeshReceiver::bind("127.0.0.1:0").expect("Failed to bind");
+    let addr = receiver.local_addr().expect("Failed to get address");
+
+    let (subscribers, _handle) = receiver.run_shared();
+    let everything = subscribers.subscribe();
+    let ocean = subscribers.subscribe_stream("ocean");
+    assert_eq!(subscribers.len(), 2);
+
+    thread::spawn(move || {
+        let mut sender = MeshSender::connect(addr).expect("Failed to connect");
+        for (i, id) in ["ocean", "river", "ocean"].into_iter().enumerate() {
+            let mut mesh = MeshFrame::new(id.to_string(), i as u32);
+            mesh.vertices = vec![i as f32; 300];
+            sender.send_mesh(&mesh).expect("Failed to send");
+        }
+    });
+
+    let timeout = Duration::from_secs(5);
+    let all: Vec<_> = (0..3)
+        .map(|_| everything.recv_timeout(timeout).unwrap())
+        .collect();
+    let filtered: Vec<_> = (0..2)
+        .map(|_| ocean.recv_timeout(timeout).unwrap())
+        .collect();
+
+    // Both subscribers hold the very same buffers
+    assert!(std::sync::Arc::ptr_eq(&all[0], &filtered[0]));
+    assert!(std::sync::Arc::ptr_eq(&all[2], &filtered[1]));
+    assert_eq!(all[1].header().unwrap().simulation_id, "river");
+    assert_eq!(filtered[1].decode().unwrap().frame_number, 2);
+}
+
+#[test]
+fn test_io_uring_backend() {
+    // Falls back to blocking sockets where io_uring is unavailable
+    let config = ReceiverConfig {
+        io_backend: IoBackend::Uring,
+        read_timeout: Some(Duration::from_secs(5)),
+        ..Default::default()
+    };
+    let mut receiver =
+        MeshReceiver::bind_with_config("127.0.0.1:0", config).expect("Failed to bind");
+    let addr = receiver.local_addr().expect("Failed to get address");
+
+    thread::spawn(move || {
+        let config = SenderConfig {
+            io_backend: IoBackend::Uring,
+            ..SenderConfig::default()
+        };
+        let mut sender = MeshSender::connect_with_config(addr, config).expect("Failed to connect");
+        for i in 0..20 {
+            let mut mesh = MeshFrame::new("uring".to_string(), i);
+            mesh.vertices = vec![i as f32; 9 * (1 + i as usize * 1000)];
+            sender.send_mesh(&mesh).expect("Failed to send");
+            sender.send_heartbeat().expect("Failed to send heartbeat");
+        }
+    });
+
+    for i in 0..20 {
+        let received = receiver.receive_one().expect("Failed to receive");
+        assert_eq!(received.frame.frame_number, i);
+        assert_eq!(received.frame.vertices.len(), 9 * (1 + i as usize * 1000));
+        assert!(received.frame.vertices.iter().all(|&v| v == i as f32));
+    }
+}
+
+#[test]
+fn test_zerocopy_sender() {
+    let mut receiver = MeshReceiver::bind("127.0.0.1:0").expect("Failed to bind");
+    let addr = receiver.local_addr().expect("Failed to get address");
+
+    let sending = thread::spawn(move || {
+        let config = SenderConfig {
+            zerocopy_threshold: Some(64 * 1024),
+            ..SenderConfig::default()
+        };
+        let mut sender = MeshSender::connect_with_config(addr, config).expect("Failed to connect");
+        for i in 0..12 {
+            let mut mesh = MeshFrame::new("zerocopy".to_string(), i);
+            mesh.vertices = vec![i as f32; 9 * 20_000];
+            sender.send_mesh(&mesh).expect("Failed to send");
+        }
+        sender.flush().expect("Failed to flush");
+    });
+
+    for i in 0..12 {
+        let received = receiver.receive_one().expect("Failed to receive");
+        assert_eq!(received.frame.frame_number, i);
+        assert!(received.frame.vertices.iter().all(|&v| v == i as f32));
+    }
+    sending.join().expect("Sender thread panicked");
+}
+
+#[test]
+fn test_lod_streaming() {
+    let mut receiver = MeshReceiver::bind("127.0.0.1:0").expect("Failed to bind");
+    let addr = receiver.local_addr().expect("Failed to get address");
+
+    // A 100 x 100 quad grid
+    let mut mesh = MeshFrame::new("lod".to_string(), 0);
+    for y in 0..=100 {
+        for x in 0..=100 {
+            mesh.vertices.extend([x as f32, y as f32, 0.0]);
+        }
+    }
+    let indices: Vec<u32> = (0..100u32)
+        .flat_map(|y| (0..100u32).map(move |x| y * 101 + x))
+        .flat_map(|c| [c, c + 1, c + 101, c + 1, c + 102, c + 101])
+        .collect();
+    mesh.indices = Some(indices);
+    let full_triangles = mesh.triangle_count();
+
+    let frames = 40;
+    let sending = thread::spawn(move || {
+        let config = SenderConfig {
+            lod: Some(LodConfig {
+                target: LodTarget::Ratio(0.1),
+                full_every: 0,
+                workers: 2,
+            }),
+            ..SenderConfig::default()
+        };
+        let mut sender = MeshSender::connect_with_config(addr, config).expect("Failed to connect");
+        for i in 0..frames {
+            mesh.frame_number = i;
+            sender.send_mesh(&mesh).expect("Failed to send");
+            thread::sleep(Duration::from_millis(10));
+        }
+    });
+
+    // A new connection starts at full resolution, then drops to reduced
+    let first = receiver.receive_one().expect("Failed to receive");
+    assert_eq!(first.frame.triangle_count(), full_triangles);
+    let second = receiver.receive_one().expect("Failed to receive");
+    assert!(second.frame.triangle_count() <= full_triangles / 5);
+    assert!(second.frame.validate().is_ok());
+
+    // Asking for full resolution brings one more full frame
+    receiver
+        .request_full_resolution()
+        .expect("Failed to request full resolution");
+    let full = (2..frames)
+        .map(|_| receiver.receive_one().expect("Failed to receive"))
+        .filter(|received| received.frame.triangle_count() == full_triangles)
+        .count();
+    assert_eq!(full, 1);
+    sending.join().expect("Sender thread panicked");
+}
+
+#[test]
+fn test_progressive_frames() {
+    let mut receiver = MeshReceiver::bind("127.0.0.1:0").expect("Failed to bind");
+    let addr = receiver.local_addr().expect("Failed to get address");
+
+    // A 60 x 60 quad grid
+    let mut mesh = MeshFrame::new("progressive".to_string(), 0);
+    for y in 0..=60 {
+        for x in 0..=60 {
+            mesh.vertices.extend([x as f32, y as f32, 0.0]);
+        }
+    }
+    let indices: Vec<u32> = (0..60u32)
+        .flat_map(|y| (0..60u32).map(move |x| y * 61 + x))
+        .flat_map(|c| [c, c + 1, c + 61, c + 1, c + 62, c + 61])
+        .collect();
+    mesh.indices = Some(indices);
+    let full_triangles = mesh.triangle_count();
+
+    let frames = 5;
+    let sending = thread::spawn(move || {
+        let config = SenderConfig {
+            progressive: Some(ProgressiveConfig {
+                levels: vec![LodTarget::Ratio(0.02), LodTarget::Ratio(0.2)],
+                min_triangles: 1000,
+                workers: 2,
+            }),
+            ..SenderConfig::default()
+        };
+        let mut sender = MeshSender::connect_with_config(addr, config).expect("Failed to connect");
+        for i in 0..frames {
+            mesh.frame_number = i;
+            sender.send_mesh(&mesh).expect("Failed to send");
+            thread::sleep(Duration::from_millis(20));
+        }
+    });
+
+    // Once negotiated, each frame arrives coarse to fine, ending complete
+    let mut received = Vec::new();
+    loop {
+        let mesh = receiver.receive_one().expect("Failed to receive");
+        assert!(mesh.frame.validate().is_ok());
+        if mesh.level.is_none() {
+            assert_eq!(mesh.frame.triangle_count(), full_triangles);
+        } else {
+            assert!(mesh.frame.triangle_count() < full_triangles / 2);
+        }
+        received.push((mesh.frame.frame_number, mesh.level));
+        if mesh.frame.frame_number == frames - 1 && mesh.level.is_none() {
+            break;
+        }
+    }
+    sending.join().expect("Sender thread panicked");
+
+    let last = &received[received.len() - 3..];
+    assert_eq!(last[0].1.map(|l| (l.level, l.levels)), Some((0, 3)));
+    assert_eq!(last[1].1.map(|l| (l.level, l.levels)), Some((1, 3)));
+    assert!(last.iter().all(|(frame, _)| *frame == frames - 1));
+}
+
+#[test]
+fn test_region_of_interest() {
+    let mut receiver = MeshReceiver::bind("127.0.0.1:0").expect("Failed to bind");
+    let addr = receiver.local_addr().expect("Failed to get address");
+    receiver
+        .set_region_of_interest(Some(RegionOfInterest::new(Region::Aabb {
+            min: [0.0, 0.0, -1.0],
+            max: [9.5, 9.5, 1.0],
+        })))
+        .expect("Failed to subscribe");
+
+    // A 40 x 40 quad grid
+    let mut mesh = MeshFrame::new("roi".to_string(), 0);
+    for y in 0..=40 {
+        for x in 0..=40 {
+            mesh.vertices.extend([x as f32, y as f32, 0.0]);
+        }
+    }
+    let indices: Vec<u32> = (0..40u32)
+        .flat_map(|y| (0..40u32).map(move |x| y * 41 + x))
+        .flat_map(|c| [c, c + 1, c + 41, c + 1, c + 42, c + 41])
+        .collect();
+    mesh.indices = Some(indices);
+    let full_triangles = mesh.triangle_count();
+
+    let (stop_tx, stop_rx) = mpsc::channel();
+    let sending = thread::spawn(move || {
+        let mut sender = MeshSender::connect(addr).expect("Failed to connect");
+        let mut frame = 0;
+        while stop_rx.try_recv().is_err() {
+            mesh.frame_number = frame;
+            sender.send_mesh(&mesh).expect("Failed to send");
+            frame += 1;
+            thread::sleep(Duration::from_millis(10));
+        }
+    });
+
+    // The subscription reaches the sender as soon as it connects
+    let mut clipped = receiver.receive_one().expect("Failed to receive");
+    while clipped.frame.triangle_count() == full_triangles {
+        clipped = receiver.receive_one().expect("Failed to receive");
+    }
+    assert_eq!(clipped.frame.triangle_count(), 10 * 10 * 2);
+    assert!(clipped.frame.vertices.iter().all(|&v| v <= 10.0));
+
+    // Cancelling it brings back complete frames
+    receiver
+        .set_region_of_interest(None)
+        .expect("Failed to unsubscribe");
+    let mut complete = receiver.receive_one().expect("Failed to receive");
+    while complete.frame.triangle_count() != full_triangles {
+        complete = receiver.receive_one().expect("Failed to receive");
+    }
+    assert!(complete.frame.frame_number > clipped.frame.frame_number);
+
+    stop_tx.send(()).unwrap();
+    sending.join().expect("Sender thread panicked");
+}
+
+#[test]
+fn test_receiver_rate_limit() {
+    let mut receiver = MeshReceiver::bind("127.0.0.1:0").expect("Failed to bind");
+    let addr = receiver.local_addr().expect("Failed to get address");
+    receiver
+        .set_rate_limit(Some(RateLimit::every_nth(5)))
+        .expect("Failed to set rate limit");
+
+    let sending = thread::spawn(move || {
+        let mut sender = MeshSender::connect(addr).expect("Failed to connect");
+        for i in 0..60 {
+            let mut mesh = MeshFrame::new("rate".to_string(), i);
+            mesh.vertices = vec![i as f32; 9];
+            sender.send_mesh(&mesh).expect("Failed to send");
+            thread::sleep(Duration::from_millis(2));
+        }
+        sender.flush().expect("Failed to flush");
+        sender.stats()
+    });
+
+    // The limit is handed over when the connection is accepted
+    let first = receiver.receive_one().expect("Failed to receive");
+    let stats = sending.join().expect("Sender thread panicked");
+    assert_eq!(stats.frames_sent + stats.frames_skipped, 60);
+    assert!(stats.frames_skipped >= 40, "{stats:?}");
+
+    let mut previous = first.frame.frame_number;
+    for _ in 1..stats.frames_sent {
+        let received = receiver.receive_one().expect("Failed to receive");
+        let number = received.frame.frame_number;
+        assert!(number > previous);
+        previous = number;
+    }
+}
+
+#[test]
+fn test_partial_updates() {
+    let config = ReceiverConfig {
+        partial_updates: true,
+        ..ReceiverConfig::default()
+    };
+    let mut receiver =
+        MeshReceiver::bind_with_config("127.0.0.1:0", config).expect("Failed to bind");
+    let addr = receiver.local_addr().expect("Failed to get address");
+
+    let mut mesh = MeshFrame::new("partial".to_string(), 0);
+    mesh.vertices = (0..3000).map(|i| i as f32).collect();
+    mesh.indices = Some((0..999).collect());
+
+    let frames = 6;
+    let mut expected = Vec::new();
+    for i in 0..frames {
+        mesh.frame_number = i;
+        mesh.vertices[(i as usize * 150) * 3] = -(i as f32);
+        expected.push(mesh.vertices.clone());
+    }
+
+    let sending = thread::spawn(move || {
+        let config = SenderConfig {
+            partial_updates: Some(DeltaConfig {
+                block_vertices: 100,
+                ..DeltaConfig::default()
+            }),
+            ..SenderConfig::default()
+        };
+        let mut sender = MeshSender::connect_with_config(addr, config).expect("Failed to connect");
+        let mut mesh = mesh;
+        for i in 0..frames {
+            mesh.frame_number = i;
+            mesh.vertices = expected[i as usize].clone();
+            // The last frame says what changed, the others are compared
+            if i == frames - 1 {
+                let changed = i as usize * 150;
+                sender
+                    .send_mesh_dirty(&mesh, &[changed..changed + 1])
+                    .expect("Failed to send");
+            } else {
+                sender.send_mesh(&mesh).expect("Failed to send");
+            }
+            thread::sleep(Duration::from_millis(20));
+        }
+        expected
+    });
+
+    let mut received = Vec::new();
+    for _ in 0..frames {
+        received.push(receiver.receive_one().expect("Failed to receive"));
+    }
+    let expected = sending.join().expect("Sender thread panicked");
+
+    for (mesh, vertices) in received.iter().zip(&expected) {
+        assert_eq!(&mesh.frame.vertices, vertices);
+    }
+    // Once negotiated, frames arrive as the one block that changed
+    let last = received.last().unwrap();
+    assert_eq!(last.frame.frame_number, frames - 1);
+    assert_eq!(last.dirty, Some(vec![700..800]));
+    assert!(received[0].dirty.is_none());
+}
+
+#[test]
+fn test_partial_updates_not_replayed_to_legacy_receiver() {
+    let config = ReceiverConfig {
+        partial_updates: true,
+        ..ReceiverConfig::default()
+    };
+    let mut receiver =
+        MeshReceiver::bind_with_config("127.0.0.1:0", config).expect("Failed to bind");
+    let addr = receiver.local_addr().expect("Failed to get address");
+
+    let config = SenderConfig {
+        partial_updates: Some(DeltaConfig {
+            block_vertices: 100,
+            ..DeltaConfig::default()
+        }),
+        reconnect: Some(ReconnectConfig {
+            initial_backoff: Duration::from_millis(10),
+            max_backoff: Duration::from_millis(50),
+            replay_frames: 4,
+            ..ReconnectConfig::default()
+        }),
+        ..SenderConfig::default()
+    };
+    let mut sender = MeshSender::connect_with_config(addr, config).expect("Failed to connect");
+
+    let mut mesh = MeshFrame::new("legacy-reconnect".to_string(), 0);
+    mesh.vertices = (0..3000).map(|i| i as f32).collect();
+    mesh.indices = Some((0..999).collect());
+    let mut frame = |i: u32| {
+        mesh.frame_number = i;
+        mesh.vertices[(i as usize % 20) * 150] = -(i as f32);
+        mesh.clone()
+    };
+
+    // Once negotiated, frames go out as partial updates
+    let mut partial = false;
+    for i in 0..6 {
+        sender.send_mesh(&frame(i)).expect("Failed to send");
+        let received = receiver.receive_one().expect("Failed to receive");
+        partial |= received.dirty.is_some();
+        thread::sleep(Duration::from_millis(20));
+    }
+    assert!(partial);
+
+    // The viewer is replaced by one from before the handshake, which closes
+    // the connection on any message it does not know
+    drop(receiver);
+    for i in 6..8 {
+        sender
+            .send_mesh(&frame(i))
+            .expect("Send failed during outage");
+        thread::sleep(Duration::from_millis(5));
+    }
+    let listener = TcpListener::bind(addr).expect("Failed to rebind");
+    let old_receiver = thread::spawn(move || {
+        let protocol = Protocol::default();
+        let mut received = Vec::new();
+        loop {
+            let (mut stream, _) = listener.accept().unwrap();
+            while let Ok(message) = protocol.read_message(&mut stream) {
+                match message.msg_type {
+                    MessageType::MeshFrame => {
+                        let mesh = protocol.deserialize_mesh(&message.payload).unwrap();
+                        received.push(mesh.frame_number);
+                        if mesh.frame_number >= 8 {
+                            return Ok(received);
+                        }
+                    }
+                    MessageType::Heartbeat => continue,
+                    MessageType::PartialUpdate => return Err(received),
+                    _ => break,
+                }
+            }
+        }
+    });
+
+    for i in 8..100 {
+        if old_receiver.is_finished() {
+            break;
+        }
+        sender.send_mesh(&frame(i)).expect("Failed to send");
+        thread::sleep(Duration::from_millis(50));
+    }
+
+    // Only full frames were replayed, and the stream went on with full frames
+    let received = old_receiver
+        .join()
+        .unwrap()
+        .unwrap_or_else(|received| panic!("Partial update after frames {received:?}"));
+    assert!(received.contains(&7), "{received:?}");
+    assert!(sender.negotiated().is_none());
+}
+
+#[test]
+fn test_compact_indices() {
+    let mut receiver = MeshReceiver::bind("127.0.0.1:0").expect("Failed to bind");
+    let addr = receiver.local_addr().expect("Failed to get address");
+
+    // A 100 x 100 quad grid
+    let mut mesh = MeshFrame::new("indices".to_string(), 0);
+    for y in 0..=100 {
+        for x in 0..=100 {
+            mesh.vertices.extend([x as f32, y as f32, 0.0]);
+        }
+    }
+    let indices: Vec<u32> = (0..100u32)
+        .flat_map(|y| (0..100u32).map(move |x| y * 101 + x))
+        .flat_map(|c| [c, c + 1, c + 101, c + 1, c + 102, c + 101])
+        .collect();
+    let index_bytes = indices.len() * 4;
+    mesh.indices = Some(indices);
+
+    for compression in [IndexCompression::Narrow, IndexCompression::Coded] {
+        let sent = mesh.clone();
+        let sending = thread::spawn(move || {
+            let config = SenderConfig {
+                index_compression: compression,
+                ..SenderConfig::default()
+            };
+            let mut sender =
+                MeshSender::connect_with_config(addr, config).expect("Failed to connect");
+            for _ in 0..200 {
+                if sender.negotiated().is_some() {
+                    break;
+                }
+                thread::sleep(Duration::from_millis(10));
+            }
+            sender.send_mesh(&sent).expect("Failed to send");
+        });
+
+        let received = receiver.receive_frame().expect("Failed to receive");
+        sending.join().expect("Sender thread panicked");
+        assert_eq!(received.msg_type, MessageType::ColumnarFrame);
+        let saved = columnar::encode(&mesh).len() - received.payload.len();
+
+        match compression {
+            IndexCompression::Narrow => {
+                assert!(saved >= index_bytes / 2, "{saved}");
+                let view = received.view().expect("Narrow indices are viewable");
+                assert!(matches!(view.indices, Some(IndexSlice::U16(_))));
+            }
+            _ => {
+                assert!(saved >= index_bytes * 2 / 3, "{saved}");
+                assert!(received.view().is_err());
+            }
+        }
+        let decoded = received.decode().expect("Failed to decode");
+        assert_eq!(decoded.indices, mesh.indices);
+        assert_eq!(decoded.vertices, mesh.vertices);
+    }
+}
+
+#[test]
+fn test_volume_frames() {
+    let mut receiver = MeshReceiver::bind("127.0.0.1:0").expect("Failed to bind");
+    let addr = receiver.local_addr().expect("Failed to get address");
+
+    // Distance from the centre of a 48³ grid
+    let n = 48;
+    let grid = VolumeGrid {
+        origin: [-1.0; 3],
+        spacing: [2.0 / (n - 1) as f32; 3],
+        dims: [n; 3],
+    };
+    let values: Vec<f32> = (0..n * n * n)
+        .map(|i| {
+            let p = [i % n, i / n % n, i / (n * n)].map(|c| -1.0 + c as f32 * grid.spacing[0]);
+            (p[0] * p[0] + p[1] * p[1] + p[2] * p[2]).sqrt()
+        })
+        .collect();
+    let mut volume = VolumeFrame::from_values(
+        "volume".to_string(),
+        7,
+        grid,
+        &values,
+        0.6,
+        VolumeLayout::Sparse { block_size: 8 },
+    )
+    .expect("Failed to quantize");
+    volume.timestamp = 42;
+
+    // One sender extracts nothing itself, the other cannot say it may not
+    for negotiate in [true, false] {
+        let sent = volume.clone();
+        let sending = thread::spawn(move || {
+            let config = SenderConfig {
+                negotiate,
+                ..SenderConfig::default()
+            };
+            let mut sender =
+                MeshSender::connect_with_config(addr, config).expect("Failed to connect");
+            for _ in 0..200 {
+                if !negotiate || sender.negotiated().is_some() {
+                    break;
+                }
+                thread::sleep(Duration::from_millis(10));
+            }
+            sender.send_volume(&sent).expect("Failed to send");
+        });
+
+        if negotiate {
+            let received = receiver.receive_one().expect("Failed to receive");
+            sending.join().expect("Sender thread panicked");
+            let frame = &received.frame;
+            assert_eq!((frame.frame_number, frame.timestamp), (7, 42));
+            assert!(frame.triangle_count() > 1000);
+            assert!(frame.normals.is_some());
+            frame.validate().expect("Invalid surface");
+
+            // Moving the iso-value extracts the kept volume again
+            let smaller = receiver.set_iso_value(Some(0.3)).expect("No volume kept");
+            assert_eq!(smaller.frame_number, 7);
+            assert!(smaller.triangle_count() < frame.triangle_count() / 2);
+            receiver.set_iso_value(None);
+        } else {
+            let received = receiver.receive_frame().expect("Failed to receive");
+            sending.join().expect("Sender thread panicked");
+            assert_eq!(received.msg_type, MessageType::MeshFrame);
+            let decoded = received.decode().expect("Failed to decode");
+            let expected = volume.extract_surface(0.6).expect("Failed to extract");
+            assert_eq!(decoded.vertices, expected.vertices);
+            assert_eq!(decoded.indices, expected.indices);
+        }
+    }
+}
+
+#[test]
+fn test_point_frames() {
+    let config = ReceiverConfig {
+        point_frames: true,
+        ..ReceiverConfig::default()
+    };
+    let mut receiver =
+        MeshReceiver::bind_with_config("127.0.0.1:0", config).expect("Failed to bind");
+    let addr = receiver.local_addr().expect("Failed to get address");
+
+    // Particles along a helix, with their height as a value
+    let count = 20_000;
+    let positions: Vec<f32> = (0..count)
+        .flat_map(|i| {
+            let t = i as f32 * 0.01;
+            [t.cos(), t.sin(), t / 200.0]
+        })
+        .collect();
+    let heights: Vec<f32> = positions.chunks_exact(3).map(|p| p[2]).collect();
+    let bounds = DomainBounds::new([-1.0, -1.0, 0.0], [1.0, 1.0, 1.0]);
+    let mut frame = PointFrame::encode(
+        "sph".to_string(),
+        3,
+        bounds,
+        &positions,
+        &[PointScalars {
+            name: "height",
+            values: &heights,
+        }],
+    )
+    .expect("Failed to encode");
+    frame.timestamp = 9;
+    // Positions alone as floats
+    let raw_bytes = count * 12;
+
+    let sending = thread::spawn(move || {
+        // Skipped for a receiver that has not agreed to point frames
+        let config = SenderConfig {
+            negotiate: false,
+            ..SenderConfig::default()
+        };
+        let mut sender = MeshSender::connect_with_config(addr, config).expect("Failed to connect");
+        sender.send_points(&frame).expect("Failed to send");
+        assert_eq!(sender.stats().frames_skipped, 1);
+        drop(sender);
+
+        let mut sender = MeshSender::connect(addr).expect("Failed to connect");
+        for _ in 0..200 {
+            if sender.negotiated().is_some() {
+                break;
+            }
+            thread::sleep(Duration::from_millis(10));
+        }
+        sender.send_points(&frame).expect("Failed to send");
+        sender.flush().expect("Failed to flush");
+        sender.stats()
+    });
+
+    let received = receiver.receive_one().expect("Failed to receive");
+    let stats = sending.join().expect("Sender thread panicked");
+    assert_eq!(stats.frames_sent, 1);
+    assert!(stats.bytes_sent < raw_bytes as u64, "{}", stats.bytes_sent);
+
+    assert_eq!(
+        (received.frame.frame_number, received.frame.timestamp),
+        (3, 9)
+    );
+    assert_eq!(received.frame.vertex_count(), 0);
+    let points = received.points.expect("Not a point frame");
+    assert_eq!(points.len(), count);
+    let height = points.scalar("height").expect("No heights");
+    for i in 0..count {
+        let p = points.position(i);
+        assert!((p[0] * p[0] + p[1] * p[1] - 1.0).abs() < 1e-3, "{p:?}");
+        assert!((height.value(i) - p[2]).abs() < 1e-3);
+    }
+}
@@ -4,6 +4,8 @@ use bevy::diagnostic::{DiagnosticsStore, FrameTimeDiagnosticsPlugin};
 use bevy::prelude::*;
 use std::time::Duration;
 
+use crate::lib::mesh_optimize::{VertexCacheReport, VertexCacheReports};
+
 /// Resource to track rendering statistics
 #[derive(Resource, Default, Debug)]
 pub struct RenderingStats {
@@ -23,6 +25,9 @@ pub struct RenderingStats {
     pub max_history: usize,
     /// Last update time
     pub last_update: Duration,
+    /// Vertex cache report of the largest visible mesh, if it was optimized
+    /// on load
+    pub vertex_cache: Option<VertexCacheReport>,
 }
 
 impl RenderingStats {
@@ -106,6 +111,8 @@ fn update_rendering_stats(
     time: Res<Time>,
     diagnostics: Res<DiagnosticsStore>,
     meshes: Res<Assets<Mesh>>,
+    asset_server: Res<AssetServer>,
+    reports: Option<Res<VertexCacheReports>>,
     mesh_query: Query<(&Mesh3d, &Visibility), With<Mesh3d>>,
 ) {
     // Reset counters
@@ -114,6 +121,7 @@ fn update_rendering_stats(
     stats.mesh_count = 0;
     stats.visible_mesh_count = 0;
     stats.largest_mesh_vertices = 0;
+    stats.vertex_cache = None;
 
     // Count mesh statistics
     for (mesh_handle, visibility) in mesh_query.iter() {
@@ -128,8 +136,14 @@ fn update_rendering_stats(
         if let Some(mesh) = meshes.get(&mesh_handle.0) {
             let vertex_count = mesh.count_vertices();
             stats.total_vertices += vertex_count;
-            stats.total_triangles += vertex_count / 3; // Assuming triangle list
-            stats.largest_mesh_vertices = stats.largest_mesh_vertices.max(vertex_count);
+            stats.total_triangles += triangle_count(mesh);
+            if vertex_count >= stats.largest_mesh_vertices {
+                stats.largest_mesh_vertices = vertex_count;
+                stats.vertex_cache = reports.as_ref().and_then(|reports| {
+                    let path = asset_server.get_path(mesh_handle.id())?;
+                    reports.get(&path.to_string())
+                });
+            }
         }
     }
 
@@ -180,6 +194,13 @@ fn log_rendering_diagnostics(
         let bytes_per_vertex = 12 + 12 + 8; // position + normal + uv
         let gpu_memory_mb = (stats.total_vertices * bytes_per_vertex) as f32 / 1_048_576.0;
         info!("Estimated GPU memory usage: {:.1} MB", gpu_memory_mb);
+
+        if let Some(report) = stats.vertex_cache {
+            info!(
+                "Vertex Cache - ACMR: {:.2} (was {:.2}), ATVR: {:.2} (was {:.2})",
+                report.after.acmr, report.before.acmr, report.after.atvr, report.before.atvr,
+            );
+        }
     }
 }
 
@@ -262,7 +283,7 @@ pub fn track_mesh_stats(
     for (entity, mesh_handle) in new_meshes.iter() {
         if let Some(mesh) = meshes.get(&mesh_handle.0) {
             let vertex_count = mesh.count_vertices();
-            let triangle_count = vertex_count / 3;
+            let triangle_count = triangle_count(mesh);
 
             commands.entity(entity).insert(MeshStats {
                 vertex_count,
@@ -281,6 +302,17 @@ pub fn track_mesh_stats(
     }
 }
 
+/// Number of triangles in a triangle-list mesh.
+///
+/// Indexed meshes (which is what the STL and glTF loaders produce) have far
+/// fewer vertices than `3 × triangles`, so count indices when present.
+pub fn triangle_count(mesh: &Mesh) -> usize {
+    match mesh.indices() {
+        Some(indices) => indices.len() / 3,
+        None => mesh.count_vertices() / 3,
+    }
+}
+
 /// Helper to analyze why performance might be bad
 #[allow(dead_code)]
 pub fn analyze_performance_issues(stats: &RenderingStats) -> Vec<String> {
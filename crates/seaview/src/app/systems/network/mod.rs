@@ -1,9 +1,25 @@
 //! Network system for receiving mesh data in real-time
+//!
+//! Received frames are converted into Bevy meshes on the
+//! [`AsyncComputeTaskPool`] so that large frames never stall `Update`.
+//! A lightweight collector system picks up finished conversions and hands
+//! them to a [`JitterBuffer`], which reorders frames and releases them at a
+//! steady cadence; releasing only swaps the mesh handle on the
+//! per-simulation display entity.
+//!
+//! This module is not compiled yet: `lib::network` and this module stay
+//! commented out until `baby_shark` is available again, so none of this
+//! has been measured in a running viewer.
 
 use bevy::prelude::*;
+use bevy::tasks::{block_on, futures_lite::future, AsyncComputeTaskPool, Task};
 
+use std::collections::HashMap;
 use std::sync::{Arc, Mutex};
+use std::time::{Duration, Instant};
 
+use crate::lib::asset_loaders::narrow_indices;
+use crate::lib::network::jitter::JitterBuffer;
 use crate::lib::network::{
     NetworkConfig, NetworkMeshReceived, NonBlockingMeshReceiver, ReceivedMesh,
 };
@@ -16,9 +32,21 @@ impl Plugin for NetworkMeshPlugin {
     fn build(&self, app: &mut App) {
         app.init_resource::<NetworkConfig>()
             .init_resource::<NetworkReceiver>()
+            .init_resource::<MeshConversionTasks>()
+            .init_resource::<NetworkMeshEntities>()
+            .init_resource::<NetworkConversionStats>()
+            .init_resource::<NetworkJitterBuffer>()
             .add_message::<NetworkMeshReceived>()
             .add_systems(Startup, setup_network_receiver)
-            .add_systems(Update, poll_network_meshes);
+            .add_systems(
+                Update,
+                (
+                    collect_converted_meshes,
+                    release_buffered_meshes,
+                    poll_network_meshes,
+                )
+                    .chain(),
+            );
     }
 }
 
@@ -37,6 +65,61 @@ pub struct NetworkMesh {
     pub frame_number: u32,
 }
 
+/// Output of one background conversion
+struct ConvertedMesh {
+    simulation_uuid: String,
+    frame_number: u32,
+    triangle_count: u32,
+    received_at: Instant,
+    result: Result<Mesh, String>,
+    convert_time: Duration,
+}
+
+/// A converted frame waiting in the jitter buffer
+pub struct BufferedMesh {
+    mesh: Mesh,
+    triangle_count: u32,
+}
+
+/// Playout buffer between conversion and display
+#[derive(Resource, Default)]
+pub struct NetworkJitterBuffer(pub JitterBuffer<BufferedMesh>);
+
+/// In-flight mesh conversions on the async compute pool
+#[derive(Resource, Default)]
+pub struct MeshConversionTasks {
+    tasks: Vec<Task<ConvertedMesh>>,
+}
+
+impl MeshConversionTasks {
+    /// Number of conversions currently running
+    pub fn in_flight(&self) -> usize {
+        self.tasks.len()
+    }
+}
+
+/// Display entity (and its material) for each simulation stream
+#[derive(Resource, Default)]
+pub struct NetworkMeshEntities {
+    by_simulation: HashMap<String, Entity>,
+    material: Option<Handle<StandardMaterial>>,
+}
+
+/// Conversion timings, for comparing frame times against the inline path
+#[derive(Resource, Default, Debug)]
+pub struct NetworkConversionStats {
+    /// Conversions finished successfully
+    pub completed: u64,
+    /// Conversions that failed
+    pub failed: u64,
+    /// Duration of the last conversion
+    pub last_convert_time: Duration,
+    /// Longest conversion seen so far
+    pub max_convert_time: Duration,
+    /// Time spent releasing buffered frames on the last run
+    pub last_collect_time: Duration,
+}
+
 fn setup_network_receiver(
     config: Res<NetworkConfig>,
     mut network_receiver: ResMut<NetworkReceiver>,
@@ -60,77 +143,232 @@ fn setup_network_receiver(
     }
 }
 
+/// Pull received frames and start converting them in the background.
+///
+/// At most `NetworkConfig::max_concurrent_conversions` conversions run at
+/// once; further frames stay queued in the receiver until a slot frees up.
+/// A cap of zero converts inline on the main thread (the old behaviour),
+/// straight into the jitter buffer, which is useful as a baseline when
+/// comparing frame times.
 fn poll_network_meshes(
+    config: Res<NetworkConfig>,
+    network_receiver: Res<NetworkReceiver>,
+    mut conversions: ResMut<MeshConversionTasks>,
+    mut jitter: ResMut<NetworkJitterBuffer>,
+    mut stats: ResMut<NetworkConversionStats>,
+) {
+    let Some(receiver) = &network_receiver.receiver else {
+        return;
+    };
+    // Try to lock the receiver
+    let Ok(mut receiver_guard) = receiver.try_lock() else {
+        return;
+    };
+
+    let inline = config.max_concurrent_conversions == 0;
+    let task_pool = AsyncComputeTaskPool::get();
+
+    // Process available meshes
+    while inline || conversions.tasks.len() < config.max_concurrent_conversions {
+        match receiver_guard.try_receive() {
+            Ok(Some(received_mesh)) => {
+                info!(
+                    "Received mesh via network: {} triangles for simulation {} frame {}",
+                    received_mesh.triangle_count,
+                    received_mesh.simulation_uuid,
+                    received_mesh.frame_number
+                );
+
+                let received_at = Instant::now();
+                if inline {
+                    let converted = convert_received(received_mesh, received_at);
+                    buffer_converted(converted, &mut jitter, &mut stats);
+                } else {
+                    let task = task_pool
+                        .spawn(async move { convert_received(received_mesh, received_at) });
+                    conversions.tasks.push(task);
+                }
+            }
+            Ok(None) => {
+                // No more meshes available
+                break;
+            }
+            Err(e) => {
+                error!("Error receiving mesh: {}", e);
+                break;
+            }
+        }
+    }
+}
+
+/// Collect finished conversions into the jitter buffer.
+fn collect_converted_meshes(
+    mut conversions: ResMut<MeshConversionTasks>,
+    mut jitter: ResMut<NetworkJitterBuffer>,
+    mut stats: ResMut<NetworkConversionStats>,
+) {
+    if conversions.tasks.is_empty() {
+        return;
+    }
+
+    let mut finished = Vec::new();
+    conversions
+        .tasks
+        .retain_mut(|task| match block_on(future::poll_once(task)) {
+            Some(converted) => {
+                finished.push(converted);
+                false
+            }
+            None => true,
+        });
+
+    for converted in finished {
+        buffer_converted(converted, &mut jitter, &mut stats);
+    }
+}
+
+/// Record a finished conversion and queue its mesh for display.
+fn buffer_converted(
+    converted: ConvertedMesh,
+    jitter: &mut NetworkJitterBuffer,
+    stats: &mut NetworkConversionStats,
+) {
+    stats.last_convert_time = converted.convert_time;
+    stats.max_convert_time = stats.max_convert_time.max(converted.convert_time);
+
+    let mesh = match converted.result {
+        Ok(mesh) => mesh,
+        Err(e) => {
+            stats.failed += 1;
+            error!("Failed to convert received mesh: {}", e);
+            return;
+        }
+    };
+    stats.completed += 1;
+
+    // Arrival is when the frame came off the socket, so conversion time
+    // does not skew the jitter estimate.
+    jitter.0.push(
+        &converted.simulation_uuid,
+        converted.frame_number,
+        BufferedMesh {
+            mesh,
+            triangle_count: converted.triangle_count,
+        },
+        converted.received_at,
+    );
+}
+
+/// Release due frames from the jitter buffer onto the display entities.
+///
+/// This only adds the mesh asset and replaces a handle, so its cost does not
+/// depend on mesh size.
+fn release_buffered_meshes(
     mut commands: Commands,
     mut meshes: ResMut<Assets<Mesh>>,
     mut materials: ResMut<Assets<StandardMaterial>>,
-    network_receiver: Res<NetworkReceiver>,
+    mut jitter: ResMut<NetworkJitterBuffer>,
+    mut entities: ResMut<NetworkMeshEntities>,
+    mut stats: ResMut<NetworkConversionStats>,
+    mut displayed: Query<(&mut Mesh3d, &mut NetworkMesh)>,
     mut mesh_received_events: MessageWriter<NetworkMeshReceived>,
 ) {
-    if let Some(receiver) = &network_receiver.receiver {
-        // Try to lock the receiver
-        if let Ok(mut receiver_guard) = receiver.try_lock() {
-            // Process available meshes
-            loop {
-                match receiver_guard.try_receive() {
-                    Ok(Some(received_mesh)) => {
-                        info!(
-                            "Received mesh via network: {} triangles for simulation {} frame {}",
-                            received_mesh.triangle_count,
-                            received_mesh.simulation_uuid,
-                            received_mesh.frame_number
-                        );
-
-                        // Convert received mesh to Bevy mesh
-                        match convert_to_bevy_mesh(&received_mesh) {
-                            Ok(mesh) => {
-                                let mesh_handle = meshes.add(mesh);
-
-                                // Create a blue-ish material for network meshes
-                                let material = materials.add(StandardMaterial {
-                                    base_color: Color::srgb(0.3, 0.5, 0.8),
-                                    metallic: 0.1,
-                                    perceptual_roughness: 0.8,
-                                    ..default()
-                                });
-
-                                // Spawn the mesh entity
-                                let entity = commands
-                                    .spawn((
-                                        Mesh3d(mesh_handle),
-                                        MeshMaterial3d(material),
-                                        Transform::default(),
-                                        NetworkMesh {
-                                            simulation_uuid: received_mesh.simulation_uuid.clone(),
-                                            frame_number: received_mesh.frame_number,
-                                        },
-                                    ))
-                                    .id();
-
-                                // Emit event
-                                mesh_received_events.write(NetworkMeshReceived {
-                                    entity,
-                                    simulation_uuid: received_mesh.simulation_uuid,
-                                    frame_number: received_mesh.frame_number,
-                                    triangle_count: received_mesh.triangle_count,
-                                });
-                            }
-                            Err(e) => {
-                                error!("Failed to convert received mesh: {}", e);
-                            }
-                        }
-                    }
-                    Ok(None) => {
-                        // No more meshes available
-                        break;
-                    }
-                    Err(e) => {
-                        error!("Error receiving mesh: {}", e);
-                        break;
-                    }
-                }
-            }
+    let start = Instant::now();
+    // Entities spawned in this run, with their current mesh; `displayed` only
+    // sees them once the commands are applied.
+    let mut spawned: HashMap<String, (Entity, Handle<Mesh>)> = HashMap::new();
+
+    for (simulation_uuid, frame_number, buffered) in jitter.0.pop_ready(start) {
+        let handle = meshes.add(buffered.mesh);
+
+        if let Some((entity, current)) = spawned.get_mut(&simulation_uuid) {
+            let old_handle = std::mem::replace(current, handle.clone());
+            meshes.remove(&old_handle);
+            commands.entity(*entity).insert((
+                Mesh3d(handle),
+                NetworkMesh {
+                    simulation_uuid: simulation_uuid.clone(),
+                    frame_number,
+                },
+            ));
+            mesh_received_events.write(NetworkMeshReceived {
+                entity: *entity,
+                simulation_uuid,
+                frame_number,
+                triangle_count: buffered.triangle_count,
+            });
+            continue;
         }
+
+        let existing = entities
+            .by_simulation
+            .get(&simulation_uuid)
+            .copied()
+            .and_then(|entity| displayed.get_mut(entity).ok().map(|q| (entity, q)));
+
+        let entity = match existing {
+            Some((entity, (mut mesh3d, mut network_mesh))) => {
+                let old_handle = std::mem::replace(&mut mesh3d.0, handle);
+                meshes.remove(&old_handle);
+                network_mesh.frame_number = frame_number;
+                entity
+            }
+            None => {
+                // Create a blue-ish material for network meshes
+                let material = entities
+                    .material
+                    .get_or_insert_with(|| {
+                        materials.add(StandardMaterial {
+                            base_color: Color::srgb(0.3, 0.5, 0.8),
+                            metallic: 0.1,
+                            perceptual_roughness: 0.8,
+                            ..default()
+                        })
+                    })
+                    .clone();
+
+                let entity = commands
+                    .spawn((
+                        Mesh3d(handle.clone()),
+                        MeshMaterial3d(material),
+                        Transform::default(),
+                        NetworkMesh {
+                            simulation_uuid: simulation_uuid.clone(),
+                            frame_number,
+                        },
+                    ))
+                    .id();
+                entities
+                    .by_simulation
+                    .insert(simulation_uuid.clone(), entity);
+                spawned.insert(simulation_uuid.clone(), (entity, handle));
+                entity
+            }
+        };
+
+        // Emit event
+        mesh_received_events.write(NetworkMeshReceived {
+            entity,
+            simulation_uuid,
+            frame_number,
+            triangle_count: buffered.triangle_count,
+        });
+    }
+
+    stats.last_collect_time = start.elapsed();
+}
+
+/// Convert one received frame, timing the conversion.
+fn convert_received(received: ReceivedMesh, received_at: Instant) -> ConvertedMesh {
+    let start = Instant::now();
+    let result = convert_to_bevy_mesh(&received);
+    ConvertedMesh {
+        simulation_uuid: received.simulation_uuid,
+        frame_number: received.frame_number,
+        triangle_count: received.triangle_count,
+        received_at,
+        result,
+        convert_time: start.elapsed(),
     }
 }
 
@@ -159,7 +397,8 @@ fn convert_to_bevy_mesh(received: &ReceivedMesh) -> Result<Mesh, String> {
     let baby_shark_mesh = BabySharkMesh::new(vertices, indices);
 
     // Convert to Bevy mesh - baby_shark handles normals and UVs automatically
-    let bevy_mesh: Mesh = baby_shark_mesh.into();
+    let mut bevy_mesh: Mesh = baby_shark_mesh.into();
+    narrow_indices(&mut bevy_mesh);
 
     Ok(bevy_mesh)
 }
@@ -5,6 +5,8 @@
 use bevy::prelude::*;
 use bevy_egui::EguiPrimaryContextPass;
 
+use crate::lib::sequence::SequencePlaybackSet;
+
 mod event_handlers;
 mod material_system;
 mod menu_bar;
@@ -42,7 +44,7 @@ impl Plugin for UiSystemsPlugin {
                 handle_switch_session_events,
                 handle_delete_session_events,
                 handle_create_session_events,
-                playback_update_system,
+                playback_update_system.in_set(SequencePlaybackSet),
                 apply_material_config,
             ),
         );
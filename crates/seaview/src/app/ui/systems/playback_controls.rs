@@ -7,6 +7,7 @@ use bevy_egui::{egui, EguiContexts};
 
 use crate::app::systems::camera::CenterOnMeshEvent;
 use crate::app::ui::state::UiState;
+use crate::lib::sequence::interpolation::{FrameInterpolation, InterpolationMode};
 use crate::lib::sequence::{SequenceAssets, SequenceEvent, SequenceManager};
 use crate::lib::settings::SaveViewEvent;
 
@@ -20,6 +21,7 @@ pub fn playback_controls_system(
     time: Res<Time>,
     sequence_manager: Res<SequenceManager>,
     sequence_assets: Res<SequenceAssets>,
+    mut interpolation: ResMut<FrameInterpolation>,
 ) {
     if !ui_state.show_playback_controls {
         return;
@@ -155,6 +157,22 @@ pub fn playback_controls_system(
                     // Loop toggle
                     ui.checkbox(&mut ui_state.playback.loop_enabled, "Loop");
 
+                    // Frame interpolation toggles
+                    ui.checkbox(&mut interpolation.enabled, "Interpolate")
+                        .on_hover_text(
+                            "Blend in-between frames when consecutive frames share topology",
+                        );
+                    if interpolation.enabled {
+                        let mut hermite = interpolation.mode == InterpolationMode::Hermite;
+                        if ui.checkbox(&mut hermite, "Hermite").changed() {
+                            interpolation.mode = if hermite {
+                                InterpolationMode::Hermite
+                            } else {
+                                InterpolationMode::Linear
+                            };
+                        }
+                    }
+
                     // Add some spacing before the right side
                     ui.with_layout(egui::Layout::right_to_left(egui::Align::Center), |ui| {
                         // FPS display
@@ -244,10 +262,14 @@ pub fn playback_controls_system(
 pub fn playback_update_system(
     mut ui_state: ResMut<UiState>,
     mut sequence_events: MessageWriter<SequenceEvent>,
+    mut interpolation: ResMut<FrameInterpolation>,
     time: Res<Time>,
     mut last_update: Local<f32>,
 ) {
     if !ui_state.playback.is_playing || ui_state.playback.total_frames == 0 {
+        if interpolation.phase != 0.0 {
+            interpolation.phase = 0.0;
+        }
         return;
     }
 
@@ -266,4 +288,7 @@ pub fn playback_update_system(
             sequence_events.write(SequenceEvent::PlaybackStopped);
         }
     }
+
+    // Publish sub-frame progress for in-between frame generation
+    interpolation.phase = (*last_update / frame_duration).clamp(0.0, 1.0);
 }
@@ -10,6 +10,8 @@ use uuid::Uuid;
 use crate::app::ui::state::{AlphaModeConfig, DeleteSessionEvent, MaterialConfig, SwitchSessionEvent, UiState};
 use crate::lib::lighting::{NightLightingConfig, PlacementAlgorithm};
 use crate::lib::mesh_info::{MeshDimensions, RecomputeMeshBounds};
+use crate::lib::sequence::index::SequenceIndex;
+use crate::lib::sequence::SequenceManager;
 use crate::lib::session::SessionManager;
 
 /// System that renders the session management panel
@@ -23,6 +25,7 @@ pub fn session_panel_system(
     mut material_config: ResMut<MaterialConfig>,
     mesh_dims: Res<MeshDimensions>,
     mut recompute_events: MessageWriter<RecomputeMeshBounds>,
+    sequence_manager: Res<SequenceManager>,
 ) {
     if !ui_state.show_session_panel {
         debug!("Session panel is hidden");
@@ -184,6 +187,14 @@ pub fn session_panel_system(
                                 ui.label("No mesh loaded");
                             }
 
+                            if let Some(index) = sequence_manager
+                                .current_sequence()
+                                .and_then(|s| s.index.as_ref())
+                            {
+                                ui.add_space(4.0);
+                                render_sequence_index(ui, index, sequence_manager.current_frame);
+                            }
+
                             ui.add_space(4.0);
                             if ui.button("⟳ Recompute").clicked() {
                                 recompute_events.write(RecomputeMeshBounds);
@@ -215,6 +226,60 @@ pub fn session_panel_system(
         });
 }
 
+/// Render per-frame and whole-sequence statistics from the sidecar index
+fn render_sequence_index(ui: &mut egui::Ui, index: &SequenceIndex, current_frame: usize) {
+    egui::Grid::new("sequence_index_grid")
+        .num_columns(2)
+        .spacing([8.0, 4.0])
+        .show(ui, |ui| {
+            if let Some(frame) = index.frame(current_frame) {
+                ui.label("Vertices:");
+                ui.label(format_count(frame.vertex_count));
+                ui.end_row();
+                ui.label("Triangles:");
+                ui.label(format_count(frame.triangle_count));
+                ui.end_row();
+                ui.label("File size:");
+                ui.label(format_bytes(frame.file_size));
+                ui.end_row();
+            }
+            ui.label("Sequence:");
+            ui.label(format!(
+                "{} frames, {}",
+                index.frames.len(),
+                format_bytes(index.total_bytes())
+            ));
+            ui.end_row();
+            ui.label("Total triangles:");
+            ui.label(format_count(index.total_triangles()));
+            ui.end_row();
+        });
+}
+
+/// Format a count with a K/M suffix
+fn format_count(n: u64) -> String {
+    if n >= 1_000_000 {
+        format!("{:.2}M", n as f64 / 1_000_000.0)
+    } else if n >= 1_000 {
+        format!("{:.1}K", n as f64 / 1_000.0)
+    } else {
+        n.to_string()
+    }
+}
+
+/// Format a byte size in KB/MB/GB
+fn format_bytes(bytes: u64) -> String {
+    const KB: f64 = 1024.0;
+    let b = bytes as f64;
+    if b >= KB * KB * KB {
+        format!("{:.2} GB", b / (KB * KB * KB))
+    } else if b >= KB * KB {
+        format!("{:.1} MB", b / (KB * KB))
+    } else {
+        format!("{:.1} KB", b / KB)
+    }
+}
+
 /// Render a single session item in the list
 fn render_session_item(
     ui: &mut egui::Ui,
@@ -8,6 +8,7 @@ pub mod lib {
     pub mod coordinates;
     pub mod lighting;
     pub mod mesh_info;
+    pub mod mesh_optimize;
     // pub mod network;
     pub mod sequence;
     pub mod session;
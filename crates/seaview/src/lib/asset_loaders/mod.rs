@@ -22,19 +22,45 @@
 
 pub mod stl_loader;
 
+use bevy::mesh::Indices;
 use bevy::prelude::*;
 
+use super::mesh_optimize::VertexCacheReports;
+
 pub use stl_loader::StlLoader;
 
+/// Index buffer for `indices`, 16-bit when every index fits.
+///
+/// Halves the index memory on the GPU for meshes of up to 65,536 vertices.
+pub fn compact_indices(indices: Vec<u32>) -> Indices {
+    if indices.iter().all(|&index| index <= u16::MAX as u32) {
+        Indices::U16(indices.into_iter().map(|index| index as u16).collect())
+    } else {
+        Indices::U32(indices)
+    }
+}
+
+/// Switch a mesh to 16-bit indices if they all fit.
+pub fn narrow_indices(mesh: &mut Mesh) {
+    if let Some(Indices::U32(indices)) = mesh.remove_indices() {
+        mesh.insert_indices(compact_indices(indices));
+    }
+}
+
 /// Plugin that registers all custom asset loaders.
 ///
 /// Currently registers:
 /// - [`StlLoader`] for `.stl` files
+///
+/// Also inserts the [`VertexCacheReports`] the loaders fill in when they
+/// optimize a mesh.
 pub struct AssetLoadersPlugin;
 
 impl Plugin for AssetLoadersPlugin {
     fn build(&self, app: &mut App) {
-        app.register_asset_loader(StlLoader);
+        let reports = VertexCacheReports::default();
+        app.insert_resource(reports.clone())
+            .register_asset_loader(StlLoader::new(reports));
         info!("Registered custom asset loaders: STL");
     }
 }
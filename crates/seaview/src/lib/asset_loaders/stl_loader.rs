@@ -1,12 +1,16 @@
 //! Custom Bevy AssetLoader for STL (STereoLithography) files.
 //!
 //! Supports both binary and ASCII STL formats via the `stl_io` crate.
-//! Produces indexed Bevy `Mesh` assets with positions, normals, and u32 indices.
+//! Produces indexed Bevy `Mesh` assets with positions, normals, and u16
+//! indices where they fit (u32 otherwise).
 
 use bevy::asset::io::Reader;
 use bevy::asset::{AssetLoader, LoadContext, RenderAssetUsages};
-use bevy::mesh::{Indices, Mesh, PrimitiveTopology};
+use bevy::mesh::{Mesh, PrimitiveTopology};
 use bevy::prelude::*;
+
+use super::compact_indices;
+use crate::lib::mesh_optimize::{optimize_mesh, VertexCacheReports};
 use serde::{Deserialize, Serialize};
 use std::io::Cursor;
 use thiserror::Error;
@@ -19,6 +23,10 @@ pub struct StlLoaderSettings {
     /// Defaults to false (use per-vertex normals derived from face normals).
     #[serde(default)]
     pub recompute_normals: bool,
+    /// If true, reorder triangles and vertices for the GPU's vertex cache
+    /// (see [`optimize_mesh`]). Runs once per file, on the loader thread.
+    #[serde(default)]
+    pub optimize: bool,
 }
 
 /// Errors that can occur when loading an STL file.
@@ -35,9 +43,22 @@ pub enum StlLoaderError {
 ///
 /// The loader reads the entire file into memory, parses it with `stl_io`
 /// (auto-detecting binary vs ASCII), builds an indexed triangle-list mesh,
-/// and returns it as a Bevy [`Mesh`] with positions, normals, and u32 indices.
-#[derive(Default, Debug, Clone, Copy, bevy::reflect::TypePath)]
-pub struct StlLoader;
+/// and returns it as a Bevy [`Mesh`] with positions, normals, and compact
+/// indices (see [`compact_indices`]).
+///
+/// Meshes loaded with [`StlLoaderSettings::optimize`] record their vertex
+/// cache report in the shared [`VertexCacheReports`] under their asset path.
+#[derive(Default, Debug, Clone, bevy::reflect::TypePath)]
+pub struct StlLoader {
+    reports: VertexCacheReports,
+}
+
+impl StlLoader {
+    /// Loader that records vertex cache reports in `reports`.
+    pub fn new(reports: VertexCacheReports) -> Self {
+        Self { reports }
+    }
+}
 
 impl AssetLoader for StlLoader {
     type Asset = Mesh;
@@ -48,7 +69,7 @@ impl AssetLoader for StlLoader {
         &self,
         reader: &mut dyn Reader,
         settings: &StlLoaderSettings,
-        _load_context: &mut LoadContext<'_>,
+        load_context: &mut LoadContext<'_>,
     ) -> Result<Mesh, StlLoaderError> {
         // Read entire file into memory so we can hand it to stl_io
         // (which requires Read + Seek).
@@ -62,12 +83,28 @@ impl AssetLoader for StlLoader {
             return Err(StlLoaderError::EmptyMesh);
         }
 
-        let mesh = if settings.recompute_normals {
+        let mut mesh = if settings.recompute_normals {
             build_mesh_auto_normals(&indexed_mesh)
         } else {
             build_mesh_with_stl_normals(&indexed_mesh)
         };
 
+        // stl_io has already welded shared vertices, so the index buffer is
+        // ready for reordering.
+        if settings.optimize {
+            if let Some(report) = optimize_mesh(&mut mesh) {
+                debug!(
+                    "Optimized {}: ACMR {:.2} -> {:.2}, ATVR {:.2} -> {:.2}",
+                    load_context.asset_path(),
+                    report.before.acmr,
+                    report.after.acmr,
+                    report.before.atvr,
+                    report.after.atvr,
+                );
+                self.reports.record(load_context.asset_path().to_string(), report);
+            }
+        }
+
         Ok(mesh)
     }
 
@@ -100,7 +137,7 @@ fn build_mesh_auto_normals(stl: &stl_io::IndexedMesh) -> Mesh {
 
     let mut mesh = Mesh::new(PrimitiveTopology::TriangleList, RenderAssetUsages::default())
         .with_inserted_attribute(Mesh::ATTRIBUTE_POSITION, positions)
-        .with_inserted_indices(Indices::U32(indices));
+        .with_inserted_indices(compact_indices(indices));
 
     // Let Bevy compute smooth normals from the indexed geometry.
     mesh.compute_normals();
@@ -160,5 +197,5 @@ fn build_mesh_with_stl_normals(stl: &stl_io::IndexedMesh) -> Mesh {
     Mesh::new(PrimitiveTopology::TriangleList, RenderAssetUsages::default())
         .with_inserted_attribute(Mesh::ATTRIBUTE_POSITION, positions)
         .with_inserted_attribute(Mesh::ATTRIBUTE_NORMAL, normals)
-        .with_inserted_indices(Indices::U32(indices))
+        .with_inserted_indices(compact_indices(indices))
 }
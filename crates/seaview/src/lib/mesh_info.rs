@@ -3,13 +3,29 @@
 //! Computes and caches axis-aligned bounding box (AABB) dimensions for the
 //! currently loaded mesh. Results are persisted to `seaview.toml` so the UI
 //! can display dimensions immediately on subsequent launches.
+//!
+//! Bounds are also computed once per sequence frame as each frame finishes
+//! loading and kept in a [`FrameBoundsTable`]. Camera framing, lighting and
+//! culling can then query exact bounds for any frame, or the union over a
+//! frame range, without rescanning vertex data during playback.
 
-use bevy::prelude::*;
+use bevy::math::Vec3A;
 use bevy::mesh::VertexAttributeValues;
+use bevy::prelude::*;
+use rayon::prelude::*;
+use std::ops::{Bound, RangeBounds};
 
-use super::sequence::loader::SequenceMeshDisplay;
+use super::sequence::loader::{
+    FrameLoadedEvent, LoadSequenceRequest, SequenceAssets, SequenceMeshDisplay,
+};
 use super::settings::{MeshBoundsSettings, SettingsResource};
 
+/// Vertices per rayon work item when scanning positions.
+///
+/// Large enough that the per-task overhead is negligible next to the
+/// min/max work, small enough to balance across cores on ~100k-vertex frames.
+const AABB_CHUNK_SIZE: usize = 16 * 1024;
+
 /// Plugin that registers mesh-info systems and resources.
 pub struct MeshInfoPlugin;
 
@@ -20,9 +36,13 @@ impl Plugin for MeshInfoPlugin {
             .add_systems(
                 Update,
                 (
+                    reset_frame_bounds_on_load_request,
+                    compute_frame_bounds_on_load,
                     compute_bounds_on_first_load,
+                    sync_displayed_frame_bounds,
                     handle_recompute_request,
-                ),
+                )
+                    .chain(),
             );
     }
 }
@@ -44,6 +64,10 @@ pub struct MeshDimensions {
     pub dimensions: Option<Vec3>,
     /// Whether we already attempted auto-computation for this load
     pub computed: bool,
+    /// Per-frame bounds for the current sequence, filled in as frames load
+    pub frames: FrameBoundsTable,
+    /// Sequence frame whose bounds `min`/`max` currently reflect
+    pub current_frame: Option<usize>,
 }
 
 impl MeshDimensions {
@@ -54,6 +78,7 @@ impl MeshDimensions {
             max: Some(Vec3::from_array(s.max)),
             dimensions: Some(Vec3::from_array(s.dimensions)),
             computed: true,
+            ..Default::default()
         }
     }
 
@@ -75,6 +100,139 @@ impl MeshDimensions {
         self.max = None;
         self.dimensions = None;
         self.computed = false;
+        self.current_frame = None;
+    }
+
+    /// Exact bounds of a single sequence frame, if it has been measured.
+    pub fn frame_bounds(&self, frame: usize) -> Option<FrameBounds> {
+        self.frames.get(frame)
+    }
+
+    /// Union of the bounds of every measured frame in `range`.
+    ///
+    /// Frames that have not finished loading are skipped; use
+    /// [`FrameBoundsTable::is_complete`] to check whether the result covers
+    /// the whole range.
+    pub fn union_bounds(&self, range: impl RangeBounds<usize>) -> Option<FrameBounds> {
+        self.frames.union(range)
+    }
+
+    /// Set the current bounds (`min`, `max`, `dimensions`) from `bounds`.
+    fn set_bounds(&mut self, bounds: FrameBounds) {
+        self.min = Some(bounds.min);
+        self.max = Some(bounds.max);
+        self.dimensions = Some(bounds.dimensions());
+        self.computed = true;
+    }
+
+    /// Whether `min`/`max` already equal `bounds`.
+    fn has_bounds(&self, bounds: FrameBounds) -> bool {
+        self.min == Some(bounds.min) && self.max == Some(bounds.max)
+    }
+}
+
+/// Axis-aligned bounds of one mesh frame.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct FrameBounds {
+    /// Minimum corner (metres)
+    pub min: Vec3,
+    /// Maximum corner (metres)
+    pub max: Vec3,
+}
+
+impl FrameBounds {
+    /// Extent along each axis (max − min).
+    pub fn dimensions(&self) -> Vec3 {
+        self.max - self.min
+    }
+
+    /// Centre point of the box.
+    pub fn center(&self) -> Vec3 {
+        (self.min + self.max) * 0.5
+    }
+
+    /// Smallest box containing both `self` and `other`.
+    pub fn union(&self, other: &FrameBounds) -> FrameBounds {
+        FrameBounds {
+            min: self.min.min(other.min),
+            max: self.max.max(other.max),
+        }
+    }
+}
+
+/// Compact per-frame bounds table indexed by sequence frame.
+///
+/// Holds one optional [`FrameBounds`] (24 bytes) per frame, so even
+/// multi-thousand-frame sequences cost well under a megabyte.
+#[derive(Debug, Clone, Default)]
+pub struct FrameBoundsTable {
+    bounds: Vec<Option<FrameBounds>>,
+}
+
+impl FrameBoundsTable {
+    /// Clear the table and size it for a sequence of `frame_count` frames.
+    pub fn reset(&mut self, frame_count: usize) {
+        self.bounds.clear();
+        self.bounds.resize(frame_count, None);
+    }
+
+    /// Record the bounds of `frame`, growing the table if needed.
+    pub fn insert(&mut self, frame: usize, bounds: FrameBounds) {
+        if frame >= self.bounds.len() {
+            self.bounds.resize(frame + 1, None);
+        }
+        self.bounds[frame] = Some(bounds);
+    }
+
+    /// Bounds of `frame`, if measured.
+    pub fn get(&self, frame: usize) -> Option<FrameBounds> {
+        self.bounds.get(frame).copied().flatten()
+    }
+
+    /// Number of frame slots in the table.
+    pub fn len(&self) -> usize {
+        self.bounds.len()
+    }
+
+    /// Whether the table has no frame slots.
+    pub fn is_empty(&self) -> bool {
+        self.bounds.is_empty()
+    }
+
+    /// Number of frames whose bounds have been measured.
+    pub fn measured_count(&self) -> usize {
+        self.bounds.iter().filter(|b| b.is_some()).count()
+    }
+
+    /// Union of all measured bounds in `range` (clamped to the table).
+    pub fn union(&self, range: impl RangeBounds<usize>) -> Option<FrameBounds> {
+        self.slice(range)
+            .iter()
+            .flatten()
+            .copied()
+            .reduce(|a, b| a.union(&b))
+    }
+
+    /// Whether every frame in `range` (clamped to the table) has been measured.
+    pub fn is_complete(&self, range: impl RangeBounds<usize>) -> bool {
+        self.slice(range).iter().all(Option::is_some)
+    }
+
+    fn slice(&self, range: impl RangeBounds<usize>) -> &[Option<FrameBounds>] {
+        let len = self.bounds.len();
+        let start = match range.start_bound() {
+            Bound::Included(&s) => s,
+            Bound::Excluded(&s) => s.saturating_add(1),
+            Bound::Unbounded => 0,
+        }
+        .min(len);
+        let end = match range.end_bound() {
+            Bound::Included(&e) => e.saturating_add(1),
+            Bound::Excluded(&e) => e,
+            Bound::Unbounded => len,
+        }
+        .clamp(start, len);
+        &self.bounds[start..end]
     }
 }
 
@@ -82,6 +240,44 @@ impl MeshDimensions {
 // Systems
 // ---------------------------------------------------------------------------
 
+/// Size the per-frame table for each newly requested sequence.
+fn reset_frame_bounds_on_load_request(
+    mut requests: MessageReader<LoadSequenceRequest>,
+    mut dims: ResMut<MeshDimensions>,
+) {
+    for request in requests.read() {
+        dims.frames.reset(request.frame_paths.len());
+        dims.current_frame = None;
+    }
+}
+
+/// Measure each sequence frame once, as soon as its mesh asset is loaded.
+fn compute_frame_bounds_on_load(
+    mut events: MessageReader<FrameLoadedEvent>,
+    mut dims: ResMut<MeshDimensions>,
+    sequence_assets: Res<SequenceAssets>,
+    meshes: Res<Assets<Mesh>>,
+) {
+    for event in events.read() {
+        if !event.success {
+            continue;
+        }
+        let Some(mesh) = sequence_assets
+            .get_frame(event.frame_index)
+            .and_then(|handle| meshes.get(handle))
+        else {
+            continue;
+        };
+        if let Some(bounds) = compute_aabb(mesh) {
+            // Bookkeeping only; consumers react to `min`/`max` changes via
+            // `sync_displayed_frame_bounds`.
+            dims.bypass_change_detection()
+                .frames
+                .insert(event.frame_index, bounds);
+        }
+    }
+}
+
 /// Automatically compute bounds the first time a `SequenceMeshDisplay` entity
 /// appears and we haven't computed yet.
 fn compute_bounds_on_first_load(
@@ -102,28 +298,53 @@ fn compute_bounds_on_first_load(
         return;
     };
 
-    if let Some((mn, mx)) = compute_aabb(mesh) {
-        let d = mx - mn;
+    if let Some(bounds) = compute_aabb(mesh) {
+        let (mn, mx, d) = (bounds.min, bounds.max, bounds.dimensions());
         info!(
             "Mesh AABB computed — min: ({:.2}, {:.2}, {:.2}), max: ({:.2}, {:.2}, {:.2}), dims: {:.2} × {:.2} × {:.2} m",
             mn.x, mn.y, mn.z, mx.x, mx.y, mx.z, d.x, d.y, d.z
         );
-        dims.min = Some(mn);
-        dims.max = Some(mx);
-        dims.dimensions = Some(d);
-        dims.computed = true;
+        dims.set_bounds(bounds);
 
         // Persist to seaview.toml
         save_bounds_to_settings(&dims, &mut settings_res);
     }
 }
 
+/// Keep `min`/`max` in step with the displayed sequence frame.
+///
+/// Uses the bounds measured at load time, so switching frames during
+/// playback is a table lookup. The resource is only marked changed when the
+/// bounds actually differ, so lighting is not rebuilt for identical frames.
+fn sync_displayed_frame_bounds(
+    mut dims: ResMut<MeshDimensions>,
+    sequence_assets: Res<SequenceAssets>,
+) {
+    let Some(frame) = sequence_assets.displayed_frame else {
+        return;
+    };
+    if dims.current_frame == Some(frame) {
+        return;
+    }
+    let Some(bounds) = dims.frame_bounds(frame) else {
+        return;
+    };
+
+    if dims.has_bounds(bounds) {
+        dims.bypass_change_detection().current_frame = Some(frame);
+    } else {
+        dims.set_bounds(bounds);
+        dims.current_frame = Some(frame);
+    }
+}
+
 /// Respond to an explicit recompute request (e.g. the UI button).
 fn handle_recompute_request(
     mut events: MessageReader<RecomputeMeshBounds>,
     mut dims: ResMut<MeshDimensions>,
     mesh_query: Query<&Mesh3d, With<SequenceMeshDisplay>>,
     meshes: Res<Assets<Mesh>>,
+    sequence_assets: Res<SequenceAssets>,
     mut settings_res: ResMut<SettingsResource>,
 ) {
     // Drain all pending events; we only need to recompute once.
@@ -145,16 +366,17 @@ fn handle_recompute_request(
         return;
     };
 
-    if let Some((mn, mx)) = compute_aabb(mesh) {
-        let d = mx - mn;
+    if let Some(bounds) = compute_aabb(mesh) {
+        let d = bounds.dimensions();
         info!(
             "Mesh AABB recomputed — dims: {:.2} × {:.2} × {:.2} m",
             d.x, d.y, d.z
         );
-        dims.min = Some(mn);
-        dims.max = Some(mx);
-        dims.dimensions = Some(d);
-        dims.computed = true;
+        dims.set_bounds(bounds);
+        if let Some(frame) = sequence_assets.displayed_frame {
+            dims.frames.insert(frame, bounds);
+            dims.current_frame = Some(frame);
+        }
 
         save_bounds_to_settings(&dims, &mut settings_res);
     }
@@ -164,23 +386,11 @@ fn handle_recompute_request(
 // Helpers
 // ---------------------------------------------------------------------------
 
-/// Walk all position vertices and return (min, max).
-fn compute_aabb(mesh: &Mesh) -> Option<(Vec3, Vec3)> {
+/// Compute the AABB of a mesh's `Float32x3` position attribute.
+fn compute_aabb(mesh: &Mesh) -> Option<FrameBounds> {
     let positions = mesh.attribute(Mesh::ATTRIBUTE_POSITION)?;
     match positions {
-        VertexAttributeValues::Float32x3(verts) => {
-            if verts.is_empty() {
-                return None;
-            }
-            let mut mn = Vec3::new(f32::MAX, f32::MAX, f32::MAX);
-            let mut mx = Vec3::new(f32::MIN, f32::MIN, f32::MIN);
-            for v in verts {
-                let p = Vec3::new(v[0], v[1], v[2]);
-                mn = mn.min(p);
-                mx = mx.max(p);
-            }
-            Some((mn, mx))
-        }
+        VertexAttributeValues::Float32x3(verts) => compute_aabb_positions(verts),
         _ => {
             warn!("Mesh positions are not Float32x3 — cannot compute AABB");
             None
@@ -188,6 +398,45 @@ fn compute_aabb(mesh: &Mesh) -> Option<(Vec3, Vec3)> {
     }
 }
 
+/// Compute the AABB of a position slice.
+///
+/// Chunks are reduced in parallel with rayon; within a chunk the min/max is
+/// folded in [`Vec3A`] lanes so each vertex costs two SIMD ops instead of six
+/// scalar compares. Small meshes are scanned on the calling thread.
+pub fn compute_aabb_positions(positions: &[[f32; 3]]) -> Option<FrameBounds> {
+    if positions.is_empty() {
+        return None;
+    }
+
+    let (mn, mx) = if positions.len() <= AABB_CHUNK_SIZE {
+        aabb_chunk(positions)
+    } else {
+        positions
+            .par_chunks(AABB_CHUNK_SIZE)
+            .map(aabb_chunk)
+            .reduce(
+                || (Vec3A::splat(f32::MAX), Vec3A::splat(f32::MIN)),
+                |(amn, amx), (bmn, bmx)| (amn.min(bmn), amx.max(bmx)),
+            )
+    };
+
+    Some(FrameBounds {
+        min: mn.into(),
+        max: mx.into(),
+    })
+}
+
+/// Serial SIMD min/max over one chunk of positions.
+fn aabb_chunk(chunk: &[[f32; 3]]) -> (Vec3A, Vec3A) {
+    chunk.iter().fold(
+        (Vec3A::splat(f32::MAX), Vec3A::splat(f32::MIN)),
+        |(mn, mx), p| {
+            let v = Vec3A::from_array(*p);
+            (mn.min(v), mx.max(v))
+        },
+    )
+}
+
 /// Persist the current bounds into the settings resource and flush to disk.
 fn save_bounds_to_settings(dims: &MeshDimensions, settings_res: &mut SettingsResource) {
     if let Some(bounds) = dims.to_settings() {
@@ -199,3 +448,79 @@ fn save_bounds_to_settings(dims: &MeshDimensions, settings_res: &mut SettingsRes
         }
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn bounds(min: [f32; 3], max: [f32; 3]) -> FrameBounds {
+        FrameBounds {
+            min: Vec3::from_array(min),
+            max: Vec3::from_array(max),
+        }
+    }
+
+    #[test]
+    fn test_aabb_empty() {
+        assert_eq!(compute_aabb_positions(&[]), None);
+    }
+
+    #[test]
+    fn test_aabb_matches_serial_scan() {
+        // Enough vertices to take the parallel path with a ragged last chunk.
+        let n = AABB_CHUNK_SIZE * 3 + 17;
+        let positions: Vec<[f32; 3]> = (0..n)
+            .map(|i| {
+                let t = i as f32;
+                [t.sin() * 5.0, (t * 0.37).cos() * 2.0 - 1.0, t * 0.001]
+            })
+            .collect();
+
+        let mut mn = Vec3::splat(f32::MAX);
+        let mut mx = Vec3::splat(f32::MIN);
+        for p in &positions {
+            mn = mn.min(Vec3::from_array(*p));
+            mx = mx.max(Vec3::from_array(*p));
+        }
+
+        let b = compute_aabb_positions(&positions).unwrap();
+        assert_eq!(b.min, mn);
+        assert_eq!(b.max, mx);
+    }
+
+    #[test]
+    fn test_frame_table_exact_and_union() {
+        let mut table = FrameBoundsTable::default();
+        table.reset(4);
+        table.insert(0, bounds([0.0, 0.0, 0.0], [1.0, 1.0, 1.0]));
+        table.insert(2, bounds([-1.0, 0.5, 0.0], [0.5, 3.0, 1.0]));
+
+        assert_eq!(table.len(), 4);
+        assert_eq!(table.measured_count(), 2);
+        assert_eq!(table.get(1), None);
+        assert_eq!(
+            table.get(2),
+            Some(bounds([-1.0, 0.5, 0.0], [0.5, 3.0, 1.0]))
+        );
+
+        assert_eq!(
+            table.union(..),
+            Some(bounds([-1.0, 0.0, 0.0], [1.0, 3.0, 1.0]))
+        );
+        assert_eq!(table.union(1..2), None);
+        assert_eq!(table.union(2..=10), table.get(2));
+        assert!(!table.is_complete(..));
+        assert!(table.is_complete(0..1));
+    }
+
+    #[test]
+    fn test_frame_table_grows_on_insert() {
+        let mut table = FrameBoundsTable::default();
+        table.insert(3, bounds([0.0; 3], [1.0; 3]));
+        assert_eq!(table.len(), 4);
+        assert!(!table.is_complete(..));
+
+        table.reset(2);
+        assert_eq!(table.measured_count(), 0);
+    }
+}
@@ -0,0 +1,347 @@
+//! Adaptive jitter buffer for live mesh streams
+//!
+//! Frames arrive in bursts and occasionally out of order. The buffer holds
+//! each stream's frames keyed by frame number, waits a small playout delay
+//! sized from the observed arrival jitter, and then releases frames in order,
+//! one per learned arrival interval. The wire protocol carries no sender
+//! timestamps, so pacing comes from arrival times alone.
+//!
+//! A frame far behind the last one released, or a run of late frames longer
+//! than the buffer, means the sender restarted its frame numbering. The
+//! stream then starts a new epoch: its pending frames are flushed and
+//! numbering is tracked afresh.
+
+use std::collections::{BTreeMap, HashMap};
+use std::time::{Duration, Instant};
+
+/// Tuning for [`JitterBuffer`]
+#[derive(Debug, Clone)]
+pub struct JitterConfig {
+    /// Smallest playout delay, even on a perfectly smooth stream
+    pub min_delay: Duration,
+    /// Largest playout delay the buffer will adapt up to
+    pub max_delay: Duration,
+    /// Playout delay as a multiple of the smoothed jitter estimate
+    pub jitter_multiplier: f32,
+    /// Maximum frames held per stream; the oldest is dropped beyond this
+    pub max_depth: usize,
+}
+
+impl Default for JitterConfig {
+    fn default() -> Self {
+        Self {
+            min_delay: Duration::from_millis(20),
+            max_delay: Duration::from_millis(500),
+            jitter_multiplier: 3.0,
+            max_depth: 16,
+        }
+    }
+}
+
+/// Counters exposed to diagnostics
+#[derive(Debug, Clone, Copy, Default, PartialEq)]
+pub struct JitterStats {
+    /// Frames currently buffered across all streams
+    pub depth: usize,
+    /// Frames that arrived after a later frame had already been released
+    pub late: u64,
+    /// Frames discarded because the buffer overflowed, or skipped over as
+    /// missing when a later frame was released
+    pub dropped: u64,
+    /// Frames released for display
+    pub released: u64,
+    /// Largest current playout delay across streams
+    pub delay: Duration,
+}
+
+/// Per-simulation reorder and timing state
+struct StreamState<T> {
+    pending: BTreeMap<u32, T>,
+    last_released: Option<u32>,
+    last_arrival: Option<Instant>,
+    /// Late frames in a row
+    late_run: usize,
+    /// Smoothed inter-arrival interval, seconds
+    interval: f32,
+    /// Smoothed absolute deviation of arrival spacing, seconds
+    jitter: f32,
+    /// Time the next frame may be released
+    next_release: Option<Instant>,
+}
+
+impl<T> StreamState<T> {
+    fn new() -> Self {
+        Self {
+            pending: BTreeMap::new(),
+            last_released: None,
+            last_arrival: None,
+            late_run: 0,
+            interval: 0.0,
+            jitter: 0.0,
+            next_release: None,
+        }
+    }
+
+    /// Update interval and jitter estimates (RFC 3550 style 1/16 smoothing).
+    fn observe_arrival(&mut self, now: Instant) {
+        if let Some(prev) = self.last_arrival {
+            let arrival_gap = now.saturating_duration_since(prev).as_secs_f32();
+            if self.interval > 0.0 {
+                let deviation = (arrival_gap - self.interval).abs();
+                self.jitter += (deviation - self.jitter) / 16.0;
+            }
+            if self.interval == 0.0 {
+                self.interval = arrival_gap;
+            } else {
+                self.interval += (arrival_gap - self.interval) / 16.0;
+            }
+        }
+        self.last_arrival = Some(now);
+    }
+
+    fn delay(&self, config: &JitterConfig) -> Duration {
+        Duration::from_secs_f32(self.jitter * config.jitter_multiplier)
+            .clamp(config.min_delay, config.max_delay)
+    }
+
+    /// Time at which the oldest pending frame should be shown.
+    fn due_at(&self, config: &JitterConfig, now: Instant) -> Option<Instant> {
+        self.pending.keys().next()?;
+        Some(
+            self.next_release
+                .unwrap_or_else(|| now + self.delay(config)),
+        )
+    }
+}
+
+/// Reordering, adaptive-delay playout buffer keyed by
+/// `(simulation_id, frame_number)`
+pub struct JitterBuffer<T> {
+    config: JitterConfig,
+    streams: HashMap<String, StreamState<T>>,
+    stats: JitterStats,
+}
+
+impl<T> Default for JitterBuffer<T> {
+    fn default() -> Self {
+        Self::new(JitterConfig::default())
+    }
+}
+
+impl<T> JitterBuffer<T> {
+    /// Create an empty buffer
+    pub fn new(config: JitterConfig) -> Self {
+        Self {
+            config,
+            streams: HashMap::new(),
+            stats: JitterStats::default(),
+        }
+    }
+
+    /// Buffer a frame that arrived at `now`.
+    pub fn push(&mut self, simulation_id: &str, frame_number: u32, item: T, now: Instant) {
+        let stream = self
+            .streams
+            .entry(simulation_id.to_string())
+            .or_insert_with(StreamState::new);
+
+        if let Some(last) = stream.last_released.filter(|&last| frame_number <= last) {
+            let depth = self.config.max_depth;
+            if (last - frame_number) as usize <= depth && stream.late_run < depth {
+                stream.late_run += 1;
+                self.stats.late += 1;
+                return;
+            }
+            // The sender restarted its numbering; flush the old epoch.
+            self.stats.dropped += stream.pending.len() as u64;
+            *stream = StreamState::new();
+        }
+        stream.late_run = 0;
+
+        stream.observe_arrival(now);
+        if stream.next_release.is_none() {
+            stream.next_release = Some(now + stream.delay(&self.config));
+        }
+        stream.pending.insert(frame_number, item);
+
+        while stream.pending.len() > self.config.max_depth {
+            if let Some((dropped, _)) = stream.pending.pop_first() {
+                stream.last_released = Some(dropped);
+                self.stats.dropped += 1;
+            }
+        }
+        self.refresh_stats();
+    }
+
+    /// Release the frames whose playout time has come, oldest first.
+    ///
+    /// Each stream releases at most one frame per call so a stalled stream
+    /// catching up does not burst.
+    pub fn pop_ready(&mut self, now: Instant) -> Vec<(String, u32, T)> {
+        let mut ready = Vec::new();
+        for (simulation_id, stream) in &mut self.streams {
+            let Some(due) = stream.due_at(&self.config, now) else {
+                continue;
+            };
+            if now < due {
+                continue;
+            }
+            let Some((frame_number, item)) = stream.pending.pop_first() else {
+                continue;
+            };
+
+            if let Some(last) = stream.last_released {
+                self.stats.dropped +=
+                    u64::from(frame_number.saturating_sub(last).saturating_sub(1));
+            }
+            stream.last_released = Some(frame_number);
+            self.stats.released += 1;
+            ready.push((simulation_id.clone(), frame_number, item));
+
+            let interval = Duration::from_secs_f32(stream.interval);
+            stream.next_release = Some((due + interval).max(now));
+        }
+        self.refresh_stats();
+        ready
+    }
+
+    /// Forget a stream (e.g. when the sender ends it)
+    pub fn remove_stream(&mut self, simulation_id: &str) {
+        self.streams.remove(simulation_id);
+        self.refresh_stats();
+    }
+
+    /// Current counters
+    pub fn stats(&self) -> JitterStats {
+        self.stats
+    }
+
+    fn refresh_stats(&mut self) {
+        self.stats.depth = self.streams.values().map(|s| s.pending.len()).sum();
+        self.stats.delay = self
+            .streams
+            .values()
+            .map(|s| s.delay(&self.config))
+            .max()
+            .unwrap_or_default();
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const MS: Duration = Duration::from_millis(1);
+
+    fn config() -> JitterConfig {
+        JitterConfig {
+            min_delay: 20 * MS,
+            max_delay: 200 * MS,
+            jitter_multiplier: 3.0,
+            max_depth: 4,
+        }
+    }
+
+    #[test]
+    fn test_reorders_frames() {
+        let mut buffer = JitterBuffer::new(config());
+        let t0 = Instant::now();
+
+        // Frames 1 and 2 arrive swapped in a burst.
+        buffer.push("sim", 0, 'a', t0);
+        buffer.push("sim", 2, 'c', t0 + 70 * MS);
+        buffer.push("sim", 1, 'b', t0 + 71 * MS);
+
+        let released: Vec<_> = (0..3)
+            .flat_map(|i| buffer.pop_ready(t0 + (200 + i * 100) * MS))
+            .map(|(_, n, c)| (n, c))
+            .collect();
+        assert_eq!(released, vec![(0, 'a'), (1, 'b'), (2, 'c')]);
+        assert_eq!(buffer.stats().depth, 0);
+        assert_eq!(buffer.stats().late, 0);
+    }
+
+    #[test]
+    fn test_holds_frames_until_playout_delay() {
+        let mut buffer = JitterBuffer::new(config());
+        let t0 = Instant::now();
+
+        buffer.push("sim", 0, (), t0);
+        assert!(buffer.pop_ready(t0 + 5 * MS).is_empty());
+        assert_eq!(buffer.pop_ready(t0 + 25 * MS).len(), 1);
+    }
+
+    #[test]
+    fn test_late_and_dropped_frames_are_counted() {
+        let mut buffer = JitterBuffer::new(config());
+        let t0 = Instant::now();
+
+        buffer.push("sim", 0, (), t0);
+        buffer.push("sim", 3, (), t0 + MS);
+        assert_eq!(buffer.pop_ready(t0 + 100 * MS).len(), 1);
+        assert_eq!(buffer.pop_ready(t0 + 200 * MS).len(), 1);
+
+        // Frames 1 and 2 were skipped; frame 2 then shows up too late.
+        assert_eq!(buffer.stats().dropped, 2);
+        buffer.push("sim", 2, (), t0 + 250 * MS);
+        assert_eq!(buffer.stats().late, 1);
+
+        // Overflow drops the oldest.
+        for n in 10..16 {
+            buffer.push("sim", n, (), t0 + 300 * MS);
+        }
+        assert_eq!(buffer.stats().depth, 4);
+        assert_eq!(buffer.stats().dropped, 4);
+    }
+
+    #[test]
+    fn test_restarted_numbering_starts_new_epoch() {
+        let mut buffer = JitterBuffer::new(config());
+        let t0 = Instant::now();
+
+        buffer.push("sim", 100, 'a', t0);
+        assert_eq!(buffer.pop_ready(t0 + 100 * MS).len(), 1);
+
+        // Far behind the last release: a restart, not a late frame.
+        buffer.push("sim", 0, 'b', t0 + 200 * MS);
+        let released = buffer.pop_ready(t0 + 300 * MS);
+        assert_eq!(released[0].1, 0);
+        assert_eq!(buffer.stats().late, 0);
+
+        // Close behind, but late for longer than the buffer could reorder.
+        for _ in 0..5 {
+            buffer.push("sim", 0, 'c', t0 + 400 * MS);
+        }
+        assert_eq!(buffer.stats().late, 4);
+        assert_eq!(buffer.stats().depth, 1);
+    }
+
+    #[test]
+    fn test_releases_one_per_call() {
+        let mut buffer = JitterBuffer::new(config());
+        let t0 = Instant::now();
+        for n in 0..3 {
+            buffer.push("sim", n, n, t0 + n * 33 * MS);
+        }
+        let late = t0 + Duration::from_secs(1);
+        assert_eq!(buffer.pop_ready(late).len(), 1);
+        assert_eq!(buffer.pop_ready(late).len(), 1);
+        assert_eq!(buffer.stats().depth, 1);
+    }
+
+    #[test]
+    fn test_delay_adapts_to_jitter() {
+        let mut smooth = JitterBuffer::new(config());
+        let mut bursty = JitterBuffer::new(config());
+        let t0 = Instant::now();
+        for n in 0..32u32 {
+            smooth.push("sim", n, (), t0 + n * 33 * MS);
+            let wobble = if n % 2 == 0 { 0 } else { 40 };
+            bursty.push("sim", n, (), t0 + (n * 33 + wobble) * MS);
+            smooth.pop_ready(t0 + n * 33 * MS);
+            bursty.pop_ready(t0 + n * 33 * MS);
+        }
+        assert_eq!(smooth.stats().delay, 20 * MS);
+        assert!(bursty.stats().delay > 20 * MS);
+    }
+}
@@ -1,5 +1,6 @@
 //! Network communication module for mesh data transfer
 
+pub mod jitter;
 pub mod protocol;
 pub mod receiver;
 
@@ -16,6 +17,9 @@ pub struct NetworkConfig {
     pub enabled: bool,
     pub port: u16,
     pub max_message_size_mb: usize,
+    /// Maximum number of received frames converted to meshes concurrently
+    /// on the async compute pool. Zero converts inline on the main thread.
+    pub max_concurrent_conversions: usize,
 }
 
 impl Default for NetworkConfig {
@@ -24,6 +28,7 @@ impl Default for NetworkConfig {
             enabled: false,
             port: 9877,
             max_message_size_mb: 100,
+            max_concurrent_conversions: 2,
         }
     }
 }
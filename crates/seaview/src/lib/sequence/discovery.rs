@@ -1,6 +1,9 @@
 //! Sequence discovery module for finding mesh file sequences
 
-use super::{loader::LoadSequenceRequest, FrameInfo, Sequence, SequenceEvent, SequenceManager};
+use super::{
+    index::SequenceIndex, loader::LoadSequenceRequest, FrameInfo, Sequence, SequenceEvent,
+    SequenceManager,
+};
 use bevy::prelude::*;
 use regex::Regex;
 use std::collections::HashMap;
@@ -173,6 +176,14 @@ pub fn discover_sequences(
             sequence.add_frame(FrameInfo::new(path, frame_number));
         }
 
+        // A saved index that still matches the frame files is usable right
+        // away; anything else is rebuilt in the background once the sequence
+        // is opened.
+        sequence.index = SequenceIndex::load_from_dir(directory)
+            .ok()
+            .flatten()
+            .filter(|index| index.is_current_for(&sequence.frames));
+
         sequences.push(sequence);
     }
 
@@ -0,0 +1,594 @@
+//! Per-sequence metadata sidecar index
+//!
+//! The index is stored as `seaview-index.toml` next to `seaview.toml` in the
+//! sequence directory. It records, for every frame, the vertex and triangle
+//! counts, bounding box, file size and a content hash, so the UI and memory
+//! planning can answer questions about a sequence without parsing any mesh.
+//!
+//! The index is built once in the background the first time a sequence is
+//! opened. A saved index is trusted while every frame file keeps its name,
+//! size and modification time; when some frames change, only those are
+//! parsed again. Discovery attaches a saved index that is still current, so
+//! the session panel and load planning can use it immediately.
+
+use bevy::prelude::*;
+use bevy::tasks::{block_on, futures_lite::future, AsyncComputeTaskPool, Task};
+use rayon::prelude::*;
+use serde::{Deserialize, Serialize};
+use std::collections::HashMap;
+use std::io::Cursor;
+use std::path::{Path, PathBuf};
+use std::time::UNIX_EPOCH;
+
+use super::{FrameInfo, SequenceManager};
+
+/// Filename used for the per-sequence index
+pub const INDEX_FILENAME: &str = "seaview-index.toml";
+
+/// Version of the index layout; older files are rebuilt.
+pub const INDEX_VERSION: u32 = 2;
+
+/// Plugin that loads or builds the sidecar index for the current sequence
+pub struct SequenceIndexPlugin;
+
+impl Plugin for SequenceIndexPlugin {
+    fn build(&self, app: &mut App) {
+        app.init_resource::<SequenceIndexTask>()
+            .add_systems(Update, (start_index_for_sequence, poll_index_task).chain());
+    }
+}
+
+/// Index metadata for a single frame file
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct FrameIndexEntry {
+    /// Frame filename (relative to the sequence directory)
+    pub filename: String,
+    /// File size in bytes
+    pub file_size: u64,
+    /// File modification time (nanoseconds since the Unix epoch)
+    pub modified: u64,
+    /// FNV-1a 64-bit hash of the file contents, as 16 hex digits
+    pub content_hash: String,
+    /// Number of vertices in the mesh as loaded
+    pub vertex_count: u64,
+    /// Number of triangles in the mesh
+    pub triangle_count: u64,
+    /// Axis-aligned minimum corner [x, y, z]
+    pub min: [f32; 3],
+    /// Axis-aligned maximum corner [x, y, z]
+    pub max: [f32; 3],
+}
+
+impl FrameIndexEntry {
+    /// Whether this entry still describes `frame`, judged by filename, size
+    /// and modification time.
+    fn matches(&self, frame: &FrameInfo) -> bool {
+        self.filename == frame.filename
+            && self.file_size == frame.file_size
+            && Some(self.modified) == modified_nanos(&frame.path)
+    }
+}
+
+/// Sidecar index for a whole sequence, serialized as `seaview-index.toml`
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct SequenceIndex {
+    /// Index layout version
+    pub version: u32,
+    /// One entry per frame, in sequence order
+    pub frames: Vec<FrameIndexEntry>,
+}
+
+impl SequenceIndex {
+    /// Build an index by parsing every frame in parallel.
+    pub fn build(frames: &[FrameInfo]) -> Result<Self, IndexError> {
+        let entries = frames
+            .par_iter()
+            .map(|frame| index_frame(&frame.path))
+            .collect::<Result<Vec<_>, _>>()?;
+        Ok(Self {
+            version: INDEX_VERSION,
+            frames: entries,
+        })
+    }
+
+    /// Load the index from the given directory.
+    /// Returns Ok(None) if the file doesn't exist.
+    pub fn load_from_dir(dir: &Path) -> Result<Option<Self>, IndexError> {
+        let path = dir.join(INDEX_FILENAME);
+        if !path.exists() {
+            return Ok(None);
+        }
+        let contents = std::fs::read_to_string(&path).map_err(|e| IndexError::Io {
+            path: path.clone(),
+            source: e,
+        })?;
+        let index: SequenceIndex =
+            toml::from_str(&contents).map_err(|e| IndexError::ParseToml {
+                path: path.clone(),
+                source: e,
+            })?;
+        Ok(Some(index))
+    }
+
+    /// Save the index to the given directory, replacing any existing file.
+    pub fn save_to_dir(&self, dir: &Path) -> Result<(), IndexError> {
+        let path = dir.join(INDEX_FILENAME);
+        let contents = toml::to_string(self).map_err(|e| IndexError::SerializeToml {
+            path: path.clone(),
+            source: e,
+        })?;
+        std::fs::write(&path, contents).map_err(|e| IndexError::Io {
+            path: path.clone(),
+            source: e,
+        })?;
+        info!("Saved sequence index to {:?}", path);
+        Ok(())
+    }
+
+    /// Whether this index still describes `frames`.
+    ///
+    /// Only filenames, sizes and modification times are compared; no frame
+    /// is read.
+    pub fn is_current_for(&self, frames: &[FrameInfo]) -> bool {
+        self.version == INDEX_VERSION
+            && self.frames.len() == frames.len()
+            && self
+                .frames
+                .iter()
+                .zip(frames)
+                .all(|(entry, frame)| entry.matches(frame))
+    }
+
+    /// Bring the index up to date with `frames`, parsing only the frames
+    /// that are new or whose size or modification time changed.
+    ///
+    /// Returns the updated index and the number of frames that were parsed.
+    pub fn refresh(&self, frames: &[FrameInfo]) -> Result<(Self, usize), IndexError> {
+        let known: HashMap<&str, &FrameIndexEntry> = if self.version == INDEX_VERSION {
+            self.frames
+                .iter()
+                .map(|entry| (entry.filename.as_str(), entry))
+                .collect()
+        } else {
+            HashMap::new()
+        };
+        let unchanged = |frame: &FrameInfo| {
+            known
+                .get(frame.filename.as_str())
+                .filter(|entry| entry.matches(frame))
+                .map(|&entry| entry.clone())
+        };
+
+        let reindexed = frames
+            .iter()
+            .filter(|&frame| unchanged(frame).is_none())
+            .count();
+        let entries = frames
+            .par_iter()
+            .map(|frame| match unchanged(frame) {
+                Some(entry) => Ok(entry),
+                None => index_frame(&frame.path),
+            })
+            .collect::<Result<Vec<_>, _>>()?;
+        Ok((
+            Self {
+                version: INDEX_VERSION,
+                frames: entries,
+            },
+            reindexed,
+        ))
+    }
+
+    /// Entry for a frame index
+    pub fn frame(&self, index: usize) -> Option<&FrameIndexEntry> {
+        self.frames.get(index)
+    }
+
+    /// Total triangles across all frames
+    pub fn total_triangles(&self) -> u64 {
+        self.frames.iter().map(|f| f.triangle_count).sum()
+    }
+
+    /// Total size of all frame files in bytes
+    pub fn total_bytes(&self) -> u64 {
+        self.frames.iter().map(|f| f.file_size).sum()
+    }
+
+    /// Total vertices across all frames
+    pub fn total_vertices(&self) -> u64 {
+        self.frames.iter().map(|f| f.vertex_count).sum()
+    }
+
+    /// Largest vertex count of any single frame
+    pub fn max_vertex_count(&self) -> u64 {
+        self.frames
+            .iter()
+            .map(|f| f.vertex_count)
+            .max()
+            .unwrap_or(0)
+    }
+
+    /// Union of all frame bounds as (min, max)
+    pub fn bounds(&self) -> Option<([f32; 3], [f32; 3])> {
+        self.frames
+            .iter()
+            .map(|f| (f.min, f.max))
+            .reduce(|(amn, amx), (bmn, bmx)| {
+                (
+                    std::array::from_fn(|i| amn[i].min(bmn[i])),
+                    std::array::from_fn(|i| amx[i].max(bmx[i])),
+                )
+            })
+    }
+}
+
+/// Errors that can occur while building or reading the index
+#[derive(Debug, thiserror::Error)]
+pub enum IndexError {
+    #[error("I/O error at {path}: {source}")]
+    Io {
+        path: PathBuf,
+        source: std::io::Error,
+    },
+    #[error("Failed to parse TOML at {path}: {source}")]
+    ParseToml {
+        path: PathBuf,
+        source: toml::de::Error,
+    },
+    #[error("Failed to serialize TOML for {path}: {source}")]
+    SerializeToml {
+        path: PathBuf,
+        source: toml::ser::Error,
+    },
+    #[error("Failed to parse mesh {path}: {message}")]
+    Mesh { path: PathBuf, message: String },
+    #[error("Unsupported mesh file extension: {path}")]
+    UnsupportedFormat { path: PathBuf },
+}
+
+/// Mesh statistics extracted from a single file
+struct MeshSummary {
+    vertex_count: u64,
+    triangle_count: u64,
+    min: [f32; 3],
+    max: [f32; 3],
+}
+
+/// Read one frame file and produce its index entry.
+pub fn index_frame(path: &Path) -> Result<FrameIndexEntry, IndexError> {
+    let bytes = std::fs::read(path).map_err(|e| IndexError::Io {
+        path: path.to_path_buf(),
+        source: e,
+    })?;
+
+    let ext = path
+        .extension()
+        .and_then(|e| e.to_str())
+        .map(|e| e.to_ascii_lowercase());
+    let summary = match ext.as_deref() {
+        Some("stl") => summarize_stl(&bytes),
+        Some("gltf") | Some("glb") => summarize_gltf(&bytes),
+        _ => {
+            return Err(IndexError::UnsupportedFormat {
+                path: path.to_path_buf(),
+            })
+        }
+    }
+    .map_err(|message| IndexError::Mesh {
+        path: path.to_path_buf(),
+        message,
+    })?;
+
+    Ok(FrameIndexEntry {
+        filename: path
+            .file_name()
+            .unwrap_or_default()
+            .to_string_lossy()
+            .to_string(),
+        file_size: bytes.len() as u64,
+        modified: modified_nanos(path).unwrap_or(0),
+        content_hash: format!("{:016x}", fnv1a_64(&bytes)),
+        vertex_count: summary.vertex_count,
+        triangle_count: summary.triangle_count,
+        min: summary.min,
+        max: summary.max,
+    })
+}
+
+/// STL: counts match the indexed mesh built by the STL asset loader.
+fn summarize_stl(bytes: &[u8]) -> Result<MeshSummary, String> {
+    let mesh = stl_io::read_stl(&mut Cursor::new(bytes)).map_err(|e| e.to_string())?;
+
+    let mut min = [f32::MAX; 3];
+    let mut max = [f32::MIN; 3];
+    for v in &mesh.vertices {
+        let p: [f32; 3] = (*v).into();
+        for i in 0..3 {
+            min[i] = min[i].min(p[i]);
+            max[i] = max[i].max(p[i]);
+        }
+    }
+    if mesh.vertices.is_empty() {
+        min = [0.0; 3];
+        max = [0.0; 3];
+    }
+
+    Ok(MeshSummary {
+        vertex_count: mesh.vertices.len() as u64,
+        triangle_count: mesh.faces.len() as u64,
+        min,
+        max,
+    })
+}
+
+/// glTF/GLB: reads accessor counts and min/max from the JSON document only,
+/// for the first primitive of the first mesh (the one the loader displays).
+fn summarize_gltf(bytes: &[u8]) -> Result<MeshSummary, String> {
+    let gltf = gltf::Gltf::from_slice(bytes).map_err(|e| e.to_string())?;
+    let primitive = gltf
+        .meshes()
+        .next()
+        .and_then(|m| m.primitives().next())
+        .ok_or_else(|| "file contains no mesh primitives".to_string())?;
+
+    let vertex_count = primitive
+        .get(&gltf::Semantic::Positions)
+        .map(|a| a.count() as u64)
+        .ok_or_else(|| "primitive has no POSITION attribute".to_string())?;
+    let triangle_count = match primitive.indices() {
+        Some(indices) => indices.count() as u64 / 3,
+        None => vertex_count / 3,
+    };
+    let bounds = primitive.bounding_box();
+
+    Ok(MeshSummary {
+        vertex_count,
+        triangle_count,
+        min: bounds.min,
+        max: bounds.max,
+    })
+}
+
+/// File modification time in nanoseconds since the Unix epoch.
+///
+/// Whole seconds would miss a frame rewritten with the same size within the
+/// same second.
+fn modified_nanos(path: &Path) -> Option<u64> {
+    std::fs::metadata(path)
+        .and_then(|m| m.modified())
+        .ok()
+        .and_then(|t| t.duration_since(UNIX_EPOCH).ok())
+        .and_then(|d| u64::try_from(d.as_nanos()).ok())
+}
+
+/// 64-bit FNV-1a hash; cheap, dependency-free and stable across platforms.
+fn fnv1a_64(bytes: &[u8]) -> u64 {
+    const OFFSET: u64 = 0xcbf2_9ce4_8422_2325;
+    const PRIME: u64 = 0x0000_0100_0000_01b3;
+    bytes
+        .iter()
+        .fold(OFFSET, |hash, &b| (hash ^ b as u64).wrapping_mul(PRIME))
+}
+
+// ---------------------------------------------------------------------------
+// Systems
+// ---------------------------------------------------------------------------
+
+/// Resource tracking the background index build for the current sequence
+#[derive(Resource, Default)]
+pub struct SequenceIndexTask {
+    /// Directory of the sequence the index was last requested for
+    pub directory: Option<PathBuf>,
+    /// In-flight build, if any
+    task: Option<Task<Result<SequenceIndex, IndexError>>>,
+}
+
+impl SequenceIndexTask {
+    /// Whether an index build is currently running
+    pub fn is_building(&self) -> bool {
+        self.task.is_some()
+    }
+}
+
+/// When a new sequence becomes current, load its index from disk or build
+/// one in the background.
+fn start_index_for_sequence(
+    mut sequence_manager: ResMut<SequenceManager>,
+    mut index_task: ResMut<SequenceIndexTask>,
+) {
+    if !sequence_manager.is_changed() {
+        return;
+    }
+    let Some(sequence) = sequence_manager.current_sequence.as_ref() else {
+        return;
+    };
+    if sequence.index.is_some() || sequence.frames.is_empty() {
+        return;
+    }
+    if index_task.directory.as_ref() == Some(&sequence.base_dir) {
+        return;
+    }
+
+    let dir = sequence.base_dir.clone();
+    let frames = sequence.frames.clone();
+    index_task.directory = Some(dir.clone());
+
+    index_task.task = Some(AsyncComputeTaskPool::get().spawn(async move {
+        let saved = match SequenceIndex::load_from_dir(&dir) {
+            Ok(Some(index)) if index.is_current_for(&frames) => {
+                info!(
+                    "Loaded sequence index for {} frames from {:?}",
+                    index.frames.len(),
+                    dir
+                );
+                return Ok(index);
+            }
+            Ok(saved) => saved,
+            Err(e) => {
+                warn!("Failed to read sequence index, rebuilding: {}", e);
+                None
+            }
+        };
+
+        let index = match saved {
+            Some(saved) => {
+                let (index, reindexed) = saved.refresh(&frames)?;
+                info!(
+                    "Sequence index in {:?} was stale, re-indexed {} of {} frames",
+                    dir,
+                    reindexed,
+                    frames.len()
+                );
+                index
+            }
+            None => {
+                info!("No sequence index in {:?}, building", dir);
+                SequenceIndex::build(&frames)?
+            }
+        };
+        if let Err(e) = index.save_to_dir(&dir) {
+            warn!("Failed to save sequence index: {}", e);
+        }
+        Ok(index)
+    }));
+}
+
+/// Attach a loaded or freshly built index to the current sequence.
+fn poll_index_task(
+    mut sequence_manager: ResMut<SequenceManager>,
+    mut index_task: ResMut<SequenceIndexTask>,
+) {
+    let Some(task) = index_task.task.as_mut() else {
+        return;
+    };
+    let Some(result) = block_on(future::poll_once(task)) else {
+        return;
+    };
+    index_task.task = None;
+
+    match result {
+        Ok(index) => {
+            let Some(sequence) = sequence_manager.current_sequence.as_mut() else {
+                return;
+            };
+            if index_task.directory.as_ref() != Some(&sequence.base_dir) {
+                debug!("Discarding index built for a previous sequence");
+                return;
+            }
+            info!(
+                "Sequence index ready: {} frames, {:.1}M triangles total",
+                index.frames.len(),
+                index.total_triangles() as f64 / 1_000_000.0
+            );
+            sequence.index = Some(index);
+        }
+        Err(e) => warn!("Failed to build sequence index: {}", e),
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// Minimal ASCII STL with two triangles sharing an edge (4 unique vertices).
+    const QUAD_STL: &str = "solid quad
+facet normal 0 0 1
+ outer loop
+  vertex 0 0 0
+  vertex 2 0 0
+  vertex 2 1 0
+ endloop
+endfacet
+facet normal 0 0 1
+ outer loop
+  vertex 0 0 0
+  vertex 2 1 0
+  vertex 0 1 0
+ endloop
+endfacet
+endsolid quad
+";
+
+    #[test]
+    fn test_fnv1a_known_values() {
+        assert_eq!(fnv1a_64(b""), 0xcbf2_9ce4_8422_2325);
+        assert_eq!(fnv1a_64(b"a"), 0xaf63_dc4c_8601_ec8c);
+    }
+
+    #[test]
+    fn test_index_stl_frame_and_roundtrip() {
+        let temp_dir = tempfile::tempdir().unwrap();
+        let path = temp_dir.path().join("quad_0001.stl");
+        std::fs::write(&path, QUAD_STL).unwrap();
+
+        let frames = vec![FrameInfo::new(path, 1)];
+        let index = SequenceIndex::build(&frames).unwrap();
+
+        let entry = index.frame(0).unwrap();
+        assert_eq!(entry.filename, "quad_0001.stl");
+        assert_eq!(entry.vertex_count, 4);
+        assert_eq!(entry.triangle_count, 2);
+        assert_eq!(entry.min, [0.0, 0.0, 0.0]);
+        assert_eq!(entry.max, [2.0, 1.0, 0.0]);
+        assert_eq!(entry.file_size, QUAD_STL.len() as u64);
+        assert!(index.is_current_for(&frames));
+
+        index.save_to_dir(temp_dir.path()).unwrap();
+        let loaded = SequenceIndex::load_from_dir(temp_dir.path())
+            .unwrap()
+            .unwrap();
+        assert_eq!(loaded, index);
+    }
+
+    #[test]
+    fn test_index_detects_changed_frames() {
+        let temp_dir = tempfile::tempdir().unwrap();
+        let path = temp_dir.path().join("quad_0001.stl");
+        std::fs::write(&path, QUAD_STL).unwrap();
+
+        let frames = vec![FrameInfo::new(path.clone(), 1)];
+        let index = SequenceIndex::build(&frames).unwrap();
+
+        std::fs::write(&path, format!("{QUAD_STL}\n")).unwrap();
+        let changed = vec![FrameInfo::new(path, 1)];
+        assert!(!index.is_current_for(&changed));
+        assert!(!index.is_current_for(&[]));
+    }
+
+    #[test]
+    fn test_refresh_reindexes_only_changed_frames() {
+        let temp_dir = tempfile::tempdir().unwrap();
+        let paths: Vec<_> = (1..=3)
+            .map(|n| temp_dir.path().join(format!("quad_000{n}.stl")))
+            .collect();
+        for path in &paths {
+            std::fs::write(path, QUAD_STL).unwrap();
+        }
+        let frames: Vec<_> = paths
+            .iter()
+            .enumerate()
+            .map(|(n, path)| FrameInfo::new(path.clone(), n + 1))
+            .collect();
+        let mut index = SequenceIndex::build(&frames).unwrap();
+
+        // Metadata is trusted: a stale hash on an unchanged frame is kept.
+        index.frames[0].content_hash = "stale".to_string();
+        let (refreshed, reindexed) = index.refresh(&frames).unwrap();
+        assert_eq!(reindexed, 0);
+        assert_eq!(refreshed.frames[0].content_hash, "stale");
+
+        // Only the rewritten frame is parsed again.
+        std::fs::write(&paths[1], format!("{QUAD_STL}\n")).unwrap();
+        let frames: Vec<_> = paths
+            .iter()
+            .enumerate()
+            .map(|(n, path)| FrameInfo::new(path.clone(), n + 1))
+            .collect();
+        assert!(!index.is_current_for(&frames));
+        let (refreshed, reindexed) = index.refresh(&frames).unwrap();
+        assert_eq!(reindexed, 1);
+        assert!(refreshed.is_current_for(&frames));
+        assert_eq!(refreshed.frames[0].content_hash, "stale");
+        assert_eq!(refreshed.frames[1].file_size, QUAD_STL.len() as u64 + 1);
+    }
+}
@@ -0,0 +1,536 @@
+//! In-between frame generation for smooth sequence playback
+//!
+//! Simulations typically write output every N solver steps, so playing the
+//! raw frames at display rate looks steppy. When two consecutive frames share
+//! topology (same vertex count and identical index buffer), positions and
+//! normals can be blended to synthesise the frames in between.
+//!
+//! The playback system publishes its sub-frame phase into
+//! [`FrameInterpolation::phase`]; this module quantises the phase into
+//! `substeps` and, for each new step, blends the displayed frame with the
+//! next one on the [`AsyncComputeTaskPool`]. The result is written into a
+//! dedicated mesh asset that is swapped onto the display entity. The next
+//! `FrameChanged` event restores the real frame handle as usual.
+//!
+//! Geometry is extracted once per frame asset and kept while the frame is
+//! near the playhead. The blend mesh copies indices and other attributes
+//! only when the topology changes; blended positions and normals replace its
+//! buffers in place, and the replaced buffers are reused by the next blend.
+
+use bevy::mesh::{Indices, MeshVertexAttribute, VertexAttributeValues};
+use bevy::prelude::*;
+use bevy::tasks::{block_on, futures_lite::future, AsyncComputeTaskPool, Task};
+use std::collections::HashMap;
+use std::hash::{Hash, Hasher};
+use std::sync::Arc;
+
+use super::loader::{handle_frame_changes, SequenceAssets, SequenceMeshDisplay};
+use super::SequencePlaybackSet;
+
+/// Plugin that generates interpolated frames during playback
+pub struct FrameInterpolationPlugin;
+
+impl Plugin for FrameInterpolationPlugin {
+    fn build(&self, app: &mut App) {
+        // Runs after playback has published this tick's phase and frame, so
+        // blends never target the previous tick's playhead.
+        app.init_resource::<FrameInterpolation>().add_systems(
+            Update,
+            (apply_interpolated_frame, schedule_interpolation)
+                .chain()
+                .after(SequencePlaybackSet)
+                .after(handle_frame_changes),
+        );
+    }
+}
+
+/// Blending curve used between frames
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub enum InterpolationMode {
+    /// Straight-line blend between the two neighbouring frames
+    #[default]
+    Linear,
+    /// Cubic Hermite (Catmull-Rom tangents) through the four surrounding
+    /// frames; smoother through direction changes, falls back to linear at
+    /// the ends of the sequence or across topology changes
+    Hermite,
+}
+
+/// Resource controlling frame interpolation
+#[derive(Resource)]
+pub struct FrameInterpolation {
+    /// Whether in-between frames are generated
+    pub enabled: bool,
+    /// Blending curve
+    pub mode: InterpolationMode,
+    /// Progress from the displayed frame towards the next one (0.0 to 1.0),
+    /// written by the playback system
+    pub phase: f32,
+    /// Number of steps each frame interval is divided into
+    pub substeps: u32,
+    /// In-flight blend, if any
+    task: Option<Task<BlendedFrame>>,
+    /// Extracted geometry for frame assets near the playhead
+    cache: HashMap<AssetId<Mesh>, Arc<FrameGeometry>>,
+    /// Mesh asset that receives blended frames
+    blend_handle: Option<Handle<Mesh>>,
+    /// Topology the blend mesh's index buffer and other attributes match
+    blend_topology: Option<u64>,
+    /// Buffers replaced by the last blend, reused by the next one
+    spare_positions: Vec<[f32; 3]>,
+    spare_normals: Vec<[f32; 3]>,
+    /// (base frame, step) currently shown on the display entity
+    shown: Option<(usize, u32)>,
+}
+
+impl Default for FrameInterpolation {
+    fn default() -> Self {
+        Self {
+            enabled: false,
+            mode: InterpolationMode::Linear,
+            phase: 0.0,
+            substeps: 6,
+            task: None,
+            cache: HashMap::new(),
+            blend_handle: None,
+            blend_topology: None,
+            spare_positions: Vec::new(),
+            spare_normals: Vec::new(),
+            shown: None,
+        }
+    }
+}
+
+impl FrameInterpolation {
+    /// Current phase quantised to `0..substeps`
+    pub fn step(&self) -> u32 {
+        let substeps = self.substeps.max(1);
+        ((self.phase.clamp(0.0, 1.0) * substeps as f32) as u32).min(substeps - 1)
+    }
+
+    /// Whether an interpolated frame is currently displayed
+    pub fn is_showing_blend(&self) -> bool {
+        self.shown.is_some()
+    }
+}
+
+/// Positions, normals and topology fingerprint of one frame
+#[derive(Debug)]
+pub struct FrameGeometry {
+    pub positions: Vec<[f32; 3]>,
+    pub normals: Option<Vec<[f32; 3]>>,
+    pub topology: u64,
+}
+
+impl FrameGeometry {
+    /// Extract blendable geometry from a triangle mesh.
+    pub fn from_mesh(mesh: &Mesh) -> Option<Self> {
+        let positions = match mesh.attribute(Mesh::ATTRIBUTE_POSITION)? {
+            VertexAttributeValues::Float32x3(p) => p.clone(),
+            _ => return None,
+        };
+        let normals = match mesh.attribute(Mesh::ATTRIBUTE_NORMAL) {
+            Some(VertexAttributeValues::Float32x3(n)) => Some(n.clone()),
+            _ => None,
+        };
+        let topology = topology_hash(positions.len(), mesh.indices());
+        Some(Self {
+            positions,
+            normals,
+            topology,
+        })
+    }
+
+    /// Whether `other` has the same vertex layout and connectivity.
+    pub fn same_topology(&self, other: &FrameGeometry) -> bool {
+        self.topology == other.topology
+            && self.positions.len() == other.positions.len()
+            && self.normals.is_some() == other.normals.is_some()
+    }
+}
+
+/// Fingerprint of a mesh's connectivity: vertex count plus index buffer.
+pub fn topology_hash(vertex_count: usize, indices: Option<&Indices>) -> u64 {
+    let mut hasher = std::collections::hash_map::DefaultHasher::new();
+    vertex_count.hash(&mut hasher);
+    match indices {
+        Some(Indices::U16(i)) => i.hash(&mut hasher),
+        Some(Indices::U32(i)) => i.hash(&mut hasher),
+        None => 0u8.hash(&mut hasher),
+    }
+    hasher.finish()
+}
+
+/// Linear blend `a + (b - a) * t`, written into `out`.
+///
+/// Operates on the flattened `f32` slices so the loop compiles to packed
+/// SIMD on every target.
+pub fn lerp_into(a: &[[f32; 3]], b: &[[f32; 3]], t: f32, out: &mut Vec<[f32; 3]>) {
+    out.clear();
+    out.resize(a.len(), [0.0; 3]);
+    let (a, b) = (a.as_flattened(), b.as_flattened());
+    for ((o, &a), &b) in out.as_flattened_mut().iter_mut().zip(a).zip(b) {
+        *o = a + (b - a) * t;
+    }
+}
+
+/// Cubic Hermite blend between `p1` and `p2` with Catmull-Rom tangents
+/// derived from the neighbouring frames `p0` and `p3`.
+pub fn hermite_into(
+    p0: &[[f32; 3]],
+    p1: &[[f32; 3]],
+    p2: &[[f32; 3]],
+    p3: &[[f32; 3]],
+    t: f32,
+    out: &mut Vec<[f32; 3]>,
+) {
+    let t2 = t * t;
+    let t3 = t2 * t;
+    let h00 = 2.0 * t3 - 3.0 * t2 + 1.0;
+    let h10 = t3 - 2.0 * t2 + t;
+    let h01 = -2.0 * t3 + 3.0 * t2;
+    let h11 = t3 - t2;
+
+    out.clear();
+    out.resize(p1.len(), [0.0; 3]);
+    let (p0, p1, p2, p3) = (
+        p0.as_flattened(),
+        p1.as_flattened(),
+        p2.as_flattened(),
+        p3.as_flattened(),
+    );
+    for (i, o) in out.as_flattened_mut().iter_mut().enumerate() {
+        let m1 = 0.5 * (p2[i] - p0[i]);
+        let m2 = 0.5 * (p3[i] - p1[i]);
+        *o = h00 * p1[i] + h10 * m1 + h01 * p2[i] + h11 * m2;
+    }
+}
+
+/// Renormalise blended normals in place; degenerate normals become +Y.
+pub fn renormalize(normals: &mut [[f32; 3]]) {
+    for n in normals {
+        let len = (n[0] * n[0] + n[1] * n[1] + n[2] * n[2]).sqrt();
+        if len > f32::EPSILON {
+            let inv = 1.0 / len;
+            n[0] *= inv;
+            n[1] *= inv;
+            n[2] *= inv;
+        } else {
+            *n = [0.0, 1.0, 0.0];
+        }
+    }
+}
+
+/// Result of one background blend
+struct BlendedFrame {
+    base: usize,
+    step: u32,
+    topology: u64,
+    positions: Vec<[f32; 3]>,
+    normals: Option<Vec<[f32; 3]>>,
+}
+
+/// Frames feeding one blend: (previous, current, next, next-but-one)
+struct BlendInputs {
+    p0: Arc<FrameGeometry>,
+    p1: Arc<FrameGeometry>,
+    p2: Arc<FrameGeometry>,
+    p3: Arc<FrameGeometry>,
+}
+
+impl BlendInputs {
+    /// Blend into the given buffers; returns whether normals were blended.
+    fn blend(
+        &self,
+        mode: InterpolationMode,
+        t: f32,
+        positions: &mut Vec<[f32; 3]>,
+        normals: &mut Vec<[f32; 3]>,
+    ) -> bool {
+        match mode {
+            InterpolationMode::Linear => {
+                lerp_into(&self.p1.positions, &self.p2.positions, t, positions)
+            }
+            InterpolationMode::Hermite => hermite_into(
+                &self.p0.positions,
+                &self.p1.positions,
+                &self.p2.positions,
+                &self.p3.positions,
+                t,
+                positions,
+            ),
+        }
+
+        // Normals are always blended linearly; Hermite overshoot on unit
+        // vectors buys nothing once they are renormalised.
+        match (&self.p1.normals, &self.p2.normals) {
+            (Some(n1), Some(n2)) => {
+                lerp_into(n1, n2, t, normals);
+                renormalize(normals);
+                true
+            }
+            _ => false,
+        }
+    }
+}
+
+/// Copy of a mesh without its positions and normals, which blends supply.
+fn blend_template(base: &Mesh) -> Mesh {
+    let mut template = Mesh::new(base.primitive_topology(), base.asset_usage);
+    for (attribute, values) in base.attributes() {
+        if attribute.id != Mesh::ATTRIBUTE_POSITION.id && attribute.id != Mesh::ATTRIBUTE_NORMAL.id
+        {
+            template.insert_attribute(attribute.clone(), values.clone());
+        }
+    }
+    if let Some(indices) = base.indices() {
+        template.insert_indices(indices.clone());
+    }
+    template
+}
+
+/// Replace a `Float32x3` attribute's buffer and return the old one.
+fn swap_attribute(
+    mesh: &mut Mesh,
+    attribute: MeshVertexAttribute,
+    values: Vec<[f32; 3]>,
+) -> Vec<[f32; 3]> {
+    if let Some(VertexAttributeValues::Float32x3(current)) = mesh.attribute_mut(attribute.id) {
+        return std::mem::replace(current, values);
+    }
+    mesh.insert_attribute(attribute, values);
+    Vec::new()
+}
+
+// ---------------------------------------------------------------------------
+// Systems
+// ---------------------------------------------------------------------------
+
+/// Swap a finished blend onto the display entity.
+fn apply_interpolated_frame(
+    mut interp: ResMut<FrameInterpolation>,
+    sequence_assets: Res<SequenceAssets>,
+    mut meshes: ResMut<Assets<Mesh>>,
+    mut display: Query<&mut Mesh3d, With<SequenceMeshDisplay>>,
+) {
+    let Some(task) = interp.task.as_mut() else {
+        return;
+    };
+    let Some(blended) = block_on(future::poll_once(task)) else {
+        return;
+    };
+    interp.task = None;
+
+    // The playhead moved on while we were blending.
+    let base_handle = sequence_assets
+        .get_frame(blended.base)
+        .filter(|_| interp.enabled && sequence_assets.displayed_frame == Some(blended.base));
+    let Some(base_handle) = base_handle else {
+        interp.spare_positions = blended.positions;
+        return;
+    };
+
+    // Refresh the blend mesh's indices and other attributes only when the
+    // topology changes; per step only positions/normals move.
+    if interp.blend_topology != Some(blended.topology) || interp.blend_handle.is_none() {
+        let Some(template) = meshes.get(base_handle).map(blend_template) else {
+            return;
+        };
+        match interp.blend_handle.clone() {
+            Some(handle) => {
+                if let Some(mesh) = meshes.get_mut(&handle) {
+                    *mesh = template;
+                }
+            }
+            None => interp.blend_handle = Some(meshes.add(template)),
+        }
+        interp.blend_topology = Some(blended.topology);
+    }
+
+    let Some(handle) = interp.blend_handle.clone() else {
+        return;
+    };
+    if let Some(mesh) = meshes.get_mut(&handle) {
+        interp.spare_positions = swap_attribute(mesh, Mesh::ATTRIBUTE_POSITION, blended.positions);
+        if let Some(normals) = blended.normals {
+            interp.spare_normals = swap_attribute(mesh, Mesh::ATTRIBUTE_NORMAL, normals);
+        }
+    }
+
+    if let Ok(mut mesh3d) = display.single_mut() {
+        if mesh3d.0 != handle {
+            mesh3d.0 = handle;
+        }
+    }
+    interp.shown = Some((blended.base, blended.step));
+}
+
+/// Start a blend for the current sub-frame step if one is needed.
+fn schedule_interpolation(
+    mut interp: ResMut<FrameInterpolation>,
+    sequence_assets: Res<SequenceAssets>,
+    meshes: Res<Assets<Mesh>>,
+    mut display: Query<&mut Mesh3d, With<SequenceMeshDisplay>>,
+) {
+    let Some(base) = sequence_assets.displayed_frame else {
+        return;
+    };
+    let step = interp.step();
+    let next = base + 1;
+
+    if !interp.enabled || step == 0 || next >= sequence_assets.frame_handles.len() {
+        restore_base_frame(&mut interp, &sequence_assets, &mut display);
+        return;
+    }
+    if interp.task.is_some() || interp.shown == Some((base, step)) {
+        return;
+    }
+
+    // Gather geometry for the frames around the playhead, extracting each
+    // frame asset once while it stays in the window.
+    let last = sequence_assets.frame_handles.len() - 1;
+    let wanted = [base.saturating_sub(1), base, next, (next + 1).min(last)];
+    let Some(ids) = wanted
+        .iter()
+        .map(|&frame| sequence_assets.get_frame(frame).map(Handle::id))
+        .collect::<Option<Vec<_>>>()
+    else {
+        return;
+    };
+    interp.cache.retain(|id, _| ids.contains(id));
+    let mut geometry = Vec::with_capacity(ids.len());
+    for &id in &ids {
+        if !interp.cache.contains_key(&id) {
+            let Some(extracted) = meshes.get(id).and_then(FrameGeometry::from_mesh) else {
+                // Not loaded yet; try again next frame.
+                return;
+            };
+            interp.cache.insert(id, Arc::new(extracted));
+        }
+        geometry.push(interp.cache[&id].clone());
+    }
+
+    let [p0, p1, p2, p3] = <[_; 4]>::try_from(geometry).unwrap();
+    if !p1.same_topology(&p2) {
+        restore_base_frame(&mut interp, &sequence_assets, &mut display);
+        return;
+    }
+    // Hermite needs matching neighbours; fall back to the interval's own
+    // endpoints (which reduces the tangent at that end) when they differ.
+    let p0 = Some(p0)
+        .filter(|p| p.same_topology(&p1))
+        .unwrap_or_else(|| p1.clone());
+    let p3 = Some(p3)
+        .filter(|p| p.same_topology(&p2))
+        .unwrap_or_else(|| p2.clone());
+
+    let topology = p1.topology;
+    let inputs = BlendInputs { p0, p1, p2, p3 };
+    let mode = interp.mode;
+    let t = step as f32 / interp.substeps.max(1) as f32;
+    let mut positions = std::mem::take(&mut interp.spare_positions);
+    let mut normals = std::mem::take(&mut interp.spare_normals);
+
+    interp.task = Some(AsyncComputeTaskPool::get().spawn(async move {
+        let has_normals = inputs.blend(mode, t, &mut positions, &mut normals);
+        BlendedFrame {
+            base,
+            step,
+            topology,
+            positions,
+            normals: has_normals.then_some(normals),
+        }
+    }));
+}
+
+/// Put the real frame back on the display entity if a blend is showing.
+fn restore_base_frame(
+    interp: &mut FrameInterpolation,
+    sequence_assets: &SequenceAssets,
+    display: &mut Query<&mut Mesh3d, With<SequenceMeshDisplay>>,
+) {
+    if interp.shown.take().is_none() {
+        return;
+    }
+    let (Some(handle), Ok(mut mesh3d)) = (
+        sequence_assets
+            .displayed_frame
+            .and_then(|f| sequence_assets.get_frame(f)),
+        display.single_mut(),
+    ) else {
+        return;
+    };
+    mesh3d.0 = handle.clone();
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_lerp_endpoints_and_midpoint() {
+        let a = vec![[0.0, 0.0, 0.0], [1.0, 2.0, 3.0]];
+        let b = vec![[2.0, 4.0, 6.0], [1.0, 0.0, -3.0]];
+        let mut out = Vec::new();
+
+        lerp_into(&a, &b, 0.0, &mut out);
+        assert_eq!(out, a);
+        lerp_into(&a, &b, 1.0, &mut out);
+        assert_eq!(out, b);
+        lerp_into(&a, &b, 0.5, &mut out);
+        assert_eq!(out, vec![[1.0, 2.0, 3.0], [1.0, 1.0, 0.0]]);
+    }
+
+    #[test]
+    fn test_hermite_matches_linear_for_uniform_motion() {
+        // Constant velocity: Catmull-Rom reproduces the straight line.
+        let p: Vec<Vec<[f32; 3]>> = (0..4)
+            .map(|i| vec![[i as f32, 0.0, 2.0 * i as f32]])
+            .collect();
+        let mut hermite = Vec::new();
+        let mut linear = Vec::new();
+        for t in [0.0, 0.25, 0.5, 0.75, 1.0] {
+            hermite_into(&p[0], &p[1], &p[2], &p[3], t, &mut hermite);
+            lerp_into(&p[1], &p[2], t, &mut linear);
+            for (h, l) in hermite[0].iter().zip(&linear[0]) {
+                assert!((h - l).abs() < 1e-5, "t={t}: {h} vs {l}");
+            }
+        }
+    }
+
+    #[test]
+    fn test_renormalize() {
+        let mut n = vec![[0.0, 3.0, 4.0], [0.0, 0.0, 0.0]];
+        renormalize(&mut n);
+        assert!((n[0][1] - 0.6).abs() < 1e-6 && (n[0][2] - 0.8).abs() < 1e-6);
+        assert_eq!(n[1], [0.0, 1.0, 0.0]);
+    }
+
+    #[test]
+    fn test_topology_hash() {
+        let a = Indices::U32(vec![0, 1, 2, 2, 1, 3]);
+        let b = Indices::U32(vec![0, 1, 2, 1, 2, 3]);
+        assert_eq!(topology_hash(4, Some(&a)), topology_hash(4, Some(&a)));
+        assert_ne!(topology_hash(4, Some(&a)), topology_hash(4, Some(&b)));
+        assert_ne!(topology_hash(4, Some(&a)), topology_hash(5, Some(&a)));
+    }
+
+    #[test]
+    fn test_step_quantisation() {
+        let mut interp = FrameInterpolation {
+            substeps: 4,
+            ..Default::default()
+        };
+        for (phase, step) in [
+            (0.0, 0),
+            (0.24, 0),
+            (0.25, 1),
+            (0.6, 2),
+            (0.99, 3),
+            (1.0, 3),
+        ] {
+            interp.phase = phase;
+            assert_eq!(interp.step(), step, "phase {phase}");
+        }
+    }
+}
@@ -18,6 +18,8 @@ use bevy::prelude::*;
 use std::path::PathBuf;
 
 use super::{SequenceEvent, SequenceManager};
+use crate::lib::asset_loaders::stl_loader::StlLoaderSettings;
+use crate::lib::settings::SettingsResource;
 
 /// Recognised mesh file formats for sequence loading.
 #[derive(Debug, Clone, Copy, PartialEq, Eq)]
@@ -154,17 +156,23 @@ pub struct SequenceMeshDisplay;
 /// For **glTF / GLB** files we use [`GltfAssetLabel::Primitive`] to request
 /// the first mesh primitive (`mesh 0, primitive 0`), which gives back a
 /// `Handle<Mesh>`.
+///
+/// With `optimize` set, STL frames are reordered for the vertex cache while
+/// they load; glTF frames are left as exported.
 fn load_mesh_handle(
     asset_server: &AssetServer,
     filename: &str,
     format: MeshFileFormat,
+    optimize: bool,
 ) -> Handle<Mesh> {
     let asset_path = format!("seq://{}", filename);
 
     match format {
         MeshFileFormat::Stl => {
             // The StlLoader registered for ".stl" will produce a Mesh directly.
-            asset_server.load(asset_path)
+            asset_server.load_with_settings(asset_path, move |s: &mut StlLoaderSettings| {
+                s.optimize = optimize
+            })
         }
         MeshFileFormat::Gltf | MeshFileFormat::Glb => {
             // Use GltfAssetLabel to extract Mesh 0 / Primitive 0.
@@ -210,7 +218,14 @@ fn handle_load_requests(
     mut load_requests: MessageReader<LoadSequenceRequest>,
     mut sequence_assets: ResMut<SequenceAssets>,
     asset_server: Res<AssetServer>,
+    settings: Option<Res<SettingsResource>>,
 ) {
+    let optimize = settings
+        .as_ref()
+        .and_then(|s| s.settings.sequence.as_ref())
+        .and_then(|seq| seq.optimize_meshes)
+        .unwrap_or(false);
+
     for request in load_requests.read() {
         info!("Loading sequence with {} frames", request.frame_paths.len());
 
@@ -258,7 +273,7 @@ fn handle_load_requests(
                 idx, filename, format, path
             );
 
-            let handle = load_mesh_handle(&asset_server, filename, format);
+            let handle = load_mesh_handle(&asset_server, filename, format, optimize);
             sequence_assets.frame_handles.push(handle);
         }
 
@@ -438,7 +453,7 @@ fn update_mesh_display(
 }
 
 /// System that responds to frame change events and updates the mesh
-fn handle_frame_changes(
+pub(crate) fn handle_frame_changes(
     mut sequence_events: MessageReader<SequenceEvent>,
     mut sequence_assets: ResMut<SequenceAssets>,
     mut mesh_query: Query<&mut Mesh3d, With<SequenceMeshDisplay>>,
@@ -478,6 +493,14 @@ pub fn load_discovered_sequence(
         sequence.name,
         frame_paths.len()
     );
+    if let Some(index) = &sequence.index {
+        info!(
+            "Sequence '{}' holds {:.1}M vertices ({:.1} MB of mesh files) across all frames",
+            sequence.name,
+            index.total_vertices() as f64 / 1_000_000.0,
+            index.total_bytes() as f64 / 1_048_576.0
+        );
+    }
 
     load_events.write(LoadSequenceRequest { frame_paths });
 }
@@ -0,0 +1,523 @@
+//! Simplified levels of detail for sequence frames
+//!
+//! Zoomed out, a multi-million-triangle frame covers a few hundred pixels and
+//! most of its triangles are smaller than a pixel. As each frame finishes
+//! loading, a background task on the [`AsyncComputeTaskPool`] builds a chain
+//! of simplified index buffers from a copy of its positions and indices with
+//! meshoptimizer's `simplify`, each keeping about a quarter of the triangles
+//! of the one before. The finished levels pick their other attributes from
+//! the frame's mesh and are kept next to it for as long as the sequence is
+//! loaded.
+//!
+//! Every level records its geometric error relative to the mesh extent. Each
+//! update, the frame bounds are projected onto the screen and the coarsest
+//! level whose error stays below [`FrameLods::pixel_error`] pixels is swapped
+//! onto the display entity; zooming in brings back full detail.
+
+use bevy::mesh::{Indices, PrimitiveTopology, VertexAttributeValues};
+use bevy::prelude::*;
+use bevy::tasks::{block_on, futures_lite::future, AsyncComputeTaskPool, Task};
+use std::collections::VecDeque;
+
+use super::loader::{FrameLoadedEvent, LoadSequenceRequest, SequenceAssets, SequenceMeshDisplay};
+use crate::lib::asset_loaders::compact_indices;
+use crate::lib::mesh_info::compute_aabb_positions;
+use crate::lib::mesh_optimize::{can_permute, gather_attribute, optimize_vertex_fetch};
+use crate::lib::settings::SettingsResource;
+
+/// Fraction of the previous level's triangles each level aims for.
+const LOD_RATIO: f32 = 0.25;
+
+/// Most simplified levels built per frame.
+pub const MAX_LOD_LEVELS: usize = 4;
+
+/// Levels smaller than this are not worth building.
+const MIN_LOD_TRIANGLES: usize = 256;
+
+/// Stop the chain once simplification keeps more than this fraction of the
+/// previous level's triangles (e.g. when mesh borders block collapses).
+const MIN_REDUCTION: f32 = 0.9;
+
+/// Plugin that builds and selects per-frame levels of detail
+pub struct FrameLodPlugin;
+
+impl Plugin for FrameLodPlugin {
+    fn build(&self, app: &mut App) {
+        app.init_resource::<FrameLods>()
+            .add_systems(
+                Update,
+                (
+                    reset_lods_on_load_request,
+                    collect_lod_chains,
+                    queue_lod_builds,
+                )
+                    .chain(),
+            )
+            // After the loader and interpolation have picked this update's
+            // frame handle
+            .add_systems(PostUpdate, select_frame_lod);
+    }
+}
+
+/// One simplified level of a frame
+pub struct LodLevel {
+    /// Simplified mesh asset
+    pub handle: Handle<Mesh>,
+    /// Triangles in the level
+    pub triangles: usize,
+    /// Deviation from the full mesh, relative to the mesh extent
+    pub error: f32,
+}
+
+/// Simplified levels of one frame, finest first
+pub struct LodChain {
+    /// Centre of the frame's bounding box (mesh space)
+    pub center: Vec3,
+    /// Radius of the frame's bounding sphere (mesh space)
+    pub radius: f32,
+    /// Levels 1.. in order of increasing error
+    pub levels: Vec<LodLevel>,
+}
+
+/// One level as simplified in the background, before it becomes a mesh
+struct SimplifiedLevel {
+    /// Triangles, indexing `vertices`
+    indices: Vec<u32>,
+    /// Vertex of the full mesh for each vertex of the level
+    vertices: Vec<u32>,
+    triangles: usize,
+    error: f32,
+}
+
+/// Output of one background build
+struct BuiltChain {
+    frame: usize,
+    /// Vertices of the full mesh the levels were built from
+    vertex_count: usize,
+    center: Vec3,
+    radius: f32,
+    levels: Vec<SimplifiedLevel>,
+}
+
+/// Resource holding the level-of-detail chains of the current sequence
+#[derive(Resource)]
+pub struct FrameLods {
+    /// Simplified levels built per frame (0 disables)
+    pub levels: usize,
+    /// Frames with fewer triangles are always drawn at full detail
+    pub min_triangles: usize,
+    /// Largest projected error, in pixels, a displayed level may have
+    pub pixel_error: f32,
+    /// Chains built in parallel at most (each holds a copy of its frame's
+    /// positions and indices)
+    pub max_concurrent_builds: usize,
+    /// Chain per frame, once built
+    chains: Vec<Option<LodChain>>,
+    /// Loaded frames waiting for a build slot
+    pending: VecDeque<usize>,
+    /// In-flight builds
+    tasks: Vec<Task<BuiltChain>>,
+    /// (frame, level) currently on the display entity
+    shown: Option<(usize, usize)>,
+}
+
+impl Default for FrameLods {
+    fn default() -> Self {
+        Self {
+            levels: 3,
+            min_triangles: 100_000,
+            pixel_error: 1.0,
+            max_concurrent_builds: 2,
+            chains: Vec::new(),
+            pending: VecDeque::new(),
+            tasks: Vec::new(),
+            shown: None,
+        }
+    }
+}
+
+impl FrameLods {
+    /// Level-of-detail chain of `frame`, if built
+    pub fn chain(&self, frame: usize) -> Option<&LodChain> {
+        self.chains.get(frame).and_then(Option::as_ref)
+    }
+
+    /// Frames whose chains are built
+    pub fn built_count(&self) -> usize {
+        self.chains.iter().filter(|chain| chain.is_some()).count()
+    }
+
+    /// Level currently displayed (0 = full detail), if known
+    pub fn shown_level(&self) -> Option<usize> {
+        self.shown.map(|(_, level)| level)
+    }
+}
+
+/// Build up to `levels` simplified versions of a triangle mesh.
+///
+/// Each level is simplified from the previous one and returned as a compact
+/// mesh with only the vertices it uses, together with its triangle count and
+/// accumulated error relative to the mesh extent. Returns fewer levels once
+/// a level gets too small or stops shrinking, and none for meshes that are
+/// not indexed triangle lists with `Float32x3` positions.
+pub fn build_lod_chain(mesh: &Mesh, levels: usize) -> Vec<(Mesh, usize, f32)> {
+    let Some((positions, indices)) = lod_source(mesh) else {
+        return Vec::new();
+    };
+    let indices = indices.iter().map(|index| index as u32).collect();
+    simplify_chain(positions, indices, levels)
+        .into_iter()
+        .map(|level| {
+            let (triangles, error) = (level.triangles, level.error);
+            (compact_mesh(mesh, level), triangles, error)
+        })
+        .collect()
+}
+
+/// Simplified index buffers of a triangle mesh, finest first.
+///
+/// Only needs the positions, so background builds can leave the rest of the
+/// mesh behind; [`compact_mesh`] attaches the other attributes afterwards.
+fn simplify_chain(
+    positions: &[[f32; 3]],
+    mut source: Vec<u32>,
+    levels: usize,
+) -> Vec<SimplifiedLevel> {
+    let mut chain = Vec::new();
+    let Ok(vertices) = meshopt::VertexDataAdapter::new(meshopt::typed_to_bytes(positions), 12, 0)
+    else {
+        return chain;
+    };
+
+    let vertex_count = positions.len();
+    let mut error = 0.0;
+    for _ in 0..levels.min(MAX_LOD_LEVELS) {
+        let triangles = source.len() / 3;
+        let target = (triangles as f32 * LOD_RATIO) as usize;
+        if target < MIN_LOD_TRIANGLES {
+            break;
+        }
+
+        let mut level_error = 0.0;
+        let simplified = meshopt::simplify(
+            &source,
+            &vertices,
+            target * 3,
+            1.0,
+            meshopt::SimplifyOptions::empty(),
+            Some(&mut level_error),
+        );
+        if simplified.len() as f32 > source.len() as f32 * MIN_REDUCTION {
+            break;
+        }
+        // Errors of successive simplifications add up at worst
+        error += level_error;
+
+        let mut indices = meshopt::optimize_vertex_cache(&simplified, vertex_count);
+        let mut order = optimize_vertex_fetch(&mut indices, vertex_count);
+        // Renumbered in order of first use, so the used vertices come first
+        let used = indices.iter().max().map_or(0, |&max| max as usize + 1);
+        order.truncate(used);
+        chain.push(SimplifiedLevel {
+            indices,
+            vertices: order,
+            triangles: simplified.len() / 3,
+            error,
+        });
+        source = simplified;
+    }
+    chain
+}
+
+/// Index of the level to draw: the coarsest whose error, scaled to a mesh
+/// covering `screen_pixels`, is at most `pixel_error` (0 = full detail).
+///
+/// `errors` are the relative errors of levels 1.., in increasing order.
+pub fn select_level(errors: &[f32], screen_pixels: f32, pixel_error: f32) -> usize {
+    errors
+        .iter()
+        .rposition(|&error| error * screen_pixels <= pixel_error)
+        .map_or(0, |level| level + 1)
+}
+
+// ---------------------------------------------------------------------------
+// Systems
+// ---------------------------------------------------------------------------
+
+/// Drop the chains of the previous sequence and pick up settings.
+fn reset_lods_on_load_request(
+    mut requests: MessageReader<LoadSequenceRequest>,
+    mut lods: ResMut<FrameLods>,
+    settings: Option<Res<SettingsResource>>,
+) {
+    for request in requests.read() {
+        if let Some(levels) = settings
+            .as_ref()
+            .and_then(|s| s.settings.sequence.as_ref())
+            .and_then(|seq| seq.lod_levels)
+        {
+            lods.levels = levels.min(MAX_LOD_LEVELS);
+        }
+        lods.chains.clear();
+        lods.chains.resize_with(request.frame_paths.len(), || None);
+        lods.pending.clear();
+        // Dropping a task cancels it
+        lods.tasks.clear();
+        lods.shown = None;
+    }
+}
+
+/// Store finished chains as mesh assets.
+fn collect_lod_chains(
+    mut lods: ResMut<FrameLods>,
+    sequence_assets: Res<SequenceAssets>,
+    mut meshes: ResMut<Assets<Mesh>>,
+) {
+    let mut finished = Vec::new();
+    lods.tasks
+        .retain_mut(|task| match block_on(future::poll_once(task)) {
+            Some(built) => {
+                finished.push(built);
+                false
+            }
+            None => true,
+        });
+
+    for built in finished {
+        if built.levels.is_empty() || built.frame >= lods.chains.len() {
+            continue;
+        }
+        // The other attributes come from the frame's mesh, if it is unchanged
+        let Some(full) = sequence_assets
+            .get_frame(built.frame)
+            .and_then(|handle| meshes.get(handle))
+            .filter(|full| full.count_vertices() == built.vertex_count)
+        else {
+            continue;
+        };
+        debug!(
+            "Built {} LOD levels for frame {} (down to {} triangles)",
+            built.levels.len(),
+            built.frame,
+            built.levels.last().map_or(0, |level| level.triangles)
+        );
+        let compact: Vec<_> = built
+            .levels
+            .into_iter()
+            .map(|level| {
+                let (triangles, error) = (level.triangles, level.error);
+                (compact_mesh(full, level), triangles, error)
+            })
+            .collect();
+        let levels = compact
+            .into_iter()
+            .map(|(mesh, triangles, error)| LodLevel {
+                handle: meshes.add(mesh),
+                triangles,
+                error,
+            })
+            .collect();
+        lods.chains[built.frame] = Some(LodChain {
+            center: built.center,
+            radius: built.radius,
+            levels,
+        });
+    }
+}
+
+/// Start background builds for newly loaded frames.
+fn queue_lod_builds(
+    mut loaded: MessageReader<FrameLoadedEvent>,
+    mut lods: ResMut<FrameLods>,
+    sequence_assets: Res<SequenceAssets>,
+    meshes: Res<Assets<Mesh>>,
+) {
+    for event in loaded.read() {
+        if event.success && lods.levels > 0 {
+            lods.pending.push_back(event.frame_index);
+        }
+    }
+
+    let task_pool = AsyncComputeTaskPool::get();
+    while lods.tasks.len() < lods.max_concurrent_builds.max(1) {
+        let Some(frame) = lods.pending.pop_front() else {
+            break;
+        };
+        let Some(mesh) = sequence_assets.get_frame(frame).and_then(|h| meshes.get(h)) else {
+            continue;
+        };
+        let Some((positions, indices)) = lod_source(mesh) else {
+            continue;
+        };
+        if indices.len() / 3 < lods.min_triangles {
+            continue;
+        }
+        let Some(bounds) = compute_aabb_positions(positions) else {
+            continue;
+        };
+
+        // Only what simplification reads goes to the task
+        let positions = positions.clone();
+        let indices: Vec<u32> = indices.iter().map(|index| index as u32).collect();
+        let levels = lods.levels;
+        lods.tasks.push(task_pool.spawn(async move {
+            BuiltChain {
+                frame,
+                vertex_count: positions.len(),
+                center: bounds.center(),
+                radius: bounds.dimensions().length() * 0.5,
+                levels: simplify_chain(&positions, indices, levels),
+            }
+        }));
+    }
+}
+
+/// Show the level of the displayed frame that suits its size on screen.
+fn select_frame_lod(
+    mut lods: ResMut<FrameLods>,
+    sequence_assets: Res<SequenceAssets>,
+    cameras: Query<(&Camera, &GlobalTransform, &Projection), With<Camera3d>>,
+    mut display: Query<(&mut Mesh3d, &GlobalTransform), With<SequenceMeshDisplay>>,
+) {
+    let Some(frame) = sequence_assets.displayed_frame else {
+        return;
+    };
+    let (Some(full), Some(chain)) = (sequence_assets.get_frame(frame), lods.chain(frame)) else {
+        lods.shown = None;
+        return;
+    };
+    let Ok((mut mesh3d, transform)) = display.single_mut() else {
+        return;
+    };
+    // Leave interpolated frames and other replacements alone
+    let current = std::iter::once(full)
+        .chain(chain.levels.iter().map(|level| &level.handle))
+        .position(|handle| *handle == mesh3d.0);
+    if current.is_none() {
+        return;
+    }
+    let Some((camera, camera_transform, projection)) =
+        cameras.iter().find(|(camera, ..)| camera.is_active)
+    else {
+        return;
+    };
+    let Some(viewport) = camera.logical_viewport_size() else {
+        return;
+    };
+
+    let center = transform.transform_point(chain.center);
+    let radius = chain.radius * transform.compute_transform().scale.max_element();
+    let distance = camera_transform.translation().distance(center);
+    let screen_pixels = match projection {
+        Projection::Perspective(perspective) if distance > radius => {
+            radius * viewport.y / (distance * (perspective.fov * 0.5).tan())
+        }
+        Projection::Orthographic(orthographic) => {
+            2.0 * radius * viewport.y / orthographic.area.height().max(f32::EPSILON)
+        }
+        // Inside the bounds or an unknown projection: full detail
+        _ => f32::INFINITY,
+    };
+
+    let errors: Vec<f32> = chain.levels.iter().map(|level| level.error).collect();
+    let level = select_level(&errors, screen_pixels, lods.pixel_error);
+    if current != Some(level) {
+        mesh3d.0 = match level {
+            0 => full.clone(),
+            level => chain.levels[level - 1].handle.clone(),
+        };
+        debug!(
+            "Frame {} at {:.0} px: showing LOD {} of {}",
+            frame,
+            screen_pixels,
+            level,
+            chain.levels.len()
+        );
+    }
+    lods.shown = Some((frame, level));
+}
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+/// Positions and indices of a mesh levels can be built for: an indexed
+/// triangle list with `Float32x3` positions and attributes
+/// [`gather_attribute`] can reorder.
+fn lod_source(mesh: &Mesh) -> Option<(&Vec<[f32; 3]>, &Indices)> {
+    if mesh.primitive_topology() != PrimitiveTopology::TriangleList
+        || !mesh.attributes().all(|(_, values)| can_permute(values))
+    {
+        return None;
+    }
+    let Some(VertexAttributeValues::Float32x3(positions)) =
+        mesh.attribute(Mesh::ATTRIBUTE_POSITION)
+    else {
+        return None;
+    };
+    Some((positions, mesh.indices()?))
+}
+
+/// Mesh with `mesh`'s attributes, reduced to the vertices `level` uses.
+fn compact_mesh(mesh: &Mesh, level: SimplifiedLevel) -> Mesh {
+    let mut compact = Mesh::new(PrimitiveTopology::TriangleList, mesh.asset_usage);
+    for (attribute, values) in mesh.attributes() {
+        if let Some(gathered) = gather_attribute(values, &level.vertices) {
+            compact.insert_attribute(attribute.clone(), gathered);
+        }
+    }
+    compact.insert_indices(compact_indices(level.indices));
+    compact
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use bevy::asset::RenderAssetUsages;
+
+    /// A wavy `n` × `n` grid surface.
+    fn grid(n: u32) -> Mesh {
+        let positions: Vec<[f32; 3]> = (0..(n + 1) * (n + 1))
+            .map(|v| {
+                let (x, y) = ((v % (n + 1)) as f32, (v / (n + 1)) as f32);
+                [x, y, (x * 0.2).sin() + (y * 0.3).cos()]
+            })
+            .collect();
+        let indices: Vec<u32> = (0..n * n)
+            .map(|q| (q / n) * (n + 1) + q % n)
+            .flat_map(|c| [c, c + 1, c + n + 1, c + 1, c + n + 2, c + n + 1])
+            .collect();
+        Mesh::new(
+            PrimitiveTopology::TriangleList,
+            RenderAssetUsages::default(),
+        )
+        .with_inserted_attribute(Mesh::ATTRIBUTE_POSITION, positions)
+        .with_inserted_indices(compact_indices(indices))
+    }
+
+    #[test]
+    fn test_chain_shrinks_and_selection_follows_screen_size() {
+        let mesh = grid(200);
+        let chain = build_lod_chain(&mesh, 3);
+        assert_eq!(chain.len(), 3);
+
+        let mut previous = mesh.indices().unwrap().len() / 3;
+        let mut previous_error = 0.0;
+        for (level, triangles, error) in &chain {
+            assert!(*triangles <= previous / 2, "{triangles} of {previous}");
+            assert!(*error >= previous_error);
+            // Only the vertices the level uses are kept
+            let used: std::collections::HashSet<usize> = level.indices().unwrap().iter().collect();
+            assert_eq!(used.len(), level.count_vertices());
+            previous = *triangles;
+            previous_error = *error;
+        }
+
+        let errors = [0.001, 0.004, 0.02];
+        assert_eq!(select_level(&errors, f32::INFINITY, 1.0), 0);
+        assert_eq!(select_level(&errors, 2000.0, 1.0), 0);
+        assert_eq!(select_level(&errors, 500.0, 1.0), 1);
+        assert_eq!(select_level(&errors, 200.0, 1.0), 2);
+        assert_eq!(select_level(&errors, 20.0, 1.0), 3);
+    }
+}
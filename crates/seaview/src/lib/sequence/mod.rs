@@ -4,7 +4,10 @@
 //! sequences of mesh files (e.g., simulation timesteps).
 
 pub mod discovery;
+pub mod index;
+pub mod interpolation;
 pub mod loader;
+pub mod lod;
 pub mod playback;
 
 use bevy::prelude::*;
@@ -13,6 +16,12 @@ use std::path::PathBuf;
 // Re-export commonly used types from loader
 pub use loader::{FrameLoadedEvent, LoadSequenceRequest, LoadingStats, SequenceAssets};
 
+/// Systems that advance the playhead, publishing the current frame and the
+/// sub-frame phase for this tick. Whoever drives playback adds its system to
+/// this set; per-tick consumers such as frame interpolation run after it.
+#[derive(SystemSet, Debug, Clone, PartialEq, Eq, Hash)]
+pub struct SequencePlaybackSet;
+
 /// Plugin for mesh sequence management
 pub struct SequencePlugin;
 
@@ -22,6 +31,9 @@ impl Plugin for SequencePlugin {
             discovery::SequenceDiscoveryPlugin,
             playback::SequencePlaybackPlugin,
             loader::SequenceLoaderPlugin,
+            index::SequenceIndexPlugin,
+            interpolation::FrameInterpolationPlugin,
+            lod::FrameLodPlugin,
         ))
         .init_resource::<SequenceManager>()
         .add_message::<SequenceEvent>()
@@ -170,6 +182,8 @@ pub struct Sequence {
     pub source_orientation: crate::lib::coordinates::SourceOrientation,
     /// Pattern that matches the sequence files
     pub pattern: String,
+    /// Precomputed per-frame metadata, once loaded or built
+    pub index: Option<index::SequenceIndex>,
 }
 
 impl Sequence {
@@ -185,6 +199,7 @@ impl Sequence {
             frames: Vec::new(),
             source_orientation,
             pattern,
+            index: None,
         }
     }
 
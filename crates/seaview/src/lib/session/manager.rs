@@ -8,6 +8,7 @@ use std::collections::HashMap;
 use std::path::PathBuf;
 use uuid::Uuid;
 
+use super::storage::FrameStorageConfig;
 use super::types::*;
 
 /// Resource that manages all active sessions
@@ -21,6 +22,9 @@ pub struct SessionManager {
 
     /// Currently active network receivers
     active_receivers: HashMap<u16, bool>,
+
+    /// Memory budget and spill location for the frames of new sessions
+    storage: FrameStorageConfig,
 }
 
 impl SessionManager {
@@ -29,6 +33,14 @@ impl SessionManager {
         Self::default()
     }
 
+    /// Create a session manager whose sessions spill frames as `storage` says
+    pub fn with_storage_config(storage: FrameStorageConfig) -> Self {
+        Self {
+            storage,
+            ..Self::default()
+        }
+    }
+
     /// Create a new network session
     pub fn create_network_session(&mut self, name: &str, port: u16) -> Result<Uuid, SessionError> {
         // Check if port is already in use
@@ -36,12 +48,13 @@ impl SessionManager {
             return Err(SessionError::PortInUse(port));
         }
 
-        let session = Session::new(
+        let session = Session::with_storage(
             name.to_string(),
             SessionSource::Network {
                 port,
                 source_address: None,
             },
+            &self.storage,
         );
 
         let id = session.id;
@@ -57,7 +70,11 @@ impl SessionManager {
 
     /// Create a new file session
     pub fn create_file_session(&mut self, name: &str, path: PathBuf) -> Result<Uuid, SessionError> {
-        let session = Session::new(name.to_string(), SessionSource::File { path: path.clone() });
+        let session = Session::with_storage(
+            name.to_string(),
+            SessionSource::File { path: path.clone() },
+            &self.storage,
+        );
 
         let id = session.id;
         self.sessions.insert(id, session);
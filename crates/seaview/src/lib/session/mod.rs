@@ -9,9 +9,11 @@ use bevy::prelude::*;
 use uuid::Uuid;
 
 pub mod manager;
+pub mod storage;
 pub mod types;
 
 pub use manager::SessionManager;
+pub use storage::{FrameStorage, FrameStorageConfig};
 pub use types::*;
 
 /// Plugin that adds session management functionality
@@ -0,0 +1,538 @@
+//! Frame storage for sessions
+//!
+//! Live sessions receive frames for as long as the simulation runs, so
+//! keeping every frame in memory ends with the process being killed.
+//! [`FrameStorage`] holds frames as `Arc`-shared, immutable meshes and keeps
+//! at most [`FrameStorageConfig::ram_budget`] bytes of them resident. Older
+//! frames are appended to a spill file under `{sessions_dir}/{id}/meshes/`,
+//! in the system temp directory by default, and read back through a memory
+//! map when asked for, so callers never see where a frame lives.
+//!
+//! Cloning a storage shares its frames and spill files; the frame table is
+//! copied only when one of the clones changes it. A spill file is deleted
+//! once no storage refers to it, and the session's directory with the last
+//! one.
+
+use bevy::asset::RenderAssetUsages;
+use bevy::mesh::{Indices, MeshVertexAttribute, PrimitiveTopology, VertexAttributeValues};
+use bevy::prelude::*;
+use memmap2::Mmap;
+use std::fs::{self, File, OpenOptions};
+use std::io::{self, Write};
+use std::path::{Path, PathBuf};
+use std::sync::{Arc, Mutex};
+use uuid::Uuid;
+
+use crate::lib::mesh_optimize::can_permute;
+
+/// Resident frame data kept by default before frames spill to disk.
+pub const DEFAULT_RAM_BUDGET: usize = 2 << 30;
+
+/// Topologies in the order of their tag in a spill record.
+const TOPOLOGIES: [PrimitiveTopology; 5] = [
+    PrimitiveTopology::PointList,
+    PrimitiveTopology::LineList,
+    PrimitiveTopology::LineStrip,
+    PrimitiveTopology::TriangleList,
+    PrimitiveTopology::TriangleStrip,
+];
+
+/// Where and when session frames spill to disk.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct FrameStorageConfig {
+    /// Bytes of frame data kept in memory before the oldest frames spill
+    pub ram_budget: usize,
+    /// Directory holding one `{id}/` directory per session
+    pub sessions_dir: PathBuf,
+}
+
+impl Default for FrameStorageConfig {
+    fn default() -> Self {
+        Self {
+            ram_budget: DEFAULT_RAM_BUDGET,
+            sessions_dir: std::env::temp_dir().join("seaview-sessions"),
+        }
+    }
+}
+
+/// Mesh frames of a session, in memory up to a budget and on disk beyond it
+#[derive(Debug, Default, Clone)]
+pub struct FrameStorage {
+    /// Stored frames, shared between clones until one of them changes
+    frames: Arc<Vec<Slot>>,
+    /// Bytes of vertex and index data of the resident frames
+    resident_bytes: usize,
+    /// Frames before this one are spilled or cannot be
+    next_spill: usize,
+    /// Spill settings; `None` keeps every frame in memory
+    spill: Option<Spill>,
+}
+
+#[derive(Debug, Clone)]
+enum Slot {
+    Resident(Arc<Mesh>),
+    Spilled {
+        file: Arc<SpillFile>,
+        offset: u64,
+        len: u64,
+    },
+}
+
+#[derive(Debug, Clone)]
+struct Spill {
+    /// Directory new spill files are created in
+    dir: PathBuf,
+    /// Directory of the session, removed with its last spill file
+    session_dir: PathBuf,
+    ram_budget: usize,
+    /// File frames are currently appended to, created on the first spill
+    file: Option<Arc<SpillFile>>,
+}
+
+impl FrameStorage {
+    /// Create a frame storage that keeps every frame in memory
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Create a frame storage for a session that spills frames past the
+    /// budget of `config`
+    pub fn with_config(session_id: Uuid, config: &FrameStorageConfig) -> Self {
+        let session_dir = config.sessions_dir.join(session_id.to_string());
+        Self {
+            spill: Some(Spill {
+                dir: session_dir.join("meshes"),
+                session_dir,
+                ram_budget: config.ram_budget,
+                file: None,
+            }),
+            ..Self::default()
+        }
+    }
+
+    /// Add a mesh frame and return its index
+    pub fn add(&mut self, mesh: Mesh) -> usize {
+        self.resident_bytes += mesh_bytes(&mesh);
+        Arc::make_mut(&mut self.frames).push(Slot::Resident(Arc::new(mesh)));
+        self.spill_over_budget();
+        self.frames.len() - 1
+    }
+
+    /// Get a mesh frame by index, reading it back if it was spilled
+    pub fn get(&self, index: usize) -> Option<Arc<Mesh>> {
+        match self.frames.get(index)? {
+            Slot::Resident(mesh) => Some(mesh.clone()),
+            Slot::Spilled { file, offset, len } => match file.read(*offset, *len) {
+                Ok(mesh) => Some(Arc::new(mesh)),
+                Err(e) => {
+                    error!("Failed to read spilled frame {}: {}", index, e);
+                    None
+                }
+            },
+        }
+    }
+
+    /// Get the number of stored frames
+    pub fn count(&self) -> usize {
+        self.frames.len()
+    }
+
+    /// Get the number of frames that live on disk
+    pub fn spilled_count(&self) -> usize {
+        self.frames
+            .iter()
+            .filter(|slot| matches!(slot, Slot::Spilled { .. }))
+            .count()
+    }
+
+    /// Get the bytes of vertex and index data held in memory
+    pub fn resident_bytes(&self) -> usize {
+        self.resident_bytes
+    }
+
+    /// Clear all frames
+    ///
+    /// Clones keep their frames; later spills go to a new file.
+    pub fn clear(&mut self) {
+        self.frames = Arc::default();
+        self.resident_bytes = 0;
+        self.next_spill = 0;
+        if let Some(spill) = &mut self.spill {
+            spill.file = None;
+        }
+    }
+
+    /// Move the oldest resident frames to disk until the rest fit the budget
+    ///
+    /// Frames with attributes a spill record cannot hold stay in memory. If
+    /// writing fails, spilling stops and frames are kept in memory from then
+    /// on.
+    fn spill_over_budget(&mut self) {
+        while let Some(spill) = &mut self.spill {
+            if self.resident_bytes <= spill.ram_budget || self.next_spill >= self.frames.len() {
+                break;
+            }
+            let index = self.next_spill;
+            self.next_spill += 1;
+            let Slot::Resident(mesh) = &self.frames[index] else {
+                continue;
+            };
+            if !mesh.attributes().all(|(_, values)| can_permute(values)) {
+                continue;
+            }
+            let mesh = mesh.clone();
+
+            let appended = spill.current_file().and_then(|file| {
+                let (offset, len) = file.append(&mesh)?;
+                Ok(Slot::Spilled { file, offset, len })
+            });
+            match appended {
+                Ok(slot) => {
+                    Arc::make_mut(&mut self.frames)[index] = slot;
+                    self.resident_bytes -= mesh_bytes(&mesh);
+                }
+                Err(e) => {
+                    warn!(
+                        "Failed to spill frame {} to {}: {}; keeping frames in memory",
+                        index,
+                        spill.dir.display(),
+                        e
+                    );
+                    self.spill = None;
+                }
+            }
+        }
+    }
+}
+
+impl Spill {
+    /// File to append spilled frames to, creating it if needed
+    fn current_file(&mut self) -> io::Result<Arc<SpillFile>> {
+        if let Some(file) = &self.file {
+            return Ok(file.clone());
+        }
+        let file = Arc::new(SpillFile::create(&self.dir, &self.session_dir)?);
+        self.file = Some(file.clone());
+        Ok(file)
+    }
+}
+
+/// Append-only file of encoded frames, read through a memory map
+#[derive(Debug)]
+struct SpillFile {
+    path: PathBuf,
+    /// Outermost directory to remove once this file is gone and it is empty
+    root: PathBuf,
+    inner: Mutex<SpillInner>,
+}
+
+#[derive(Debug)]
+struct SpillInner {
+    file: File,
+    /// Bytes written so far
+    len: u64,
+    /// Map of the file, replaced when a read reaches past its end
+    map: Option<Arc<Mmap>>,
+    /// Attributes of the frames in the file, referred to by index
+    attributes: Vec<MeshVertexAttribute>,
+}
+
+impl SpillFile {
+    /// Create a new spill file in `dir`, which is `root` or inside it
+    fn create(dir: &Path, root: &Path) -> io::Result<Self> {
+        fs::create_dir_all(dir)?;
+        let path = dir.join(format!("{}.frames", Uuid::new_v4()));
+        let file = OpenOptions::new()
+            .read(true)
+            .append(true)
+            .create_new(true)
+            .open(&path)?;
+        Ok(Self {
+            path,
+            root: root.to_path_buf(),
+            inner: Mutex::new(SpillInner {
+                file,
+                len: 0,
+                map: None,
+                attributes: Vec::new(),
+            }),
+        })
+    }
+
+    /// Append a frame and return the offset and length of its record
+    fn append(&self, mesh: &Mesh) -> io::Result<(u64, u64)> {
+        let mut inner = self.inner.lock().unwrap();
+        let record = encode_mesh(mesh, &mut inner.attributes);
+        if let Err(e) = inner.file.write_all(&record) {
+            // Skip whatever part of the record made it to disk
+            inner.len = inner.file.metadata().map_or(inner.len, |m| m.len());
+            return Err(e);
+        }
+        let offset = inner.len;
+        inner.len += record.len() as u64;
+        Ok((offset, record.len() as u64))
+    }
+
+    /// Read back the frame whose record starts at `offset`
+    fn read(&self, offset: u64, len: u64) -> io::Result<Mesh> {
+        let (map, attributes) = {
+            let mut inner = self.inner.lock().unwrap();
+            if inner
+                .map
+                .as_ref()
+                .is_none_or(|map| (map.len() as u64) < offset + len)
+            {
+                // SAFETY: the file is private to this storage and only ever
+                // appended to, so the mapped bytes never change underneath.
+                inner.map = Some(Arc::new(unsafe { Mmap::map(&inner.file)? }));
+            }
+            (inner.map.clone().unwrap(), inner.attributes.clone())
+        };
+        decode_mesh(&map[offset as usize..(offset + len) as usize], &attributes)
+    }
+}
+
+impl Drop for SpillFile {
+    fn drop(&mut self) {
+        if let Err(e) = fs::remove_file(&self.path) {
+            warn!("Failed to remove spill file {}: {}", self.path.display(), e);
+        }
+        // Directories other files are still in stay
+        for dir in self.path.ancestors().skip(1) {
+            if fs::remove_dir(dir).is_err() || dir == self.root {
+                break;
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Spill records
+// ---------------------------------------------------------------------------
+
+/// Bytes of vertex and index data of a mesh.
+fn mesh_bytes(mesh: &Mesh) -> usize {
+    let indices = match mesh.indices() {
+        Some(Indices::U16(indices)) => indices.len() * 2,
+        Some(Indices::U32(indices)) => indices.len() * 4,
+        None => 0,
+    };
+    mesh.attributes()
+        .map(|(_, values)| values.get_bytes().len())
+        .sum::<usize>()
+        + indices
+}
+
+/// Encode a mesh whose attributes all pass [`can_permute`].
+///
+/// Attributes are stored as an index into `attributes`, which grows as new
+/// ones appear. Vertex data is written in native byte order; spill files
+/// never leave the machine that wrote them.
+fn encode_mesh(mesh: &Mesh, attributes: &mut Vec<MeshVertexAttribute>) -> Vec<u8> {
+    let topology = TOPOLOGIES
+        .iter()
+        .position(|&t| t == mesh.primitive_topology())
+        .unwrap_or(3);
+    let mut record = vec![topology as u8, mesh.asset_usage.bits()];
+    record.push(mesh.attributes().count() as u8);
+
+    for (attribute, values) in mesh.attributes() {
+        let slot = match attributes.iter().position(|a| a.id == attribute.id) {
+            Some(slot) => slot,
+            None => {
+                attributes.push(attribute.clone());
+                attributes.len() - 1
+            }
+        };
+        use VertexAttributeValues as V;
+        let tag: u8 = match values {
+            V::Float32(_) => 0,
+            V::Float32x2(_) => 1,
+            V::Float32x3(_) => 2,
+            V::Float32x4(_) => 3,
+            V::Uint32(_) => 4,
+            V::Uint16x4(_) => 5,
+            _ => 6,
+        };
+        let bytes = values.get_bytes();
+        record.extend_from_slice(&(slot as u16).to_le_bytes());
+        record.push(tag);
+        record.extend_from_slice(&(bytes.len() as u32).to_le_bytes());
+        record.extend_from_slice(bytes);
+    }
+
+    match mesh.indices() {
+        Some(Indices::U16(indices)) => {
+            record.push(1);
+            record.extend_from_slice(&(indices.len() as u32).to_le_bytes());
+            record.extend(indices.iter().flat_map(|i| i.to_ne_bytes()));
+        }
+        Some(Indices::U32(indices)) => {
+            record.push(2);
+            record.extend_from_slice(&(indices.len() as u32).to_le_bytes());
+            record.extend(indices.iter().flat_map(|i| i.to_ne_bytes()));
+        }
+        None => record.push(0),
+    }
+    record
+}
+
+/// Decode a record written by [`encode_mesh`].
+fn decode_mesh(bytes: &[u8], attributes: &[MeshVertexAttribute]) -> io::Result<Mesh> {
+    let mut record = Record(bytes);
+    let topology = *TOPOLOGIES
+        .get(record.u8()? as usize)
+        .ok_or_else(|| invalid("unknown topology"))?;
+    let usage = RenderAssetUsages::from_bits_truncate(record.u8()?);
+    let mut mesh = Mesh::new(topology, usage);
+
+    for _ in 0..record.u8()? {
+        let slot = u16::from_le_bytes(record.array()?) as usize;
+        let attribute = attributes
+            .get(slot)
+            .ok_or_else(|| invalid("unknown attribute"))?;
+        let tag = record.u8()?;
+        let len = record.u32()? as usize;
+        let data = record.take(len)?;
+
+        use VertexAttributeValues as V;
+        let values = match tag {
+            0 => V::Float32(scalars(data, f32::from_ne_bytes)),
+            1 => V::Float32x2(vectors(&scalars(data, f32::from_ne_bytes))),
+            2 => V::Float32x3(vectors(&scalars(data, f32::from_ne_bytes))),
+            3 => V::Float32x4(vectors(&scalars(data, f32::from_ne_bytes))),
+            4 => V::Uint32(scalars(data, u32::from_ne_bytes)),
+            5 => V::Uint16x4(vectors(&scalars(data, u16::from_ne_bytes))),
+            6 => V::Unorm8x4(vectors(data)),
+            _ => return Err(invalid("unknown attribute format")),
+        };
+        mesh.insert_attribute(attribute.clone(), values);
+    }
+
+    match record.u8()? {
+        0 => {}
+        1 => {
+            let count = record.u32()? as usize;
+            let data = record.take(count * 2)?;
+            mesh.insert_indices(Indices::U16(scalars(data, u16::from_ne_bytes)));
+        }
+        2 => {
+            let count = record.u32()? as usize;
+            let data = record.take(count * 4)?;
+            mesh.insert_indices(Indices::U32(scalars(data, u32::from_ne_bytes)));
+        }
+        _ => return Err(invalid("unknown index format")),
+    }
+    Ok(mesh)
+}
+
+/// Cursor over a spill record.
+struct Record<'a>(&'a [u8]);
+
+impl<'a> Record<'a> {
+    fn take(&mut self, len: usize) -> io::Result<&'a [u8]> {
+        if self.0.len() < len {
+            return Err(invalid("truncated frame record"));
+        }
+        let (head, rest) = self.0.split_at(len);
+        self.0 = rest;
+        Ok(head)
+    }
+
+    fn array<const N: usize>(&mut self) -> io::Result<[u8; N]> {
+        Ok(self.take(N)?.try_into().unwrap())
+    }
+
+    fn u8(&mut self) -> io::Result<u8> {
+        Ok(self.take(1)?[0])
+    }
+
+    fn u32(&mut self) -> io::Result<u32> {
+        Ok(u32::from_le_bytes(self.array()?))
+    }
+}
+
+fn invalid(message: &str) -> io::Error {
+    io::Error::new(io::ErrorKind::InvalidData, message)
+}
+
+fn scalars<T, const S: usize>(data: &[u8], from: fn([u8; S]) -> T) -> Vec<T> {
+    data.chunks_exact(S)
+        .map(|chunk| from(chunk.try_into().unwrap()))
+        .collect()
+}
+
+fn vectors<T: Copy, const N: usize>(values: &[T]) -> Vec<[T; N]> {
+    values
+        .chunks_exact(N)
+        .map(|chunk| std::array::from_fn(|i| chunk[i]))
+        .collect()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn triangle(x: f32) -> Mesh {
+        Mesh::new(
+            PrimitiveTopology::TriangleList,
+            RenderAssetUsages::default(),
+        )
+        .with_inserted_attribute(
+            Mesh::ATTRIBUTE_POSITION,
+            vec![[x, 0.0, 0.0], [x + 1.0, 0.0, 0.0], [x, 1.0, 0.0]],
+        )
+        .with_inserted_attribute(Mesh::ATTRIBUTE_NORMAL, vec![[0.0, 0.0, 1.0]; 3])
+        .with_inserted_indices(Indices::U16(vec![0, 1, 2]))
+    }
+
+    #[test]
+    fn test_frames_spill_past_budget_and_read_back() {
+        let dir = tempfile::tempdir().unwrap();
+        let config = FrameStorageConfig {
+            ram_budget: 2 * mesh_bytes(&triangle(0.0)),
+            sessions_dir: dir.path().to_path_buf(),
+        };
+        let id = Uuid::new_v4();
+        let mut storage = FrameStorage::with_config(id, &config);
+        for frame in 0..5 {
+            assert_eq!(storage.add(triangle(frame as f32)), frame);
+        }
+        assert_eq!(storage.spilled_count(), 3);
+        assert!(storage.resident_bytes() <= config.ram_budget);
+
+        // Clones share resident frames and outlive the original's frames
+        let snapshot = storage.clone();
+        assert!(Arc::ptr_eq(
+            &storage.get(4).unwrap(),
+            &snapshot.get(4).unwrap()
+        ));
+        storage.clear();
+        assert_eq!(storage.count(), 0);
+
+        for frame in 0..5 {
+            let mesh = snapshot.get(frame).unwrap();
+            let Some(VertexAttributeValues::Float32x3(positions)) =
+                mesh.attribute(Mesh::ATTRIBUTE_POSITION)
+            else {
+                panic!("no positions in frame {frame}");
+            };
+            assert_eq!(positions[1], [frame as f32 + 1.0, 0.0, 0.0]);
+            assert!(mesh.attribute(Mesh::ATTRIBUTE_NORMAL).is_some());
+            assert!(matches!(mesh.indices(), Some(Indices::U16(i)) if i == &[0, 1, 2]));
+        }
+
+        // The spill file and the session's directory go away with the last
+        // storage using them
+        let session_dir = dir.path().join(id.to_string());
+        assert_eq!(fs::read_dir(session_dir.join("meshes")).unwrap().count(), 1);
+        drop(snapshot);
+        assert!(!session_dir.exists());
+        assert!(dir.path().exists());
+    }
+
+    #[test]
+    fn test_default_sessions_dir_is_absolute() {
+        assert!(FrameStorageConfig::default().sessions_dir.is_absolute());
+    }
+}
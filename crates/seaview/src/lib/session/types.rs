@@ -6,8 +6,11 @@ use bevy::prelude::*;
 use serde::{Deserialize, Serialize};
 use std::collections::HashMap;
 use std::path::PathBuf;
+use std::sync::Arc;
 use uuid::Uuid;
 
+use super::storage::{FrameStorage, FrameStorageConfig};
+
 /// A session represents a collection of mesh frames from a specific source
 #[derive(Debug, Clone, Serialize, Deserialize)]
 pub struct Session {
@@ -37,15 +40,21 @@ pub struct Session {
 impl Session {
     /// Create a new session with the given name and source
     pub fn new(name: String, source: SessionSource) -> Self {
+        Self::with_storage(name, source, &FrameStorageConfig::default())
+    }
+
+    /// Create a new session whose frames spill to disk as `storage` says
+    pub fn with_storage(name: String, source: SessionSource, storage: &FrameStorageConfig) -> Self {
         let now = chrono::Local::now();
+        let id = Uuid::new_v4();
         Self {
-            id: Uuid::new_v4(),
+            id,
             name,
             created_at: now,
             last_accessed: now,
             source,
             metadata: SessionMetadata::default(),
-            frames: FrameStorage::new(),
+            frames: FrameStorage::with_config(id, storage),
         }
     }
 
@@ -68,7 +77,7 @@ impl Session {
     }
 
     /// Get a mesh frame by index
-    pub fn get_frame(&self, index: usize) -> Option<&Mesh> {
+    pub fn get_frame(&self, index: usize) -> Option<Arc<Mesh>> {
         self.frames.get(index)
     }
 }
@@ -142,41 +151,6 @@ pub struct SpatialBounds {
     pub max: Vec3,
 }
 
-/// In-memory storage for mesh frames
-#[derive(Debug, Default, Clone)]
-pub struct FrameStorage {
-    /// Stored mesh frames
-    frames: Vec<Mesh>,
-}
-
-impl FrameStorage {
-    /// Create a new frame storage
-    pub fn new() -> Self {
-        Self { frames: Vec::new() }
-    }
-
-    /// Add a mesh frame and return its index
-    pub fn add(&mut self, mesh: Mesh) -> usize {
-        self.frames.push(mesh);
-        self.frames.len() - 1
-    }
-
-    /// Get a mesh frame by index
-    pub fn get(&self, index: usize) -> Option<&Mesh> {
-        self.frames.get(index)
-    }
-
-    /// Get the number of stored frames
-    pub fn count(&self) -> usize {
-        self.frames.len()
-    }
-
-    /// Clear all frames
-    pub fn clear(&mut self) {
-        self.frames.clear();
-    }
-}
-
 /// Session creation parameters
 #[derive(Debug, Clone)]
 pub struct CreateSessionParams {
@@ -59,12 +59,18 @@ impl CameraSettings {
 pub struct SequenceSettings {
     /// Source coordinate system: "yup", "zup", "fluidx3d"
     pub source_coordinates: Option<String>,
+    /// Reorder frames for the GPU vertex cache as they load
+    pub optimize_meshes: Option<bool>,
+    /// Simplified levels of detail built per frame (0 disables)
+    pub lod_levels: Option<usize>,
 }
 
 impl Default for SequenceSettings {
     fn default() -> Self {
         Self {
             source_coordinates: None,
+            optimize_meshes: None,
+            lod_levels: None,
         }
     }
 }
@@ -295,6 +301,8 @@ mod tests {
             }),
             sequence: Some(SequenceSettings {
                 source_coordinates: Some("fluidx3d".to_string()),
+                optimize_meshes: Some(true),
+                lod_levels: Some(2),
             }),
             playback: Some(PlaybackSettings {
                 speed: Some(1.5),
@@ -312,6 +320,8 @@ mod tests {
 
         let seq = recovered.sequence.unwrap();
         assert_eq!(seq.source_coordinates.unwrap(), "fluidx3d");
+        assert_eq!(seq.optimize_meshes, Some(true));
+        assert_eq!(seq.lod_levels, Some(2));
 
         let pb = recovered.playback.unwrap();
         assert_eq!(pb.speed.unwrap(), 1.5);
@@ -286,9 +286,11 @@ fn handle_save_view(
             settings_res
                 .settings
                 .set_playback(ui_state.playback.speed, ui_state.playback.loop_enabled);
+            let previous = settings_res.settings.sequence.take().unwrap_or_default();
             settings_res.settings.sequence =
                 Some(seaview::lib::settings::SequenceSettings {
                     source_coordinates: Some(source_orientation.to_string()),
+                    ..previous
                 });
 
             match settings_res.save() {